@@ -20,7 +20,35 @@ local settings = {
     aspect_ratio_x_mult = 1.18,
     aspect_ratio_y_mult = 0.84,
     use_rumble = 1,
-    debug_gamedata_mapping = 0
+    debug_gamedata_mapping = 0,
+    fast_math = 0,
+    mmap_gamedata = 1,
+    log_levels = "",
+    io_trace = 0,
+    readahead = 1,
+    import_stats = 0,
+    target_fps = 0,
+    gl_state_cache = 1,
+    gl_uniform_cache = 1,
+    gl_record_frames = 0,
+    gl_record_start = 0,
+    perf_hud = 1,
+    frame_stats = 0,
+    stutter_factor = 2.0,
+    dynamic_resolution = 0,
+    dynamic_resolution_min = 0.5,
+    render_scale = 1.0,
+    upscale_filter = 1,
+    shader_cache = 1,
+    async_shaders = 1,
+    shader_precision = 0,
+    shader_overrides = 1,
+    texture_transcode = 0,
+    texture_budget = 0,
+    async_textures = 0,
+    vertex_stream = 0,
+    draw_batch = 0,
+    framebuffer_discard = 0
 }
 
 local defaultSettings = {}
@@ -154,13 +182,242 @@ local meta = {
         step = 1,
         label = "Debug File Logging",
         hint = "Log all file open/close operations"
+    },
+    fast_math = {
+        type = "int",
+        min = 0,
+        max = 2,
+        step = 1,
+        label = "Fast Math",
+        hint = "Faster, less precise math functions (2 = also log accuracy report)"
+    },
+    mmap_gamedata = {
+        type = "int",
+        min = 0,
+        max = 2,
+        step = 1,
+        label = "Mapped Archives",
+        hint = "Read game archives through memory mappings (2 = also log benchmark)"
+    },
+    log_levels = {
+        type = "string",
+        maxlen = 255,
+        label = "Log Levels"
+    },
+    io_trace = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "I/O Trace",
+        hint = "Record all game file reads to iotrace.bin"
+    },
+    readahead = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Archive Prefetch",
+        hint = "Read level data ahead in the background based on earlier runs"
+    },
+    import_stats = {
+        type = "int",
+        min = 0,
+        max = 2,
+        step = 1,
+        label = "Import Stats",
+        hint = "Log library call counts (2 = also sample call times)"
+    },
+    target_fps = {
+        type = "int",
+        min = 0,
+        max = 60,
+        values = {0, 30, 40, 45, 60},
+        label = "Frame Rate Limit",
+        hint = "Pace frames evenly at this rate (Off = vsync only)"
+    },
+    gl_state_cache = {
+        type = "int",
+        min = 0,
+        max = 2,
+        step = 1,
+        label = "GL State Cache",
+        hint = "Skip redundant GL state changes (2 = also check against GL)"
+    },
+    gl_uniform_cache = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Uniform Cache",
+        hint = "Skip shader constant uploads that repeat the current values"
+    },
+    gl_record_frames = {
+        type = "int",
+        min = 0,
+        max = 600,
+        step = 60,
+        label = "GL Trace Frames",
+        hint = "Record this many frames of GL calls to gltrace.bin"
+    },
+    gl_record_start = {
+        type = "int",
+        min = 0,
+        max = 36000,
+        step = 600,
+        label = "GL Trace Start",
+        hint = "Frame to start the GL trace at (600 frames = 10 s at 60 fps)"
+    },
+    perf_hud = {
+        type = "int",
+        min = 0,
+        max = 2,
+        step = 1,
+        label = "Performance Overlay",
+        hint = "0 = off, 1 = toggle with Select+L1, 2 = shown at start"
+    },
+    frame_stats = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Frame Time Stats",
+        hint = "Write frame time percentiles per level to framestats.csv"
+    },
+    stutter_factor = {
+        type = "float",
+        min = 1.5,
+        max = 5.0,
+        step = 0.5,
+        label = "Stutter Threshold",
+        hint = "Frames this many times the median frame time are stutters"
+    },
+    dynamic_resolution = {
+        type = "int",
+        min = 0,
+        max = 60,
+        step = 5,
+        label = "Dynamic Resolution",
+        hint = "Lower the resolution in heavy scenes to hold this frame rate (0 = off)"
+    },
+    dynamic_resolution_min = {
+        type = "float",
+        min = 0.25,
+        max = 1.0,
+        step = 0.05,
+        label = "Min Resolution Scale",
+        hint = "Lowest resolution dynamic resolution may drop to"
+    },
+    render_scale = {
+        type = "float",
+        min = 0.25,
+        max = 1.0,
+        step = 0.05,
+        label = "Render Scale",
+        hint = "Render at this fraction of the screen resolution and upscale"
+    },
+    upscale_filter = {
+        type = "int",
+        min = 0,
+        max = 2,
+        step = 1,
+        label = "Upscale Filter",
+        hint = "0 = bilinear, 1 = sharp bilinear, 2 = sharp bicubic"
+    },
+    shader_cache = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Shader Cache",
+        hint = "Keep compiled shaders between runs for faster loading"
+    },
+    async_shaders = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Background Shader Compiling",
+        hint = "Compile shaders in the background while the game loads"
+    },
+    shader_precision = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Lower Shader Precision",
+        hint = "Run pixel shaders at medium precision where it is safe"
+    },
+    shader_overrides = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Shader Overrides",
+        hint = "Use the hand-optimized shaders in gamedata/es2/overrides"
+    },
+    texture_transcode = {
+        type = "int",
+        min = 0,
+        max = 2,
+        step = 1,
+        label = "Texture Compression",
+        hint = "0 = off, 1 = 16-bit, 2 = ETC (slow on the first run)"
+    },
+    texture_budget = {
+        type = "int",
+        min = 0,
+        max = 1024,
+        step = 16,
+        label = "Texture Memory (MB)",
+        hint = "Lower unused textures' resolution above this, 0 = off"
+    },
+    async_textures = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Async Texture Uploads",
+        hint = "Upload textures on a background thread"
+    },
+    vertex_stream = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Stream Vertex Arrays",
+        hint = "Copy vertices drawn from memory into GPU buffers"
+    },
+    draw_batch = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Merge Draw Calls",
+        hint = "Draw runs of small draws with the same state as one"
+    },
+    framebuffer_discard = {
+        type = "int",
+        min = 0,
+        max = 1,
+        step = 1,
+        label = "Discard Framebuffers",
+        hint = "Skip writing back depth the GPU won't need again"
     }
 }
 
 -- Display order for settings
 local order = {"stick_deadzone",  "force_widescreen", "use_bloom", "use_rumble", "trilinear_filter", "disable_mipmaps", "language",
-               "character_shadows", "drop_highest_lod", "vsync_enabled", "decal_limit", "debris_limit",
-               "aspect_ratio_x_mult", "aspect_ratio_y_mult", "debug_gamedata_mapping"}
+               "character_shadows", "drop_highest_lod", "vsync_enabled", "target_fps", "decal_limit", "debris_limit",
+               "aspect_ratio_x_mult", "aspect_ratio_y_mult", "fast_math", "mmap_gamedata", "readahead", "debug_gamedata_mapping", "io_trace", "import_stats",
+               "gl_state_cache", "gl_uniform_cache",
+               "gl_record_frames", "gl_record_start", "perf_hud",
+               "frame_stats", "stutter_factor",
+               "dynamic_resolution", "dynamic_resolution_min",
+               "render_scale", "upscale_filter", "shader_cache",
+               "async_shaders", "shader_precision", "shader_overrides",
+               "texture_transcode", "texture_budget", "async_textures",
+               "vertex_stream", "draw_batch", "framebuffer_discard"}
 
 -- Language names
 local languageNames = {
@@ -312,6 +569,36 @@ local function serialize()
     push("aspect_ratio_y_mult", settings.aspect_ratio_y_mult)
     push("use_rumble", settings.use_rumble)
     push("debug_gamedata_mapping", settings.debug_gamedata_mapping)
+    push("fast_math", settings.fast_math)
+    push("mmap_gamedata", settings.mmap_gamedata)
+    if settings.log_levels ~= "" then
+        push("log_levels", settings.log_levels)
+    end
+    push("io_trace", settings.io_trace)
+    push("readahead", settings.readahead)
+    push("import_stats", settings.import_stats)
+    push("target_fps", settings.target_fps)
+    push("gl_state_cache", settings.gl_state_cache)
+    push("gl_uniform_cache", settings.gl_uniform_cache)
+    push("gl_record_frames", settings.gl_record_frames)
+    push("gl_record_start", settings.gl_record_start)
+    push("perf_hud", settings.perf_hud)
+    push("frame_stats", settings.frame_stats)
+    push("stutter_factor", settings.stutter_factor)
+    push("dynamic_resolution", settings.dynamic_resolution)
+    push("dynamic_resolution_min", settings.dynamic_resolution_min)
+    push("render_scale", settings.render_scale)
+    push("upscale_filter", settings.upscale_filter)
+    push("shader_cache", settings.shader_cache)
+    push("async_shaders", settings.async_shaders)
+    push("shader_precision", settings.shader_precision)
+    push("shader_overrides", settings.shader_overrides)
+    push("texture_transcode", settings.texture_transcode)
+    push("texture_budget", settings.texture_budget)
+    push("async_textures", settings.async_textures)
+    push("vertex_stream", settings.vertex_stream)
+    push("draw_batch", settings.draw_batch)
+    push("framebuffer_discard", settings.framebuffer_discard)
     return table.concat(out, "\n") .. "\n"
 end
 
@@ -398,6 +685,16 @@ function config.adjustValue(key, dir)
             
             -- If no valid language found, keep current
             return false
+        elseif m.values then
+            -- step through the allowed values
+            local idx = 1
+            for i, v in ipairs(m.values) do
+                if v <= settings[key] then
+                    idx = i
+                end
+            end
+            settings[key] = m.values[clamp(idx + dir, 1, #m.values)]
+            return true
         else
             settings[key] = clamp(settings[key] + (dir * m.step), m.min, m.max)
             return true
@@ -433,6 +730,8 @@ function config.formatValue(key)
             return languageNames[val] or ("Unknown (" .. tostring(val) .. ")")
         elseif key == "character_shadows" then
             return shadowNames[val] or ("Unknown (" .. tostring(val) .. ")")
+        elseif key == "target_fps" then
+            return (val == 0) and "Off" or tostring(val)
         else
             return tostring(val)
         end
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Summarize an iotrace.bin written with io_trace 1 in conf/config.txt.
+
+The trace is split into segments at marker events (level transitions) and,
+with --gap, wherever no file was touched for that many seconds. For each
+segment it prints the bytes read per file, a histogram of seek distances and
+the time threads spent blocked in file I/O.
+
+usage: analyze_iotrace.py [--gap SECONDS] [--top N] iotrace.bin
+"""
+
+import argparse
+import collections
+import struct
+import sys
+
+MAGIC = b"MPIOTRC1"
+HEADER = struct.Struct("<8sII")
+# must match IoTraceEvent in src/iotrace.h
+EVENT = struct.Struct("<QqIIIHBB")
+
+OPEN, READ, SEEK, CLOSE, MARK = 1, 2, 3, 4, 5
+
+
+def read_events(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, version, event_size = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or event_size != EVENT.size:
+        sys.exit("%s: not an iotrace file (or a different version)" % path)
+    pos = HEADER.size
+    while pos + EVENT.size <= len(data):
+        time_ns, offset, size, duration, tid, file, kind, flags = \
+            EVENT.unpack_from(data, pos)
+        pos += EVENT.size
+        text = None
+        if kind in (OPEN, MARK):
+            text = data[pos:pos + size].decode("utf-8", "replace")
+            pos += size
+        yield time_ns, offset, size, duration, tid, file, kind, flags, text
+
+
+class Segment:
+    def __init__(self, label, start_ns):
+        self.label = label
+        self.start_ns = start_ns
+        self.end_ns = start_ns
+        self.bytes_by_file = collections.Counter()
+        self.reads = 0
+        self.seeks = 0
+        self.opens = 0
+        self.failed_opens = 0
+        self.seek_hist = collections.Counter()
+        self.blocked_ns = collections.Counter()
+
+
+def bucket(distance):
+    # power of two buckets: 0, <1K, <2K, <4K, ...
+    if distance == 0:
+        return 0
+    return max(distance.bit_length() - 9, 1)
+
+
+def bucket_label(b):
+    if b == 0:
+        return "0"
+    return "<%s" % human(1 << (b + 9))
+
+
+def human(n):
+    for unit in ("B", "K", "M", "G"):
+        if n < 1024:
+            return "%d%s" % (n, unit)
+        n //= 1024
+    return "%dT" % n
+
+
+def analyze(events, gap_ns):
+    names = {}
+    # position after the last read per file, to measure how far seeks jump
+    last_end = {}
+    segments = [Segment("start", 0)]
+    for time_ns, offset, size, duration, tid, file, kind, flags, text in events:
+        seg = segments[-1]
+        if kind == MARK or (gap_ns and seg.reads and
+                            time_ns - seg.end_ns > gap_ns):
+            seg = Segment(text if kind == MARK else "after idle gap", time_ns)
+            segments.append(seg)
+        seg.end_ns = max(seg.end_ns, time_ns + duration)
+        seg.blocked_ns[tid] += duration
+
+        if kind == OPEN:
+            seg.opens += 1
+            if file:
+                names[file] = text
+                last_end[file] = 0
+            else:
+                seg.failed_opens += 1
+        elif kind == READ:
+            seg.reads += 1
+            seg.bytes_by_file[names.get(file, "#%d" % file)] += size
+            last_end[file] = offset + size
+        elif kind == SEEK:
+            seg.seeks += 1
+            seg.seek_hist[bucket(abs(offset - last_end.get(file, 0)))] += 1
+    return [s for s in segments if s.opens or s.reads or s.seeks]
+
+
+def report(segments, top):
+    for seg in segments:
+        duration = (seg.end_ns - seg.start_ns) / 1e9
+        total = sum(seg.bytes_by_file.values())
+        print("== %s (at %.2f s, %.2f s long)" %
+              (seg.label, seg.start_ns / 1e9, duration))
+        print("   %s read in %d reads, %d seeks, %d opens (%d failed)" %
+              (human(total), seg.reads, seg.seeks, seg.opens,
+               seg.failed_opens))
+        for name, count in seg.bytes_by_file.most_common(top):
+            print("   %10s  %s" % (human(count), name))
+        if seg.seek_hist:
+            print("   seek distance from the end of the previous read:")
+            peak = max(seg.seek_hist.values())
+            for b in sorted(seg.seek_hist):
+                count = seg.seek_hist[b]
+                print("   %8s %7d %s" % (bucket_label(b), count,
+                                        "#" * max(1, 40 * count // peak)))
+        print("   time blocked in file I/O per thread:")
+        for tid, ns in seg.blocked_ns.most_common():
+            print("   %8d %9.1f ms" % (tid, ns / 1e6))
+        print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("trace")
+    parser.add_argument("--gap", type=float, default=0.0,
+                        help="also start a new segment after this many "
+                             "seconds without file I/O")
+    parser.add_argument("--top", type=int, default=10,
+                        help="number of files listed per segment")
+    args = parser.parse_args()
+    report(analyze(read_events(args.trace), int(args.gap * 1e9)), args.top)
+
+
+if __name__ == "__main__":
+    main()
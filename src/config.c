@@ -33,6 +33,34 @@
   CONFIG_VAR_FLOAT(aspect_ratio_y_mult);                                       \
   CONFIG_VAR_INT(use_rumble);                                                  \
   CONFIG_VAR_INT(debug_gamedata_mapping);                                      \
+  CONFIG_VAR_INT(fast_math);                                                   \
+  CONFIG_VAR_INT(mmap_gamedata);                                               \
+  CONFIG_VAR_STR(log_levels);                                                  \
+  CONFIG_VAR_INT(io_trace);                                                    \
+  CONFIG_VAR_INT(readahead);                                                   \
+  CONFIG_VAR_INT(import_stats);                                                \
+  CONFIG_VAR_INT(target_fps);                                                  \
+  CONFIG_VAR_INT(gl_state_cache);                                              \
+  CONFIG_VAR_INT(gl_uniform_cache);                                            \
+  CONFIG_VAR_INT(gl_record_frames);                                            \
+  CONFIG_VAR_INT(gl_record_start);                                             \
+  CONFIG_VAR_INT(perf_hud);                                                    \
+  CONFIG_VAR_INT(frame_stats);                                                 \
+  CONFIG_VAR_FLOAT(stutter_factor);                                            \
+  CONFIG_VAR_INT(dynamic_resolution);                                          \
+  CONFIG_VAR_FLOAT(dynamic_resolution_min);                                    \
+  CONFIG_VAR_FLOAT(render_scale);                                              \
+  CONFIG_VAR_INT(upscale_filter);                                              \
+  CONFIG_VAR_INT(shader_cache);                                                \
+  CONFIG_VAR_INT(async_shaders);                                               \
+  CONFIG_VAR_INT(shader_precision);                                            \
+  CONFIG_VAR_INT(shader_overrides);                                            \
+  CONFIG_VAR_INT(texture_transcode);                                           \
+  CONFIG_VAR_INT(texture_budget);                                              \
+  CONFIG_VAR_INT(async_textures);                                              \
+  CONFIG_VAR_INT(vertex_stream);                                               \
+  CONFIG_VAR_INT(draw_batch);                                                  \
+  CONFIG_VAR_INT(framebuffer_discard);                                         \
 
 Config config;
 
@@ -84,6 +112,33 @@ int read_config(const char *file) {
   config.aspect_ratio_y_mult = 0.84f;
   config.use_rumble = 1; // enable rumble by default
   config.debug_gamedata_mapping = 0; // disable debug logging by default
+  config.fast_math = 0; // use precise libm math by default
+  config.mmap_gamedata = 1; // read archives through file mappings
+  config.io_trace = 0;
+  config.readahead = 1; // prefetch level archives in the background
+  config.import_stats = 0;
+  config.target_fps = 0; // no frame rate limit by default
+  config.gl_state_cache = 1;
+  config.gl_uniform_cache = 1;
+  config.gl_record_frames = 0;
+  config.gl_record_start = 0;
+  config.perf_hud = 1;
+  config.frame_stats = 0;
+  config.stutter_factor = 2.0f;
+  config.dynamic_resolution = 0;
+  config.dynamic_resolution_min = 0.5f;
+  config.render_scale = 1.0f;
+  config.upscale_filter = 1;
+  config.shader_cache = 1;
+  config.async_shaders = 1;
+  config.shader_precision = 0;
+  config.shader_overrides = 1;
+  config.texture_transcode = 0;
+  config.texture_budget = 0;
+  config.async_textures = 0;
+  config.vertex_stream = 0;
+  config.draw_batch = 0;
+  config.framebuffer_discard = 0;
 
   FILE *f = fopen(file, "r");
   if (f == NULL)
@@ -141,3 +196,53 @@ int write_config(const char *file) {
 
   return 0;
 }
+
+static void write_quoted(FILE *f, const char *s, char escape) {
+  fputc('"', f);
+  for (; *s; ++s) {
+    if (*s == '"' || *s == escape)
+      fputc(escape, f);
+    fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+void write_config_json(FILE *f) {
+  const char *sep = "";
+  fputc('{', f);
+#define CONFIG_VAR_INT(var)                                                    \
+  fprintf(f, "%s\"%s\": %d", sep, #var, config.var), sep = ", "
+#define CONFIG_VAR_FLOAT(var)                                                  \
+  fprintf(f, "%s\"%s\": %g", sep, #var, config.var), sep = ", "
+#define CONFIG_VAR_STR(var)                                                    \
+  fprintf(f, "%s\"%s\": ", sep, #var);                                         \
+  write_quoted(f, config.var, '\\'), sep = ", "
+  CONFIG_VARS
+#undef CONFIG_VAR_INT
+#undef CONFIG_VAR_FLOAT
+#undef CONFIG_VAR_STR
+  fputc('}', f);
+}
+
+void write_config_csv(FILE *f, int header) {
+  const char *sep = "";
+  if (header) {
+#define CONFIG_VAR_INT(var) fprintf(f, "%s%s", sep, #var), sep = ","
+#define CONFIG_VAR_FLOAT(var) CONFIG_VAR_INT(var)
+#define CONFIG_VAR_STR(var) CONFIG_VAR_INT(var)
+    CONFIG_VARS
+#undef CONFIG_VAR_INT
+#undef CONFIG_VAR_FLOAT
+#undef CONFIG_VAR_STR
+    return;
+  }
+#define CONFIG_VAR_INT(var) fprintf(f, "%s%d", sep, config.var), sep = ","
+#define CONFIG_VAR_FLOAT(var) fprintf(f, "%s%g", sep, config.var), sep = ","
+#define CONFIG_VAR_STR(var)                                                    \
+  fputs(sep, f);                                                               \
+  write_quoted(f, config.var, '"'), sep = ","
+  CONFIG_VARS
+#undef CONFIG_VAR_INT
+#undef CONFIG_VAR_FLOAT
+#undef CONFIG_VAR_STR
+}
@@ -10,6 +10,8 @@
 #ifndef __CONFIG_H__
 #define __CONFIG_H__
 
+#include <stdio.h>
+
 // should be enough for pretend purposes
 #define MEMORY_MB 256
 
@@ -42,11 +44,42 @@ typedef struct {
   float aspect_ratio_y_mult; // aspect ratio multiplier for Y axis
   int use_rumble; // 0=disabled, 1=enabled
   int debug_gamedata_mapping; // 0=disabled, 1=enabled (debug file open/close)
+  int fast_math; // 0=libm, 1=fast math imports, 2=fast math + accuracy report
+  int mmap_gamedata; // 0=stdio, 1=map read-only gamedata files, 2=1+benchmark
+  char log_levels[0x100]; // per subsystem log levels, e.g. "game=warn,gl=debug"
+  int io_trace; // 0=disabled, 1=write file accesses to iotrace.bin
+  int readahead; // 0=disabled, 1=prefetch archive ranges read in earlier runs
+  int import_stats; // 0=disabled, 1=count import calls, 2=1+sample latency
+  int target_fps; // 0=uncapped (vsync only), otherwise frame rate limit
+  int gl_state_cache; // 0=disabled, 1=drop redundant GL state, 2=1+verify
+  int gl_uniform_cache; // 0=disabled, 1=drop repeated uniform uploads
+  int gl_record_frames; // 0=disabled, otherwise frames to write to gltrace.bin
+  int gl_record_start; // frame to start recording draws from
+  int perf_hud; // 0=disabled, 1=hidden until toggled, 2=shown
+  int frame_stats; // 0=disabled, 1=write frame time summaries on exit
+  float stutter_factor; // frames this many times the median are stutters
+  int dynamic_resolution; // 0=native resolution, otherwise fps to scale for
+  float dynamic_resolution_min; // lowest resolution scale (0.25 - 1.0)
+  float render_scale; // resolution the game renders at, 1.0=screen's
+  int upscale_filter; // 0=bilinear, 1=sharp bilinear, 2=deringed bicubic
+  int shader_cache; // 0=disabled, 1=keep linked programs in conf/shadercache
+  int async_shaders; // 0=compile on the game thread, 1=in the background
+  int shader_precision; // 0=as written, 1=lower fragment shaders to mediump
+  int shader_overrides; // 0=disabled, 1=use the shaders in es2/overrides
+  int texture_transcode; // RGB(A) textures as 0=they are, 1=16-bit, 2=ETC
+  int texture_budget;    // texture memory in MB before mips are dropped, 0=off
+  int async_textures;    // 0=upload textures on the game thread, 1=on a worker
+  int vertex_stream; // 0=draw from client arrays, 1=stream them into buffers
+  int draw_batch;    // 1=merge consecutive draws with the same state
+  int framebuffer_discard; // 1=discard attachments that needn't be kept
 } Config;
 
 extern Config config;
 
 int read_config(const char *file);
 int write_config(const char *file);
+// all settings as a JSON object, or as a CSV header or row (no newline)
+void write_config_json(FILE *f);
+void write_config_csv(FILE *f, int header);
 
 #endif
@@ -0,0 +1,377 @@
+/* draw_batch.c -- consecutive draws with the same state merged into one
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Particles, decals and the HUD are drawn as many small glDrawElements calls
+// one right after the other, with nothing changed in between. Every GL import
+// that could change what a draw does goes through this layer, so a draw that
+// directly follows another one is known to have the same state. Such draws
+// are held back and their indices put one after the other, and the whole run
+// is drawn with one call when the state changes, or at swap.
+//
+// Only triangle, line and point lists can be joined. Indices from client
+// memory are copied, as the game may change them once the call returns;
+// indices in a buffer are joined when they follow each other in it. Vertices
+// from client memory can change the same way, so draws with client-side
+// attributes are never held back. Attribute pointers set again as they were
+// don't end a run, and the layer goes below the state and uniform caches so
+// that the other calls that change nothing are dropped before they get here.
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "draw_batch.h"
+#include "gl_trace.h"
+#include "log.h"
+
+// calls that need a hand-written wrapper
+#define DRAW_BATCH_SPECIAL_CALLS(X)                                            \
+  X(glClear)                                                                   \
+  X(glBindBuffer)                                                              \
+  X(glEnableVertexAttribArray)                                                 \
+  X(glDisableVertexAttribArray)                                                \
+  X(glDeleteTextures)                                                          \
+  X(glDeleteBuffers)                                                           \
+  X(glDeleteFramebuffers)                                                      \
+  X(glDeleteRenderbuffers)                                                     \
+  X(glBufferData)                                                              \
+  X(glTexImage2D)                                                              \
+  X(glCompressedTexImage2D)                                                    \
+  X(glUniform1fv)                                                              \
+  X(glUniform2fv)                                                              \
+  X(glUniform3fv)                                                              \
+  X(glUniform4fv)                                                              \
+  X(glUniformMatrix3fv)                                                        \
+  X(glUniformMatrix4fv)                                                        \
+  X(glVertexAttrib4fv)                                                         \
+  X(glVertexAttribPointer)                                                     \
+  X(glDrawArrays)                                                              \
+  X(glDrawElements)                                                            \
+  X(glReadPixels)
+
+#define NEXT(name, ...) __typeof__(&name) name;
+
+static struct {
+  GL_TRACE_CALLS(NEXT, NEXT, NEXT, NEXT, NEXT, NEXT)
+  DRAW_BATCH_SPECIAL_CALLS(NEXT)
+} next;
+
+typedef struct {
+  int enabled;
+  GLint size;
+  GLenum type;
+  GLboolean normalized;
+  GLsizei stride;
+  const void *pointer;
+  GLuint buffer; // bound to GL_ARRAY_BUFFER when the pointer was set
+} Attrib;
+
+typedef struct {
+  GLsizei draws;  // calls merged so far, 0 when nothing is held back
+  GLenum mode;
+  GLenum type;
+  GLsizei count;  // indices
+  GLuint buffer;  // element buffer, or 0 for the copied indices
+  size_t offset;  // of the first index in the buffer
+} Batch;
+
+DrawBatchCounters draw_batch_last_frame;
+
+static Batch batch;
+static uint32_t indices[DRAW_BATCH_INDEX_BYTES / sizeof(uint32_t)];
+static Attrib attribs[DRAW_BATCH_MAX_ATTRIBS];
+static GLuint array_buffer = 0;
+static GLuint element_buffer = 0;
+
+static DrawBatchCounters frame;
+static unsigned long long total_draws = 0;
+static unsigned long long total_batches = 0;
+static unsigned long long total_calls = 0; // all glDrawElements calls
+static unsigned int frames = 0;
+
+static size_t index_size(GLenum type) {
+  switch (type) {
+  case GL_UNSIGNED_BYTE:
+    return 1;
+  case GL_UNSIGNED_SHORT:
+    return 2;
+  default:
+    return 4;
+  }
+}
+
+void draw_batch_flush(void) {
+  if (!batch.draws)
+    return;
+  if (batch.draws > 1) {
+    frame.draws += batch.draws;
+    frame.batches++;
+  }
+  next.glDrawElements(batch.mode, batch.count, batch.type,
+                      batch.buffer ? (const void *)(uintptr_t)batch.offset
+                                   : indices);
+  batch.draws = 0;
+}
+
+// wrappers for the plain calls
+#define FLUSH0(name)                                                           \
+  static void batch_##name(void) {                                             \
+    draw_batch_flush();                                                        \
+    next.name();                                                               \
+  }
+#define FLUSH1(name, A)                                                        \
+  static void batch_##name(GL_TRACE_TYPE_##A a0) {                             \
+    draw_batch_flush();                                                        \
+    next.name(a0);                                                             \
+  }
+#define FLUSH2(name, A, B)                                                     \
+  static void batch_##name(GL_TRACE_TYPE_##A a0, GL_TRACE_TYPE_##B a1) {       \
+    draw_batch_flush();                                                        \
+    next.name(a0, a1);                                                         \
+  }
+#define FLUSH3(name, A, B, C)                                                  \
+  static void batch_##name(GL_TRACE_TYPE_##A a0, GL_TRACE_TYPE_##B a1,         \
+                           GL_TRACE_TYPE_##C a2) {                             \
+    draw_batch_flush();                                                        \
+    next.name(a0, a1, a2);                                                     \
+  }
+#define FLUSH4(name, A, B, C, D)                                               \
+  static void batch_##name(GL_TRACE_TYPE_##A a0, GL_TRACE_TYPE_##B a1,         \
+                           GL_TRACE_TYPE_##C a2, GL_TRACE_TYPE_##D a3) {       \
+    draw_batch_flush();                                                        \
+    next.name(a0, a1, a2, a3);                                                 \
+  }
+#define FLUSH5(name, A, B, C, D, E)                                            \
+  static void batch_##name(GL_TRACE_TYPE_##A a0, GL_TRACE_TYPE_##B a1,         \
+                           GL_TRACE_TYPE_##C a2, GL_TRACE_TYPE_##D a3,         \
+                           GL_TRACE_TYPE_##E a4) {                             \
+    draw_batch_flush();                                                        \
+    next.name(a0, a1, a2, a3, a4);                                             \
+  }
+
+GL_TRACE_CALLS(FLUSH0, FLUSH1, FLUSH2, FLUSH3, FLUSH4, FLUSH5)
+FLUSH1(glClear, BITS)
+
+// the array buffer binding only matters to glVertexAttribPointer, and calls
+// that don't change anything don't end the run either
+static void batch_glBindBuffer(GLenum target, GLuint buffer) {
+  if (target == GL_ARRAY_BUFFER) {
+    array_buffer = buffer;
+  } else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    if (buffer != element_buffer)
+      draw_batch_flush();
+    element_buffer = buffer;
+  } else {
+    draw_batch_flush();
+  }
+  next.glBindBuffer(target, buffer);
+}
+
+static void set_enabled(GLuint index, int enabled) {
+  if (index >= DRAW_BATCH_MAX_ATTRIBS) {
+    draw_batch_flush();
+    return;
+  }
+  if (attribs[index].enabled != enabled)
+    draw_batch_flush();
+  attribs[index].enabled = enabled;
+}
+
+static void batch_glEnableVertexAttribArray(GLuint index) {
+  set_enabled(index, 1);
+  next.glEnableVertexAttribArray(index);
+}
+
+static void batch_glDisableVertexAttribArray(GLuint index) {
+  set_enabled(index, 0);
+  next.glDisableVertexAttribArray(index);
+}
+
+static void batch_glVertexAttribPointer(GLuint index, GLint size,
+                                        GLenum type, GLboolean normalized,
+                                        GLsizei stride, const void *pointer) {
+  if (index < DRAW_BATCH_MAX_ATTRIBS) {
+    Attrib *a = &attribs[index];
+    if (a->size != size || a->type != type || a->normalized != normalized ||
+        a->stride != stride || a->pointer != pointer ||
+        a->buffer != array_buffer)
+      draw_batch_flush();
+    a->size = size;
+    a->type = type;
+    a->normalized = normalized;
+    a->stride = stride;
+    a->pointer = pointer;
+    a->buffer = array_buffer;
+  } else {
+    draw_batch_flush();
+  }
+  next.glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+// deleting a bound buffer resets the binding to 0
+static void batch_glDeleteBuffers(GLsizei n, const GLuint *buffers) {
+  draw_batch_flush();
+  for (GLsizei i = 0; i < n; ++i) {
+    if (buffers[i] == array_buffer)
+      array_buffer = 0;
+    if (buffers[i] == element_buffer)
+      element_buffer = 0;
+  }
+  next.glDeleteBuffers(n, buffers);
+}
+
+#define FLUSH_DELETE(name)                                                     \
+  static void batch_##name(GLsizei n, const GLuint *names) {                   \
+    draw_batch_flush();                                                        \
+    next.name(n, names);                                                       \
+  }
+
+FLUSH_DELETE(glDeleteTextures)
+FLUSH_DELETE(glDeleteFramebuffers)
+FLUSH_DELETE(glDeleteRenderbuffers)
+
+static void batch_glBufferData(GLenum target, GLsizeiptr size,
+                               const void *data, GLenum usage) {
+  draw_batch_flush();
+  next.glBufferData(target, size, data, usage);
+}
+
+static void batch_glTexImage2D(GLenum target, GLint level,
+                               GLint internalformat, GLsizei width,
+                               GLsizei height, GLint border, GLenum format,
+                               GLenum type, const void *pixels) {
+  draw_batch_flush();
+  next.glTexImage2D(target, level, internalformat, width, height, border,
+                    format, type, pixels);
+}
+
+static void batch_glCompressedTexImage2D(GLenum target, GLint level,
+                                         GLenum internalformat, GLsizei width,
+                                         GLsizei height, GLint border,
+                                         GLsizei imageSize, const void *data) {
+  draw_batch_flush();
+  next.glCompressedTexImage2D(target, level, internalformat, width, height,
+                              border, imageSize, data);
+}
+
+#define FLUSH_UNIFORM_V(name)                                                  \
+  static void batch_##name(GLint location, GLsizei count,                      \
+                           const GLfloat *value) {                             \
+    draw_batch_flush();                                                        \
+    next.name(location, count, value);                                         \
+  }
+#define FLUSH_UNIFORM_MATRIX(name)                                             \
+  static void batch_##name(GLint location, GLsizei count,                      \
+                           GLboolean transpose, const GLfloat *value) {        \
+    draw_batch_flush();                                                        \
+    next.name(location, count, transpose, value);                              \
+  }
+
+FLUSH_UNIFORM_V(glUniform1fv)
+FLUSH_UNIFORM_V(glUniform2fv)
+FLUSH_UNIFORM_V(glUniform3fv)
+FLUSH_UNIFORM_V(glUniform4fv)
+FLUSH_UNIFORM_MATRIX(glUniformMatrix3fv)
+FLUSH_UNIFORM_MATRIX(glUniformMatrix4fv)
+
+static void batch_glVertexAttrib4fv(GLuint index, const GLfloat *v) {
+  draw_batch_flush();
+  next.glVertexAttrib4fv(index, v);
+}
+
+static void batch_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  draw_batch_flush();
+  next.glDrawArrays(mode, first, count);
+}
+
+static void batch_glReadPixels(GLint x, GLint y, GLsizei width,
+                               GLsizei height, GLenum format, GLenum type,
+                               void *pixels) {
+  draw_batch_flush();
+  next.glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+static int client_attribs(void) {
+  for (int i = 0; i < DRAW_BATCH_MAX_ATTRIBS; ++i) {
+    if (attribs[i].enabled && !attribs[i].buffer)
+      return 1;
+  }
+  return 0;
+}
+
+// whether the draw can be added to the one held back
+static int joins(GLenum mode, GLsizei count, GLenum type,
+                 const void *offset) {
+  if (!batch.draws || batch.mode != mode || batch.type != type ||
+      batch.buffer != element_buffer)
+    return 0;
+  size_t size = index_size(type);
+  if (element_buffer)
+    return (uintptr_t)offset == batch.offset + batch.count * size;
+  return (batch.count + count) * size <= sizeof(indices);
+}
+
+static void batch_glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                                 const void *offset) {
+  total_calls++;
+  size_t size = index_size(type);
+  if (count <= 0 || client_attribs() ||
+      (mode != GL_TRIANGLES && mode != GL_LINES && mode != GL_POINTS) ||
+      (!element_buffer && count * size > sizeof(indices))) {
+    draw_batch_flush();
+    next.glDrawElements(mode, count, type, offset);
+    return;
+  }
+
+  if (!joins(mode, count, type, offset)) {
+    draw_batch_flush();
+    batch.mode = mode;
+    batch.type = type;
+    batch.count = 0;
+    batch.buffer = element_buffer;
+    batch.offset = (uintptr_t)offset;
+  }
+  if (!element_buffer)
+    memcpy((uint8_t *)indices + batch.count * size, offset, count * size);
+  batch.count += count;
+  batch.draws++;
+}
+
+void draw_batch_install(uintptr_t (*replace)(const char *symbol,
+                                             uintptr_t func)) {
+#define INSTALL(name, ...)                                                     \
+  next.name = (void *)replace(#name, (uintptr_t)&batch_##name);
+  GL_TRACE_CALLS(INSTALL, INSTALL, INSTALL, INSTALL, INSTALL, INSTALL)
+  DRAW_BATCH_SPECIAL_CALLS(INSTALL)
+#undef INSTALL
+}
+
+void draw_batch_frame(void) {
+  draw_batch_last_frame = frame;
+  total_draws += frame.draws;
+  total_batches += frame.batches;
+  memset(&frame, 0, sizeof(frame));
+
+  if (++frames % DRAW_BATCH_REPORT_FRAMES)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "draw_batch: %.1f draws merged into %.1f per frame so far, last "
+             "frame %u into %u\n",
+             (double)total_draws / frames, (double)total_batches / frames,
+             draw_batch_last_frame.draws, draw_batch_last_frame.batches);
+}
+
+void draw_batch_report(void) {
+  if (!frames)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "draw_batch: %llu of %llu glDrawElements calls merged into %llu "
+             "in %u frames, %.1f draws saved per frame\n",
+             total_draws, total_calls, total_batches, frames,
+             (double)(total_draws - total_batches) / frames);
+}
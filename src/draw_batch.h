@@ -0,0 +1,40 @@
+/* draw_batch.h -- consecutive draws with the same state merged into one
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef DRAW_BATCH_H
+#define DRAW_BATCH_H
+
+#include <stdint.h>
+
+#define DRAW_BATCH_MAX_ATTRIBS 16
+// room for the client-side indices of one merged draw; longer draws are
+// drawn as they are
+#define DRAW_BATCH_INDEX_BYTES (64 * 1024)
+// frames between reports in the log
+#define DRAW_BATCH_REPORT_FRAMES 600
+
+typedef struct {
+  unsigned int draws;   // glDrawElements calls that went into a merged draw
+  unsigned int batches; // merged draws made of them
+} DrawBatchCounters;
+
+// counts of the last finished frame
+extern DrawBatchCounters draw_batch_last_frame;
+
+// wraps the GL imports with replace (which returns the previous function)
+void draw_batch_install(uintptr_t (*replace)(const char *symbol,
+                                             uintptr_t func));
+// draws what has been merged so far; call before using GL directly outside
+// the imports, e.g. before the swap
+void draw_batch_flush(void);
+// called once per frame at swap, after draw_batch_flush
+void draw_batch_frame(void);
+// logs how many draws were saved, call when the game exits
+void draw_batch_report(void);
+
+#endif // DRAW_BATCH_H
@@ -0,0 +1,226 @@
+/* etc_encode.c -- ETC1, ETC2 and EAC texture block encoder
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// An ETC1 block splits 4x4 pixels into two halves, side by side or one above
+// the other (the flip bit), each with a base color and a table of four
+// offsets added to all of its channels; each pixel picks one of the offsets.
+// The base colors are either 4 bits per channel each or 5 bits and a 3-bit
+// difference. For both splits and both kinds the halves' average colors are
+// taken as the base colors, each half gets the table that fits its pixels
+// best, and the combination with the smallest error is kept. That is a
+// fraction of what a full search finds but costs little, and since the
+// differences are kept in range the blocks are valid ETC2 as well.
+//
+// EAC alpha is a base value, a multiplier and one of 16 tables of eight
+// offsets, tried exhaustively with the base centered on the block's range.
+
+#include <string.h>
+
+#include "etc_encode.h"
+
+static const int rgb_tables[8][2] = {{2, 8},   {5, 17},  {9, 29},  {13, 42},
+                                     {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+static const int alpha_tables[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},  {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},  {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},   {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+typedef struct {
+  unsigned int error;
+  uint32_t high; // colors, tables and the flip and difference bits
+  uint8_t indices[16];
+} Candidate;
+
+static int clamp255(int v) { return v < 0 ? 0 : v > 255 ? 255 : v; }
+
+// green counts the most, as it does for the eye
+static unsigned int color_error(const uint8_t *p, int r, int g, int b) {
+  int dr = p[0] - r, dg = p[1] - g, db = p[2] - b;
+  return 3 * dr * dr + 6 * dg * dg + db * db;
+}
+
+// picks the table and the pixels' offsets for one half; pixels are numbered
+// row by row
+static unsigned int fit_half(const uint8_t *pixels, const int *half,
+                             const int base[3], int *table,
+                             uint8_t *indices) {
+  unsigned int best = ~0u;
+  for (int t = 0; t < 8; ++t) {
+    unsigned int error = 0;
+    uint8_t chosen[8];
+    for (int i = 0; i < 8 && error < best; ++i) {
+      const uint8_t *p = pixels + half[i] * 4;
+      unsigned int pixel_best = ~0u;
+      for (int v = 0; v < 4; ++v) {
+        // 0 and 1 add the small and large offset, 2 and 3 subtract them
+        int offset = v & 2 ? -rgb_tables[t][v & 1] : rgb_tables[t][v & 1];
+        unsigned int e =
+            color_error(p, clamp255(base[0] + offset),
+                        clamp255(base[1] + offset), clamp255(base[2] + offset));
+        if (e < pixel_best) {
+          pixel_best = e;
+          chosen[i] = v;
+        }
+      }
+      error += pixel_best;
+    }
+    if (error < best) {
+      best = error;
+      *table = t;
+      for (int i = 0; i < 8; ++i)
+        indices[half[i]] = chosen[i];
+    }
+  }
+  return best;
+}
+
+static void try_split(const uint8_t *pixels, int flip, int differential,
+                      Candidate *best) {
+  int halves[2][8];
+  int n[2] = {0, 0};
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 4; ++x) {
+      int h = flip ? y >= 2 : x >= 2;
+      halves[h][n[h]++] = y * 4 + x;
+    }
+  }
+
+  int q[2][3], base[2][3];
+  for (int h = 0; h < 2; ++h) {
+    for (int c = 0; c < 3; ++c) {
+      int sum = 0;
+      for (int i = 0; i < 8; ++i)
+        sum += pixels[halves[h][i] * 4 + c];
+      if (differential) {
+        q[h][c] = (sum * 31 + 255 * 4) / (255 * 8);
+        base[h][c] = (q[h][c] << 3) | (q[h][c] >> 2);
+      } else {
+        q[h][c] = (sum * 15 + 255 * 4) / (255 * 8);
+        base[h][c] = (q[h][c] << 4) | q[h][c];
+      }
+    }
+  }
+  if (differential) {
+    for (int c = 0; c < 3; ++c) {
+      int d = q[1][c] - q[0][c];
+      if (d < -4 || d > 3)
+        return;
+    }
+  }
+
+  Candidate cand;
+  int tables[2];
+  cand.error = 0;
+  for (int h = 0; h < 2 && cand.error < best->error; ++h)
+    cand.error += fit_half(pixels, halves[h], base[h], &tables[h],
+                           cand.indices);
+  if (cand.error >= best->error)
+    return;
+
+  if (differential)
+    cand.high = (uint32_t)q[0][0] << 27 | (uint32_t)((q[1][0] - q[0][0]) & 7)
+                << 24 | (uint32_t)q[0][1] << 19 |
+                (uint32_t)((q[1][1] - q[0][1]) & 7) << 16 |
+                (uint32_t)q[0][2] << 11 |
+                (uint32_t)((q[1][2] - q[0][2]) & 7) << 8;
+  else
+    cand.high = (uint32_t)q[0][0] << 28 | (uint32_t)q[1][0] << 24 |
+                (uint32_t)q[0][1] << 20 | (uint32_t)q[1][1] << 16 |
+                (uint32_t)q[0][2] << 12 | (uint32_t)q[1][2] << 8;
+  cand.high |= (uint32_t)tables[0] << 5 | (uint32_t)tables[1] << 2 |
+               (uint32_t)differential << 1 | (uint32_t)flip;
+  *best = cand;
+}
+
+static void put_be32(uint8_t *out, uint32_t v) {
+  out[0] = v >> 24;
+  out[1] = v >> 16;
+  out[2] = v >> 8;
+  out[3] = v;
+}
+
+void etc_encode_rgb(const uint8_t *pixels, uint8_t *block) {
+  Candidate best = {.error = ~0u};
+  for (int flip = 0; flip < 2; ++flip) {
+    try_split(pixels, flip, 1, &best);
+    try_split(pixels, flip, 0, &best);
+  }
+
+  // the offsets' high bits, then their low bits, numbered column by column
+  uint32_t low = 0;
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 4; ++x) {
+      int v = best.indices[y * 4 + x], bit = x * 4 + y;
+      low |= (uint32_t)(v >> 1) << (bit + 16) | (uint32_t)(v & 1) << bit;
+    }
+  }
+  put_be32(block, best.high);
+  put_be32(block + 4, low);
+}
+
+void etc_encode_alpha(const uint8_t *pixels, uint8_t *block) {
+  int min = 255, max = 0;
+  for (int i = 0; i < 16; ++i) {
+    int a = pixels[i * 4 + 3];
+    min = a < min ? a : min;
+    max = a > max ? a : max;
+  }
+
+  int best_base = min, best_mult = 1, best_table = 13;
+  uint8_t best_indices[16];
+  memset(best_indices, 4, sizeof(best_indices)); // table 13's 0 offset
+  if (min != max) {
+    unsigned int best = ~0u;
+    for (int t = 0; t < 16; ++t) {
+      const int *offsets = alpha_tables[t];
+      for (int m = 1; m < 16; ++m) {
+        // the offsets' range centered on the pixels' range
+        int lo = offsets[3] * m, hi = offsets[7] * m;
+        int base = clamp255((min + max - lo - hi + 1) / 2);
+        unsigned int error = 0;
+        uint8_t indices[16];
+        for (int i = 0; i < 16 && error < best; ++i) {
+          int a = pixels[i * 4 + 3];
+          unsigned int pixel_best = ~0u;
+          for (int v = 0; v < 8; ++v) {
+            int d = clamp255(base + offsets[v] * m) - a;
+            if ((unsigned int)(d * d) < pixel_best) {
+              pixel_best = d * d;
+              indices[i] = v;
+            }
+          }
+          error += pixel_best;
+        }
+        if (error < best) {
+          best = error;
+          best_base = base;
+          best_mult = m;
+          best_table = t;
+          memcpy(best_indices, indices, sizeof(indices));
+        }
+      }
+    }
+  }
+
+  // three bits per pixel from the top, numbered column by column
+  uint64_t bits = 0;
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 4; ++x)
+      bits |= (uint64_t)best_indices[y * 4 + x] << (45 - 3 * (x * 4 + y));
+  }
+  block[0] = best_base;
+  block[1] = best_mult << 4 | best_table;
+  for (int i = 0; i < 6; ++i)
+    block[2 + i] = bits >> (40 - 8 * i);
+}
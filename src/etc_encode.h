@@ -0,0 +1,23 @@
+/* etc_encode.h -- ETC1, ETC2 and EAC texture block encoder
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef ETC_ENCODE_H
+#define ETC_ENCODE_H
+
+#include <stdint.h>
+
+// encoded blocks are 8 bytes for 4x4 pixels; pixels are given as 16 RGBA8
+// values, row by row
+
+// the color of a block as an ETC1 block, which is also a valid ETC2 RGB8 one
+void etc_encode_rgb(const uint8_t *pixels, uint8_t *block);
+// the alpha of a block as an EAC block, which goes before the color block in
+// ETC2 RGBA8
+void etc_encode_alpha(const uint8_t *pixels, uint8_t *block);
+
+#endif // ETC_ENCODE_H
@@ -0,0 +1,444 @@
+/* fastmath.c -- reduced precision libm replacements for the import table
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The float functions are evaluated in double precision with short
+// polynomials, which on AArch64 costs the same as float and keeps the result
+// within ~1 ULP without any table lookups. Arguments that are out of the
+// fast path's range (huge angles, NaN, infinities, negative pow bases, ...)
+// are handed to libm so the edge case behaviour stays the same.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fastmath.h"
+#include "util.h"
+
+#define PI 3.14159265358979311600e+00
+#define PIO2 1.57079632679489655800e+00
+#define INVPIO2 6.36619772367581382433e-01
+// pi/2 split into parts for Cody-Waite range reduction
+#define PIO2_1 1.57079632673412561417e+00
+#define PIO2_1T 6.07710050650619224932e-11
+#define PIO2_2 6.07710050630396597660e-11
+#define PIO2_2T 2.02226624879595063154e-21
+
+// largest argument that the range reduction above handles accurately; past
+// it k * PIO2_1 is no longer exact
+#define TRIG_MAX_F 0x1p20f
+#define TRIG_MAX 0x1p20
+
+static inline double round_to_int(double x) {
+  // adding and subtracting 1.5*2^52 rounds to nearest without a branch
+  const double magic = 0x1.8p52;
+  return (x + magic) - magic;
+}
+
+static inline double select_d(int cond, double a, double b) {
+  return cond ? a : b;
+}
+
+// sin(x) and cos(x) for |x| <= pi/4, coefficients from FreeBSD's
+// k_sinf.c/k_cosf.c that are accurate enough for a float result
+static inline double kernel_sinf(double x) {
+  const double S1 = -0x15555554cbac77.0p-55;
+  const double S2 = 0x111110896efbb2.0p-59;
+  const double S3 = -0x1a00f9e2cae774.0p-65;
+  const double S4 = 0x16cd878c3b46a7.0p-71;
+  double z = x * x;
+  double w = z * z;
+  double r = S3 + z * S4;
+  double s = z * x;
+  return (x + s * (S1 + z * S2)) + s * w * r;
+}
+
+static inline double kernel_cosf(double x) {
+  const double C0 = -0x1ffffffd0c5e81.0p-54;
+  const double C1 = 0x155553e1053a42.0p-57;
+  const double C2 = -0x16c087e80f1e27.0p-62;
+  const double C3 = 0x199342e0ee5069.0p-68;
+  double z = x * x;
+  double w = z * z;
+  double r = C2 + z * C3;
+  return ((1.0 + z * C0) + w * C1) + (w * z) * r;
+}
+
+// same for double results, coefficients from fdlibm's k_sin.c/k_cos.c
+static inline double kernel_sin(double x) {
+  const double S1 = -1.66666666666666324348e-01;
+  const double S2 = 8.33333333332248946124e-03;
+  const double S3 = -1.98412698298579493134e-04;
+  const double S4 = 2.75573137070700676789e-06;
+  const double S5 = -2.50507602534068634195e-08;
+  const double S6 = 1.58969099521155010221e-10;
+  double z = x * x;
+  double v = z * x;
+  double r = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+  return x + v * (S1 + z * r);
+}
+
+static inline double kernel_cos(double x) {
+  const double C1 = 4.16666666666666019037e-02;
+  const double C2 = -1.38888888888741095749e-03;
+  const double C3 = 2.48015872894767294178e-05;
+  const double C4 = -2.75573143513906633035e-07;
+  const double C5 = 2.08757232129817482790e-09;
+  const double C6 = -1.13596475577881948265e-11;
+  double z = x * x;
+  double r = z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+  double hz = 0.5 * z;
+  double w = 1.0 - hz;
+  return w + (((1.0 - w) - hz) + z * r);
+}
+
+// evaluates sin (quadrant offset 0) or cos (quadrant offset 1) of a reduced
+// argument; both kernels are computed so that the quadrant only selects
+static inline double trig_select(double s, double c, unsigned int n) {
+  double v = select_d(n & 1, c, s);
+  return select_d(n & 2, -v, v);
+}
+
+float fast_sinf(float x) {
+  if (!(fabsf(x) < TRIG_MAX_F))
+    return sinf(x);
+  double k = round_to_int(x * INVPIO2);
+  double r = (x - k * PIO2_1) - k * PIO2_1T;
+  return (float)trig_select(kernel_sinf(r), kernel_cosf(r), (int64_t)k);
+}
+
+float fast_cosf(float x) {
+  if (!(fabsf(x) < TRIG_MAX_F))
+    return cosf(x);
+  double k = round_to_int(x * INVPIO2);
+  double r = (x - k * PIO2_1) - k * PIO2_1T;
+  return (float)trig_select(kernel_sinf(r), kernel_cosf(r), (int64_t)k + 1);
+}
+
+// two Cody-Waite steps as in fdlibm's __ieee754_rem_pio2, the second one
+// keeping the result accurate when x is close to a multiple of pi/2
+static inline double reduce_pio2(double x, double *k) {
+  *k = round_to_int(x * INVPIO2);
+  double t = x - *k * PIO2_1;
+  double w = *k * PIO2_2;
+  double r = t - w;
+  w = *k * PIO2_2T - ((t - r) - w);
+  return r - w;
+}
+
+double fast_sin(double x) {
+  if (!(fabs(x) < TRIG_MAX))
+    return sin(x);
+  double k;
+  double r = reduce_pio2(x, &k);
+  return trig_select(kernel_sin(r), kernel_cos(r), (int64_t)k);
+}
+
+double fast_cos(double x) {
+  if (!(fabs(x) < TRIG_MAX))
+    return cos(x);
+  double k;
+  double r = reduce_pio2(x, &k);
+  return trig_select(kernel_sin(r), kernel_cos(r), (int64_t)k + 1);
+}
+
+float fast_sqrtf(float x) {
+  // the instruction is exact; this just skips the errno handling wrapper
+#if defined(__aarch64__)
+  float r;
+  __asm__("fsqrt %s0, %s1" : "=w"(r) : "w"(x));
+  return r;
+#else
+  return __builtin_sqrtf(x);
+#endif
+}
+
+double fast_sqrt(double x) {
+#if defined(__aarch64__)
+  double r;
+  __asm__("fsqrt %d0, %d1" : "=w"(r) : "w"(x));
+  return r;
+#else
+  return __builtin_sqrt(x);
+#endif
+}
+
+float fast_atan2f(float y, float x) {
+  double ax = fabsf(x);
+  double ay = fabsf(y);
+  // zeroes and infinities need the exact libm sign and quadrant rules
+  if (!(ax > 0.0 && ay > 0.0 && ax < INFINITY && ay < INFINITY))
+    return atan2f(y, x);
+
+  int swap = ay > ax;
+  double t = select_d(swap, ax, ay) / select_d(swap, ay, ax);
+  // reduce to |t| <= tan(pi/8)
+  int big = t > 0.41421356237309503;
+  t = select_d(big, (t - 1.0) / (t + 1.0), t);
+
+  // Cephes atanf polynomial
+  double z = t * t;
+  double a = (((8.05374449538e-2 * z - 1.38776856032e-1) * z +
+               1.99777106478e-1) * z -
+              3.33329491539e-1) * z * t + t;
+  a += select_d(big, PI / 4.0, 0.0);
+  a = select_d(swap, PIO2 - a, a);
+  a = select_d(signbit(x), PI - a, a);
+  return (float)select_d(signbit(y), -a, a);
+}
+
+// asin(a) for a in [0, 0.5], where z is a^2; Cephes asinf polynomial
+static inline double asinf_poly(double a, double z) {
+  return ((((4.2163199048e-2 * z + 2.4181311049e-2) * z + 4.5470025998e-2) *
+               z +
+           7.4953002686e-2) *
+              z +
+          1.6666752422e-1) *
+             z * a +
+         a;
+}
+
+float fast_acosf(float x) {
+  double ax = fabsf(x);
+  if (!(ax <= 1.0))
+    return acosf(x);
+
+  int big = ax > 0.5;
+  // for |x| > 0.5 use acos(x) = 2 * asin(sqrt((1 - x) / 2))
+  double z = select_d(big, 0.5 * (1.0 - ax), ax * ax);
+  double a = asinf_poly(select_d(big, fast_sqrt(z), ax), z);
+  double small_res = PIO2 - select_d(signbit(x), -a, a);
+  double big_res = select_d(signbit(x), PI - 2.0 * a, 2.0 * a);
+  return (float)select_d(big, big_res, small_res);
+}
+
+// R(z) from fdlibm's e_asin.c, asin(a) = a + a * R(a^2) for a in [0, 0.5]
+static inline double asin_rational(double z) {
+  const double pS0 = 1.66666666666666657415e-01;
+  const double pS1 = -3.25565818622400915405e-01;
+  const double pS2 = 2.01212532134862925881e-01;
+  const double pS3 = -4.00555345006794114027e-02;
+  const double pS4 = 7.91534994289814532176e-04;
+  const double pS5 = 3.47933107596021167570e-05;
+  const double qS1 = -2.40339491173441421878e+00;
+  const double qS2 = 2.02094576023350569471e+00;
+  const double qS3 = -6.88283971605453293030e-01;
+  const double qS4 = 7.70381505559019352791e-02;
+  double p = z * (pS0 + z * (pS1 + z * (pS2 + z * (pS3 + z * (pS4 + z * pS5)))));
+  double q = 1.0 + z * (qS1 + z * (qS2 + z * (qS3 + z * qS4)));
+  return p / q;
+}
+
+double fast_acos(double x) {
+  double ax = fabs(x);
+  if (!(ax <= 1.0))
+    return acos(x);
+
+  int big = ax > 0.5;
+  double z = select_d(big, 0.5 * (1.0 - ax), ax * ax);
+  double s = select_d(big, fast_sqrt(z), ax);
+  double a = s + s * asin_rational(z);
+  double small_res = PIO2 - select_d(signbit(x), -a, a);
+  double big_res = select_d(signbit(x), PI - 2.0 * a, 2.0 * a);
+  return select_d(big, big_res, small_res);
+}
+
+float fast_powf(float x, float y) {
+  // negative bases, zero, infinities and NaNs go through libm
+  if (!(x > 0.0f && x < INFINITY && fabsf(y) < INFINITY))
+    return powf(x, y);
+
+  // log2(x) = e + log2(m) with m in [sqrt(1/2), sqrt(2)); floats are always
+  // normal when widened to double so the exponent can be read directly
+  double dx = x;
+  uint64_t ix;
+  memcpy(&ix, &dx, sizeof(ix));
+  int e = (int)((ix >> 52) & 0x7ff) - 1023;
+  ix = (ix & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+  double m;
+  memcpy(&m, &ix, sizeof(m));
+  int hi = m > 1.41421356237309504880;
+  m = select_d(hi, m * 0.5, m);
+  e += hi;
+
+  // ln(m) = 2 * atanh(s), s = (m - 1) / (m + 1), |s| < 0.172; the series
+  // is evaluated in Estrin form to keep the dependency chains short
+  double s = (m - 1.0) / (m + 1.0);
+  double s2 = s * s;
+  double s4 = s2 * s2;
+  double s8 = s4 * s4;
+  double ln_m =
+      2.0 * s *
+      ((1.0 + s2 * (1.0 / 3)) + s4 * (1.0 / 5 + s2 * (1.0 / 7)) +
+       s8 * ((1.0 / 9 + s2 * (1.0 / 11)) + s4 * (1.0 / 13)));
+  double t = (double)y * (e + ln_m * 1.44269504088896340736);
+
+  // results that overflow or underflow to a subnormal float
+  if (!(t > -126.0 && t < 128.0))
+    return powf(x, y);
+
+  // 2^t = 2^n * exp(f * ln2), f in [-0.5, 0.5]; the truncated series is
+  // below 2^-27 relative error
+  double n = round_to_int(t);
+  double u = (t - n) * 0.69314718055994530942;
+  double u2 = u * u;
+  double u4 = u2 * u2;
+  double p = ((1.0 + u) + u2 * (1.0 / 2 + u * (1.0 / 6))) +
+             u4 * ((1.0 / 24 + u * (1.0 / 120)) +
+                   u2 * (1.0 / 720 + u * (1.0 / 5040)));
+  uint64_t scale_bits = (uint64_t)((int64_t)n + 1023) << 52;
+  double scale;
+  memcpy(&scale, &scale_bits, sizeof(scale));
+  return (float)(p * scale);
+}
+
+// ---- accuracy and speed report ----
+
+#define REPORT_SAMPLES 200000
+#define BENCH_ITERATIONS 2000000
+
+typedef enum { FN_F1, FN_F2, FN_D1 } FnKind;
+
+typedef struct {
+  const char *name;
+  FnKind kind;
+  uintptr_t fast;
+  uintptr_t ref;   // libm function that the fast one replaces
+  uintptr_t wide;  // same function in the next wider precision
+  double budget;   // max allowed error in ULP of the result type
+  double lo, hi;   // sampled range of the first argument
+  double lo2, hi2; // sampled range of the second argument for FN_F2
+} FnTest;
+
+static const FnTest fn_tests[] = {
+    {"sinf", FN_F1, (uintptr_t)&fast_sinf, (uintptr_t)&sinf, (uintptr_t)&sin,
+     2.0, -TRIG_MAX_F, TRIG_MAX_F},
+    {"cosf", FN_F1, (uintptr_t)&fast_cosf, (uintptr_t)&cosf, (uintptr_t)&cos,
+     2.0, -TRIG_MAX_F, TRIG_MAX_F},
+    {"atan2f", FN_F2, (uintptr_t)&fast_atan2f, (uintptr_t)&atan2f,
+     (uintptr_t)&atan2, 3.0, -100.0, 100.0, -100.0, 100.0},
+    {"powf", FN_F2, (uintptr_t)&fast_powf, (uintptr_t)&powf, (uintptr_t)&pow,
+     2.0, 0.001, 64.0, -8.0, 8.0},
+    {"sqrtf", FN_F1, (uintptr_t)&fast_sqrtf, (uintptr_t)&sqrtf,
+     (uintptr_t)&sqrt, 0.5, 0.0, 1.0e6},
+    {"acosf", FN_F1, (uintptr_t)&fast_acosf, (uintptr_t)&acosf,
+     (uintptr_t)&acos, 2.0, -1.0, 1.0},
+    {"sin", FN_D1, (uintptr_t)&fast_sin, (uintptr_t)&sin, (uintptr_t)&sinl,
+     2.0, -TRIG_MAX, TRIG_MAX},
+    {"cos", FN_D1, (uintptr_t)&fast_cos, (uintptr_t)&cos, (uintptr_t)&cosl,
+     2.0, -TRIG_MAX, TRIG_MAX},
+    {"sqrt", FN_D1, (uintptr_t)&fast_sqrt, (uintptr_t)&sqrt, (uintptr_t)&sqrtl,
+     0.5, 0.0, 1.0e6},
+    {"acos", FN_D1, (uintptr_t)&fast_acos, (uintptr_t)&acos, (uintptr_t)&acosl,
+     2.0, -1.0, 1.0},
+};
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static double rand_range(double lo, double hi) {
+  // xorshift64*, only needs to be deterministic
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  uint64_t r = rng_state * 0x2545f4914f6cdd1dULL;
+  return lo + (hi - lo) * ((r >> 11) * 0x1p-53);
+}
+
+static long double wide_value(const FnTest *t, double a, double b) {
+  if (t->kind == FN_F1)
+    return ((double (*)(double))t->wide)(a);
+  if (t->kind == FN_F2)
+    return ((double (*)(double, double))t->wide)(a, b);
+  return ((long double (*)(long double))t->wide)(a);
+}
+
+static double ulp_error(const FnTest *t, long double got, long double ref) {
+  int exp;
+  if (ref == 0.0L)
+    return got == 0.0L ? 0.0 : INFINITY;
+  frexpl(ref, &exp);
+  int mant_bits = t->kind == FN_D1 ? 53 : 24;
+  int min_exp = t->kind == FN_D1 ? -1021 : -125;
+  if (exp < min_exp)
+    exp = min_exp;
+  return (double)(fabsl(got - ref) / ldexpl(1.0L, exp - mant_bits));
+}
+
+static double measure_max_ulp(const FnTest *t) {
+  double max_err = 0.0;
+  for (int i = 0; i < REPORT_SAMPLES; ++i) {
+    double a = rand_range(t->lo, t->hi);
+    double b = rand_range(t->lo2, t->hi2);
+    long double got;
+    if (t->kind == FN_F1) {
+      a = (float)a;
+      got = ((float (*)(float))t->fast)(a);
+    } else if (t->kind == FN_F2) {
+      a = (float)a;
+      b = (float)b;
+      got = ((float (*)(float, float))t->fast)(a, b);
+    } else {
+      got = ((double (*)(double))t->fast)(a);
+    }
+    double err = ulp_error(t, got, wide_value(t, a, b));
+    if (err > max_err)
+      max_err = err;
+  }
+  return max_err;
+}
+
+// calls go through a volatile pointer like the game's import table calls do
+static double bench_ns_per_call(const FnTest *t, uintptr_t fn) {
+  static float in_f[256], in_f2[256];
+  static double in_d[256];
+  volatile uintptr_t target = fn;
+  volatile double sink = 0.0;
+
+  for (int i = 0; i < 256; ++i) {
+    in_d[i] = rand_range(t->lo, t->hi);
+    in_f[i] = (float)in_d[i];
+    in_f2[i] = (float)rand_range(t->lo2, t->hi2);
+  }
+
+  uint64_t start = now_ns();
+  if (t->kind == FN_F1) {
+    float (*f)(float) = (void *)target;
+    float acc = 0.0f;
+    for (int i = 0; i < BENCH_ITERATIONS; ++i)
+      acc += f(in_f[i & 255]);
+    sink = acc;
+  } else if (t->kind == FN_F2) {
+    float (*f)(float, float) = (void *)target;
+    float acc = 0.0f;
+    for (int i = 0; i < BENCH_ITERATIONS; ++i)
+      acc += f(in_f[i & 255], in_f2[i & 255]);
+    sink = acc;
+  } else {
+    double (*f)(double) = (void *)target;
+    double acc = 0.0;
+    for (int i = 0; i < BENCH_ITERATIONS; ++i)
+      acc += f(in_d[i & 255]);
+    sink = acc;
+  }
+  (void)sink;
+  return (double)(now_ns() - start) / BENCH_ITERATIONS;
+}
+
+void fastmath_report(void) {
+  debugPrintf("fastmath: accuracy (%d samples) and speed report\n",
+              REPORT_SAMPLES);
+  for (size_t i = 0; i < sizeof(fn_tests) / sizeof(*fn_tests); ++i) {
+    const FnTest *t = &fn_tests[i];
+    double err = measure_max_ulp(t);
+    double fast_ns = bench_ns_per_call(t, t->fast);
+    double ref_ns = bench_ns_per_call(t, t->ref);
+    debugPrintf("fastmath: %-6s max %.2f ulp (budget %.1f) %s, %.1f ns/call "
+                "vs %.1f ns/call libm\n",
+                t->name, err, t->budget, err <= t->budget ? "ok" : "OVER",
+                fast_ns, ref_ns);
+  }
+}
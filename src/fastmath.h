@@ -0,0 +1,28 @@
+/* fastmath.h -- reduced precision libm replacements for the import table
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef __FASTMATH_H__
+#define __FASTMATH_H__
+
+float fast_sinf(float x);
+float fast_cosf(float x);
+float fast_atan2f(float y, float x);
+float fast_powf(float x, float y);
+float fast_sqrtf(float x);
+float fast_acosf(float x);
+
+double fast_sin(double x);
+double fast_cos(double x);
+double fast_sqrt(double x);
+double fast_acos(double x);
+
+// measures the max ULP error of every fast function against libm and
+// benchmarks both, writing the results to the debug log
+void fastmath_report(void);
+
+#endif
@@ -0,0 +1,184 @@
+/* frame_pacing.c -- frame rate limiting with precise waits
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Frames are released on a fixed grid of 1/target_fps. Waits sleep with an
+// absolute deadline until shortly before the slot and busy-wait the rest, so
+// the kernel's wakeup latency doesn't end up in the frame time. How early to
+// wake up adapts to the oversleep actually observed.
+//
+// The game also throttles itself with usleep/nanosleep. Those calls are routed
+// through the same wait; on the render thread they are cut short at the next
+// frame slot, so the game's own sleeps can't push a frame past it.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/prctl.h>
+
+#include "config.h"
+#include "frame_pacing.h"
+#include "log.h"
+#include "util.h"
+
+static uint64_t period_ns = 0; // 0 when vsync does the pacing
+static uint64_t next_deadline = 0;
+static pthread_t render_thread;
+static int have_render_thread = 0;
+static uint64_t spin_ns = FRAME_PACING_MIN_SPIN_NS * 4;
+
+// stats over the current FRAME_PACING_STATS_FRAMES window
+static uint64_t last_frame = 0;
+static uint64_t min_frame_ns = UINT64_MAX, max_frame_ns = 0, sum_frame_ns = 0;
+static uint64_t sum_spin_ns = 0;
+static int missed_slots = 0;
+static int window_frames = 0;
+
+static void sleep_abs(uint64_t t) {
+  struct timespec ts = {t / 1000000000ull, t % 1000000000ull};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+}
+
+// sleeps until shortly before t and spins the rest; returns the time spun
+static uint64_t wait_until(uint64_t t) {
+  uint64_t spin = __atomic_load_n(&spin_ns, __ATOMIC_RELAXED);
+  uint64_t now = now_ns();
+  if (now + spin < t) {
+    uint64_t wake = t - spin;
+    sleep_abs(wake);
+    now = now_ns();
+    // track twice the worst recent oversleep, decaying slowly
+    uint64_t late = now > wake ? now - wake : 0;
+    uint64_t next = spin - spin / 16;
+    if (late * 2 > next)
+      next = late * 2;
+    if (next < FRAME_PACING_MIN_SPIN_NS)
+      next = FRAME_PACING_MIN_SPIN_NS;
+    if (next > FRAME_PACING_MAX_SPIN_NS)
+      next = FRAME_PACING_MAX_SPIN_NS;
+    __atomic_store_n(&spin_ns, next, __ATOMIC_RELAXED);
+  }
+
+  uint64_t spin_start = now;
+  while (now < t) {
+#ifdef __aarch64__
+    __asm__ volatile("yield");
+#endif
+    now = now_ns();
+  }
+  return now - spin_start;
+}
+
+void frame_pacing_init(void) {
+  if (prctl(PR_SET_TIMERSLACK, FRAME_PACING_TIMER_SLACK_NS) < 0)
+    debugPrintf("frame_pacing: could not lower timer slack\n");
+}
+
+int frame_pacing_swap_interval(int refresh_rate) {
+  int vsync = config.vsync_enabled ? 1 : 0;
+  if (config.target_fps <= 0)
+    return vsync;
+
+  if (vsync && refresh_rate > 0 && refresh_rate % config.target_fps == 0) {
+    debugPrintf("frame_pacing: %d fps via swap interval %d at %d Hz\n",
+                config.target_fps, refresh_rate / config.target_fps,
+                refresh_rate);
+    return refresh_rate / config.target_fps;
+  }
+
+  period_ns = 1000000000ull / config.target_fps;
+  debugPrintf("frame_pacing: %d fps via timed waits (%d Hz display)\n",
+              config.target_fps, refresh_rate);
+  return vsync;
+}
+
+static void frame_stats(uint64_t now, uint64_t spun) {
+  if (last_frame) {
+    uint64_t frame = now - last_frame;
+    if (frame < min_frame_ns)
+      min_frame_ns = frame;
+    if (frame > max_frame_ns)
+      max_frame_ns = frame;
+    sum_frame_ns += frame;
+    sum_spin_ns += spun;
+    window_frames++;
+  }
+  last_frame = now;
+
+  if (window_frames == FRAME_PACING_STATS_FRAMES) {
+    LOG_PRINTF(LOG_SYS_VIDEO, LOG_LEVEL_DEBUG,
+               "frame_pacing: frame time min %.2f avg %.2f max %.2f ms, "
+               "%d missed slots, avg spin %.3f ms\n",
+               min_frame_ns / 1e6, sum_frame_ns / 1e6 / window_frames,
+               max_frame_ns / 1e6, missed_slots,
+               sum_spin_ns / 1e6 / window_frames);
+    min_frame_ns = UINT64_MAX;
+    max_frame_ns = sum_frame_ns = sum_spin_ns = 0;
+    missed_slots = window_frames = 0;
+  }
+}
+
+void frame_pacing_wait(void) {
+  if (!period_ns)
+    return;
+  if (!have_render_thread) {
+    render_thread = pthread_self();
+    have_render_thread = 1;
+  }
+
+  uint64_t now = now_ns();
+  uint64_t spun = 0;
+  if (now < next_deadline) {
+    spun = wait_until(next_deadline);
+    now = now_ns();
+  } else if (now - next_deadline > period_ns) {
+    // more than a frame behind (loading, first frame): start a new grid
+    // instead of rushing out frames to catch up
+    if (next_deadline)
+      missed_slots++;
+    next_deadline = now;
+  }
+  __atomic_store_n(&next_deadline, next_deadline + period_ns,
+                   __ATOMIC_RELAXED);
+  frame_stats(now, spun);
+}
+
+static void paced_sleep(uint64_t ns) {
+  uint64_t now = now_ns();
+  uint64_t end = now + ns;
+  if (have_render_thread && pthread_equal(pthread_self(), render_thread)) {
+    // a slot that has already passed (e.g. while loading) doesn't limit the
+    // sleep, otherwise polling loops on this thread would turn into busy loops
+    uint64_t deadline = __atomic_load_n(&next_deadline, __ATOMIC_RELAXED);
+    if (deadline > now && deadline < end) {
+      wait_until(deadline);
+      return;
+    }
+  }
+  // everything else only needs to not oversleep, no need to spin
+  sleep_abs(end);
+}
+
+int frame_pacing_usleep(useconds_t usec) {
+  paced_sleep((uint64_t)usec * 1000);
+  return 0;
+}
+
+int frame_pacing_nanosleep(const struct timespec *req, struct timespec *rem) {
+  if (!req || req->tv_nsec < 0 || req->tv_nsec >= 1000000000L ||
+      req->tv_sec < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  paced_sleep((uint64_t)req->tv_sec * 1000000000ull + req->tv_nsec);
+  if (rem)
+    rem->tv_sec = rem->tv_nsec = 0;
+  return 0;
+}
@@ -0,0 +1,35 @@
+/* frame_pacing.h -- frame rate limiting with precise waits
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <time.h>
+#include <unistd.h>
+
+// timer slack requested for all threads while pacing is on
+#define FRAME_PACING_TIMER_SLACK_NS 1000
+// bounds of the adaptive busy-wait at the end of a paced wait
+#define FRAME_PACING_MIN_SPIN_NS 100000
+#define FRAME_PACING_MAX_SPIN_NS 2000000
+// frames between pacing stats in the log
+#define FRAME_PACING_STATS_FRAMES 600
+
+// lowers the timer slack; call early so that threads started later inherit it
+void frame_pacing_init(void);
+// picks the swap interval for the display's refresh rate (0 if unknown);
+// target rates that divide the refresh rate are paced by vsync alone
+int frame_pacing_swap_interval(int refresh_rate);
+// waits for the next frame slot, call right before swapping
+void frame_pacing_wait(void);
+
+// replacements for the sleep imports
+int frame_pacing_usleep(useconds_t usec);
+int frame_pacing_nanosleep(const struct timespec *req, struct timespec *rem);
+
+#endif // FRAME_PACING_H
@@ -0,0 +1,355 @@
+/* frame_stats.c -- frame time percentiles, stutters and session summaries
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Every frame is timed from swap to swap. The last FRAME_STATS_WINDOW frames
+// are kept in a ring for the rolling numbers in the log, and a frame taking
+// more than stutter_factor times the rolling median counts as a stutter.
+// For the session summary each level gets a histogram with
+// FRAME_STATS_BIN_US buckets, so the percentiles don't need every frame time
+// kept around. The game opens all of its archives at start, but only starts
+// reading a level archive when that level loads, which is what tells the
+// levels apart, so fopen and fread are wrapped to see the first read.
+//
+// On exit a row per level is appended to FRAME_STATS_CSV_NAME together with
+// every setting, so runs with different settings can be compared, and the
+// same is written to FRAME_STATS_JSON_NAME for the last run.
+
+#include <GLES2/gl2.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "frame_stats.h"
+#include "log.h"
+#include "util.h"
+
+typedef struct {
+  char name[32];
+  unsigned int frames;
+  unsigned int stutters;
+  double sum_ms;
+  float max_ms;
+  unsigned int hist[FRAME_STATS_BINS]; // the last bin has everything above
+} Level;
+
+typedef struct {
+  float avg, p50, p95, p99, max;
+} Summary;
+
+static float window[FRAME_STATS_WINDOW];
+static unsigned int total_frames = 0;
+static uint64_t last_frame_ns = 0;
+static float median_ms = 0;
+static unsigned int window_stutters = 0;
+
+static Level levels[FRAME_STATS_MAX_LEVELS];
+static int num_levels = 0;
+static time_t start_time;
+static char renderer[128];
+
+typedef struct {
+  FILE *file;
+  char name[32];
+} LevelArchive;
+
+FrameStatsNext frame_stats_next;
+
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static char pending_level[32];
+// level archives the game has opened but not read from yet
+static LevelArchive unread[FRAME_STATS_MAX_LEVELS];
+static int num_unread = 0;
+
+static int compare_floats(const void *a, const void *b) {
+  float x = *(const float *)a, y = *(const float *)b;
+  return x < y ? -1 : x > y;
+}
+
+// percentiles of the window; sorts a copy, so only every few frames
+static Summary summarize_window(unsigned int count) {
+  static float sorted[FRAME_STATS_WINDOW];
+  Summary s = {0};
+  double sum = 0;
+  memcpy(sorted, window, count * sizeof(*sorted));
+  qsort(sorted, count, sizeof(*sorted), compare_floats);
+  for (unsigned int i = 0; i < count; ++i)
+    sum += sorted[i];
+  s.avg = sum / count;
+  s.p50 = sorted[count / 2];
+  s.p95 = sorted[count * 95 / 100];
+  s.p99 = sorted[count * 99 / 100];
+  s.max = sorted[count - 1];
+  return s;
+}
+
+static float percentile(const Level *l, unsigned int permille) {
+  unsigned int wanted = (uint64_t)l->frames * permille / 1000, seen = 0;
+  for (int i = 0; i < FRAME_STATS_BINS; ++i) {
+    seen += l->hist[i];
+    if (seen > wanted)
+      return i == FRAME_STATS_BINS - 1 ? l->max_ms
+                                       : (i + 0.5f) * FRAME_STATS_BIN_US / 1e3f;
+  }
+  return l->max_ms;
+}
+
+static Summary summarize_level(const Level *l) {
+  Summary s = {0};
+  if (l->frames) {
+    s.avg = l->sum_ms / l->frames;
+    s.p50 = percentile(l, 500);
+    s.p95 = percentile(l, 950);
+    s.p99 = percentile(l, 990);
+    s.max = l->max_ms;
+  }
+  return s;
+}
+
+static Level *start_level(const char *name) {
+  if (num_levels == FRAME_STATS_MAX_LEVELS)
+    return &levels[num_levels - 1];
+  Level *l = &levels[num_levels++];
+  snprintf(l->name, sizeof(l->name), "%s", name);
+  return l;
+}
+
+// caller holds pending_lock; returns the entry of f, or NULL if it isn't an
+// unread level archive
+static LevelArchive *find_unread(FILE *f) {
+  for (int i = 0; i < FRAME_STATS_MAX_LEVELS; ++i) {
+    if (unread[i].file == f)
+      return &unread[i];
+  }
+  return NULL;
+}
+
+FILE *frame_stats_fopen(const char *filename, const char *mode) {
+  FILE *f = frame_stats_next.fopen(filename, mode);
+  const char *name = strrchr(filename, '/');
+  name = name ? name + 1 : filename;
+  if (!f || strncasecmp(name, "x_level", 7) || strpbrk(mode, "wa+"))
+    return f;
+
+  pthread_mutex_lock(&pending_lock);
+  LevelArchive *a = find_unread(NULL);
+  if (a) {
+    size_t len = strcspn(name, ".");
+    if (len >= sizeof(a->name))
+      len = sizeof(a->name) - 1;
+    for (size_t i = 0; i < len; ++i)
+      a->name[i] = tolower((unsigned char)name[i]);
+    a->name[len] = '\0';
+    a->file = f;
+    __atomic_add_fetch(&num_unread, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&pending_lock);
+  return f;
+}
+
+size_t frame_stats_fread(void *ptr, size_t size, size_t nmemb, FILE *f) {
+  size_t ret = frame_stats_next.fread(ptr, size, nmemb, f);
+  // nothing to look up once every level archive has been read from
+  if (!__atomic_load_n(&num_unread, __ATOMIC_RELAXED))
+    return ret;
+
+  pthread_mutex_lock(&pending_lock);
+  LevelArchive *a = find_unread(f);
+  if (a) {
+    snprintf(pending_level, sizeof(pending_level), "%s", a->name);
+    a->file = NULL;
+    __atomic_sub_fetch(&num_unread, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&pending_lock);
+  return ret;
+}
+
+int frame_stats_fclose(FILE *f) {
+  if (__atomic_load_n(&num_unread, __ATOMIC_RELAXED)) {
+    pthread_mutex_lock(&pending_lock);
+    LevelArchive *a = find_unread(f);
+    if (a) {
+      a->file = NULL;
+      __atomic_sub_fetch(&num_unread, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&pending_lock);
+  }
+  return frame_stats_next.fclose(f);
+}
+
+void frame_stats_frame(void) {
+  uint64_t now = now_ns();
+  if (!last_frame_ns) {
+    // the context is current here, which it isn't yet when the module is
+    // set up
+    const char *r = (const char *)glGetString(GL_RENDERER);
+    snprintf(renderer, sizeof(renderer), "%s", r ? r : "unknown");
+    start_time = time(NULL);
+    start_level("startup");
+    last_frame_ns = now;
+    return;
+  }
+  float ms = (now - last_frame_ns) / 1e6f;
+  last_frame_ns = now;
+
+  pthread_mutex_lock(&pending_lock);
+  if (pending_level[0]) {
+    start_level(pending_level);
+    pending_level[0] = '\0';
+  }
+  pthread_mutex_unlock(&pending_lock);
+
+  Level *l = &levels[num_levels - 1];
+  int bin = ms * 1e3f / FRAME_STATS_BIN_US;
+  l->hist[bin < FRAME_STATS_BINS ? bin : FRAME_STATS_BINS - 1]++;
+  l->frames++;
+  l->sum_ms += ms;
+  if (ms > l->max_ms)
+    l->max_ms = ms;
+
+  if (median_ms > 0 && ms > median_ms * config.stutter_factor) {
+    l->stutters++;
+    window_stutters++;
+    LOG_PRINTF(LOG_SYS_VIDEO, LOG_LEVEL_DEBUG,
+               "frame_stats: stutter at frame %u in %s, %.2f ms (median "
+               "%.2f ms)\n",
+               total_frames, l->name, ms, median_ms);
+  }
+
+  window[total_frames % FRAME_STATS_WINDOW] = ms;
+  total_frames++;
+
+  if (total_frames % FRAME_STATS_MEDIAN_FRAMES == 0) {
+    unsigned int count = total_frames < FRAME_STATS_WINDOW
+                             ? total_frames
+                             : FRAME_STATS_WINDOW;
+    Summary s = summarize_window(count);
+    median_ms = s.p50;
+    if (total_frames % FRAME_STATS_WINDOW == 0) {
+      LOG_PRINTF(LOG_SYS_VIDEO, LOG_LEVEL_DEBUG,
+                 "frame_stats: avg %.2f p50 %.2f p95 %.2f p99 %.2f max %.2f "
+                 "ms, %u stutters\n",
+                 s.avg, s.p50, s.p95, s.p99, s.max, window_stutters);
+      window_stutters = 0;
+    }
+  }
+}
+
+// the board or device name where the kernel has one, otherwise the machine
+static void device_name(char *buf, size_t size) {
+  FILE *f = fopen("/proc/device-tree/model", "r");
+  if (f) {
+    size_t len = fread(buf, 1, size - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    if (len)
+      return;
+  }
+  struct utsname u;
+  if (uname(&u) == 0)
+    snprintf(buf, size, "%s %s", u.machine, u.release);
+  else
+    snprintf(buf, size, "unknown");
+}
+
+static void write_csv(const char *date, const char *device) {
+  FILE *f = fopen(FRAME_STATS_CSV_NAME, "a");
+  if (!f) {
+    LOG_PRINTF(LOG_SYS_VIDEO, LOG_LEVEL_WARN,
+               "frame_stats: could not open %s\n", FRAME_STATS_CSV_NAME);
+    return;
+  }
+  fseek(f, 0, SEEK_END);
+  if (ftell(f) == 0) {
+    fprintf(f, "date,device,renderer,width,height,level,frames,avg_ms,p50_ms,"
+               "p95_ms,p99_ms,max_ms,stutters,");
+    write_config_csv(f, 1);
+    fputc('\n', f);
+  }
+  for (int i = 0; i < num_levels; ++i) {
+    const Level *l = &levels[i];
+    if (!l->frames)
+      continue;
+    Summary s = summarize_level(l);
+    fprintf(f, "%s,\"%s\",\"%s\",%d,%d,%s,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%u,",
+            date, device, renderer, screen_width, screen_height, l->name,
+            l->frames, s.avg, s.p50, s.p95, s.p99, s.max, l->stutters);
+    write_config_csv(f, 0);
+    fputc('\n', f);
+  }
+  fclose(f);
+}
+
+static void write_json(const char *date, const char *device) {
+  FILE *f = fopen(FRAME_STATS_JSON_NAME, "w");
+  if (!f) {
+    LOG_PRINTF(LOG_SYS_VIDEO, LOG_LEVEL_WARN,
+               "frame_stats: could not open %s\n", FRAME_STATS_JSON_NAME);
+    return;
+  }
+  fprintf(f,
+          "{\n  \"date\": \"%s\",\n  \"device\": \"%s\",\n"
+          "  \"renderer\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n"
+          "  \"stutter_factor\": %g,\n  \"config\": ",
+          date, device, renderer, screen_width, screen_height,
+          config.stutter_factor);
+  write_config_json(f);
+  fprintf(f, ",\n  \"levels\": [");
+  const char *sep = "";
+  for (int i = 0; i < num_levels; ++i) {
+    const Level *l = &levels[i];
+    if (!l->frames)
+      continue;
+    Summary s = summarize_level(l);
+    fprintf(f,
+            "%s\n    {\"level\": \"%s\", \"frames\": %u, \"avg_ms\": %.3f, "
+            "\"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, "
+            "\"max_ms\": %.3f, \"stutters\": %u}",
+            sep, l->name, l->frames, s.avg, s.p50, s.p95, s.p99, s.max,
+            l->stutters);
+    sep = ",";
+  }
+  fprintf(f, "\n  ]\n}\n");
+  fclose(f);
+}
+
+void frame_stats_report(void) {
+  if (!num_levels)
+    return;
+
+  char date[32], device[256];
+  strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&start_time));
+  device_name(device, sizeof(device));
+  // quotes would break both formats and aren't expected in either name
+  for (char *c = device; *c; ++c) {
+    if (*c == '"' || *c == '\\' || *c == '\n')
+      *c = ' ';
+  }
+  for (char *c = renderer; *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      *c = ' ';
+  }
+
+  write_csv(date, device);
+  write_json(date, device);
+
+  for (int i = 0; i < num_levels; ++i) {
+    Summary s = summarize_level(&levels[i]);
+    LOG_PRINTF(LOG_SYS_VIDEO, LOG_LEVEL_INFO,
+               "frame_stats: %s: %u frames, avg %.2f p50 %.2f p95 %.2f p99 "
+               "%.2f max %.2f ms, %u stutters\n",
+               levels[i].name, levels[i].frames, s.avg, s.p50, s.p95, s.p99,
+               s.max, levels[i].stutters);
+  }
+}
@@ -0,0 +1,47 @@
+/* frame_stats.h -- frame time percentiles, stutters and session summaries
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <stdio.h>
+
+// session summaries; the CSV gets a row per level and run, the JSON file
+// has the last run only
+#define FRAME_STATS_CSV_NAME "framestats.csv"
+#define FRAME_STATS_JSON_NAME "framestats.json"
+// frames in the rolling window, which is also logged when it fills up
+#define FRAME_STATS_WINDOW 600
+// frames between updates of the rolling median stutters are compared against
+#define FRAME_STATS_MEDIAN_FRAMES 60
+// histogram resolution and range for the session percentiles
+#define FRAME_STATS_BIN_US 100
+#define FRAME_STATS_BINS 2500
+#define FRAME_STATS_MAX_LEVELS 32
+
+// functions the wrapped imports forward to, filled in by update_imports
+typedef struct {
+  FILE *(*fopen)(const char *, const char *);
+  size_t (*fread)(void *, size_t, size_t, FILE *);
+  int (*fclose)(FILE *);
+} FrameStatsNext;
+
+extern FrameStatsNext frame_stats_next;
+
+// called once per frame right after swapping
+void frame_stats_frame(void);
+// writes the session summary, call when the game exits
+void frame_stats_report(void);
+
+// the first read from a level archive starts a new level section in the
+// summary
+FILE *frame_stats_fopen(const char *filename, const char *mode);
+size_t frame_stats_fread(void *ptr, size_t size, size_t nmemb, FILE *f);
+int frame_stats_fclose(FILE *f);
+
+#endif // FRAME_STATS_H
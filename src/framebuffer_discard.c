@@ -0,0 +1,248 @@
+/* framebuffer_discard.c -- framebuffer contents the GPU needn't write back
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Tiled GPUs like Mali and PowerVR render a framebuffer a tile at a time in
+// on-chip memory and write every attachment back to memory when the render
+// pass ends, which is when the game binds another framebuffer or swaps. With
+// GL_EXT_discard_framebuffer the driver can be told that an attachment won't
+// be needed again, so it isn't written back, nor read in at the start of a
+// pass that is about to clear it.
+//
+// The window's depth and stencil are discarded at swap. When the game binds
+// another framebuffer, the depth and stencil of the one it leaves are
+// discarded once it has been drawn to for FRAMEBUFFER_DISCARD_LEARN_BINDS
+// binds, each clearing them before testing against them. A single draw that
+// tests against the old contents keeps them for good, as does attaching a
+// texture the game may sample later. Right before a clear that covers the
+// whole framebuffer the cleared attachments are discarded too, so their old
+// contents aren't read in. The game never changes the color and stencil
+// write masks, so only the scissor test and the depth mask can keep a clear
+// from covering everything.
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "framebuffer_discard.h"
+#include "log.h"
+#include "util.h"
+
+enum { DEPTH, STENCIL };
+
+typedef struct {
+  unsigned int clean_binds; // drawn to without using what was there before
+  uint8_t keep[2]; // used before being cleared after a bind, or a texture
+} Target;
+
+FramebufferDiscardCounters framebuffer_discard_last_frame;
+FramebufferDiscardNext framebuffer_discard_next;
+
+static PFNGLDISCARDFRAMEBUFFEREXTPROC discard = NULL;
+static Target *targets = NULL; // by the game's framebuffer name
+static GLuint num_targets = 0;
+static GLuint bound = 0;
+static int cleared[2]; // since the framebuffer was bound
+static int drew = 0;
+static int depth_test = 0;
+static int stencil_test = 0;
+static int scissor_test = 0;
+static GLboolean depth_mask = GL_TRUE;
+
+static FramebufferDiscardCounters frame;
+static unsigned long long total_swap = 0;
+static unsigned long long total_bind = 0;
+static unsigned long long total_clear = 0;
+static unsigned int frames = 0;
+
+static Target *get_target(GLuint name) {
+  if (name >= num_targets) {
+    GLuint num = name * 2 + 16;
+    Target *grown = realloc(targets, num * sizeof(*grown));
+    if (!grown)
+      fatal_error("Failed to allocate framebuffer records");
+    memset(grown + num_targets, 0, (num - num_targets) * sizeof(*grown));
+    targets = grown;
+    num_targets = num;
+  }
+  return &targets[name];
+}
+
+// the attachments are named after the framebuffer bound in GL, which isn't
+// the game's window when render_scale has it draw to a target of its own
+static void discard_bound(int color, int depth, int stencil,
+                          unsigned int *counter) {
+  GLenum attachments[3];
+  GLsizei n = 0;
+  GLint real = 0;
+  if (!color && !depth && !stencil)
+    return;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &real);
+  if (color)
+    attachments[n++] = real ? GL_COLOR_ATTACHMENT0 : GL_COLOR_EXT;
+  if (depth)
+    attachments[n++] = real ? GL_DEPTH_ATTACHMENT : GL_DEPTH_EXT;
+  if (stencil)
+    attachments[n++] = real ? GL_STENCIL_ATTACHMENT : GL_STENCIL_EXT;
+  discard(GL_FRAMEBUFFER, n, attachments);
+  *counter += n;
+}
+
+void framebuffer_discard_init(void) {
+  if (!has_extension("GL_EXT_discard_framebuffer")) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+               "framebuffer_discard: GL_EXT_discard_framebuffer is not "
+               "supported\n");
+    return;
+  }
+  discard = (void *)eglGetProcAddress("glDiscardFramebufferEXT");
+}
+
+void framebuffer_discard_glBindFramebuffer(GLenum target, GLuint framebuffer) {
+  if (discard && framebuffer != bound) {
+    Target *t = get_target(bound);
+    if (drew && t->clean_binds < FRAMEBUFFER_DISCARD_LEARN_BINDS)
+      t->clean_binds++;
+    if (t->clean_binds == FRAMEBUFFER_DISCARD_LEARN_BINDS)
+      discard_bound(0, !t->keep[DEPTH], !t->keep[STENCIL], &frame.at_bind);
+    cleared[DEPTH] = cleared[STENCIL] = drew = 0;
+  }
+  bound = framebuffer;
+  framebuffer_discard_next.glBindFramebuffer(target, framebuffer);
+}
+
+// deleting the bound framebuffer binds the window's
+void framebuffer_discard_glDeleteFramebuffers(GLsizei n,
+                                              const GLuint *framebuffers) {
+  for (GLsizei i = 0; i < n; ++i) {
+    if (!framebuffers[i])
+      continue;
+    if (framebuffers[i] < num_targets)
+      memset(&targets[framebuffers[i]], 0, sizeof(*targets));
+    if (framebuffers[i] == bound) {
+      bound = 0;
+      cleared[DEPTH] = cleared[STENCIL] = drew = 0;
+    }
+  }
+  framebuffer_discard_next.glDeleteFramebuffers(n, framebuffers);
+}
+
+void framebuffer_discard_glFramebufferTexture2D(GLenum target,
+                                                GLenum attachment,
+                                                GLenum textarget,
+                                                GLuint texture, GLint level) {
+  if (attachment == GL_DEPTH_ATTACHMENT)
+    get_target(bound)->keep[DEPTH] = 1;
+  else if (attachment == GL_STENCIL_ATTACHMENT)
+    get_target(bound)->keep[STENCIL] = 1;
+  framebuffer_discard_next.glFramebufferTexture2D(target, attachment,
+                                                  textarget, texture, level);
+}
+
+static void set_cap(GLenum cap, int enabled) {
+  if (cap == GL_DEPTH_TEST)
+    depth_test = enabled;
+  else if (cap == GL_STENCIL_TEST)
+    stencil_test = enabled;
+  else if (cap == GL_SCISSOR_TEST)
+    scissor_test = enabled;
+}
+
+void framebuffer_discard_glEnable(GLenum cap) {
+  set_cap(cap, 1);
+  framebuffer_discard_next.glEnable(cap);
+}
+
+void framebuffer_discard_glDisable(GLenum cap) {
+  set_cap(cap, 0);
+  framebuffer_discard_next.glDisable(cap);
+}
+
+void framebuffer_discard_glDepthMask(GLboolean flag) {
+  depth_mask = flag;
+  framebuffer_discard_next.glDepthMask(flag);
+}
+
+void framebuffer_discard_glClear(GLbitfield mask) {
+  if (discard && !scissor_test) {
+    int depth = (mask & GL_DEPTH_BUFFER_BIT) && depth_mask;
+    int stencil = (mask & GL_STENCIL_BUFFER_BIT) != 0;
+    discard_bound((mask & GL_COLOR_BUFFER_BIT) != 0, depth, stencil,
+                  &frame.at_clear);
+    cleared[DEPTH] |= depth;
+    cleared[STENCIL] |= stencil;
+  }
+  framebuffer_discard_next.glClear(mask);
+}
+
+// a draw testing against what the framebuffer had before it was bound means
+// that has to be kept
+static void drawn(void) {
+  drew = 1;
+  if (depth_test && !cleared[DEPTH])
+    get_target(bound)->keep[DEPTH] = 1;
+  if (stencil_test && !cleared[STENCIL])
+    get_target(bound)->keep[STENCIL] = 1;
+}
+
+void framebuffer_discard_glDrawArrays(GLenum mode, GLint first,
+                                      GLsizei count) {
+  if (discard)
+    drawn();
+  framebuffer_discard_next.glDrawArrays(mode, first, count);
+}
+
+void framebuffer_discard_glDrawElements(GLenum mode, GLsizei count,
+                                        GLenum type, const void *indices) {
+  if (discard)
+    drawn();
+  framebuffer_discard_next.glDrawElements(mode, count, type, indices);
+}
+
+void framebuffer_discard_swap(void) {
+  if (!discard)
+    return;
+  // the window's contents are undefined after the swap anyway
+  if (!bound)
+    discard_bound(0, 1, 1, &frame.at_swap);
+  cleared[DEPTH] = cleared[STENCIL] = drew = 0;
+}
+
+void framebuffer_discard_frame(void) {
+  framebuffer_discard_last_frame = frame;
+  total_swap += frame.at_swap;
+  total_bind += frame.at_bind;
+  total_clear += frame.at_clear;
+  memset(&frame, 0, sizeof(frame));
+
+  if (++frames % FRAMEBUFFER_DISCARD_REPORT_FRAMES)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "framebuffer_discard: last frame %u attachments discarded at "
+             "swap, %u at framebuffer switches, %u before clears\n",
+             framebuffer_discard_last_frame.at_swap,
+             framebuffer_discard_last_frame.at_bind,
+             framebuffer_discard_last_frame.at_clear);
+}
+
+void framebuffer_discard_report(void) {
+  if (!frames)
+    return;
+  unsigned int kept = 0;
+  for (GLuint i = 0; i < num_targets; ++i)
+    kept += targets[i].keep[DEPTH] || targets[i].keep[STENCIL];
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "framebuffer_discard: %.1f attachments discarded per frame at "
+             "swap, %.1f at framebuffer switches and %.1f before clears in "
+             "%u frames; %u framebuffers keep their depth or stencil\n",
+             (double)total_swap / frames, (double)total_bind / frames,
+             (double)total_clear / frames, frames, kept);
+}
@@ -0,0 +1,71 @@
+/* framebuffer_discard.h -- framebuffer contents the GPU needn't write back
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef FRAMEBUFFER_DISCARD_H
+#define FRAMEBUFFER_DISCARD_H
+
+#include <GLES2/gl2.h>
+
+// binds a framebuffer is drawn to, clearing before it is tested against,
+// before its depth and stencil are discarded when the game leaves it
+#define FRAMEBUFFER_DISCARD_LEARN_BINDS 30
+// frames between reports in the log
+#define FRAMEBUFFER_DISCARD_REPORT_FRAMES 600
+
+typedef struct {
+  unsigned int at_swap;  // attachments discarded at swap
+  unsigned int at_bind;  // when the game bound another framebuffer
+  unsigned int at_clear; // right before a clear covering all of them
+} FramebufferDiscardCounters;
+
+// counts of the last finished frame
+extern FramebufferDiscardCounters framebuffer_discard_last_frame;
+
+// functions the discarding imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLBINDFRAMEBUFFERPROC glBindFramebuffer;
+  PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers;
+  PFNGLFRAMEBUFFERTEXTURE2DPROC glFramebufferTexture2D;
+  PFNGLENABLEPROC glEnable;
+  PFNGLDISABLEPROC glDisable;
+  PFNGLDEPTHMASKPROC glDepthMask;
+  PFNGLCLEARPROC glClear;
+  PFNGLDRAWARRAYSPROC glDrawArrays;
+  PFNGLDRAWELEMENTSPROC glDrawElements;
+} FramebufferDiscardNext;
+
+extern FramebufferDiscardNext framebuffer_discard_next;
+
+// looks up glDiscardFramebufferEXT, call with the game's context current;
+// nothing is discarded without GL_EXT_discard_framebuffer
+void framebuffer_discard_init(void);
+// discards the depth and stencil of the window's framebuffer, call at swap
+// before anything else is drawn
+void framebuffer_discard_swap(void);
+// called once per frame at swap
+void framebuffer_discard_frame(void);
+// logs how many attachments were discarded, call when the game exits
+void framebuffer_discard_report(void);
+
+void framebuffer_discard_glBindFramebuffer(GLenum target, GLuint framebuffer);
+void framebuffer_discard_glDeleteFramebuffers(GLsizei n,
+                                              const GLuint *framebuffers);
+void framebuffer_discard_glFramebufferTexture2D(GLenum target,
+                                                GLenum attachment,
+                                                GLenum textarget,
+                                                GLuint texture, GLint level);
+void framebuffer_discard_glEnable(GLenum cap);
+void framebuffer_discard_glDisable(GLenum cap);
+void framebuffer_discard_glDepthMask(GLboolean flag);
+void framebuffer_discard_glClear(GLbitfield mask);
+void framebuffer_discard_glDrawArrays(GLenum mode, GLint first,
+                                      GLsizei count);
+void framebuffer_discard_glDrawElements(GLenum mode, GLsizei count,
+                                        GLenum type, const void *indices);
+
+#endif // FRAMEBUFFER_DISCARD_H
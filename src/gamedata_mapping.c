@@ -7,17 +7,35 @@
  */
 
 #include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "config.h"
 #include "error.h"
 #include "gamedata_mapping.h"
+#include "util.h"
+
+typedef struct {
+  char *path; // actual path on disk
+  struct stat st;
+  int st_valid; // cleared once the file has been opened for writing
+} GamedataEntry;
 
 static struct hashmap_s gamedata_mapping;
 static int mapping_initialized = 0;
+// entries are only added at runtime, never removed until cleanup, so
+// resolved path pointers stay valid after the lock is released
+static pthread_rwlock_t mapping_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static unsigned long stat_hits = 0;
+static unsigned long negative_hits = 0;
 
-static void add_path_to_mapping(const char *path) {
+static void add_path_to_mapping(const char *path, const struct stat *st) {
   if (!path) {
     return;
   }
@@ -32,14 +50,29 @@ static void add_path_to_mapping(const char *path) {
     *p = tolower((unsigned char)*p);
   }
 
-  char *value = strdup(path);
-  if (!value) {
+  GamedataEntry *entry = hashmap_get(&gamedata_mapping, key, strlen(key));
+  if (entry) {
+    // already known (e.g. recreated by the game); just refresh the metadata
+    free(key);
+    entry->st = *st;
+    entry->st_valid = 1;
+    return;
+  }
+
+  entry = calloc(1, sizeof(*entry));
+  if (entry) {
+    entry->path = strdup(path);
+  }
+  if (!entry || !entry->path) {
+    free(entry);
     free(key);
     fatal_error("Failed to allocate memory for gamedata mapping value");
     return;
   }
+  entry->st = *st;
+  entry->st_valid = 1;
 
-  hashmap_put(&gamedata_mapping, key, strlen(key), value);
+  hashmap_put(&gamedata_mapping, key, strlen(key), entry);
 }
 
 static inline int should_skip_entry(const char *name) {
@@ -68,10 +101,10 @@ static void scan_directory(const char *dir_path) {
 
     struct stat st;
     if (stat(full_path, &st) == 0) {
+      // directories are indexed too so that stat() on them can be answered
+      add_path_to_mapping(full_path, &st);
       if (S_ISDIR(st.st_mode)) {
         scan_directory(full_path);
-      } else {
-        add_path_to_mapping(full_path);
       }
     }
   }
@@ -108,7 +141,9 @@ static int cleanup_iterator(void *context, struct hashmap_element_s *element) {
     free((char *)element->key);
   }
   if (element->data) {
-    free((char *)element->data);
+    GamedataEntry *entry = element->data;
+    free(entry->path);
+    free(entry);
   }
 
   return 0;
@@ -119,35 +154,121 @@ void gamedata_mapping_cleanup(void) {
     return;
   }
 
+  if (config.debug_gamedata_mapping) {
+    debugPrintf("gamedata mapping: %lu stat calls served from cache, %lu "
+                "missing file lookups answered without the filesystem\n",
+                stat_hits, negative_hits);
+  }
+
   hashmap_iterate_pairs(&gamedata_mapping, cleanup_iterator, NULL);
   hashmap_destroy(&gamedata_mapping);
   mapping_initialized = 0;
 }
 
-const char *gamedata_mapping_get(const char *path) {
-  if (!mapping_initialized || !path) {
-    return NULL;
+// the game may create files here at any time, so lookups always go to disk
+static int is_volatile_path(const char *lowercase_path) {
+  return strncmp(lowercase_path, GAMEDATA_VOLATILE_DIR,
+                 sizeof(GAMEDATA_VOLATILE_DIR) - 2) == 0 &&
+         (lowercase_path[sizeof(GAMEDATA_VOLATILE_DIR) - 2] == '\0' ||
+          lowercase_path[sizeof(GAMEDATA_VOLATILE_DIR) - 2] == '/');
+}
+
+static int to_lowercase_key(const char *path, char *key, size_t key_size) {
+  size_t i;
+  for (i = 0; path[i]; ++i) {
+    if (i + 1 >= key_size) {
+      return -1;
+    }
+    key[i] = tolower((unsigned char)path[i]);
   }
+  key[i] = '\0';
+  return 0;
+}
 
-  char *lowercase_path = strdup(path);
-  if (!lowercase_path) {
+// caller holds mapping_lock
+static GamedataEntry *find_entry(const char *path, int *status) {
+  char key[PATH_MAX];
+  *status = GAMEDATA_PATH_UNINDEXED;
+  if (!mapping_initialized || !path ||
+      to_lowercase_key(path, key, sizeof(key)) < 0) {
     return NULL;
   }
 
-  for (char *p = lowercase_path; *p; ++p) {
-    *p = tolower((unsigned char)*p);
+  GamedataEntry *entry = hashmap_get(&gamedata_mapping, key, strlen(key));
+  if (entry) {
+    *status = GAMEDATA_PATH_FOUND;
+  } else if (!strncmp(key, "gamedata/", 9) && !is_volatile_path(key)) {
+    *status = GAMEDATA_PATH_MISSING;
   }
+  return entry;
+}
 
-  const char *result = (const char *)hashmap_get(
-      &gamedata_mapping, lowercase_path, strlen(lowercase_path));
-
-  free(lowercase_path);
+const char *gamedata_mapping_get(const char *path) {
+  const char *result = NULL;
+  gamedata_mapping_lookup(path, &result);
   return result;
 }
 
+int gamedata_mapping_lookup(const char *path, const char **resolved) {
+  int status;
+  pthread_rwlock_rdlock(&mapping_lock);
+  GamedataEntry *entry = find_entry(path, &status);
+  *resolved = entry ? entry->path : NULL;
+  pthread_rwlock_unlock(&mapping_lock);
+  if (status == GAMEDATA_PATH_MISSING) {
+    __atomic_fetch_add(&negative_hits, 1, __ATOMIC_RELAXED);
+  }
+  return status;
+}
+
+int gamedata_mapping_stat(const char *path, struct stat *st) {
+  int status;
+  const char *resolved = path;
+
+  pthread_rwlock_rdlock(&mapping_lock);
+  GamedataEntry *entry = find_entry(path, &status);
+  if (entry && entry->st_valid) {
+    *st = entry->st;
+    pthread_rwlock_unlock(&mapping_lock);
+    __atomic_fetch_add(&stat_hits, 1, __ATOMIC_RELAXED);
+    return 0;
+  }
+  if (entry) {
+    resolved = entry->path;
+  }
+  pthread_rwlock_unlock(&mapping_lock);
+
+  if (status == GAMEDATA_PATH_MISSING) {
+    __atomic_fetch_add(&negative_hits, 1, __ATOMIC_RELAXED);
+    errno = ENOENT;
+    return -1;
+  }
+  return stat(resolved, st);
+}
+
+void gamedata_mapping_add(const char *path) {
+  struct stat st;
+  if (!mapping_initialized || !path || stat(path, &st) < 0) {
+    return;
+  }
+  pthread_rwlock_wrlock(&mapping_lock);
+  add_path_to_mapping(path, &st);
+  pthread_rwlock_unlock(&mapping_lock);
+}
+
+void gamedata_mapping_invalidate(const char *path) {
+  int status;
+  pthread_rwlock_wrlock(&mapping_lock);
+  GamedataEntry *entry = find_entry(path, &status);
+  if (entry) {
+    entry->st_valid = 0;
+  }
+  pthread_rwlock_unlock(&mapping_lock);
+}
+
 struct hashmap_s *gamedata_mapping_get_hashmap(void) {
   if (!mapping_initialized) {
     return NULL;
   }
   return &gamedata_mapping;
-}
\ No newline at end of file
+}
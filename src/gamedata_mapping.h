@@ -9,17 +9,30 @@
 #ifndef GAMEDATA_MAPPING_H
 #define GAMEDATA_MAPPING_H
 
-#include <dirent.h>
-#include <limits.h>
 #include <sys/stat.h>
 
 #include "hashmap.h"
 
 #define GAMEDATA_MAPPING_INITIAL_SIZE 244
 
+// paths under here are never treated as known-missing
+#define GAMEDATA_VOLATILE_DIR "gamedata/savegames/"
+
+// results of gamedata_mapping_lookup
+#define GAMEDATA_PATH_UNINDEXED 0 // outside the index, ask the filesystem
+#define GAMEDATA_PATH_FOUND 1     // indexed, resolved holds the real path
+#define GAMEDATA_PATH_MISSING 2   // under gamedata/ and known not to exist
+
 int gamedata_mapping_init(void);
 void gamedata_mapping_cleanup(void);
 const char *gamedata_mapping_get(const char *path);
+int gamedata_mapping_lookup(const char *path, const char **resolved);
+// stat() that answers indexed and known-missing paths from the index
+int gamedata_mapping_stat(const char *path, struct stat *st);
+// indexes a file or directory that was created after the initial scan
+void gamedata_mapping_add(const char *path);
+// drops the cached metadata of a file that is about to be modified
+void gamedata_mapping_invalidate(const char *path);
 struct hashmap_s *gamedata_mapping_get_hashmap(void);
 
-#endif // GAMEDATA_MAPPING_H
\ No newline at end of file
+#endif // GAMEDATA_MAPPING_H
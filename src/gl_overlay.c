@@ -0,0 +1,119 @@
+/* gl_overlay.c -- helpers for drawing over the game's frame at swap
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The game doesn't expect anyone else to draw, so whatever an overlay changes
+// is read back before and restored after. These calls go straight to GL
+// rather than through the game's imports, so the layers there (gl_state,
+// render_scale) neither see nor count them.
+
+#include "config.h"
+#include "gl_overlay.h"
+#include "util.h"
+
+void gl_overlay_begin(GlOverlayState *s) {
+  glGetIntegerv(GL_CURRENT_PROGRAM, &s->program);
+  glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &s->array_buffer);
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &s->framebuffer);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &s->active_texture);
+  glActiveTexture(GL_TEXTURE0);
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &s->texture);
+  glGetIntegerv(GL_VIEWPORT, s->viewport);
+  glGetIntegerv(GL_BLEND_SRC_RGB, &s->blend_src_rgb);
+  glGetIntegerv(GL_BLEND_DST_RGB, &s->blend_dst_rgb);
+  glGetIntegerv(GL_BLEND_SRC_ALPHA, &s->blend_src_alpha);
+  glGetIntegerv(GL_BLEND_DST_ALPHA, &s->blend_dst_alpha);
+  s->blend = glIsEnabled(GL_BLEND);
+  s->depth_test = glIsEnabled(GL_DEPTH_TEST);
+  s->cull_face = glIsEnabled(GL_CULL_FACE);
+  s->scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+  s->stencil_test = glIsEnabled(GL_STENCIL_TEST);
+  for (int i = 0; i < GL_OVERLAY_ATTRIBS; ++i) {
+    GlOverlayAttrib *a = &s->attribs[i];
+    glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &a->enabled);
+    glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_SIZE, &a->size);
+    glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_TYPE, &a->type);
+    glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &a->normalized);
+    glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &a->stride);
+    glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &a->buffer);
+    glGetVertexAttribPointerv(i, GL_VERTEX_ATTRIB_ARRAY_POINTER, &a->pointer);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, screen_width, screen_height);
+  glDisable(GL_BLEND);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_STENCIL_TEST);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void gl_overlay_end(const GlOverlayState *s) {
+  for (int i = 0; i < GL_OVERLAY_ATTRIBS; ++i) {
+    const GlOverlayAttrib *a = &s->attribs[i];
+    glBindBuffer(GL_ARRAY_BUFFER, a->buffer);
+    glVertexAttribPointer(i, a->size, a->type, a->normalized, a->stride,
+                          a->pointer);
+    if (a->enabled)
+      glEnableVertexAttribArray(i);
+    else
+      glDisableVertexAttribArray(i);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, s->array_buffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, s->framebuffer);
+  glViewport(s->viewport[0], s->viewport[1], s->viewport[2], s->viewport[3]);
+  glBlendFuncSeparate(s->blend_src_rgb, s->blend_dst_rgb, s->blend_src_alpha,
+                      s->blend_dst_alpha);
+  (s->blend ? glEnable : glDisable)(GL_BLEND);
+  (s->depth_test ? glEnable : glDisable)(GL_DEPTH_TEST);
+  (s->cull_face ? glEnable : glDisable)(GL_CULL_FACE);
+  (s->scissor_test ? glEnable : glDisable)(GL_SCISSOR_TEST);
+  (s->stencil_test ? glEnable : glDisable)(GL_STENCIL_TEST);
+  glBindTexture(GL_TEXTURE_2D, s->texture);
+  glActiveTexture(s->active_texture);
+  glUseProgram(s->program);
+}
+
+static GLuint compile(GLenum type, const char *source) {
+  GLuint shader = glCreateShader(type);
+  GLint ok = 0;
+  glShaderSource(shader, 1, &source, NULL);
+  glCompileShader(shader);
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    char log[512] = "";
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    debugPrintf("gl_overlay: shader compile failed: %s\n", log);
+  }
+  return shader;
+}
+
+GLuint gl_overlay_program(const char *vertex_source,
+                          const char *fragment_source,
+                          const char *const *attribs, int num_attribs) {
+  GLuint vs = compile(GL_VERTEX_SHADER, vertex_source);
+  GLuint fs = compile(GL_FRAGMENT_SHADER, fragment_source);
+  GLuint program = glCreateProgram();
+  GLint ok = 0;
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  for (int i = 0; i < num_attribs; ++i)
+    glBindAttribLocation(program, i, attribs[i]);
+  glLinkProgram(program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  glGetProgramiv(program, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    char log[512] = "";
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    debugPrintf("gl_overlay: program link failed: %s\n", log);
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
@@ -0,0 +1,43 @@
+/* gl_overlay.h -- helpers for drawing over the game's frame at swap
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef GL_OVERLAY_H
+#define GL_OVERLAY_H
+
+#include <GLES2/gl2.h>
+
+// vertex attributes saved and restored, overlays use 0 to this - 1
+#define GL_OVERLAY_ATTRIBS 3
+
+typedef struct {
+  GLint enabled, size, type, normalized, stride, buffer;
+  void *pointer;
+} GlOverlayAttrib;
+
+// everything an overlay may change
+typedef struct {
+  GLint program, array_buffer, framebuffer;
+  GLint active_texture, texture, viewport[4];
+  GLint blend_src_rgb, blend_dst_rgb, blend_src_alpha, blend_dst_alpha;
+  GLboolean blend, depth_test, cull_face, scissor_test, stencil_test;
+  GlOverlayAttrib attribs[GL_OVERLAY_ATTRIBS];
+} GlOverlayState;
+
+// saves the state into s and sets up drawing to the window over the whole
+// screen, with texture unit 0 active and blending, depth, culling, scissor
+// and stencil off
+void gl_overlay_begin(GlOverlayState *s);
+// puts back the state saved by gl_overlay_begin
+void gl_overlay_end(const GlOverlayState *s);
+// compiles and links a program with attribs bound to locations 0 and up;
+// returns 0 and logs the error on failure
+GLuint gl_overlay_program(const char *vertex_source,
+                          const char *fragment_source,
+                          const char *const *attribs, int num_attribs);
+
+#endif // GL_OVERLAY_H
@@ -0,0 +1,578 @@
+/* gl_recorder.c -- records the game's GL calls for tools/glreplay
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Every GL call the game makes is written to GL_TRACE_NAME along with the
+// data it passes (textures, buffers, shader sources, uniforms), so that the
+// replayer can run the same frames without the game. Recording starts with
+// the first GL call, as a trace has to contain every object its frames use,
+// but until gl_record_start frames have passed draws and clears are left out
+// to keep the trace small. After gl_record_frames more frames the trace is
+// closed and the wrappers only forward.
+//
+// Client-side vertex arrays are read by GL at draw time, so the vertices a
+// draw uses are written just before it. For indexed draws the index range
+// comes from the indices, kept in a copy for index buffers.
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "gl_recorder.h"
+#include "gl_trace.h"
+#include "util.h"
+
+// calls that need a hand-written wrapper
+#define GL_RECORDER_SPECIAL_CALLS(X)                                           \
+  X(glGenTextures)                                                             \
+  X(glGenBuffers)                                                              \
+  X(glGenFramebuffers)                                                         \
+  X(glGenRenderbuffers)                                                        \
+  X(glDeleteTextures)                                                          \
+  X(glDeleteBuffers)                                                           \
+  X(glDeleteFramebuffers)                                                      \
+  X(glDeleteRenderbuffers)                                                     \
+  X(glCreateProgram)                                                           \
+  X(glCreateShader)                                                            \
+  X(glShaderSource)                                                            \
+  X(glGetUniformLocation)                                                      \
+  X(glGetAttribLocation)                                                       \
+  X(glBindAttribLocation)                                                      \
+  X(glBufferData)                                                              \
+  X(glTexImage2D)                                                              \
+  X(glCompressedTexImage2D)                                                    \
+  X(glUniform1fv)                                                              \
+  X(glUniform2fv)                                                              \
+  X(glUniform3fv)                                                              \
+  X(glUniform4fv)                                                              \
+  X(glUniformMatrix3fv)                                                        \
+  X(glUniformMatrix4fv)                                                        \
+  X(glVertexAttrib4fv)                                                         \
+  X(glVertexAttribPointer)                                                     \
+  X(glDrawArrays)                                                              \
+  X(glDrawElements)                                                            \
+  X(glReadPixels)
+
+#define NEXT(name, ...) __typeof__(&name) name;
+
+static struct {
+  GL_TRACE_CALLS(NEXT, NEXT, NEXT, NEXT, NEXT, NEXT)
+  GL_TRACE_TRACKED_CALLS(NEXT, NEXT, NEXT, NEXT, NEXT, NEXT)
+  GL_RECORDER_SPECIAL_CALLS(NEXT)
+} next;
+
+enum {
+  STATE_OFF,
+  STATE_SETUP, // before gl_record_start: everything but draws
+  STATE_FULL,
+};
+
+typedef struct {
+  int enabled;
+  int client; // pointer is client memory rather than a buffer offset
+  GLint size;
+  GLenum type;
+  GLboolean normalized;
+  GLsizei stride;
+  const void *pointer;
+} Attrib;
+
+typedef struct {
+  void *data;
+  size_t size;
+} IndexCopy;
+
+static FILE *trace = NULL;
+static int state = STATE_OFF;
+static unsigned int frame = 0;
+static uint64_t bytes_written = 0;
+// draws write several records that must stay together
+static pthread_mutex_t lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static Attrib attribs[GL_TRACE_MAX_ATTRIBS];
+static GLuint array_buffer = 0;
+static GLuint element_buffer = 0;
+static IndexCopy *index_copies = NULL; // by buffer name
+static GLuint num_index_copies = 0;
+
+static int recording(int draw) {
+  return state == STATE_FULL || (state == STATE_SETUP && !draw);
+}
+
+static void put_call(int op, const GlTraceArg *args, int num_args,
+                     const void *data, size_t size) {
+  static const uint8_t pad[4] = {0};
+  GlTraceCall call = {op, num_args, size};
+  pthread_mutex_lock(&lock);
+  if (trace) {
+    fwrite(&call, sizeof(call), 1, trace);
+    fwrite(args, sizeof(*args), num_args, trace);
+    if (size) {
+      fwrite(data, 1, size, trace);
+      fwrite(pad, 1, -size & 3, trace);
+    }
+    bytes_written += sizeof(call) + num_args * sizeof(*args) + size;
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+#define ARGS(...) (GlTraceArg[]){__VA_ARGS__}
+#define NUM_ARGS(...)                                                          \
+  (sizeof((GlTraceArg[]){__VA_ARGS__}) / sizeof(GlTraceArg))
+#define PUT(op, data, size, ...)                                               \
+  put_call(op, ARGS(__VA_ARGS__), NUM_ARGS(__VA_ARGS__), data, size)
+
+// wrappers for the plain calls
+#define REC0(name)                                                             \
+  static void rec_##name(void) {                                               \
+    next.name();                                                               \
+    if (recording(0))                                                          \
+      put_call(GL_TRACE_OP_##name, NULL, 0, NULL, 0);                          \
+  }
+#define REC1(name, A)                                                          \
+  static void rec_##name(GL_TRACE_TYPE_##A a0) {                               \
+    next.name(a0);                                                             \
+    if (recording(0))                                                          \
+      PUT(GL_TRACE_OP_##name, NULL, 0, GL_TRACE_ARG_##A(a0));                  \
+  }
+#define REC2(name, A, B)                                                       \
+  static void rec_##name(GL_TRACE_TYPE_##A a0, GL_TRACE_TYPE_##B a1) {         \
+    next.name(a0, a1);                                                         \
+    if (recording(0))                                                          \
+      PUT(GL_TRACE_OP_##name, NULL, 0, GL_TRACE_ARG_##A(a0),                   \
+          GL_TRACE_ARG_##B(a1));                                               \
+  }
+#define REC3(name, A, B, C)                                                    \
+  static void rec_##name(GL_TRACE_TYPE_##A a0, GL_TRACE_TYPE_##B a1,           \
+                         GL_TRACE_TYPE_##C a2) {                               \
+    next.name(a0, a1, a2);                                                     \
+    if (recording(0))                                                          \
+      PUT(GL_TRACE_OP_##name, NULL, 0, GL_TRACE_ARG_##A(a0),                   \
+          GL_TRACE_ARG_##B(a1), GL_TRACE_ARG_##C(a2));                         \
+  }
+#define REC4(name, A, B, C, D)                                                 \
+  static void rec_##name(GL_TRACE_TYPE_##A a0, GL_TRACE_TYPE_##B a1,           \
+                         GL_TRACE_TYPE_##C a2, GL_TRACE_TYPE_##D a3) {         \
+    next.name(a0, a1, a2, a3);                                                 \
+    if (recording(0))                                                          \
+      PUT(GL_TRACE_OP_##name, NULL, 0, GL_TRACE_ARG_##A(a0),                   \
+          GL_TRACE_ARG_##B(a1), GL_TRACE_ARG_##C(a2), GL_TRACE_ARG_##D(a3));   \
+  }
+#define REC5(name, A, B, C, D, E)                                              \
+  static void rec_##name(GL_TRACE_TYPE_##A a0, GL_TRACE_TYPE_##B a1,           \
+                         GL_TRACE_TYPE_##C a2, GL_TRACE_TYPE_##D a3,           \
+                         GL_TRACE_TYPE_##E a4) {                               \
+    next.name(a0, a1, a2, a3, a4);                                             \
+    if (recording(0))                                                          \
+      PUT(GL_TRACE_OP_##name, NULL, 0, GL_TRACE_ARG_##A(a0),                   \
+          GL_TRACE_ARG_##B(a1), GL_TRACE_ARG_##C(a2), GL_TRACE_ARG_##D(a3),    \
+          GL_TRACE_ARG_##E(a4));                                               \
+  }
+
+GL_TRACE_CALLS(REC0, REC1, REC2, REC3, REC4, REC5)
+
+static void rec_glClear(GLbitfield mask) {
+  next.glClear(mask);
+  if (recording(1))
+    PUT(GL_TRACE_OP_glClear, NULL, 0, {.u = mask});
+}
+
+static void rec_glEnableVertexAttribArray(GLuint index) {
+  next.glEnableVertexAttribArray(index);
+  if (index < GL_TRACE_MAX_ATTRIBS)
+    attribs[index].enabled = 1;
+  if (recording(0))
+    PUT(GL_TRACE_OP_glEnableVertexAttribArray, NULL, 0, {.u = index});
+}
+
+static void rec_glDisableVertexAttribArray(GLuint index) {
+  next.glDisableVertexAttribArray(index);
+  if (index < GL_TRACE_MAX_ATTRIBS)
+    attribs[index].enabled = 0;
+  if (recording(0))
+    PUT(GL_TRACE_OP_glDisableVertexAttribArray, NULL, 0, {.u = index});
+}
+
+static void rec_glBindBuffer(GLenum target, GLuint buffer) {
+  next.glBindBuffer(target, buffer);
+  if (target == GL_ARRAY_BUFFER)
+    array_buffer = buffer;
+  else if (target == GL_ELEMENT_ARRAY_BUFFER)
+    element_buffer = buffer;
+  if (recording(0))
+    PUT(GL_TRACE_OP_glBindBuffer, NULL, 0, {.u = target}, {.u = buffer});
+}
+
+#define REC_GEN(name)                                                          \
+  static void rec_##name(GLsizei n, GLuint *names) {                           \
+    next.name(n, names);                                                       \
+    if (recording(0) && n > 0)                                                 \
+      PUT(GL_TRACE_OP_##name, names, n * sizeof(GLuint), {.i = n});            \
+  }
+#define REC_DELETE(name)                                                       \
+  static void rec_##name(GLsizei n, const GLuint *names) {                     \
+    next.name(n, names);                                                       \
+    if (recording(0) && n > 0)                                                 \
+      PUT(GL_TRACE_OP_##name, names, n * sizeof(GLuint), {.i = n});            \
+  }
+
+REC_GEN(glGenTextures)
+REC_GEN(glGenBuffers)
+REC_GEN(glGenFramebuffers)
+REC_GEN(glGenRenderbuffers)
+REC_DELETE(glDeleteTextures)
+REC_DELETE(glDeleteFramebuffers)
+REC_DELETE(glDeleteRenderbuffers)
+
+static void rec_glDeleteBuffers(GLsizei n, const GLuint *names) {
+  next.glDeleteBuffers(n, names);
+  for (GLsizei i = 0; i < n; ++i) {
+    if (names[i] < num_index_copies) {
+      free(index_copies[names[i]].data);
+      index_copies[names[i]].data = NULL;
+      index_copies[names[i]].size = 0;
+    }
+    if (names[i] == array_buffer)
+      array_buffer = 0;
+    if (names[i] == element_buffer)
+      element_buffer = 0;
+  }
+  if (recording(0) && n > 0)
+    PUT(GL_TRACE_OP_glDeleteBuffers, names, n * sizeof(GLuint), {.i = n});
+}
+
+static GLuint rec_glCreateProgram(void) {
+  GLuint program = next.glCreateProgram();
+  if (recording(0))
+    PUT(GL_TRACE_OP_glCreateProgram, NULL, 0, {.u = program});
+  return program;
+}
+
+static GLuint rec_glCreateShader(GLenum type) {
+  GLuint shader = next.glCreateShader(type);
+  if (recording(0))
+    PUT(GL_TRACE_OP_glCreateShader, NULL, 0, {.u = type}, {.u = shader});
+  return shader;
+}
+
+static void rec_glShaderSource(GLuint shader, GLsizei count,
+                               const GLchar *const *string,
+                               const GLint *length) {
+  next.glShaderSource(shader, count, string, length);
+  if (!recording(0))
+    return;
+
+  size_t total = 0;
+  for (GLsizei i = 0; i < count; ++i)
+    total += length && length[i] >= 0 ? length[i] : strlen(string[i]);
+  char *joined = malloc(total + 1);
+  if (!joined)
+    return;
+  char *p = joined;
+  for (GLsizei i = 0; i < count; ++i) {
+    size_t len = length && length[i] >= 0 ? length[i] : strlen(string[i]);
+    memcpy(p, string[i], len);
+    p += len;
+  }
+  *p = '\0';
+  PUT(GL_TRACE_OP_glShaderSource, joined, total + 1, {.u = shader});
+  free(joined);
+}
+
+static GLint rec_glGetUniformLocation(GLuint program, const GLchar *name) {
+  GLint location = next.glGetUniformLocation(program, name);
+  if (recording(0))
+    PUT(GL_TRACE_OP_glGetUniformLocation, name, strlen(name) + 1,
+        {.u = program}, {.i = location});
+  return location;
+}
+
+static GLint rec_glGetAttribLocation(GLuint program, const GLchar *name) {
+  GLint location = next.glGetAttribLocation(program, name);
+  if (recording(0))
+    PUT(GL_TRACE_OP_glGetAttribLocation, name, strlen(name) + 1,
+        {.u = program}, {.i = location});
+  return location;
+}
+
+static void rec_glBindAttribLocation(GLuint program, GLuint index,
+                                     const GLchar *name) {
+  next.glBindAttribLocation(program, index, name);
+  if (recording(0))
+    PUT(GL_TRACE_OP_glBindAttribLocation, name, strlen(name) + 1,
+        {.u = program}, {.u = index});
+}
+
+static void rec_glBufferData(GLenum target, GLsizeiptr size, const void *data,
+                             GLenum usage) {
+  next.glBufferData(target, size, data, usage);
+
+  // keep the indices around to find the vertex range of draws
+  if (target == GL_ELEMENT_ARRAY_BUFFER && element_buffer) {
+    if (element_buffer >= num_index_copies) {
+      GLuint num = element_buffer * 2;
+      IndexCopy *copies = realloc(index_copies, num * sizeof(IndexCopy));
+      if (copies) {
+        memset(copies + num_index_copies, 0,
+               (num - num_index_copies) * sizeof(IndexCopy));
+        index_copies = copies;
+        num_index_copies = num;
+      }
+    }
+    if (element_buffer < num_index_copies) {
+      IndexCopy *copy = &index_copies[element_buffer];
+      free(copy->data);
+      copy->data = data ? malloc(size) : NULL;
+      copy->size = copy->data ? size : 0;
+      if (copy->data)
+        memcpy(copy->data, data, size);
+    }
+  }
+
+  if (recording(0))
+    PUT(GL_TRACE_OP_glBufferData, data, data ? size : 0, {.u = target},
+        {.i = size}, {.u = usage});
+}
+
+static void rec_glTexImage2D(GLenum target, GLint level, GLint internalformat,
+                             GLsizei width, GLsizei height, GLint border,
+                             GLenum format, GLenum type, const void *pixels) {
+  next.glTexImage2D(target, level, internalformat, width, height, border,
+                    format, type, pixels);
+  if (recording(0))
+    PUT(GL_TRACE_OP_glTexImage2D, pixels,
+        pixels ? image_size(width, height, format, type) : 0, {.u = target},
+        {.i = level}, {.i = internalformat}, {.i = width}, {.i = height},
+        {.i = border}, {.u = format}, {.u = type});
+}
+
+static void rec_glCompressedTexImage2D(GLenum target, GLint level,
+                                       GLenum internalformat, GLsizei width,
+                                       GLsizei height, GLint border,
+                                       GLsizei imageSize, const void *data) {
+  next.glCompressedTexImage2D(target, level, internalformat, width, height,
+                              border, imageSize, data);
+  if (recording(0))
+    PUT(GL_TRACE_OP_glCompressedTexImage2D, data, data ? imageSize : 0,
+        {.u = target}, {.i = level}, {.u = internalformat}, {.i = width},
+        {.i = height}, {.i = border}, {.i = imageSize});
+}
+
+#define REC_UNIFORM_V(name, components)                                        \
+  static void rec_##name(GLint location, GLsizei count,                        \
+                         const GLfloat *value) {                               \
+    next.name(location, count, value);                                         \
+    if (recording(0) && count > 0)                                             \
+      PUT(GL_TRACE_OP_##name, value, count * (components) * sizeof(GLfloat),   \
+          {.i = location}, {.i = count});                                      \
+  }
+#define REC_UNIFORM_MATRIX(name, components)                                   \
+  static void rec_##name(GLint location, GLsizei count, GLboolean transpose,   \
+                         const GLfloat *value) {                               \
+    next.name(location, count, transpose, value);                              \
+    if (recording(0) && count > 0)                                             \
+      PUT(GL_TRACE_OP_##name, value, count * (components) * sizeof(GLfloat),   \
+          {.i = location}, {.i = count}, {.u = transpose});                    \
+  }
+
+REC_UNIFORM_V(glUniform1fv, 1)
+REC_UNIFORM_V(glUniform2fv, 2)
+REC_UNIFORM_V(glUniform3fv, 3)
+REC_UNIFORM_V(glUniform4fv, 4)
+REC_UNIFORM_MATRIX(glUniformMatrix3fv, 9)
+REC_UNIFORM_MATRIX(glUniformMatrix4fv, 16)
+
+static void rec_glVertexAttrib4fv(GLuint index, const GLfloat *v) {
+  next.glVertexAttrib4fv(index, v);
+  if (recording(0))
+    PUT(GL_TRACE_OP_glVertexAttrib4fv, v, 4 * sizeof(GLfloat), {.u = index});
+}
+
+static void rec_glVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                      GLboolean normalized, GLsizei stride,
+                                      const void *pointer) {
+  next.glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+  if (index < GL_TRACE_MAX_ATTRIBS) {
+    Attrib *a = &attribs[index];
+    a->client = array_buffer == 0;
+    a->size = size;
+    a->type = type;
+    a->normalized = normalized;
+    a->stride = stride;
+    a->pointer = pointer;
+    if (a->client)
+      return;
+  }
+  if (recording(0))
+    PUT(GL_TRACE_OP_glVertexAttribPointer, NULL, 0, {.u = index}, {.i = size},
+        {.u = type}, {.u = normalized}, {.i = stride},
+        {.u = (uint32_t)(uintptr_t)pointer});
+}
+
+static int have_client_arrays(void) {
+  for (int i = 0; i < GL_TRACE_MAX_ATTRIBS; ++i) {
+    if (attribs[i].enabled && attribs[i].client && attribs[i].pointer)
+      return 1;
+  }
+  return 0;
+}
+
+static void put_client_arrays(GLint first, GLint last) {
+  for (int i = 0; i < GL_TRACE_MAX_ATTRIBS; ++i) {
+    Attrib *a = &attribs[i];
+    if (!a->enabled || !a->client || !a->pointer)
+      continue;
+    size_t component = a->type == GL_BYTE || a->type == GL_UNSIGNED_BYTE ? 1
+                       : a->type == GL_SHORT || a->type == GL_UNSIGNED_SHORT
+                           ? 2
+                           : 4;
+    size_t element = a->size * component;
+    size_t stride = a->stride ? (size_t)a->stride : element;
+    PUT(GL_TRACE_OP_CLIENT_ARRAY, (const char *)a->pointer + first * stride,
+        (last - first) * stride + element, {.i = i}, {.i = a->size},
+        {.u = a->type}, {.u = a->normalized}, {.i = stride}, {.i = first});
+  }
+}
+
+static size_t index_size(GLenum type) {
+  return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+// finds the range of vertices an indexed draw uses; 0 if unknown
+static int index_range(GLsizei count, GLenum type, const void *indices,
+                       GLint *first, GLint *last) {
+  size_t size = index_size(type);
+  const uint8_t *p = indices;
+  if (element_buffer) {
+    if (element_buffer >= num_index_copies)
+      return 0;
+    IndexCopy *copy = &index_copies[element_buffer];
+    size_t offset = (uintptr_t)indices;
+    if (!copy->data || offset + count * size > copy->size)
+      return 0;
+    p = (const uint8_t *)copy->data + offset;
+  } else if (!p) {
+    return 0;
+  }
+
+  GLint lo = INT32_MAX, hi = -1;
+  for (GLsizei i = 0; i < count; ++i) {
+    GLint index = size == 1   ? p[i]
+                  : size == 2 ? ((const uint16_t *)p)[i]
+                              : (GLint)((const uint32_t *)p)[i];
+    if (index < lo)
+      lo = index;
+    if (index > hi)
+      hi = index;
+  }
+  *first = lo;
+  *last = hi;
+  return hi >= 0;
+}
+
+static void rec_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  next.glDrawArrays(mode, first, count);
+  if (!recording(1) || count <= 0)
+    return;
+  pthread_mutex_lock(&lock);
+  put_client_arrays(first, first + count - 1);
+  PUT(GL_TRACE_OP_glDrawArrays, NULL, 0, {.u = mode}, {.i = first},
+      {.i = count});
+  pthread_mutex_unlock(&lock);
+}
+
+static void rec_glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                               const void *indices) {
+  next.glDrawElements(mode, count, type, indices);
+  if (!recording(1) || count <= 0)
+    return;
+  pthread_mutex_lock(&lock);
+  GLint first, last;
+  if (have_client_arrays() &&
+      index_range(count, type, indices, &first, &last))
+    put_client_arrays(first, last);
+  if (element_buffer || !indices)
+    PUT(GL_TRACE_OP_glDrawElements, NULL, 0, {.u = mode}, {.i = count},
+        {.u = type}, {.u = (uint32_t)(uintptr_t)indices});
+  else
+    PUT(GL_TRACE_OP_glDrawElements, indices,
+        count * index_size(type), {.u = mode}, {.i = count},
+        {.u = type}, {.u = 0});
+  pthread_mutex_unlock(&lock);
+}
+
+static void rec_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height,
+                             GLenum format, GLenum type, void *pixels) {
+  next.glReadPixels(x, y, width, height, format, type, pixels);
+  if (recording(1))
+    PUT(GL_TRACE_OP_glReadPixels, NULL, 0, {.i = x}, {.i = y}, {.i = width},
+        {.i = height}, {.u = format}, {.u = type});
+}
+
+static void write_header(void) {
+  GlTraceHeader header = {GL_TRACE_MAGIC, GL_TRACE_VERSION,
+                          config.gl_record_start, screen_width, screen_height};
+  fseek(trace, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, trace);
+  fseek(trace, 0, SEEK_END);
+}
+
+void gl_recorder_install(uintptr_t (*replace)(const char *symbol,
+                                              uintptr_t func)) {
+  trace = fopen(GL_TRACE_NAME, "wb");
+  if (!trace) {
+    debugPrintf("gl_recorder: could not open %s\n", GL_TRACE_NAME);
+    return;
+  }
+  setvbuf(trace, NULL, _IOFBF, 1 << 20);
+  write_header();
+
+#define INSTALL(name, ...)                                                     \
+  next.name = (void *)replace(#name, (uintptr_t)&rec_##name);
+  GL_TRACE_CALLS(INSTALL, INSTALL, INSTALL, INSTALL, INSTALL, INSTALL)
+  GL_TRACE_TRACKED_CALLS(INSTALL, INSTALL, INSTALL, INSTALL, INSTALL, INSTALL)
+  GL_RECORDER_SPECIAL_CALLS(INSTALL)
+#undef INSTALL
+
+  state = config.gl_record_start > 0 ? STATE_SETUP : STATE_FULL;
+  debugPrintf("gl_recorder: recording %d frames from frame %d to %s\n",
+              config.gl_record_frames, config.gl_record_start, GL_TRACE_NAME);
+}
+
+void gl_recorder_stop(void) {
+  pthread_mutex_lock(&lock);
+  if (trace) {
+    state = STATE_OFF;
+    write_header();
+    fclose(trace);
+    trace = NULL;
+    debugPrintf("gl_recorder: wrote %u frames, %.1f MB\n",
+                frame > (unsigned)config.gl_record_start
+                    ? frame - config.gl_record_start
+                    : 0,
+                bytes_written / 1048576.0);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void gl_recorder_frame(void) {
+  if (state == STATE_OFF)
+    return;
+  put_call(GL_TRACE_OP_FRAME, NULL, 0, NULL, 0);
+  frame++;
+  if (state == STATE_SETUP && frame >= (unsigned)config.gl_record_start) {
+    debugPrintf("gl_recorder: recording draws from frame %u\n", frame);
+    state = STATE_FULL;
+  } else if (frame >= (unsigned)(config.gl_record_start +
+                                 config.gl_record_frames)) {
+    gl_recorder_stop();
+  }
+}
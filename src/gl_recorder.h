@@ -0,0 +1,23 @@
+/* gl_recorder.h -- records the game's GL calls for tools/glreplay
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef GL_RECORDER_H
+#define GL_RECORDER_H
+
+#include <stdint.h>
+
+// wraps the GL imports with replace (which returns the previous function)
+// and opens GL_TRACE_NAME
+void gl_recorder_install(uintptr_t (*replace)(const char *symbol,
+                                              uintptr_t func));
+// called once per frame at swap
+void gl_recorder_frame(void);
+// finishes the trace early, e.g. when the game exits
+void gl_recorder_stop(void);
+
+#endif // GL_RECORDER_H
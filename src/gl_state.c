@@ -0,0 +1,328 @@
+/* gl_state.c -- shadow of the GL state to drop redundant state changes
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The engine sets most of its state before every draw whether it changed or
+// not. The imports below keep a copy of the state they set and only forward
+// calls that change something. Everything starts out unknown, so the first
+// call of each kind always goes through; gl_state_invalidate() returns to that
+// after our own code has touched GL state behind the shadow's back.
+//
+// With gl_state_cache 2 every dropped call is checked against glGet* first
+// and mismatches are logged and forwarded, which is slow but shows whether
+// the shadow ever drifts from the real state.
+
+#include <string.h>
+
+#include "config.h"
+#include "gl_state.h"
+#include "log.h"
+
+#define UNKNOWN 0xffffffffu
+
+enum {
+  CAP_BLEND,
+  CAP_CULL_FACE,
+  CAP_DEPTH_TEST,
+  CAP_DITHER,
+  CAP_POLYGON_OFFSET_FILL,
+  CAP_SAMPLE_ALPHA_TO_COVERAGE,
+  CAP_SAMPLE_COVERAGE,
+  CAP_SCISSOR_TEST,
+  CAP_STENCIL_TEST,
+  NUM_CAPS,
+};
+
+typedef struct {
+  GLuint active_unit; // index, not GL_TEXTURE0 + index
+  GLuint texture_2d[GL_STATE_MAX_UNITS];
+  GLuint texture_cube[GL_STATE_MAX_UNITS];
+  GLuint program;
+  GLuint caps[NUM_CAPS];
+  GLuint blend[4]; // src rgb, dst rgb, src alpha, dst alpha
+  GLuint depth_mask;
+  GLuint depth_func;
+  GLuint cull_face;
+  GLuint front_face;
+  GLuint array_buffer;
+  GLuint element_buffer;
+} Shadow;
+
+GlStateNext gl_state_next;
+GlStateCounters gl_state_last_frame;
+
+static Shadow shadow;
+static GlStateCounters frame;
+static unsigned long long total_calls[GL_STATE_NUM_COUNTERS];
+static unsigned long long total_skipped[GL_STATE_NUM_COUNTERS];
+static unsigned int frames = 0;
+static unsigned int mismatches = 0;
+
+static const char *const counter_names[GL_STATE_NUM_COUNTERS] = {
+    "glBindTexture", "glActiveTexture", "glUseProgram", "glEnable/Disable",
+    "glBlendFunc",   "glDepth*",        "glCull/FrontFace", "glBindBuffer",
+};
+
+void gl_state_invalidate(void) { memset(&shadow, 0xff, sizeof(shadow)); }
+
+static int cap_index(GLenum cap) {
+  switch (cap) {
+  case GL_BLEND:
+    return CAP_BLEND;
+  case GL_CULL_FACE:
+    return CAP_CULL_FACE;
+  case GL_DEPTH_TEST:
+    return CAP_DEPTH_TEST;
+  case GL_DITHER:
+    return CAP_DITHER;
+  case GL_POLYGON_OFFSET_FILL:
+    return CAP_POLYGON_OFFSET_FILL;
+  case GL_SAMPLE_ALPHA_TO_COVERAGE:
+    return CAP_SAMPLE_ALPHA_TO_COVERAGE;
+  case GL_SAMPLE_COVERAGE:
+    return CAP_SAMPLE_COVERAGE;
+  case GL_SCISSOR_TEST:
+    return CAP_SCISSOR_TEST;
+  case GL_STENCIL_TEST:
+    return CAP_STENCIL_TEST;
+  default:
+    return -1;
+  }
+}
+
+// returns 1 if the real state agrees with the shadow; only called in the
+// cross-check mode for calls that are about to be dropped
+static int verify(GLenum pname, GLint expected, const char *call) {
+  GLint real = 0;
+  glGetIntegerv(pname, &real);
+  if (real == expected)
+    return 1;
+  mismatches++;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+             "gl_state: %s: shadow has 0x%x for 0x%x but GL has 0x%x\n", call,
+             expected, pname, real);
+  return 0;
+}
+
+// counts the call and decides whether it can be dropped
+static int redundant(int counter, int same, GLenum pname, GLint expected,
+                     const char *call) {
+  frame.calls[counter]++;
+  if (!same)
+    return 0;
+  if (config.gl_state_cache > 1 && pname && !verify(pname, expected, call))
+    return 0;
+  frame.skipped[counter]++;
+  return 1;
+}
+
+void gl_state_glActiveTexture(GLenum texture) {
+  GLuint unit = texture - GL_TEXTURE0;
+  if (redundant(GL_STATE_ACTIVE_TEXTURE, unit == shadow.active_unit,
+                GL_ACTIVE_TEXTURE, texture, "glActiveTexture"))
+    return;
+  gl_state_next.glActiveTexture(texture);
+  shadow.active_unit = unit < GL_STATE_MAX_UNITS ? unit : UNKNOWN;
+}
+
+void gl_state_glBindTexture(GLenum target, GLuint texture) {
+  GLuint unit = shadow.active_unit;
+  GLuint *slot = NULL;
+  GLenum pname = 0;
+  if (unit != UNKNOWN && target == GL_TEXTURE_2D) {
+    slot = &shadow.texture_2d[unit];
+    pname = GL_TEXTURE_BINDING_2D;
+  } else if (unit != UNKNOWN && target == GL_TEXTURE_CUBE_MAP) {
+    slot = &shadow.texture_cube[unit];
+    pname = GL_TEXTURE_BINDING_CUBE_MAP;
+  }
+  if (redundant(GL_STATE_BIND_TEXTURE, slot && *slot == texture, pname,
+                texture, "glBindTexture"))
+    return;
+  gl_state_next.glBindTexture(target, texture);
+  if (slot)
+    *slot = texture;
+}
+
+void gl_state_glUseProgram(GLuint program) {
+  if (redundant(GL_STATE_USE_PROGRAM, shadow.program == program,
+                GL_CURRENT_PROGRAM, program, "glUseProgram"))
+    return;
+  gl_state_next.glUseProgram(program);
+  shadow.program = program;
+}
+
+static int set_cap(GLenum cap, GLuint enable) {
+  int idx = cap_index(cap);
+  int same = idx >= 0 && shadow.caps[idx] == enable;
+  frame.calls[GL_STATE_ENABLE]++;
+  if (!same) {
+    if (idx >= 0)
+      shadow.caps[idx] = enable;
+    return 0;
+  }
+  if (config.gl_state_cache > 1 && glIsEnabled(cap) != enable) {
+    mismatches++;
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "gl_state: glEnable/glDisable: shadow has %u for 0x%x\n",
+               enable, cap);
+    return 0;
+  }
+  frame.skipped[GL_STATE_ENABLE]++;
+  return 1;
+}
+
+void gl_state_glEnable(GLenum cap) {
+  if (!set_cap(cap, 1))
+    gl_state_next.glEnable(cap);
+}
+
+void gl_state_glDisable(GLenum cap) {
+  if (!set_cap(cap, 0))
+    gl_state_next.glDisable(cap);
+}
+
+static int blend_same(GLenum srgb, GLenum drgb, GLenum sa, GLenum da) {
+  int same = shadow.blend[0] == srgb && shadow.blend[1] == drgb &&
+             shadow.blend[2] == sa && shadow.blend[3] == da;
+  if (same && config.gl_state_cache > 1) {
+    same = verify(GL_BLEND_SRC_RGB, srgb, "glBlendFunc") &&
+           verify(GL_BLEND_DST_RGB, drgb, "glBlendFunc") &&
+           verify(GL_BLEND_SRC_ALPHA, sa, "glBlendFunc") &&
+           verify(GL_BLEND_DST_ALPHA, da, "glBlendFunc");
+  }
+  return same;
+}
+
+void gl_state_glBlendFunc(GLenum sfactor, GLenum dfactor) {
+  if (redundant(GL_STATE_BLEND_FUNC,
+                blend_same(sfactor, dfactor, sfactor, dfactor), 0, 0, NULL))
+    return;
+  gl_state_next.glBlendFunc(sfactor, dfactor);
+  shadow.blend[0] = shadow.blend[2] = sfactor;
+  shadow.blend[1] = shadow.blend[3] = dfactor;
+}
+
+void gl_state_glBlendFuncSeparate(GLenum srcRGB, GLenum dstRGB,
+                                  GLenum srcAlpha, GLenum dstAlpha) {
+  if (redundant(GL_STATE_BLEND_FUNC,
+                blend_same(srcRGB, dstRGB, srcAlpha, dstAlpha), 0, 0, NULL))
+    return;
+  gl_state_next.glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+  shadow.blend[0] = srcRGB;
+  shadow.blend[1] = dstRGB;
+  shadow.blend[2] = srcAlpha;
+  shadow.blend[3] = dstAlpha;
+}
+
+void gl_state_glDepthMask(GLboolean flag) {
+  GLuint value = flag ? 1 : 0;
+  if (redundant(GL_STATE_DEPTH, shadow.depth_mask == value,
+                GL_DEPTH_WRITEMASK, value, "glDepthMask"))
+    return;
+  gl_state_next.glDepthMask(flag);
+  shadow.depth_mask = value;
+}
+
+void gl_state_glDepthFunc(GLenum func) {
+  if (redundant(GL_STATE_DEPTH, shadow.depth_func == func, GL_DEPTH_FUNC, func,
+                "glDepthFunc"))
+    return;
+  gl_state_next.glDepthFunc(func);
+  shadow.depth_func = func;
+}
+
+void gl_state_glCullFace(GLenum mode) {
+  if (redundant(GL_STATE_CULL, shadow.cull_face == mode, GL_CULL_FACE_MODE,
+                mode, "glCullFace"))
+    return;
+  gl_state_next.glCullFace(mode);
+  shadow.cull_face = mode;
+}
+
+void gl_state_glFrontFace(GLenum mode) {
+  if (redundant(GL_STATE_CULL, shadow.front_face == mode, GL_FRONT_FACE, mode,
+                "glFrontFace"))
+    return;
+  gl_state_next.glFrontFace(mode);
+  shadow.front_face = mode;
+}
+
+void gl_state_glBindBuffer(GLenum target, GLuint buffer) {
+  GLuint *slot = NULL;
+  GLenum pname = 0;
+  if (target == GL_ARRAY_BUFFER) {
+    slot = &shadow.array_buffer;
+    pname = GL_ARRAY_BUFFER_BINDING;
+  } else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    slot = &shadow.element_buffer;
+    pname = GL_ELEMENT_ARRAY_BUFFER_BINDING;
+  }
+  if (redundant(GL_STATE_BIND_BUFFER, slot && *slot == buffer, pname, buffer,
+                "glBindBuffer"))
+    return;
+  gl_state_next.glBindBuffer(target, buffer);
+  if (slot)
+    *slot = buffer;
+}
+
+// deleting a bound object resets the binding to 0
+void gl_state_glDeleteTextures(GLsizei n, const GLuint *textures) {
+  gl_state_next.glDeleteTextures(n, textures);
+  for (GLsizei i = 0; i < n; ++i) {
+    if (!textures[i])
+      continue;
+    for (int u = 0; u < GL_STATE_MAX_UNITS; ++u) {
+      if (shadow.texture_2d[u] == textures[i])
+        shadow.texture_2d[u] = 0;
+      if (shadow.texture_cube[u] == textures[i])
+        shadow.texture_cube[u] = 0;
+    }
+  }
+}
+
+void gl_state_glDeleteBuffers(GLsizei n, const GLuint *buffers) {
+  gl_state_next.glDeleteBuffers(n, buffers);
+  for (GLsizei i = 0; i < n; ++i) {
+    if (!buffers[i])
+      continue;
+    if (shadow.array_buffer == buffers[i])
+      shadow.array_buffer = 0;
+    if (shadow.element_buffer == buffers[i])
+      shadow.element_buffer = 0;
+  }
+}
+
+void gl_state_frame(void) {
+  gl_state_last_frame = frame;
+  for (int i = 0; i < GL_STATE_NUM_COUNTERS; ++i) {
+    total_calls[i] += frame.calls[i];
+    total_skipped[i] += frame.skipped[i];
+  }
+  memset(&frame, 0, sizeof(frame));
+
+  // the swap hook draws with GL directly; the active unit is read back as the
+  // game may not set it again for a long time
+  gl_state_invalidate();
+  GLint unit = GL_TEXTURE0;
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+  if ((GLuint)(unit - GL_TEXTURE0) < GL_STATE_MAX_UNITS)
+    shadow.active_unit = unit - GL_TEXTURE0;
+
+  if (++frames % GL_STATE_REPORT_FRAMES)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "gl_state: per frame over the last %d frames (%u mismatches):\n",
+             GL_STATE_REPORT_FRAMES, mismatches);
+  for (int i = 0; i < GL_STATE_NUM_COUNTERS; ++i) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+               "  %-18s %8.1f calls %8.1f dropped\n", counter_names[i],
+               (double)total_calls[i] / GL_STATE_REPORT_FRAMES,
+               (double)total_skipped[i] / GL_STATE_REPORT_FRAMES);
+    total_calls[i] = total_skipped[i] = 0;
+  }
+}
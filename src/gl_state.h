@@ -0,0 +1,80 @@
+/* gl_state.h -- shadow of the GL state to drop redundant state changes
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <GLES2/gl2.h>
+
+#define GL_STATE_MAX_UNITS 16
+// frames between reports in the log
+#define GL_STATE_REPORT_FRAMES 600
+
+enum {
+  GL_STATE_BIND_TEXTURE,
+  GL_STATE_ACTIVE_TEXTURE,
+  GL_STATE_USE_PROGRAM,
+  GL_STATE_ENABLE,
+  GL_STATE_BLEND_FUNC,
+  GL_STATE_DEPTH,
+  GL_STATE_CULL,
+  GL_STATE_BIND_BUFFER,
+  GL_STATE_NUM_COUNTERS,
+};
+
+typedef struct {
+  unsigned int calls[GL_STATE_NUM_COUNTERS];
+  unsigned int skipped[GL_STATE_NUM_COUNTERS];
+} GlStateCounters;
+
+// counts of the last finished frame
+extern GlStateCounters gl_state_last_frame;
+
+// functions the filtered imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLBINDTEXTUREPROC glBindTexture;
+  PFNGLACTIVETEXTUREPROC glActiveTexture;
+  PFNGLUSEPROGRAMPROC glUseProgram;
+  PFNGLENABLEPROC glEnable;
+  PFNGLDISABLEPROC glDisable;
+  PFNGLBLENDFUNCPROC glBlendFunc;
+  PFNGLBLENDFUNCSEPARATEPROC glBlendFuncSeparate;
+  PFNGLDEPTHMASKPROC glDepthMask;
+  PFNGLDEPTHFUNCPROC glDepthFunc;
+  PFNGLCULLFACEPROC glCullFace;
+  PFNGLFRONTFACEPROC glFrontFace;
+  PFNGLBINDBUFFERPROC glBindBuffer;
+  PFNGLDELETETEXTURESPROC glDeleteTextures;
+  PFNGLDELETEBUFFERSPROC glDeleteBuffers;
+} GlStateNext;
+
+extern GlStateNext gl_state_next;
+
+// forgets the shadowed state; call after touching GL state outside the
+// filtered imports
+void gl_state_invalidate(void);
+// called once per frame at swap
+void gl_state_frame(void);
+
+void gl_state_glBindTexture(GLenum target, GLuint texture);
+void gl_state_glActiveTexture(GLenum texture);
+void gl_state_glUseProgram(GLuint program);
+void gl_state_glEnable(GLenum cap);
+void gl_state_glDisable(GLenum cap);
+void gl_state_glBlendFunc(GLenum sfactor, GLenum dfactor);
+void gl_state_glBlendFuncSeparate(GLenum srcRGB, GLenum dstRGB,
+                                  GLenum srcAlpha, GLenum dstAlpha);
+void gl_state_glDepthMask(GLboolean flag);
+void gl_state_glDepthFunc(GLenum func);
+void gl_state_glCullFace(GLenum mode);
+void gl_state_glFrontFace(GLenum mode);
+void gl_state_glBindBuffer(GLenum target, GLuint buffer);
+void gl_state_glDeleteTextures(GLsizei n, const GLuint *textures);
+void gl_state_glDeleteBuffers(GLsizei n, const GLuint *buffers);
+
+#endif // GL_STATE_H
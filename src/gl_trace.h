@@ -0,0 +1,165 @@
+/* gl_trace.h -- format of the GL call traces written by gl_recorder
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef GL_TRACE_H
+#define GL_TRACE_H
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+#define GL_TRACE_NAME "gltrace.bin"
+#define GL_TRACE_MAGIC "MPGLTRC1"
+#define GL_TRACE_VERSION 1
+#define GL_TRACE_MAX_ATTRIBS 16
+
+// The file starts with a header followed by one record per call: a
+// GlTraceCall, num_args 32-bit arguments and data_size bytes of payload
+// padded to 4 bytes. Object names, uniform locations and buffer offsets are
+// stored as the game saw them; the replayer maps them to its own.
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t start_frame; // frames before this one have no draws or clears
+  uint32_t width;       // screen size of the recording
+  uint32_t height;
+} GlTraceHeader;
+
+typedef struct {
+  uint16_t op;
+  uint16_t num_args;
+  uint32_t data_size;
+} GlTraceCall;
+
+typedef union {
+  int32_t i;
+  uint32_t u;
+  float f;
+} GlTraceArg;
+
+// argument kinds of the calls below: their C type and how they are stored
+#define GL_TRACE_TYPE_ENUM GLenum
+#define GL_TRACE_TYPE_BITS GLbitfield
+#define GL_TRACE_TYPE_BOOL GLboolean
+#define GL_TRACE_TYPE_INT GLint
+#define GL_TRACE_TYPE_UINT GLuint
+#define GL_TRACE_TYPE_SIZEI GLsizei
+#define GL_TRACE_TYPE_FLOAT GLfloat
+#define GL_TRACE_TYPE_LOC GLint
+#define GL_TRACE_TYPE_TEX GLuint
+#define GL_TRACE_TYPE_BUF GLuint
+#define GL_TRACE_TYPE_FB GLuint
+#define GL_TRACE_TYPE_RB GLuint
+#define GL_TRACE_TYPE_PROG GLuint
+#define GL_TRACE_TYPE_SHADER GLuint
+
+#define GL_TRACE_ARG_ENUM(v) {.u = (v)}
+#define GL_TRACE_ARG_BITS(v) {.u = (v)}
+#define GL_TRACE_ARG_BOOL(v) {.u = (v)}
+#define GL_TRACE_ARG_INT(v) {.i = (v)}
+#define GL_TRACE_ARG_UINT(v) {.u = (v)}
+#define GL_TRACE_ARG_SIZEI(v) {.i = (v)}
+#define GL_TRACE_ARG_FLOAT(v) {.f = (v)}
+#define GL_TRACE_ARG_LOC(v) {.i = (v)}
+#define GL_TRACE_ARG_TEX(v) {.u = (v)}
+#define GL_TRACE_ARG_BUF(v) {.u = (v)}
+#define GL_TRACE_ARG_FB(v) {.u = (v)}
+#define GL_TRACE_ARG_RB(v) {.u = (v)}
+#define GL_TRACE_ARG_PROG(v) {.u = (v)}
+#define GL_TRACE_ARG_SHADER(v) {.u = (v)}
+
+// calls that only take plain arguments, by argument count
+#define GL_TRACE_CALLS(X0, X1, X2, X3, X4, X5)                                 \
+  X0(glFinish)                                                                 \
+  X1(glActiveTexture, ENUM)                                                    \
+  X1(glClearDepthf, FLOAT)                                                     \
+  X1(glClearStencil, INT)                                                      \
+  X1(glCompileShader, SHADER)                                                  \
+  X1(glCullFace, ENUM)                                                         \
+  X1(glDeleteProgram, PROG)                                                    \
+  X1(glDeleteShader, SHADER)                                                   \
+  X1(glDepthFunc, ENUM)                                                        \
+  X1(glDepthMask, BOOL)                                                        \
+  X1(glDisable, ENUM)                                                          \
+  X1(glEnable, ENUM)                                                           \
+  X1(glFrontFace, ENUM)                                                        \
+  X1(glLinkProgram, PROG)                                                      \
+  X1(glUseProgram, PROG)                                                       \
+  X2(glAttachShader, PROG, SHADER)                                             \
+  X2(glBindFramebuffer, ENUM, FB)                                              \
+  X2(glBindRenderbuffer, ENUM, RB)                                             \
+  X2(glBindTexture, ENUM, TEX)                                                 \
+  X2(glBlendFunc, ENUM, ENUM)                                                  \
+  X2(glDepthRangef, FLOAT, FLOAT)                                              \
+  X2(glHint, ENUM, ENUM)                                                       \
+  X2(glPolygonOffset, FLOAT, FLOAT)                                            \
+  X2(glUniform1f, LOC, FLOAT)                                                  \
+  X2(glUniform1i, LOC, INT)                                                    \
+  X3(glTexParameterf, ENUM, ENUM, FLOAT)                                       \
+  X3(glTexParameteri, ENUM, ENUM, INT)                                         \
+  X4(glBlendFuncSeparate, ENUM, ENUM, ENUM, ENUM)                              \
+  X4(glClearColor, FLOAT, FLOAT, FLOAT, FLOAT)                                 \
+  X4(glFramebufferRenderbuffer, ENUM, ENUM, ENUM, RB)                          \
+  X4(glRenderbufferStorage, ENUM, ENUM, SIZEI, SIZEI)                          \
+  X4(glScissor, INT, INT, SIZEI, SIZEI)                                        \
+  X4(glUniform3f, LOC, FLOAT, FLOAT, FLOAT)                                    \
+  X4(glViewport, INT, INT, SIZEI, SIZEI)                                       \
+  X5(glFramebufferTexture2D, ENUM, ENUM, ENUM, TEX, INT)
+
+// plain calls the recorder needs to see for itself; replayed like the above
+#define GL_TRACE_TRACKED_CALLS(X0, X1, X2, X3, X4, X5)                         \
+  X1(glClear, BITS)                                                            \
+  X1(glDisableVertexAttribArray, UINT)                                         \
+  X1(glEnableVertexAttribArray, UINT)                                          \
+  X2(glBindBuffer, ENUM, BUF)
+
+#define GL_TRACE_OP(name, ...) GL_TRACE_OP_##name,
+
+enum {
+  GL_TRACE_OP_FRAME = 1, // end of a frame
+  // client-side vertex data of one attribute, sent before the draw using it:
+  // index, size, type, normalized, stride, first vertex; data from there on
+  GL_TRACE_OP_CLIENT_ARRAY,
+  GL_TRACE_CALLS(GL_TRACE_OP, GL_TRACE_OP, GL_TRACE_OP, GL_TRACE_OP,
+                 GL_TRACE_OP, GL_TRACE_OP)
+  GL_TRACE_TRACKED_CALLS(GL_TRACE_OP, GL_TRACE_OP, GL_TRACE_OP, GL_TRACE_OP,
+                         GL_TRACE_OP, GL_TRACE_OP)
+  // calls with payloads or return values; arguments as in GL unless noted
+  GL_TRACE_OP_glGenTextures, // n; data: the names
+  GL_TRACE_OP_glGenBuffers,
+  GL_TRACE_OP_glGenFramebuffers,
+  GL_TRACE_OP_glGenRenderbuffers,
+  GL_TRACE_OP_glDeleteTextures, // n; data: the names
+  GL_TRACE_OP_glDeleteBuffers,
+  GL_TRACE_OP_glDeleteFramebuffers,
+  GL_TRACE_OP_glDeleteRenderbuffers,
+  GL_TRACE_OP_glCreateProgram, // returned name
+  GL_TRACE_OP_glCreateShader,  // type, returned name
+  GL_TRACE_OP_glShaderSource,  // shader; data: all strings joined
+  GL_TRACE_OP_glGetUniformLocation, // program, returned location; data: name
+  GL_TRACE_OP_glGetAttribLocation,  // program, returned location; data: name
+  GL_TRACE_OP_glBindAttribLocation, // program, index; data: name
+  GL_TRACE_OP_glBufferData,         // target, size, usage; data if given
+  GL_TRACE_OP_glTexImage2D,         // all but pixels; data if given
+  GL_TRACE_OP_glCompressedTexImage2D, // all but data; data
+  GL_TRACE_OP_glUniform1fv,           // location, count; data
+  GL_TRACE_OP_glUniform2fv,
+  GL_TRACE_OP_glUniform3fv,
+  GL_TRACE_OP_glUniform4fv,
+  GL_TRACE_OP_glUniformMatrix3fv, // location, count, transpose; data
+  GL_TRACE_OP_glUniformMatrix4fv,
+  GL_TRACE_OP_glVertexAttrib4fv, // index; data
+  // index, size, type, normalized, stride, buffer offset; not sent for
+  // client-side arrays, those come as GL_TRACE_OP_CLIENT_ARRAY
+  GL_TRACE_OP_glVertexAttribPointer,
+  GL_TRACE_OP_glDrawArrays,   // as in GL
+  GL_TRACE_OP_glDrawElements, // mode, count, type, offset; data if client
+  GL_TRACE_OP_glReadPixels,   // all but pixels
+  GL_TRACE_NUM_OPS,
+};
+
+#endif // GL_TRACE_H
@@ -0,0 +1,292 @@
+/* gl_uniforms.c -- cache of uniform locations and uploaded uniform values
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The engine uploads its uniforms before every draw and looks their
+// locations up by name again and again. Uniform values belong to the program,
+// so the last value uploaded to each (program, location) is kept here and
+// uploads that match it are dropped. Linking resets a program's uniforms and
+// may move its locations, so both caches of a program are cleared then.
+//
+// Array uniforms are assumed to have their elements at consecutive locations,
+// which is what the drivers do; an upload to one element forgets any cached
+// array upload that covers it.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "gl_uniforms.h"
+#include "hashmap.h"
+#include "log.h"
+
+enum {
+  TYPE_UNKNOWN,
+  TYPE_FLOAT,
+  TYPE_VEC2,
+  TYPE_VEC3,
+  TYPE_VEC4,
+  TYPE_INT,
+  TYPE_MAT3,
+  TYPE_MAT4,
+};
+
+typedef struct {
+  uint8_t type;
+  GLsizei count;
+  size_t size;
+  size_t capacity;
+  void *data;
+} Slot;
+
+typedef struct {
+  struct hashmap_s locations; // name -> location + 2, so that 0 means missing
+  int have_locations;
+  Slot *slots;
+  int num_slots;
+  GLsizei max_count; // largest array upload, bounds the overlap search
+} Program;
+
+GlUniformsNext gl_uniforms_next;
+GlUniformCounters gl_uniforms_last_frame;
+
+static Program *programs[GL_UNIFORMS_MAX_PROGRAMS];
+static GLuint current_program = 0;
+static GlUniformCounters frame;
+static GlUniformCounters window;
+static unsigned int frames = 0;
+
+static Program *get_program(GLuint program) {
+  if (program == 0 || program >= GL_UNIFORMS_MAX_PROGRAMS)
+    return NULL;
+  if (!programs[program]) {
+    programs[program] = calloc(1, sizeof(Program));
+    if (!programs[program])
+      fatal_error("Failed to allocate uniform cache");
+  }
+  return programs[program];
+}
+
+static int free_location_name(void *context, struct hashmap_element_s *e) {
+  (void)context;
+  free((char *)e->key);
+  return -1;
+}
+
+static void clear_program(Program *p, int release) {
+  if (p->have_locations) {
+    hashmap_iterate_pairs(&p->locations, free_location_name, NULL);
+    if (release) {
+      hashmap_destroy(&p->locations);
+      p->have_locations = 0;
+    }
+  }
+  for (int i = 0; i < p->num_slots; ++i) {
+    p->slots[i].type = TYPE_UNKNOWN;
+    if (release)
+      free(p->slots[i].data);
+  }
+  if (release) {
+    free(p->slots);
+    p->slots = NULL;
+    p->num_slots = 0;
+  }
+  p->max_count = 0;
+}
+
+void gl_uniforms_glUseProgram(GLuint program) {
+  gl_uniforms_next.glUseProgram(program);
+  current_program = program;
+}
+
+void gl_uniforms_glLinkProgram(GLuint program) {
+  gl_uniforms_next.glLinkProgram(program);
+  if (program < GL_UNIFORMS_MAX_PROGRAMS && programs[program])
+    clear_program(programs[program], 0);
+}
+
+void gl_uniforms_glDeleteProgram(GLuint program) {
+  gl_uniforms_next.glDeleteProgram(program);
+  if (program < GL_UNIFORMS_MAX_PROGRAMS && programs[program]) {
+    clear_program(programs[program], 1);
+    free(programs[program]);
+    programs[program] = NULL;
+  }
+}
+
+GLint gl_uniforms_glGetUniformLocation(GLuint program, const GLchar *name) {
+  Program *p = get_program(program);
+  frame.lookups++;
+  if (!p)
+    return gl_uniforms_next.glGetUniformLocation(program, name);
+
+  if (!p->have_locations) {
+    if (hashmap_create(16, &p->locations) != 0)
+      return gl_uniforms_next.glGetUniformLocation(program, name);
+    p->have_locations = 1;
+  }
+
+  size_t len = strlen(name);
+  intptr_t cached = (intptr_t)hashmap_get(&p->locations, name, len);
+  if (cached) {
+    frame.lookup_hits++;
+    return (GLint)(cached - 2);
+  }
+
+  GLint location = gl_uniforms_next.glGetUniformLocation(program, name);
+  char *key = strdup(name);
+  if (key && hashmap_put(&p->locations, key, len,
+                         (void *)(intptr_t)(location + 2)) != 0)
+    free(key);
+  return location;
+}
+
+// returns 1 if the upload matches what the location already holds
+static int cached_upload(int type, GLint location, GLsizei count,
+                         const void *value, size_t size) {
+  frame.calls++;
+  frame.bytes += size;
+
+  // uploads to -1 are ignored by GL anyway
+  if (location < 0) {
+    frame.skipped++;
+    frame.skipped_bytes += size;
+    return 1;
+  }
+
+  Program *p = get_program(current_program);
+  if (!p || location >= GL_UNIFORMS_MAX_LOCATIONS || count <= 0)
+    return 0;
+
+  if (location >= p->num_slots) {
+    int num = p->num_slots ? p->num_slots : 16;
+    while (num <= location)
+      num *= 2;
+    Slot *slots = realloc(p->slots, num * sizeof(Slot));
+    if (!slots)
+      return 0;
+    memset(slots + p->num_slots, 0, (num - p->num_slots) * sizeof(Slot));
+    p->slots = slots;
+    p->num_slots = num;
+  }
+
+  Slot *slot = &p->slots[location];
+  if (slot->type == type && slot->count == count && slot->size == size &&
+      !memcmp(slot->data, value, size)) {
+    frame.skipped++;
+    frame.skipped_bytes += size;
+    return 1;
+  }
+
+  // forget cached uploads that overlap this one
+  for (GLint l = location + 1; l < location + count && l < p->num_slots; ++l)
+    p->slots[l].type = TYPE_UNKNOWN;
+  for (GLint l = location - 1; l >= 0 && l > location - p->max_count; --l) {
+    if (p->slots[l].type != TYPE_UNKNOWN && l + p->slots[l].count > location)
+      p->slots[l].type = TYPE_UNKNOWN;
+  }
+  if (count > p->max_count)
+    p->max_count = count;
+
+  if (slot->capacity < size) {
+    void *data = realloc(slot->data, size);
+    if (!data) {
+      slot->type = TYPE_UNKNOWN;
+      return 0;
+    }
+    slot->data = data;
+    slot->capacity = size;
+  }
+  memcpy(slot->data, value, size);
+  slot->type = type;
+  slot->count = count;
+  slot->size = size;
+  return 0;
+}
+
+void gl_uniforms_glUniform1f(GLint location, GLfloat v0) {
+  if (!cached_upload(TYPE_FLOAT, location, 1, &v0, sizeof(v0)))
+    gl_uniforms_next.glUniform1f(location, v0);
+}
+
+void gl_uniforms_glUniform1fv(GLint location, GLsizei count,
+                              const GLfloat *value) {
+  if (!cached_upload(TYPE_FLOAT, location, count, value,
+                     count * sizeof(GLfloat)))
+    gl_uniforms_next.glUniform1fv(location, count, value);
+}
+
+void gl_uniforms_glUniform1i(GLint location, GLint v0) {
+  if (!cached_upload(TYPE_INT, location, 1, &v0, sizeof(v0)))
+    gl_uniforms_next.glUniform1i(location, v0);
+}
+
+void gl_uniforms_glUniform2fv(GLint location, GLsizei count,
+                              const GLfloat *value) {
+  if (!cached_upload(TYPE_VEC2, location, count, value,
+                     count * 2 * sizeof(GLfloat)))
+    gl_uniforms_next.glUniform2fv(location, count, value);
+}
+
+void gl_uniforms_glUniform3f(GLint location, GLfloat v0, GLfloat v1,
+                             GLfloat v2) {
+  GLfloat v[3] = {v0, v1, v2};
+  if (!cached_upload(TYPE_VEC3, location, 1, v, sizeof(v)))
+    gl_uniforms_next.glUniform3f(location, v0, v1, v2);
+}
+
+void gl_uniforms_glUniform3fv(GLint location, GLsizei count,
+                              const GLfloat *value) {
+  if (!cached_upload(TYPE_VEC3, location, count, value,
+                     count * 3 * sizeof(GLfloat)))
+    gl_uniforms_next.glUniform3fv(location, count, value);
+}
+
+void gl_uniforms_glUniform4fv(GLint location, GLsizei count,
+                              const GLfloat *value) {
+  if (!cached_upload(TYPE_VEC4, location, count, value,
+                     count * 4 * sizeof(GLfloat)))
+    gl_uniforms_next.glUniform4fv(location, count, value);
+}
+
+// transpose must be GL_FALSE on GLES2; anything else goes to GL for the error
+void gl_uniforms_glUniformMatrix3fv(GLint location, GLsizei count,
+                                    GLboolean transpose, const GLfloat *value) {
+  if (transpose || !cached_upload(TYPE_MAT3, location, count, value,
+                                  count * 9 * sizeof(GLfloat)))
+    gl_uniforms_next.glUniformMatrix3fv(location, count, transpose, value);
+}
+
+void gl_uniforms_glUniformMatrix4fv(GLint location, GLsizei count,
+                                    GLboolean transpose, const GLfloat *value) {
+  if (transpose || !cached_upload(TYPE_MAT4, location, count, value,
+                                  count * 16 * sizeof(GLfloat)))
+    gl_uniforms_next.glUniformMatrix4fv(location, count, transpose, value);
+}
+
+void gl_uniforms_frame(void) {
+  gl_uniforms_last_frame = frame;
+  window.calls += frame.calls;
+  window.skipped += frame.skipped;
+  window.bytes += frame.bytes;
+  window.skipped_bytes += frame.skipped_bytes;
+  window.lookups += frame.lookups;
+  window.lookup_hits += frame.lookup_hits;
+  memset(&frame, 0, sizeof(frame));
+
+  if (++frames % GL_UNIFORMS_REPORT_FRAMES)
+    return;
+  const double n = GL_UNIFORMS_REPORT_FRAMES;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "gl_uniforms: per frame %.1f uploads (%.1f dropped), %.1f KB "
+             "(%.1f KB dropped), %.1f location lookups (%.1f cached)\n",
+             window.calls / n, window.skipped / n, window.bytes / n / 1024,
+             window.skipped_bytes / n / 1024, window.lookups / n,
+             window.lookup_hits / n);
+  memset(&window, 0, sizeof(window));
+}
@@ -0,0 +1,75 @@
+/* gl_uniforms.h -- cache of uniform locations and uploaded uniform values
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef GL_UNIFORMS_H
+#define GL_UNIFORMS_H
+
+#include <GLES2/gl2.h>
+
+// programs and locations above these are passed through uncached
+#define GL_UNIFORMS_MAX_PROGRAMS 4096
+#define GL_UNIFORMS_MAX_LOCATIONS 1024
+// frames between reports in the log
+#define GL_UNIFORMS_REPORT_FRAMES 600
+
+typedef struct {
+  unsigned int calls;
+  unsigned int skipped;
+  unsigned int bytes;
+  unsigned int skipped_bytes;
+  unsigned int lookups;
+  unsigned int lookup_hits;
+} GlUniformCounters;
+
+// counts of the last finished frame
+extern GlUniformCounters gl_uniforms_last_frame;
+
+// functions the cached imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLUSEPROGRAMPROC glUseProgram;
+  PFNGLLINKPROGRAMPROC glLinkProgram;
+  PFNGLDELETEPROGRAMPROC glDeleteProgram;
+  PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+  PFNGLUNIFORM1FPROC glUniform1f;
+  PFNGLUNIFORM1FVPROC glUniform1fv;
+  PFNGLUNIFORM1IPROC glUniform1i;
+  PFNGLUNIFORM2FVPROC glUniform2fv;
+  PFNGLUNIFORM3FPROC glUniform3f;
+  PFNGLUNIFORM3FVPROC glUniform3fv;
+  PFNGLUNIFORM4FVPROC glUniform4fv;
+  PFNGLUNIFORMMATRIX3FVPROC glUniformMatrix3fv;
+  PFNGLUNIFORMMATRIX4FVPROC glUniformMatrix4fv;
+} GlUniformsNext;
+
+extern GlUniformsNext gl_uniforms_next;
+
+// called once per frame at swap
+void gl_uniforms_frame(void);
+
+void gl_uniforms_glUseProgram(GLuint program);
+void gl_uniforms_glLinkProgram(GLuint program);
+void gl_uniforms_glDeleteProgram(GLuint program);
+GLint gl_uniforms_glGetUniformLocation(GLuint program, const GLchar *name);
+void gl_uniforms_glUniform1f(GLint location, GLfloat v0);
+void gl_uniforms_glUniform1fv(GLint location, GLsizei count,
+                              const GLfloat *value);
+void gl_uniforms_glUniform1i(GLint location, GLint v0);
+void gl_uniforms_glUniform2fv(GLint location, GLsizei count,
+                              const GLfloat *value);
+void gl_uniforms_glUniform3f(GLint location, GLfloat v0, GLfloat v1,
+                             GLfloat v2);
+void gl_uniforms_glUniform3fv(GLint location, GLsizei count,
+                              const GLfloat *value);
+void gl_uniforms_glUniform4fv(GLint location, GLsizei count,
+                              const GLfloat *value);
+void gl_uniforms_glUniformMatrix3fv(GLint location, GLsizei count,
+                                    GLboolean transpose, const GLfloat *value);
+void gl_uniforms_glUniformMatrix4fv(GLint location, GLsizei count,
+                                    GLboolean transpose, const GLfloat *value);
+
+#endif // GL_UNIFORMS_H
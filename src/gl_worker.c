@@ -0,0 +1,145 @@
+/* gl_worker.c -- background thread with a GL context shared with the game's
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Shaders, programs, textures and buffers are shared between contexts created
+// to share them, so work on those objects can be done on another thread with
+// its own context while the game thread goes on. The worker's context is made
+// current without a surface, as the window can only be current on one thread
+// at a time, which needs EGL_KHR_surfaceless_context underneath SDL.
+//
+// Changes made to a shared object in one context are only guaranteed to be
+// seen in another once they are complete, so the worker finishes each job's
+// GL work before counting it as done.
+
+#include <GLES2/gl2.h>
+#include <SDL2/SDL.h>
+#include <pthread.h>
+
+#include "gl_worker.h"
+#include "log.h"
+
+typedef struct {
+  GlWorkerJob job;
+  void *arg;
+} Entry;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queued_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t thread;
+static SDL_GLContext worker_context = NULL;
+static int running = 0;
+static int started = 0; // 1 once current, -1 if that failed
+static int stop = 0;
+
+static Entry queue[GL_WORKER_QUEUE];
+static unsigned int submitted = 0;
+static unsigned int finished = 0;
+
+static void *worker_main(void *arg) {
+  (void)arg;
+  int ok = SDL_GL_MakeCurrent(NULL, worker_context) == 0;
+  if (!ok)
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "gl_worker: could not make the context current: %s\n",
+               SDL_GetError());
+
+  pthread_mutex_lock(&lock);
+  started = ok ? 1 : -1;
+  pthread_cond_broadcast(&done_cond);
+  while (ok) {
+    while (finished == submitted && !stop)
+      pthread_cond_wait(&queued_cond, &lock);
+    if (finished == submitted)
+      break;
+    Entry e = queue[finished % GL_WORKER_QUEUE];
+    pthread_mutex_unlock(&lock);
+
+    e.job(e.arg);
+    glFinish();
+
+    pthread_mutex_lock(&lock);
+    __atomic_store_n(&finished, finished + 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&done_cond);
+  }
+  pthread_mutex_unlock(&lock);
+
+  SDL_GL_MakeCurrent(NULL, NULL);
+  return NULL;
+}
+
+int gl_worker_init(SDL_Window *window, SDL_GLContext context) {
+  if (running)
+    return 1;
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+  worker_context = SDL_GL_CreateContext(window);
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+  // creating the context made it current
+  SDL_GL_MakeCurrent(window, context);
+  if (!worker_context) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "gl_worker: could not create a shared context: %s\n",
+               SDL_GetError());
+    return 0;
+  }
+
+  if (pthread_create(&thread, NULL, worker_main, NULL) != 0) {
+    SDL_GL_DeleteContext(worker_context);
+    worker_context = NULL;
+    return 0;
+  }
+  pthread_mutex_lock(&lock);
+  while (!started)
+    pthread_cond_wait(&done_cond, &lock);
+  pthread_mutex_unlock(&lock);
+
+  if (started < 0) {
+    pthread_join(thread, NULL);
+    SDL_GL_DeleteContext(worker_context);
+    worker_context = NULL;
+    return 0;
+  }
+  running = 1;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG, "gl_worker: started\n");
+  return 1;
+}
+
+void gl_worker_shutdown(void) {
+  if (!running)
+    return;
+  pthread_mutex_lock(&lock);
+  stop = 1;
+  pthread_cond_signal(&queued_cond);
+  pthread_mutex_unlock(&lock);
+  pthread_join(thread, NULL);
+  running = 0;
+}
+
+int gl_worker_active(void) { return running; }
+
+unsigned int gl_worker_submit(GlWorkerJob job, void *arg) {
+  pthread_mutex_lock(&lock);
+  while (submitted - finished == GL_WORKER_QUEUE)
+    pthread_cond_wait(&done_cond, &lock);
+  queue[submitted % GL_WORKER_QUEUE] = (Entry){job, arg};
+  unsigned int ticket = ++submitted;
+  pthread_cond_signal(&queued_cond);
+  pthread_mutex_unlock(&lock);
+  return ticket;
+}
+
+int gl_worker_done(unsigned int ticket) {
+  return (int)(__atomic_load_n(&finished, __ATOMIC_ACQUIRE) - ticket) >= 0;
+}
+
+void gl_worker_wait(unsigned int ticket) {
+  pthread_mutex_lock(&lock);
+  while ((int)(finished - ticket) < 0)
+    pthread_cond_wait(&done_cond, &lock);
+  pthread_mutex_unlock(&lock);
+}
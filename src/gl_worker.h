@@ -0,0 +1,35 @@
+/* gl_worker.h -- background thread with a GL context shared with the game's
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef GL_WORKER_H
+#define GL_WORKER_H
+
+#include <SDL2/SDL_video.h>
+
+// jobs that can be queued before submitting blocks
+#define GL_WORKER_QUEUE 256
+
+typedef void (*GlWorkerJob)(void *arg);
+
+// creates a context sharing objects with the game's and starts the thread
+// that runs jobs with it; call with the game's context current. Returns 0 if
+// the platform can't have a second context current without a window. Later
+// calls return 1 if the thread is already running.
+int gl_worker_init(SDL_Window *window, SDL_GLContext context);
+// finishes the queued jobs and stops the thread
+void gl_worker_shutdown(void);
+int gl_worker_active(void);
+// queues a job and returns a ticket for waiting on it; jobs run in order and
+// whatever they did to shared objects is finished before the next one starts
+unsigned int gl_worker_submit(GlWorkerJob job, void *arg);
+// nonzero if the job with this ticket has run
+int gl_worker_done(unsigned int ticket);
+// waits for the job with this ticket, and so for all jobs before it
+void gl_worker_wait(unsigned int ticket);
+
+#endif // GL_WORKER_H
@@ -20,9 +20,27 @@
 #include <unistd.h>
 
 #include "../config.h"
+#include "../draw_batch.h"
+#include "../frame_stats.h"
+#include "../framebuffer_discard.h"
+#include "../gamedata_mapping.h"
+#include "../gl_worker.h"
+#include "../gl_recorder.h"
 #include "../hooks.h"
+#include "../import_stats.h"
+#include "../iotrace.h"
+#include "../log.h"
+#include "../perf_hud.h"
+#include "../readahead.h"
+#include "../shader_cache.h"
+#include "../shader_override.h"
 #include "../so_util.h"
+#include "../texture_budget.h"
+#include "../texture_transcode.h"
+#include "../texture_upload.h"
+#include "../thread_pool.h"
 #include "../util.h"
+#include "../vertex_stream.h"
 #include "../videoplayer.h"
 
 #define APK_PATH "main.obb"
@@ -230,7 +248,23 @@ void exit_game(int code) {
       code);
 
   // Use _exit instead of exit to avoid calling atexit handlers
-  // which might reference unmapped memory
+  // which might reference unmapped memory, so the log has to be closed here
+  import_stats_report();
+  frame_stats_report();
+  shader_cache_report();
+  shader_override_report();
+  texture_transcode_report();
+  texture_budget_report();
+  texture_upload_report();
+  vertex_stream_report();
+  draw_batch_report();
+  framebuffer_discard_report();
+  gl_worker_shutdown();
+  thread_pool_shutdown();
+  readahead_shutdown();
+  gl_recorder_stop();
+  iotrace_stop();
+  log_shutdown();
   _exit(code);
 }
 
@@ -302,6 +336,8 @@ int WriteDataToPrivateStorage(const char *file, const void *data, int size) {
 
   const int ret = fwrite(data, size, 1, f);
   fclose(f);
+  // keep the stat cache in sync for files the game reads back later
+  gamedata_mapping_add(fullpath);
 
   return ret;
 }
@@ -363,6 +399,14 @@ void config_hot_keys(void) {
       config.aspect_ratio_x_mult = *xMult;
     }
   }
+
+  // L1 shows or hides the performance overlay, once per press
+  static int l1_held = 0;
+  int l1 = SDL_GameControllerGetButton(gamecontroller,
+                                       SDL_CONTROLLER_BUTTON_LEFTSHOULDER);
+  if (l1 && !l1_held)
+    perf_hud_toggle();
+  l1_held = l1;
 }
 
 // 0, 5, 6: XBOX 360
@@ -577,8 +621,10 @@ int R_File_setFileSystemRoot(void *this, const char *root) {
   debugPrintf("R_File_setFileSystemRoot: %s\n", root ? root : "NULL");
   // root appears to be unused?
   R_File_unloadArchives(this);
+  iotrace_mark("R_File::loadArchives");
   const int res = R_File_loadArchives(this);
-  R_File_enablePriorityArchive(this, config.mod_file);
+  if (config.mod_file[0])
+    R_File_enablePriorityArchive(this, config.mod_file);
   return res;
 }
 
@@ -701,6 +747,7 @@ static void crash_handler(int sig) {
   debugPrintf(
       "Check the log above this point for the last successful operation\n");
   debugPrintf("=== END CRASH INFO ===\n");
+  log_flush();
 
   // Don't try to cleanup, just exit immediately
   _exit(128 + sig);
@@ -849,8 +896,9 @@ void patch_game(void) {
              (uintptr_t)MaxPayne_ConfiguredInput_readShoot);
 
   // if mod file is enabled, hook into R_File::setFileSystemRoot to set the
-  // mod as the priority archive before R_File::loadArchives is called
-  if (config.mod_file[0]) {
+  // mod as the priority archive before R_File::loadArchives is called; the io
+  // trace marks the archive loads from the same hook
+  if (config.mod_file[0] || config.io_trace) {
     R_File_unloadArchives =
         (void *)so_find_addr_rx("_ZN6R_File14unloadArchivesEv");
     R_File_loadArchives = (void *)so_find_addr_rx("_ZN6R_File12loadArchivesEv");
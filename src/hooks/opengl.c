@@ -15,8 +15,23 @@
 #include <string.h>
 
 #include "../config.h"
+#include "../draw_batch.h"
+#include "../frame_pacing.h"
+#include "../frame_stats.h"
+#include "../framebuffer_discard.h"
+#include "../gl_recorder.h"
+#include "../gl_state.h"
+#include "../gl_uniforms.h"
+#include "../import_stats.h"
+#include "../perf_hud.h"
+#include "../render_scale.h"
+#include "../shader_cache.h"
 #include "../so_util.h"
+#include "../texture_budget.h"
+#include "../texture_transcode.h"
+#include "../texture_upload.h"
 #include "../util.h"
+#include "../vertex_stream.h"
 
 // SDL OpenGL context
 static SDL_Window *sdl_window = NULL;
@@ -53,9 +68,11 @@ static int init_sdl_opengl(void) {
 
   // Get display mode for default window size
   SDL_DisplayMode mode;
+  int refresh_rate = 0;
   if (SDL_GetCurrentDisplayMode(0, &mode) == 0) {
     display_width = mode.w;
     display_height = mode.h;
+    refresh_rate = mode.refresh_rate;
     debugPrintf("✓ Display resolution: %dx%d\n", display_width, display_height);
   } else {
     // Default resolution if we can't get display info
@@ -98,7 +115,9 @@ static int init_sdl_opengl(void) {
   debugPrintf("✓ SDL OpenGL ES context made current\n");
 
   // Configure VSync
-  int vsync_interval = config.vsync_enabled ? 1 : 0;
+  // a target frame rate that divides the refresh rate maps to a longer
+  // swap interval
+  int vsync_interval = frame_pacing_swap_interval(refresh_rate);
   if (SDL_GL_SetSwapInterval(vsync_interval) < 0) {
     debugPrintf("⚠ Warning: Could not %s VSync: %s\n",
                 config.vsync_enabled ? "enable" : "disable", SDL_GetError());
@@ -120,6 +139,17 @@ static int init_sdl_opengl(void) {
   SDL_GL_SwapWindow(sdl_window);
   debugPrintf("✓ Test render completed\n");
 
+  if (render_scale_wanted())
+    render_scale_init(screen_width, screen_height);
+  if (config.shader_cache)
+    shader_cache_init(sdl_window, sdl_gl_context);
+  if (config.texture_transcode)
+    texture_transcode_init();
+  if (config.async_textures)
+    texture_upload_init(sdl_window, sdl_gl_context);
+  if (config.framebuffer_discard)
+    framebuffer_discard_init();
+
   debugPrintf("=== SDL OpenGL ES initialization complete ===\n");
   return 0;
 }
@@ -169,25 +199,53 @@ void NVEventEGLSwapBuffers(void) {
   }
 
   if (sdl_window) {
+    // the overlay and the upscale below use GL directly
+    draw_batch_flush();
+    if (config.framebuffer_discard)
+      framebuffer_discard_swap();
 
     // hack to fix 1:1 screens rendering in 4:3
+    int bar_height = 0;
     if (screen_height == screen_width && !config.force_widescreen) {
       int wanted_height = screen_height*(3.0f/4.0f);
-      int y_offset = (screen_height - wanted_height) / 2;
-      
-      // render black bars on top and bottom of the screen
+      bar_height = (screen_height - wanted_height) / 2;
+    }
 
+    // the upscale from the offscreen target draws the bars too
+    if (!render_scale_present(bar_height) && bar_height) {
+      // render black bars on top and bottom of the screen
       glEnable(GL_SCISSOR_TEST);
-      glScissor(0, 0, screen_width, y_offset);
+      glScissor(0, 0, screen_width, bar_height);
       glClearColor(0.0f, 0.0f, 0.0, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT);
-      glScissor(0, screen_height - y_offset, screen_width, y_offset);
+      glScissor(0, screen_height - bar_height, screen_width, bar_height);
       glClear(GL_COLOR_BUFFER_BIT);
       glDisable(GL_SCISSOR_TEST);
     }
-   
 
+    perf_hud_draw();
+    frame_pacing_wait();
     SDL_GL_SwapWindow(sdl_window);
+    render_scale_frame();
+    if (config.frame_stats)
+      frame_stats_frame();
+    import_stats_frame();
+    if (config.gl_state_cache)
+      gl_state_frame();
+    if (config.gl_uniform_cache)
+      gl_uniforms_frame();
+    if (config.gl_record_frames > 0)
+      gl_recorder_frame();
+    if (config.texture_budget > 0)
+      texture_budget_frame();
+    if (config.vertex_stream)
+      vertex_stream_frame();
+    if (config.draw_batch)
+      draw_batch_frame();
+    if (config.framebuffer_discard)
+      framebuffer_discard_frame();
+    if (config.perf_hud)
+      perf_hud_frame();
   } else {
     debugPrintf("NVEventEGLSwapBuffers: SDL window not available\n");
   }
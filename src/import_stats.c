@@ -0,0 +1,318 @@
+/* import_stats.c -- per-import call counters and latency histograms
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// so_resolve binds every PLT slot of the game to a small generated thunk
+// instead of the import itself. The thunk bumps the call counter of the
+// import and jumps on to the real function without touching the stack or
+// any argument register, so it works for any signature.
+//
+// When latency sampling is on, every IMPORT_STATS_SAMPLE_RATE-th call takes
+// a slow path instead: the argument registers are saved, the start time and
+// the caller's return address are pushed to a per-thread shadow stack and the
+// import is entered with its return address pointed at an exit stub, which
+// takes the time, records it in the histogram and returns to the caller.
+// Since the stack pointer is unchanged when the import is entered, stack
+// arguments and varargs are passed through untouched. Imports that never
+// return normally (exceptions, longjmp, exit) only ever get counted.
+//
+// The counter increment is a plain load/add/store to keep the thunk free of
+// extra registers, so counts can come out slightly low for imports that are
+// called from several threads at once.
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "config.h"
+#include "error.h"
+#include "import_stats.h"
+#include "util.h"
+
+#define IMPORT_STATS_BUCKETS 32 // log2 of the latency in ns
+#define SHADOW_STACK_DEPTH 64
+#define THUNK_WORDS 14
+
+typedef struct {
+  uint64_t calls; // bumped by the thunk, must stay first
+  uintptr_t func; // real function, must stay second
+  const char *symbol;
+  uint64_t window_calls; // calls at the start of the current report window
+  uint64_t samples;
+  uint64_t sample_ns;
+  uint64_t hist[IMPORT_STATS_BUCKETS];
+} ImportStat;
+
+typedef struct {
+  ImportStat *stat;
+  uintptr_t lr;
+  uint64_t start;
+} ShadowFrame;
+
+typedef struct {
+  uintptr_t func;
+  uintptr_t timed; // nonzero if the exit stub should be used
+} EnterResult;
+
+static ImportStat stats[IMPORT_STATS_MAX];
+static int num_stats = 0;
+static unsigned int frames = 0;
+
+#ifdef __aarch64__
+
+static uint32_t *thunks = NULL;
+static __thread ShadowFrame shadow_stack[SHADOW_STACK_DEPTH];
+static __thread int shadow_depth = 0;
+
+// these unwind, jump or exit past their caller, so the exit stub would never
+// run (or confuse the unwinder); dl* look at their return address
+static const char *const untimed_imports[] = {
+    "__cxa_throw", "__cxa_rethrow", "_Unwind_Resume", "_Unwind_RaiseException",
+    "longjmp",     "siglongjmp",    "_longjmp",       "setjmp",
+    "sigsetjmp",   "_setjmp",       "exit",           "_exit",
+    "abort",       "pthread_exit",  "__stack_chk_fail", "dlopen",
+    "dlsym",       "dladdr",        "dlclose",        "__assert2",
+};
+
+// called from the sample stubs below, with the argument registers saved
+EnterResult import_stats_enter(ImportStat *stat, uintptr_t lr) {
+  if (shadow_depth == SHADOW_STACK_DEPTH)
+    return (EnterResult){stat->func, 0};
+  shadow_stack[shadow_depth++] = (ShadowFrame){stat, lr, now_ns()};
+  return (EnterResult){stat->func, 1};
+}
+
+uintptr_t import_stats_exit(void) {
+  uint64_t end = now_ns();
+  if (shadow_depth == 0)
+    fatal_error("import_stats: shadow stack underflow");
+  ShadowFrame *frame = &shadow_stack[--shadow_depth];
+  uint64_t ns = end - frame->start;
+  int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+  if (bucket >= IMPORT_STATS_BUCKETS)
+    bucket = IMPORT_STATS_BUCKETS - 1;
+  __atomic_fetch_add(&frame->stat->hist[bucket], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&frame->stat->samples, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&frame->stat->sample_ns, ns, __ATOMIC_RELAXED);
+  return frame->lr;
+}
+
+// x16 = ImportStat of the import, x30 = the game's return address
+__asm__(".text\n"
+        ".balign 16\n"
+        ".global import_stats_sample_enter\n"
+        ".type import_stats_sample_enter, %function\n"
+        "import_stats_sample_enter:\n"
+        "  sub sp, sp, #208\n"
+        "  stp x0, x1, [sp, #0]\n"
+        "  stp x2, x3, [sp, #16]\n"
+        "  stp x4, x5, [sp, #32]\n"
+        "  stp x6, x7, [sp, #48]\n"
+        "  stp x8, x30, [sp, #64]\n"
+        "  stp q0, q1, [sp, #80]\n"
+        "  stp q2, q3, [sp, #112]\n"
+        "  stp q4, q5, [sp, #144]\n"
+        "  stp q6, q7, [sp, #176]\n"
+        "  mov x0, x16\n"
+        "  mov x1, x30\n"
+        "  bl import_stats_enter\n"
+        "  mov x16, x0\n"
+        "  mov x17, x1\n"
+        "  ldp x0, x1, [sp, #0]\n"
+        "  ldp x2, x3, [sp, #16]\n"
+        "  ldp x4, x5, [sp, #32]\n"
+        "  ldp x6, x7, [sp, #48]\n"
+        "  ldp x8, x30, [sp, #64]\n"
+        "  ldp q0, q1, [sp, #80]\n"
+        "  ldp q2, q3, [sp, #112]\n"
+        "  ldp q4, q5, [sp, #144]\n"
+        "  ldp q6, q7, [sp, #176]\n"
+        "  add sp, sp, #208\n"
+        "  cbz x17, 1f\n"
+        "  adr x30, import_stats_sample_exit\n"
+        "1:\n"
+        "  br x16\n"
+        ".size import_stats_sample_enter, . - import_stats_sample_enter\n"
+        "\n"
+        // return values live in x0-x1 and q0-q3 (float aggregates)
+        ".balign 16\n"
+        ".global import_stats_sample_exit\n"
+        ".type import_stats_sample_exit, %function\n"
+        "import_stats_sample_exit:\n"
+        "  sub sp, sp, #80\n"
+        "  stp x0, x1, [sp, #0]\n"
+        "  stp q0, q1, [sp, #16]\n"
+        "  stp q2, q3, [sp, #48]\n"
+        "  bl import_stats_exit\n"
+        "  mov x30, x0\n"
+        "  ldp x0, x1, [sp, #0]\n"
+        "  ldp q0, q1, [sp, #16]\n"
+        "  ldp q2, q3, [sp, #48]\n"
+        "  add sp, sp, #80\n"
+        "  ret\n"
+        ".size import_stats_sample_exit, . - import_stats_sample_exit\n");
+
+extern void import_stats_sample_enter(void);
+
+static int is_untimed(const char *symbol) {
+  for (size_t i = 0; i < sizeof(untimed_imports) / sizeof(*untimed_imports);
+       ++i) {
+    if (!strcmp(symbol, untimed_imports[i]))
+      return 1;
+  }
+  return 0;
+}
+
+static void write_thunk(uint32_t *code, ImportStat *stat, int timed) {
+  code[0] = 0x58000150u; // LDR X16, #0x28 (stat)
+  code[1] = 0xf9400211u; // LDR X17, [X16]
+  code[2] = 0x91000631u; // ADD X17, X17, #1
+  code[3] = 0xf9000211u; // STR X17, [X16]
+  code[4] = 0xf240163fu; // TST X17, #(IMPORT_STATS_SAMPLE_RATE - 1)
+  code[5] = timed ? 0x54000060u  // B.EQ #0xc
+                  : 0xd503201fu; // NOP
+  code[6] = 0xf9400611u; // LDR X17, [X16, #8] (func)
+  code[7] = 0xd61f0220u; // BR X17
+  code[8] = 0x58000091u; // LDR X17, #0x10 (sample stub)
+  code[9] = 0xd61f0220u; // BR X17
+  *(uint64_t *)(code + 10) = (uintptr_t)stat;
+  *(uint64_t *)(code + 12) = (uintptr_t)&import_stats_sample_enter;
+}
+
+_Static_assert(IMPORT_STATS_SAMPLE_RATE == 64,
+               "the TST immediate in write_thunk encodes the sample rate");
+
+uintptr_t import_stats_bind(const char *symbol, uintptr_t func) {
+  for (int i = 0; i < num_stats; ++i) {
+    if (stats[i].func == func && !strcmp(stats[i].symbol, symbol))
+      return (uintptr_t)(thunks + i * THUNK_WORDS);
+  }
+  if (num_stats == IMPORT_STATS_MAX)
+    return func;
+
+  if (!thunks) {
+    thunks = mmap(NULL, IMPORT_STATS_MAX * THUNK_WORDS * sizeof(uint32_t),
+                  PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (thunks == MAP_FAILED) {
+      thunks = NULL;
+      return func;
+    }
+  }
+
+  ImportStat *stat = &stats[num_stats];
+  stat->func = func;
+  stat->symbol = symbol;
+  uint32_t *code = thunks + num_stats * THUNK_WORDS;
+  write_thunk(code, stat, config.import_stats > 1 && !is_untimed(symbol));
+  num_stats++;
+  return (uintptr_t)code;
+}
+
+void import_stats_finalize(void) {
+  if (!thunks)
+    return;
+  size_t size = IMPORT_STATS_MAX * THUNK_WORDS * sizeof(uint32_t);
+  if (mprotect(thunks, size, PROT_READ | PROT_EXEC) < 0)
+    fatal_error("import_stats: could not make thunks executable");
+  __builtin___clear_cache((char *)thunks, (char *)thunks + size);
+  debugPrintf("import_stats: %d imports instrumented\n", num_stats);
+}
+
+#else
+
+uintptr_t import_stats_bind(const char *symbol, uintptr_t func) {
+  (void)symbol;
+  return func;
+}
+
+void import_stats_finalize(void) {
+  debugPrintf("import_stats: thunks are only implemented for arm64\n");
+}
+
+#endif
+
+// ---- reports ----
+
+static uint64_t window_delta(const ImportStat *s) {
+  return s->calls - s->window_calls;
+}
+
+static double mean_ns(const ImportStat *s) {
+  return s->samples ? (double)s->sample_ns / s->samples : 0.0;
+}
+
+static int compare_window(const void *a, const void *b) {
+  uint64_t da = window_delta(*(ImportStat *const *)a);
+  uint64_t db = window_delta(*(ImportStat *const *)b);
+  return (da < db) - (da > db);
+}
+
+static int compare_total(const void *a, const void *b) {
+  const ImportStat *sa = *(ImportStat *const *)a;
+  const ImportStat *sb = *(ImportStat *const *)b;
+  // rank by estimated time if there are samples, calls otherwise
+  double ta = sa->samples ? sa->calls * mean_ns(sa) : 0.0;
+  double tb = sb->samples ? sb->calls * mean_ns(sb) : 0.0;
+  if (ta != tb)
+    return (ta < tb) - (ta > tb);
+  return (sa->calls < sb->calls) - (sa->calls > sb->calls);
+}
+
+// median bucket of the sampled latencies, as the bucket's lower bound
+static uint64_t median_ns(const ImportStat *s) {
+  uint64_t seen = 0;
+  for (int b = 0; b < IMPORT_STATS_BUCKETS; ++b) {
+    seen += s->hist[b];
+    if (seen * 2 >= s->samples && s->samples)
+      return 1ull << b;
+  }
+  return 0;
+}
+
+static int sorted_stats(ImportStat **sorted,
+                        int (*compare)(const void *, const void *)) {
+  for (int i = 0; i < num_stats; ++i)
+    sorted[i] = &stats[i];
+  qsort(sorted, num_stats, sizeof(*sorted), compare);
+  return num_stats < IMPORT_STATS_TOP ? num_stats : IMPORT_STATS_TOP;
+}
+
+void import_stats_frame(void) {
+  if (!num_stats || ++frames % IMPORT_STATS_WINDOW)
+    return;
+
+  static ImportStat *sorted[IMPORT_STATS_MAX];
+  int top = sorted_stats(sorted, compare_window);
+  debugPrintf("import_stats: calls per frame over the last %d frames\n",
+              IMPORT_STATS_WINDOW);
+  for (int i = 0; i < top && window_delta(sorted[i]); ++i)
+    debugPrintf("  %10.1f  %8.0f ns  %s\n",
+                (double)window_delta(sorted[i]) / IMPORT_STATS_WINDOW,
+                mean_ns(sorted[i]), sorted[i]->symbol);
+  for (int i = 0; i < num_stats; ++i)
+    stats[i].window_calls = stats[i].calls;
+}
+
+void import_stats_report(void) {
+  if (!num_stats)
+    return;
+
+  static ImportStat *sorted[IMPORT_STATS_MAX];
+  int top = sorted_stats(sorted, compare_total);
+  debugPrintf("import_stats: session totals over %u frames\n"
+              "       calls    calls/frame    mean ns  median ns   est. ms  "
+              "import\n",
+              frames);
+  for (int i = 0; i < top && sorted[i]->calls; ++i) {
+    const ImportStat *s = sorted[i];
+    debugPrintf("  %10llu  %13.1f  %9.0f  %9llu  %8.1f  %s\n",
+                (unsigned long long)s->calls,
+                frames ? (double)s->calls / frames : 0.0, mean_ns(s),
+                (unsigned long long)median_ns(s), s->calls * mean_ns(s) / 1e6,
+                s->symbol);
+  }
+}
@@ -0,0 +1,30 @@
+/* import_stats.h -- per-import call counters and latency histograms
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef IMPORT_STATS_H
+#define IMPORT_STATS_H
+
+#include <stdint.h>
+
+#define IMPORT_STATS_MAX 1024
+// one call in this many goes through the timed path (power of two)
+#define IMPORT_STATS_SAMPLE_RATE 64
+// frames between per-frame reports
+#define IMPORT_STATS_WINDOW 600
+#define IMPORT_STATS_TOP 15
+
+// passed to so_resolve; returns a counting thunk that jumps to func
+uintptr_t import_stats_bind(const char *symbol, uintptr_t func);
+// makes the thunks executable, call after so_resolve
+void import_stats_finalize(void);
+// called once per frame, logs the per-frame table every IMPORT_STATS_WINDOW
+void import_stats_frame(void);
+// logs the session totals
+void import_stats_report(void);
+
+#endif // IMPORT_STATS_H
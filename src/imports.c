@@ -30,9 +30,30 @@
 #include <wctype.h>
 
 #include "config.h"
+#include "draw_batch.h"
+#include "fastmath.h"
+#include "frame_pacing.h"
+#include "frame_stats.h"
+#include "framebuffer_discard.h"
 #include "gamedata_mapping.h"
+#include "gl_recorder.h"
+#include "gl_state.h"
+#include "gl_uniforms.h"
+#include "iotrace.h"
+#include "log.h"
+#include "mmap_stream.h"
+#include "perf_hud.h"
+#include "readahead.h"
+#include "render_scale.h"
+#include "shader_cache.h"
+#include "shader_override.h"
+#include "shader_precision.h"
 #include "so_util.h"
+#include "texture_budget.h"
+#include "texture_transcode.h"
+#include "texture_upload.h"
 #include "util.h"
+#include "vertex_stream.h"
 
 extern uintptr_t __cxa_atexit;
 
@@ -58,16 +79,36 @@ void __assert2(const char *file, int line, const char *func, const char *expr) {
   assert(0);
 }
 
+// the game's own log output goes to the "game" log subsystem so that it can
+// be silenced separately from the wrapper's messages
+
+static LogLevel android_log_level(int prio) {
+  // ANDROID_LOG_VERBOSE is 2, ANDROID_LOG_ERROR is 6
+  if (prio >= 6)
+    return LOG_LEVEL_ERROR;
+  if (prio == 5)
+    return LOG_LEVEL_WARN;
+  if (prio == 4)
+    return LOG_LEVEL_INFO;
+  if (prio == 3)
+    return LOG_LEVEL_DEBUG;
+  return LOG_LEVEL_TRACE;
+}
+
 int __android_log_print(int prio, const char *tag, const char *fmt, ...) {
 #ifdef DEBUG_LOG
+  LogLevel level = android_log_level(prio);
+  if (level > log_levels[LOG_SYS_GAME])
+    return 0;
+
   va_list list;
-  static char string[0x1000];
+  char string[0x1000];
 
   va_start(list, fmt);
   vsnprintf(string, sizeof(string), fmt, list);
   va_end(list);
 
-  debugPrintf("%s: %s\n", tag, string);
+  log_printf(LOG_SYS_GAME, level, "%s: %s\n", tag, string);
 #endif
   return 0;
 }
@@ -76,17 +117,38 @@ int fake_fprintf(FILE *stream, const char *fmt, ...) {
   int ret = 0;
 #ifdef DEBUG_LOG
   va_list list;
-  static char string[0x1000];
+
+  if (LOG_LEVEL_INFO > log_levels[LOG_SYS_GAME]) {
+    va_start(list, fmt);
+    ret = vsnprintf(NULL, 0, fmt, list);
+    va_end(list);
+    return ret;
+  }
+
+  char string[0x1000];
 
   va_start(list, fmt);
   ret = vsnprintf(string, sizeof(string), fmt, list);
   va_end(list);
 
-  debugPrintf("%s", string);
+  log_printf(LOG_SYS_GAME, LOG_LEVEL_INFO, "%s", string);
 #endif
   return ret;
 }
 
+int fake_printf(const char *fmt, ...) {
+#ifdef DEBUG_LOG
+  if (LOG_LEVEL_INFO > log_levels[LOG_SYS_GAME])
+    return 0;
+
+  va_list list;
+  va_start(list, fmt);
+  log_vprintf(LOG_SYS_GAME, LOG_LEVEL_INFO, fmt, list);
+  va_end(list);
+#endif
+  return 0;
+}
+
 // pthread stuff
 // have to wrap it since struct sizes are different
 
@@ -257,11 +319,37 @@ FILE *fopen_wrapper(const char *filename, const char *mode) {
 
   // in order to support case sensitivity on case insensitive filesystems,
   // we need to map filenames game requests to their actual paths on the disk
-  const char *mapped = gamedata_mapping_get(filename);
+  const char *mapped = NULL;
+  int status = gamedata_mapping_lookup(filename, &mapped);
   if (mapped) {
     filename = mapped;
   }
-  FILE *file = fopen(filename, mode);
+
+  int writing = strpbrk(mode, "wa+") != NULL;
+  if (status == GAMEDATA_PATH_MISSING && !writing) {
+    // the game probes a lot of optional files, no need to ask the kernel
+    if (config.debug_gamedata_mapping) {
+      debugPrintf("Failed to open file: %s\n", filename);
+    }
+    errno = ENOENT;
+    return NULL;
+  }
+
+  // read-only data files are served from a mapping; savegames are excluded
+  // since the game may rewrite them while a read handle is still open
+  FILE *file = NULL;
+  if (config.mmap_gamedata && !writing && !strncmp(filename, "gamedata/", 9) &&
+      strncmp(filename, "gamedata/savegames/", 19))
+    file = mmap_stream_open(filename);
+  if (!file)
+    file = fopen(filename, mode);
+  if (file && writing) {
+    // a new file is indexed while it's still empty and being written, so
+    // its size and times are left to stat() rather than the index
+    if (status != GAMEDATA_PATH_FOUND)
+      gamedata_mapping_add(filename);
+    gamedata_mapping_invalidate(filename);
+  }
   if (config.debug_gamedata_mapping) {
     if (!file) {
       debugPrintf("Failed to open file: %s\n", filename);
@@ -270,6 +358,56 @@ FILE *fopen_wrapper(const char *filename, const char *mode) {
   return file;
 }
 
+int open_wrapper(const char *pathname, int flags, ...) {
+  mode_t mode = 0;
+  if (flags & O_CREAT) {
+    va_list list;
+    va_start(list, flags);
+    mode = va_arg(list, int);
+    va_end(list);
+  }
+
+  const char *mapped = NULL;
+  int status = gamedata_mapping_lookup(pathname, &mapped);
+  if (mapped) {
+    pathname = mapped;
+  }
+
+  int writing = (flags & (O_WRONLY | O_RDWR | O_CREAT | O_TRUNC)) != 0;
+  if (status == GAMEDATA_PATH_MISSING && !writing) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  int fd = open(pathname, flags, mode);
+  if (fd >= 0 && writing) {
+    // a new file is indexed while it's still empty and being written, so
+    // its size and times are left to stat() rather than the index
+    if (status != GAMEDATA_PATH_FOUND)
+      gamedata_mapping_add(pathname);
+    gamedata_mapping_invalidate(pathname);
+  }
+  return fd;
+}
+
+int stat_wrapper(const char *pathname, struct stat *statbuf) {
+  // bionic and glibc share the generic struct stat layout on arm64, so the
+  // cached copy can be handed to the game as is
+  return gamedata_mapping_stat(pathname, statbuf);
+}
+
+int mkdir_wrapper(const char *pathname, mode_t mode) {
+  const char *mapped = gamedata_mapping_get(pathname);
+  if (mapped) {
+    pathname = mapped;
+  }
+  int ret = mkdir(pathname, mode);
+  if (ret == 0) {
+    gamedata_mapping_add(pathname);
+  }
+  return ret;
+}
+
 // import table
 
 DynLibFunction dynlib_functions[] = {
@@ -328,7 +466,7 @@ DynLibFunction dynlib_functions[] = {
 
     {"_ctype_", (uintptr_t)&__ctype_},
 
-    // TODO: use math neon?
+    // replaced with the fastmath.c versions when fast_math is enabled
     {"acos", (uintptr_t)&acos},
     {"acosf", (uintptr_t)&acosf},
     {"asinf", (uintptr_t)&asinf},
@@ -488,7 +626,7 @@ DynLibFunction dynlib_functions[] = {
     {"memset", (uintptr_t)&memset},
     {"memchr", (uintptr_t)&memchr},
 
-    {"printf", (uintptr_t)&debugPrintf},
+    {"printf", (uintptr_t)&fake_printf},
 
     {"bsearch", (uintptr_t)&bsearch},
     {"qsort", (uintptr_t)&qsort},
@@ -502,10 +640,10 @@ DynLibFunction dynlib_functions[] = {
 
     {"close", (uintptr_t)&close},
     {"lseek", (uintptr_t)&lseek},
-    {"mkdir", (uintptr_t)&mkdir},
-    {"open", (uintptr_t)&open},
+    {"mkdir", (uintptr_t)&mkdir_wrapper},
+    {"open", (uintptr_t)&open_wrapper},
     {"read", (uintptr_t)&read},
-    {"stat", (uintptr_t)stat},
+    {"stat", (uintptr_t)&stat_wrapper},
     {"write", (uintptr_t)&write},
 
     {"strcasecmp", (uintptr_t)&strcasecmp},
@@ -552,6 +690,16 @@ DynLibFunction dynlib_functions[] = {
 size_t dynlib_numfunctions =
     sizeof(dynlib_functions) / sizeof(*dynlib_functions);
 
+// swaps in func for an import and returns what it resolved to before, so
+// wrappers can be layered on top of each other
+static uintptr_t replace_import(const char *symbol, uintptr_t func) {
+  DynLibFunction *import =
+      so_find_import(dynlib_functions, dynlib_numfunctions, symbol);
+  uintptr_t prev = import->func;
+  import->func = func;
+  return prev;
+}
+
 void update_imports(void) {
   // Initialize ctype for glibc compatibility
   __ctype_ = (char *)__ctype_b_loc();
@@ -565,4 +713,366 @@ void update_imports(void) {
   if (config.trilinear_filter)
     so_find_import(dynlib_functions, dynlib_numfunctions, "glTexParameteri")
         ->func = (uintptr_t)glTexParameteriHook;
+
+  // streams returned by fopen_wrapper for mapped gamedata files are served by
+  // these; other streams fall through to libc
+  if (config.mmap_gamedata) {
+    static const DynLibFunction mmap_stream_functions[] = {
+        {"fread", (uintptr_t)&mmap_stream_fread},
+        {"fseek", (uintptr_t)&mmap_stream_fseek},
+        {"ftell", (uintptr_t)&mmap_stream_ftell},
+        {"feof", (uintptr_t)&mmap_stream_feof},
+        {"ferror", (uintptr_t)&mmap_stream_ferror},
+        {"fgetc", (uintptr_t)&mmap_stream_fgetc},
+        {"fgets", (uintptr_t)&mmap_stream_fgets},
+        {"fclose", (uintptr_t)&mmap_stream_fclose},
+    };
+    for (size_t i = 0;
+         i < sizeof(mmap_stream_functions) / sizeof(*mmap_stream_functions);
+         ++i)
+      so_find_import(dynlib_functions, dynlib_numfunctions,
+                     mmap_stream_functions[i].symbol)
+          ->func = mmap_stream_functions[i].func;
+  }
+
+  if (config.fast_math) {
+    static const DynLibFunction fast_math_functions[] = {
+        {"sinf", (uintptr_t)&fast_sinf},   {"cosf", (uintptr_t)&fast_cosf},
+        {"atan2f", (uintptr_t)&fast_atan2f}, {"powf", (uintptr_t)&fast_powf},
+        {"sqrtf", (uintptr_t)&fast_sqrtf}, {"acosf", (uintptr_t)&fast_acosf},
+        {"sin", (uintptr_t)&fast_sin},     {"cos", (uintptr_t)&fast_cos},
+        {"sqrt", (uintptr_t)&fast_sqrt},   {"acos", (uintptr_t)&fast_acos},
+    };
+    for (size_t i = 0;
+         i < sizeof(fast_math_functions) / sizeof(*fast_math_functions); ++i)
+      so_find_import(dynlib_functions, dynlib_numfunctions,
+                     fast_math_functions[i].symbol)
+          ->func = fast_math_functions[i].func;
+    if (config.fast_math > 1)
+      fastmath_report();
+  }
+
+  // first, so that it's closest to GL and the layers above and the recorder
+  // see the game's own framebuffer, viewport and scissor values
+  if (render_scale_wanted()) {
+    render_scale_next.glBindFramebuffer = (void *)replace_import(
+        "glBindFramebuffer", (uintptr_t)&render_scale_glBindFramebuffer);
+    render_scale_next.glViewport = (void *)replace_import(
+        "glViewport", (uintptr_t)&render_scale_glViewport);
+    render_scale_next.glScissor = (void *)replace_import(
+        "glScissor", (uintptr_t)&render_scale_glScissor);
+    render_scale_next.glGetIntegerv = (void *)replace_import(
+        "glGetIntegerv", (uintptr_t)&render_scale_glGetIntegerv);
+    render_scale_next.glReadPixels = (void *)replace_import(
+        "glReadPixels", (uintptr_t)&render_scale_glReadPixels);
+  }
+
+  // tells tiled GPUs which attachments needn't be written back; below the
+  // draw batching so that the draws held back are made before a discard
+  if (config.framebuffer_discard) {
+    framebuffer_discard_next.glBindFramebuffer = (void *)replace_import(
+        "glBindFramebuffer", (uintptr_t)&framebuffer_discard_glBindFramebuffer);
+    framebuffer_discard_next.glDeleteFramebuffers = (void *)replace_import(
+        "glDeleteFramebuffers",
+        (uintptr_t)&framebuffer_discard_glDeleteFramebuffers);
+    framebuffer_discard_next.glFramebufferTexture2D = (void *)replace_import(
+        "glFramebufferTexture2D",
+        (uintptr_t)&framebuffer_discard_glFramebufferTexture2D);
+    framebuffer_discard_next.glEnable = (void *)replace_import(
+        "glEnable", (uintptr_t)&framebuffer_discard_glEnable);
+    framebuffer_discard_next.glDisable = (void *)replace_import(
+        "glDisable", (uintptr_t)&framebuffer_discard_glDisable);
+    framebuffer_discard_next.glDepthMask = (void *)replace_import(
+        "glDepthMask", (uintptr_t)&framebuffer_discard_glDepthMask);
+    framebuffer_discard_next.glClear = (void *)replace_import(
+        "glClear", (uintptr_t)&framebuffer_discard_glClear);
+    framebuffer_discard_next.glDrawArrays = (void *)replace_import(
+        "glDrawArrays", (uintptr_t)&framebuffer_discard_glDrawArrays);
+    framebuffer_discard_next.glDrawElements = (void *)replace_import(
+        "glDrawElements", (uintptr_t)&framebuffer_discard_glDrawElements);
+  }
+
+  // draws from client memory take their vertices and indices from buffers;
+  // below the draw batching so that merged draws are streamed as one. The
+  // game's bindings are put back after each draw, so the state cache above
+  // stays right.
+  if (config.vertex_stream) {
+    vertex_stream_next.glBindBuffer = (void *)replace_import(
+        "glBindBuffer", (uintptr_t)&vertex_stream_glBindBuffer);
+    vertex_stream_next.glDeleteBuffers = (void *)replace_import(
+        "glDeleteBuffers", (uintptr_t)&vertex_stream_glDeleteBuffers);
+    vertex_stream_next.glVertexAttribPointer = (void *)replace_import(
+        "glVertexAttribPointer", (uintptr_t)&vertex_stream_glVertexAttribPointer);
+    vertex_stream_next.glEnableVertexAttribArray = (void *)replace_import(
+        "glEnableVertexAttribArray",
+        (uintptr_t)&vertex_stream_glEnableVertexAttribArray);
+    vertex_stream_next.glDisableVertexAttribArray = (void *)replace_import(
+        "glDisableVertexAttribArray",
+        (uintptr_t)&vertex_stream_glDisableVertexAttribArray);
+    vertex_stream_next.glDrawArrays = (void *)replace_import(
+        "glDrawArrays", (uintptr_t)&vertex_stream_glDrawArrays);
+    vertex_stream_next.glDrawElements = (void *)replace_import(
+        "glDrawElements", (uintptr_t)&vertex_stream_glDrawElements);
+  }
+
+  // consecutive draws merged into one; below the state and uniform caches,
+  // as every call that reaches it ends the draws merged so far
+  if (config.draw_batch)
+    draw_batch_install(replace_import);
+
+  // drops state changes that don't change anything
+  if (config.gl_state_cache) {
+    gl_state_next.glBindTexture = (void *)replace_import(
+        "glBindTexture", (uintptr_t)&gl_state_glBindTexture);
+    gl_state_next.glActiveTexture = (void *)replace_import(
+        "glActiveTexture", (uintptr_t)&gl_state_glActiveTexture);
+    gl_state_next.glUseProgram = (void *)replace_import(
+        "glUseProgram", (uintptr_t)&gl_state_glUseProgram);
+    gl_state_next.glEnable =
+        (void *)replace_import("glEnable", (uintptr_t)&gl_state_glEnable);
+    gl_state_next.glDisable =
+        (void *)replace_import("glDisable", (uintptr_t)&gl_state_glDisable);
+    gl_state_next.glBlendFunc =
+        (void *)replace_import("glBlendFunc", (uintptr_t)&gl_state_glBlendFunc);
+    gl_state_next.glBlendFuncSeparate = (void *)replace_import(
+        "glBlendFuncSeparate", (uintptr_t)&gl_state_glBlendFuncSeparate);
+    gl_state_next.glDepthMask =
+        (void *)replace_import("glDepthMask", (uintptr_t)&gl_state_glDepthMask);
+    gl_state_next.glDepthFunc =
+        (void *)replace_import("glDepthFunc", (uintptr_t)&gl_state_glDepthFunc);
+    gl_state_next.glCullFace =
+        (void *)replace_import("glCullFace", (uintptr_t)&gl_state_glCullFace);
+    gl_state_next.glFrontFace =
+        (void *)replace_import("glFrontFace", (uintptr_t)&gl_state_glFrontFace);
+    gl_state_next.glBindBuffer = (void *)replace_import(
+        "glBindBuffer", (uintptr_t)&gl_state_glBindBuffer);
+    gl_state_next.glDeleteTextures = (void *)replace_import(
+        "glDeleteTextures", (uintptr_t)&gl_state_glDeleteTextures);
+    gl_state_next.glDeleteBuffers = (void *)replace_import(
+        "glDeleteBuffers", (uintptr_t)&gl_state_glDeleteBuffers);
+    gl_state_invalidate();
+  }
+
+  // compiles and links only what isn't in the program binary cache; under
+  // the uniform cache, which has to see every glLinkProgram the game makes
+  if (config.shader_cache) {
+    shader_cache_next.glCreateShader = (void *)replace_import(
+        "glCreateShader", (uintptr_t)&shader_cache_glCreateShader);
+    shader_cache_next.glCreateProgram = (void *)replace_import(
+        "glCreateProgram", (uintptr_t)&shader_cache_glCreateProgram);
+    shader_cache_next.glShaderSource = (void *)replace_import(
+        "glShaderSource", (uintptr_t)&shader_cache_glShaderSource);
+    shader_cache_next.glCompileShader = (void *)replace_import(
+        "glCompileShader", (uintptr_t)&shader_cache_glCompileShader);
+    shader_cache_next.glGetShaderiv = (void *)replace_import(
+        "glGetShaderiv", (uintptr_t)&shader_cache_glGetShaderiv);
+    shader_cache_next.glGetShaderInfoLog = (void *)replace_import(
+        "glGetShaderInfoLog", (uintptr_t)&shader_cache_glGetShaderInfoLog);
+    shader_cache_next.glAttachShader = (void *)replace_import(
+        "glAttachShader", (uintptr_t)&shader_cache_glAttachShader);
+    shader_cache_next.glBindAttribLocation = (void *)replace_import(
+        "glBindAttribLocation", (uintptr_t)&shader_cache_glBindAttribLocation);
+    shader_cache_next.glLinkProgram = (void *)replace_import(
+        "glLinkProgram", (uintptr_t)&shader_cache_glLinkProgram);
+    // wherever the game may need a shader or program that is still being
+    // compiled or linked in the background
+    if (config.async_shaders) {
+      shader_cache_next.glGetProgramiv = (void *)replace_import(
+          "glGetProgramiv", (uintptr_t)&shader_cache_glGetProgramiv);
+      shader_cache_next.glGetProgramInfoLog = (void *)replace_import(
+          "glGetProgramInfoLog", (uintptr_t)&shader_cache_glGetProgramInfoLog);
+      shader_cache_next.glUseProgram = (void *)replace_import(
+          "glUseProgram", (uintptr_t)&shader_cache_glUseProgram);
+      shader_cache_next.glGetUniformLocation =
+          (void *)replace_import("glGetUniformLocation",
+                                 (uintptr_t)&shader_cache_glGetUniformLocation);
+      shader_cache_next.glGetAttribLocation =
+          (void *)replace_import("glGetAttribLocation",
+                                 (uintptr_t)&shader_cache_glGetAttribLocation);
+      shader_cache_next.glDeleteShader = (void *)replace_import(
+          "glDeleteShader", (uintptr_t)&shader_cache_glDeleteShader);
+      shader_cache_next.glDeleteProgram = (void *)replace_import(
+          "glDeleteProgram", (uintptr_t)&shader_cache_glDeleteProgram);
+    }
+  }
+
+  // above the shader cache so that the lowered sources are what is compiled
+  // and cached, under the recorder so that traces keep the game's own
+  if (config.shader_precision) {
+    shader_precision_next.glShaderSource = (void *)replace_import(
+        "glShaderSource", (uintptr_t)&shader_precision_glShaderSource);
+  }
+
+  // hand-written shaders in place of the game's, found by the hash of the
+  // game's source, so above anything that changes the sources; the
+  // replacements skip the precision pass
+  if (config.shader_overrides) {
+    shader_override_next.glShaderSource = (void *)replace_import(
+        "glShaderSource", (uintptr_t)&shader_override_glShaderSource);
+    shader_override_next.glShaderSourceVerbatim =
+        config.shader_precision ? shader_precision_next.glShaderSource
+                                : shader_override_next.glShaderSource;
+    shader_override_next.glGetShaderiv = (void *)replace_import(
+        "glGetShaderiv", (uintptr_t)&shader_override_glGetShaderiv);
+    shader_override_next.glGetShaderInfoLog =
+        (void *)so_find_import(dynlib_functions, dynlib_numfunctions,
+                               "glGetShaderInfoLog")
+            ->func;
+    shader_override_next.glAttachShader = (void *)replace_import(
+        "glAttachShader", (uintptr_t)&shader_override_glAttachShader);
+    shader_override_next.glGetProgramiv = (void *)replace_import(
+        "glGetProgramiv", (uintptr_t)&shader_override_glGetProgramiv);
+  }
+
+  // skips uniform uploads that repeat the program's current values; on top
+  // of the state cache so that it sees every glUseProgram
+  if (config.gl_uniform_cache) {
+    gl_uniforms_next.glUseProgram = (void *)replace_import(
+        "glUseProgram", (uintptr_t)&gl_uniforms_glUseProgram);
+    gl_uniforms_next.glLinkProgram = (void *)replace_import(
+        "glLinkProgram", (uintptr_t)&gl_uniforms_glLinkProgram);
+    gl_uniforms_next.glDeleteProgram = (void *)replace_import(
+        "glDeleteProgram", (uintptr_t)&gl_uniforms_glDeleteProgram);
+    gl_uniforms_next.glGetUniformLocation = (void *)replace_import(
+        "glGetUniformLocation", (uintptr_t)&gl_uniforms_glGetUniformLocation);
+    gl_uniforms_next.glUniform1f = (void *)replace_import(
+        "glUniform1f", (uintptr_t)&gl_uniforms_glUniform1f);
+    gl_uniforms_next.glUniform1fv = (void *)replace_import(
+        "glUniform1fv", (uintptr_t)&gl_uniforms_glUniform1fv);
+    gl_uniforms_next.glUniform1i = (void *)replace_import(
+        "glUniform1i", (uintptr_t)&gl_uniforms_glUniform1i);
+    gl_uniforms_next.glUniform2fv = (void *)replace_import(
+        "glUniform2fv", (uintptr_t)&gl_uniforms_glUniform2fv);
+    gl_uniforms_next.glUniform3f = (void *)replace_import(
+        "glUniform3f", (uintptr_t)&gl_uniforms_glUniform3f);
+    gl_uniforms_next.glUniform3fv = (void *)replace_import(
+        "glUniform3fv", (uintptr_t)&gl_uniforms_glUniform3fv);
+    gl_uniforms_next.glUniform4fv = (void *)replace_import(
+        "glUniform4fv", (uintptr_t)&gl_uniforms_glUniform4fv);
+    gl_uniforms_next.glUniformMatrix3fv = (void *)replace_import(
+        "glUniformMatrix3fv", (uintptr_t)&gl_uniforms_glUniformMatrix3fv);
+    gl_uniforms_next.glUniformMatrix4fv = (void *)replace_import(
+        "glUniformMatrix4fv", (uintptr_t)&gl_uniforms_glUniformMatrix4fv);
+  }
+
+  // texture uploads on the GL worker; below the layers that change or count
+  // the uploads, so they see them as the game made them
+  if (config.async_textures) {
+    texture_upload_next.glTexImage2D = (void *)replace_import(
+        "glTexImage2D", (uintptr_t)&texture_upload_glTexImage2D);
+    texture_upload_next.glCompressedTexImage2D = (void *)replace_import(
+        "glCompressedTexImage2D",
+        (uintptr_t)&texture_upload_glCompressedTexImage2D);
+    texture_upload_next.glActiveTexture = (void *)replace_import(
+        "glActiveTexture", (uintptr_t)&texture_upload_glActiveTexture);
+    texture_upload_next.glBindTexture = (void *)replace_import(
+        "glBindTexture", (uintptr_t)&texture_upload_glBindTexture);
+    texture_upload_next.glDeleteTextures = (void *)replace_import(
+        "glDeleteTextures", (uintptr_t)&texture_upload_glDeleteTextures);
+    texture_upload_next.glFramebufferTexture2D = (void *)replace_import(
+        "glFramebufferTexture2D",
+        (uintptr_t)&texture_upload_glFramebufferTexture2D);
+    texture_upload_next.glDrawArrays = (void *)replace_import(
+        "glDrawArrays", (uintptr_t)&texture_upload_glDrawArrays);
+    texture_upload_next.glDrawElements = (void *)replace_import(
+        "glDrawElements", (uintptr_t)&texture_upload_glDrawElements);
+  }
+
+  // per-frame draw and texture upload counts for the overlay
+  if (config.perf_hud) {
+    perf_hud_next.glDrawArrays = (void *)replace_import(
+        "glDrawArrays", (uintptr_t)&perf_hud_glDrawArrays);
+    perf_hud_next.glDrawElements = (void *)replace_import(
+        "glDrawElements", (uintptr_t)&perf_hud_glDrawElements);
+    perf_hud_next.glTexImage2D = (void *)replace_import(
+        "glTexImage2D", (uintptr_t)&perf_hud_glTexImage2D);
+    perf_hud_next.glCompressedTexImage2D = (void *)replace_import(
+        "glCompressedTexImage2D", (uintptr_t)&perf_hud_glCompressedTexImage2D);
+  }
+
+  // texture memory, counted in the formats the textures end up in, so below
+  // the transcoding; above the state cache to see every bind
+  if (config.texture_budget > 0) {
+    texture_budget_next.glTexImage2D = (void *)replace_import(
+        "glTexImage2D", (uintptr_t)&texture_budget_glTexImage2D);
+    texture_budget_next.glCompressedTexImage2D = (void *)replace_import(
+        "glCompressedTexImage2D",
+        (uintptr_t)&texture_budget_glCompressedTexImage2D);
+    texture_budget_next.glBindTexture = (void *)replace_import(
+        "glBindTexture", (uintptr_t)&texture_budget_glBindTexture);
+    texture_budget_next.glDeleteTextures = (void *)replace_import(
+        "glDeleteTextures", (uintptr_t)&texture_budget_glDeleteTextures);
+  }
+
+  // the game's RGB and RGBA textures in smaller formats; above the overlay
+  // so that it counts what is uploaded in the end
+  if (config.texture_transcode) {
+    texture_transcode_next.glTexImage2D = (void *)replace_import(
+        "glTexImage2D", (uintptr_t)&texture_transcode_glTexImage2D);
+    texture_transcode_next.glCompressedTexImage2D =
+        (void *)so_find_import(dynlib_functions, dynlib_numfunctions,
+                               "glCompressedTexImage2D")
+            ->func;
+  }
+
+  // the game's own sleeps must not overshoot the paced frame slots
+  if (config.target_fps > 0) {
+    replace_import("usleep", (uintptr_t)&frame_pacing_usleep);
+    replace_import("nanosleep", (uintptr_t)&frame_pacing_nanosleep);
+  }
+
+  // records which archive ranges are read, for the next run's prefetching
+  if (config.readahead) {
+    readahead_next.fopen =
+        (void *)replace_import("fopen", (uintptr_t)&readahead_fopen);
+    readahead_next.fread =
+        (void *)replace_import("fread", (uintptr_t)&readahead_fread);
+    readahead_next.fseek =
+        (void *)replace_import("fseek", (uintptr_t)&readahead_fseek);
+    readahead_next.fclose =
+        (void *)replace_import("fclose", (uintptr_t)&readahead_fclose);
+    readahead_next.ftell =
+        (void *)so_find_import(dynlib_functions, dynlib_numfunctions, "ftell")
+            ->func;
+  }
+
+  // tells the levels in the frame time summary apart
+  if (config.frame_stats) {
+    frame_stats_next.fopen =
+        (void *)replace_import("fopen", (uintptr_t)&frame_stats_fopen);
+    frame_stats_next.fread =
+        (void *)replace_import("fread", (uintptr_t)&frame_stats_fread);
+    frame_stats_next.fclose =
+        (void *)replace_import("fclose", (uintptr_t)&frame_stats_fclose);
+  }
+
+  // outside the GL layers above so that the trace has the calls as the game
+  // makes them and replaying it exercises those layers too
+  if (config.gl_record_frames > 0)
+    gl_recorder_install(replace_import);
+
+  // installed last so that the trace shows the calls as the game makes them,
+  // including the time spent in the wrappers above
+  if (config.io_trace) {
+    iotrace_next.fopen =
+        (void *)replace_import("fopen", (uintptr_t)&iotrace_fopen);
+    iotrace_next.fread =
+        (void *)replace_import("fread", (uintptr_t)&iotrace_fread);
+    iotrace_next.fseek =
+        (void *)replace_import("fseek", (uintptr_t)&iotrace_fseek);
+    iotrace_next.fclose =
+        (void *)replace_import("fclose", (uintptr_t)&iotrace_fclose);
+    iotrace_next.open =
+        (void *)replace_import("open", (uintptr_t)&iotrace_open);
+    iotrace_next.read =
+        (void *)replace_import("read", (uintptr_t)&iotrace_read);
+    iotrace_next.lseek =
+        (void *)replace_import("lseek", (uintptr_t)&iotrace_lseek);
+    iotrace_next.close =
+        (void *)replace_import("close", (uintptr_t)&iotrace_close);
+    iotrace_next.ftell =
+        (void *)so_find_import(dynlib_functions, dynlib_numfunctions, "ftell")
+            ->func;
+    iotrace_start(IOTRACE_NAME);
+  }
 }
@@ -0,0 +1,273 @@
+/* iotrace.c -- binary trace of the game's file accesses
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The traced imports time the call they forward to and then append a fixed
+// size record to a buffer that is written out in 64 KB chunks. Handles are
+// given small ids when they're opened so the records don't have to repeat
+// paths, and the position of each handle is tracked here so reads can be
+// placed in the file without extra ftell/lseek calls.
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "iotrace.h"
+#include "util.h"
+
+#define IOTRACE_BUF_SIZE 0x10000
+#define IOTRACE_MAX_HANDLES 128
+#define IOTRACE_MAX_LABEL 255
+
+typedef struct {
+  uintptr_t handle; // FILE * or fd + 1, 0 if the slot is free
+  int is_fd;
+  uint16_t id;
+  int64_t pos;
+} TracedHandle;
+
+IoTraceNext iotrace_next;
+
+static atomic_int trace_enabled;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *trace_file = NULL;
+static uint8_t trace_buf[IOTRACE_BUF_SIZE];
+static size_t trace_buf_len = 0;
+static uint64_t trace_start_ns = 0;
+static TracedHandle handles[IOTRACE_MAX_HANDLES];
+static uint16_t next_id = 1;
+
+static uint32_t current_tid(void) {
+  static __thread uint32_t tid = 0;
+  if (!tid)
+    tid = syscall(SYS_gettid);
+  return tid;
+}
+
+// caller holds trace_lock
+static void trace_flush_locked(void) {
+  if (trace_file && trace_buf_len) {
+    fwrite(trace_buf, 1, trace_buf_len, trace_file);
+    fflush(trace_file);
+  }
+  trace_buf_len = 0;
+}
+
+// caller holds trace_lock
+static void trace_append_locked(const void *data, size_t len) {
+  if (trace_buf_len + len > sizeof(trace_buf))
+    trace_flush_locked();
+  memcpy(trace_buf + trace_buf_len, data, len);
+  trace_buf_len += len;
+}
+
+// caller holds trace_lock
+static void trace_event_locked(uint8_t type, uint16_t file, int64_t offset,
+                               uint32_t size, uint8_t flags, uint64_t start,
+                               const char *text) {
+  IoTraceEvent ev = {
+      .time_ns = start - trace_start_ns,
+      .offset = offset,
+      .size = size,
+      .duration_ns = (uint32_t)(now_ns() - start),
+      .tid = current_tid(),
+      .file = file,
+      .type = type,
+      .flags = flags,
+  };
+  trace_append_locked(&ev, sizeof(ev));
+  if (text)
+    trace_append_locked(text, size);
+}
+
+// caller holds trace_lock
+static TracedHandle *find_handle(uintptr_t handle, int is_fd) {
+  for (int i = 0; i < IOTRACE_MAX_HANDLES; ++i) {
+    if (handles[i].handle == handle && handles[i].is_fd == is_fd)
+      return &handles[i];
+  }
+  return NULL;
+}
+
+static void trace_open(uintptr_t handle, int is_fd, const char *path,
+                       uint64_t start) {
+  size_t len = strlen(path);
+  if (len > IOTRACE_MAX_LABEL)
+    len = IOTRACE_MAX_LABEL;
+
+  pthread_mutex_lock(&trace_lock);
+  uint16_t id = 0;
+  if (handle) {
+    TracedHandle *h = find_handle(0, 0);
+    // with the table full the handle just stays anonymous
+    if (h) {
+      id = next_id++;
+      if (!next_id)
+        next_id = 1;
+      *h = (TracedHandle){handle, is_fd, id, 0};
+    }
+  }
+  trace_event_locked(IOTRACE_OPEN, id, 0, len, is_fd, start, path);
+  pthread_mutex_unlock(&trace_lock);
+}
+
+static void trace_read(uintptr_t handle, int is_fd, size_t got,
+                       uint64_t start) {
+  pthread_mutex_lock(&trace_lock);
+  TracedHandle *h = find_handle(handle, is_fd);
+  if (h) {
+    trace_event_locked(IOTRACE_READ, h->id, h->pos, got, 0, start, NULL);
+    h->pos += got;
+  }
+  pthread_mutex_unlock(&trace_lock);
+}
+
+static void trace_seek(uintptr_t handle, int is_fd, int64_t pos, int whence,
+                       uint64_t start) {
+  pthread_mutex_lock(&trace_lock);
+  TracedHandle *h = find_handle(handle, is_fd);
+  if (h) {
+    h->pos = pos;
+    trace_event_locked(IOTRACE_SEEK, h->id, pos, 0, whence, start, NULL);
+  }
+  pthread_mutex_unlock(&trace_lock);
+}
+
+static void trace_close(uintptr_t handle, int is_fd, uint64_t start) {
+  pthread_mutex_lock(&trace_lock);
+  TracedHandle *h = find_handle(handle, is_fd);
+  if (h) {
+    trace_event_locked(IOTRACE_CLOSE, h->id, h->pos, 0, 0, start, NULL);
+    h->handle = 0;
+  }
+  pthread_mutex_unlock(&trace_lock);
+}
+
+int iotrace_start(const char *path) {
+  pthread_mutex_lock(&trace_lock);
+  if (!trace_file)
+    trace_file = fopen(path, "wb");
+  if (!trace_file) {
+    pthread_mutex_unlock(&trace_lock);
+    debugPrintf("iotrace: could not open %s\n", path);
+    return -1;
+  }
+  IoTraceHeader hdr = {.version = IOTRACE_VERSION,
+                       .event_size = sizeof(IoTraceEvent)};
+  memcpy(hdr.magic, IOTRACE_MAGIC, sizeof(hdr.magic));
+  trace_append_locked(&hdr, sizeof(hdr));
+  trace_start_ns = now_ns();
+  pthread_mutex_unlock(&trace_lock);
+
+  atomic_store(&trace_enabled, 1);
+  debugPrintf("iotrace: writing file accesses to %s\n", path);
+  return 0;
+}
+
+void iotrace_stop(void) {
+  if (!atomic_exchange(&trace_enabled, 0))
+    return;
+  pthread_mutex_lock(&trace_lock);
+  trace_flush_locked();
+  fclose(trace_file);
+  trace_file = NULL;
+  pthread_mutex_unlock(&trace_lock);
+}
+
+void iotrace_mark(const char *label) {
+  if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+    return;
+  size_t len = strlen(label);
+  if (len > IOTRACE_MAX_LABEL)
+    len = IOTRACE_MAX_LABEL;
+  uint64_t start = now_ns();
+  pthread_mutex_lock(&trace_lock);
+  trace_event_locked(IOTRACE_MARK, 0, 0, len, 0, start, label);
+  // markers are rare, flushing here keeps the trace usable after a crash
+  trace_flush_locked();
+  pthread_mutex_unlock(&trace_lock);
+}
+
+// ---- traced imports ----
+
+FILE *iotrace_fopen(const char *filename, const char *mode) {
+  uint64_t start = now_ns();
+  FILE *f = iotrace_next.fopen(filename, mode);
+  if (atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+    trace_open((uintptr_t)f, 0, filename, start);
+  return f;
+}
+
+size_t iotrace_fread(void *ptr, size_t size, size_t nmemb, FILE *f) {
+  uint64_t start = now_ns();
+  size_t ret = iotrace_next.fread(ptr, size, nmemb, f);
+  if (atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+    trace_read((uintptr_t)f, 0, ret * size, start);
+  return ret;
+}
+
+int iotrace_fseek(FILE *f, long offset, int whence) {
+  uint64_t start = now_ns();
+  int ret = iotrace_next.fseek(f, offset, whence);
+  if (ret == 0 && atomic_load_explicit(&trace_enabled, memory_order_relaxed)) {
+    // SEEK_SET is by far the most common, only ask for the others
+    long pos = whence == SEEK_SET ? offset : iotrace_next.ftell(f);
+    trace_seek((uintptr_t)f, 0, pos, whence, start);
+  }
+  return ret;
+}
+
+int iotrace_fclose(FILE *f) {
+  uint64_t start = now_ns();
+  if (atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+    trace_close((uintptr_t)f, 0, start);
+  return iotrace_next.fclose(f);
+}
+
+int iotrace_open(const char *pathname, int flags, ...) {
+  mode_t mode = 0;
+  if (flags & O_CREAT) {
+    va_list list;
+    va_start(list, flags);
+    mode = va_arg(list, int);
+    va_end(list);
+  }
+  uint64_t start = now_ns();
+  int fd = iotrace_next.open(pathname, flags, mode);
+  if (atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+    trace_open(fd >= 0 ? (uintptr_t)fd + 1 : 0, 1, pathname, start);
+  return fd;
+}
+
+ssize_t iotrace_read(int fd, void *buf, size_t count) {
+  uint64_t start = now_ns();
+  ssize_t ret = iotrace_next.read(fd, buf, count);
+  if (ret >= 0 && atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+    trace_read((uintptr_t)fd + 1, 1, ret, start);
+  return ret;
+}
+
+off_t iotrace_lseek(int fd, off_t offset, int whence) {
+  uint64_t start = now_ns();
+  off_t ret = iotrace_next.lseek(fd, offset, whence);
+  if (ret >= 0 && atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+    trace_seek((uintptr_t)fd + 1, 1, ret, whence, start);
+  return ret;
+}
+
+int iotrace_close(int fd) {
+  uint64_t start = now_ns();
+  if (atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+    trace_close((uintptr_t)fd + 1, 1, start);
+  return iotrace_next.close(fd);
+}
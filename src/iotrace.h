@@ -0,0 +1,78 @@
+/* iotrace.h -- binary trace of the game's file accesses
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef IOTRACE_H
+#define IOTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#define IOTRACE_NAME "iotrace.bin"
+#define IOTRACE_MAGIC "MPIOTRC1"
+#define IOTRACE_VERSION 1
+
+// file layout: IoTraceHeader followed by IoTraceEvents; open and mark events
+// are followed by `size` bytes of path/label text without a terminator.
+// scripts/analyze_iotrace.py reads this format.
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t event_size;
+} IoTraceHeader;
+
+enum {
+  IOTRACE_OPEN = 1,  // file = new id (0 if the open failed)
+  IOTRACE_READ = 2,  // offset = position before the read, size = bytes read
+  IOTRACE_SEEK = 3,  // offset = resulting position, flags = whence
+  IOTRACE_CLOSE = 4,
+  IOTRACE_MARK = 5, // label, e.g. a level transition
+};
+
+typedef struct {
+  uint64_t time_ns; // start of the call, relative to the start of the trace
+  int64_t offset;
+  uint32_t size;
+  uint32_t duration_ns; // time spent inside the call
+  uint32_t tid;
+  uint16_t file;
+  uint8_t type;
+  uint8_t flags;
+} IoTraceEvent;
+
+// functions the traced imports forward to, filled in by update_imports
+typedef struct {
+  FILE *(*fopen)(const char *, const char *);
+  size_t (*fread)(void *, size_t, size_t, FILE *);
+  int (*fseek)(FILE *, long, int);
+  long (*ftell)(FILE *);
+  int (*fclose)(FILE *);
+  int (*open)(const char *, int, ...);
+  ssize_t (*read)(int, void *, size_t);
+  off_t (*lseek)(int, off_t, int);
+  int (*close)(int);
+} IoTraceNext;
+
+extern IoTraceNext iotrace_next;
+
+int iotrace_start(const char *path);
+void iotrace_stop(void);
+// adds a labelled marker; a no-op when tracing is off
+void iotrace_mark(const char *label);
+
+FILE *iotrace_fopen(const char *filename, const char *mode);
+size_t iotrace_fread(void *ptr, size_t size, size_t nmemb, FILE *f);
+int iotrace_fseek(FILE *f, long offset, int whence);
+int iotrace_fclose(FILE *f);
+int iotrace_open(const char *pathname, int flags, ...);
+ssize_t iotrace_read(int fd, void *buf, size_t count);
+off_t iotrace_lseek(int fd, off_t offset, int whence);
+int iotrace_close(int fd);
+
+#endif // IOTRACE_H
@@ -0,0 +1,285 @@
+/* log.c -- asynchronous debug log
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Messages are formatted on the calling thread and pushed into a bounded
+// multi-producer ring (Vyukov style, one sequence number per slot). A single
+// writer thread keeps the log file open and drains the ring in batches, so
+// logging never does file I/O on the game threads. Messages longer than a
+// slot occupy several consecutive slots that are claimed in one CAS.
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "config.h"
+#include "log.h"
+
+#define LOG_SLOT_DATA 248
+#define LOG_NUM_SLOTS 1024 // must be a power of two
+#define LOG_FORMAT_BUF 1024
+#define LOG_IDLE_WAIT_MS 100
+
+typedef struct {
+  atomic_size_t seq;
+  uint16_t len;
+  char data[LOG_SLOT_DATA];
+} LogSlot;
+
+uint8_t log_levels[LOG_SYS_COUNT] = {
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO,
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO,
+};
+
+static const char *const log_sys_names[LOG_SYS_COUNT] = {
+    "core", "game", "gl", "al", "io", "input", "video",
+};
+
+static const char *const log_level_names[] = {
+    "error", "warn", "info", "debug", "trace",
+};
+
+static LogSlot log_ring[LOG_NUM_SLOTS];
+static atomic_size_t log_write_pos;
+static size_t log_read_pos; // only touched with log_consumer_lock held
+static atomic_uint log_dropped;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t log_consumer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t log_thread;
+static int log_thread_running = 0;
+static atomic_int log_writer_idle;
+static atomic_int log_stop;
+static sem_t log_wake;
+static FILE *log_file = NULL;
+
+void log_set_levels(const char *spec) {
+  char buf[0x100];
+  strncpy(buf, spec, sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = '\0';
+
+  char *save = NULL;
+  for (char *tok = strtok_r(buf, ", ", &save); tok;
+       tok = strtok_r(NULL, ", ", &save)) {
+    char *eq = strchr(tok, '=');
+    if (!eq)
+      continue;
+    *eq = '\0';
+    for (int s = 0; s < LOG_SYS_COUNT; ++s) {
+      if (strcasecmp(tok, log_sys_names[s]) && strcmp(tok, "all"))
+        continue;
+      for (int l = 0; l <= LOG_LEVEL_TRACE; ++l) {
+        if (!strcasecmp(eq + 1, log_level_names[l]))
+          log_levels[s] = l;
+      }
+    }
+  }
+}
+
+static void log_write(const char *data, size_t len) {
+  if (log_file)
+    fwrite(data, 1, len, log_file);
+  fwrite(data, 1, len, stdout);
+}
+
+// drains everything that has been committed; caller holds the consumer lock
+static int log_drain(void) {
+  int count = 0;
+  for (;;) {
+    LogSlot *slot = &log_ring[log_read_pos & (LOG_NUM_SLOTS - 1)];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq != log_read_pos + 1)
+      break;
+    log_write(slot->data, slot->len);
+    atomic_store_explicit(&slot->seq, log_read_pos + LOG_NUM_SLOTS,
+                          memory_order_release);
+    log_read_pos++;
+    count++;
+  }
+
+  unsigned int dropped = atomic_exchange(&log_dropped, 0);
+  if (dropped) {
+    char msg[64];
+    int len = snprintf(msg, sizeof(msg), "log: %u messages dropped\n", dropped);
+    log_write(msg, len);
+  }
+
+  if (count) {
+    if (log_file)
+      fflush(log_file);
+    fflush(stdout);
+  }
+  return count;
+}
+
+static void *log_thread_main(void *arg) {
+  (void)arg;
+  while (!atomic_load(&log_stop)) {
+    pthread_mutex_lock(&log_consumer_lock);
+    int count = log_drain();
+    pthread_mutex_unlock(&log_consumer_lock);
+    if (count)
+      continue;
+
+    // announce that we're about to sleep, then check once more so that a
+    // message committed in between isn't left waiting for the timeout
+    atomic_store(&log_writer_idle, 1);
+    LogSlot *slot = &log_ring[log_read_pos & (LOG_NUM_SLOTS - 1)];
+    if (atomic_load(&slot->seq) == log_read_pos + 1) {
+      atomic_store(&log_writer_idle, 0);
+      continue;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += LOG_IDLE_WAIT_MS * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait(&log_wake, &ts) < 0 && errno == EINTR)
+      ;
+    atomic_store(&log_writer_idle, 0);
+  }
+  return NULL;
+}
+
+static void log_init(void) {
+  for (size_t i = 0; i < LOG_NUM_SLOTS; ++i)
+    atomic_init(&log_ring[i].seq, i);
+
+  log_file = fopen(LOG_NAME, "a");
+  if (log_file)
+    setvbuf(log_file, NULL, _IOFBF, 0x10000);
+
+  sem_init(&log_wake, 0, 0);
+  if (pthread_create(&log_thread, NULL, log_thread_main, NULL) == 0) {
+    log_thread_running = 1;
+    atexit(log_shutdown);
+  }
+}
+
+static void log_push(const char *msg, size_t len) {
+  size_t nslots = len ? (len + LOG_SLOT_DATA - 1) / LOG_SLOT_DATA : 1;
+  if (nslots > LOG_NUM_SLOTS / 4) {
+    nslots = LOG_NUM_SLOTS / 4;
+    len = nslots * LOG_SLOT_DATA;
+  }
+
+  // claim nslots consecutive slots; the consumer frees slots in order so the
+  // whole range is free if its last slot is
+  size_t pos = atomic_load_explicit(&log_write_pos, memory_order_relaxed);
+  for (;;) {
+    LogSlot *last = &log_ring[(pos + nslots - 1) & (LOG_NUM_SLOTS - 1)];
+    size_t seq = atomic_load_explicit(&last->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + nslots - 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&log_write_pos, &pos,
+                                                pos + nslots,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      // ring is full; never block the caller
+      atomic_fetch_add(&log_dropped, 1);
+      return;
+    } else {
+      pos = atomic_load_explicit(&log_write_pos, memory_order_relaxed);
+    }
+  }
+
+  for (size_t i = 0; i < nslots; ++i) {
+    LogSlot *slot = &log_ring[(pos + i) & (LOG_NUM_SLOTS - 1)];
+    size_t chunk = len > LOG_SLOT_DATA ? LOG_SLOT_DATA : len;
+    memcpy(slot->data, msg, chunk);
+    slot->len = chunk;
+    msg += chunk;
+    len -= chunk;
+  }
+  // publish in order so the consumer never sees a partial message tail
+  for (size_t i = 0; i < nslots; ++i) {
+    LogSlot *slot = &log_ring[(pos + i) & (LOG_NUM_SLOTS - 1)];
+    atomic_store_explicit(&slot->seq, pos + i + 1, memory_order_release);
+  }
+
+  if (atomic_load_explicit(&log_writer_idle, memory_order_relaxed) &&
+      atomic_exchange(&log_writer_idle, 0))
+    sem_post(&log_wake);
+}
+
+void log_vprintf(LogSubsystem sys, LogLevel level, const char *fmt,
+                 va_list list) {
+  (void)sys;
+  (void)level;
+  pthread_once(&log_once, log_init);
+
+  char buf[LOG_FORMAT_BUF];
+  va_list copy;
+  va_copy(copy, list);
+  int len = vsnprintf(buf, sizeof(buf), fmt, list);
+  if (len < 0) {
+    va_end(copy);
+    return;
+  }
+
+  if ((size_t)len < sizeof(buf)) {
+    log_push(buf, len);
+  } else {
+    char *big = malloc(len + 1);
+    if (big) {
+      vsnprintf(big, len + 1, fmt, copy);
+      log_push(big, len);
+      free(big);
+    } else {
+      log_push(buf, sizeof(buf) - 1);
+    }
+  }
+  va_end(copy);
+
+  if (!log_thread_running)
+    log_flush();
+}
+
+void log_printf(LogSubsystem sys, LogLevel level, const char *fmt, ...) {
+  va_list list;
+  va_start(list, fmt);
+  log_vprintf(sys, level, fmt, list);
+  va_end(list);
+}
+
+void log_flush(void) {
+  // trylock so that a crash on the writer thread itself can't deadlock here
+  for (int i = 0; i < 100; ++i) {
+    if (pthread_mutex_trylock(&log_consumer_lock) == 0) {
+      log_drain();
+      pthread_mutex_unlock(&log_consumer_lock);
+      return;
+    }
+    struct timespec ts = {0, 1000000L};
+    nanosleep(&ts, NULL);
+  }
+}
+
+void log_shutdown(void) {
+  if (log_thread_running) {
+    atomic_store(&log_stop, 1);
+    sem_post(&log_wake);
+    pthread_join(log_thread, NULL);
+    log_thread_running = 0;
+  }
+  log_flush();
+  if (log_file) {
+    fclose(log_file);
+    log_file = NULL;
+  }
+}
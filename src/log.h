@@ -0,0 +1,65 @@
+/* log.h -- asynchronous debug log
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <stdarg.h>
+#include <stdint.h>
+
+typedef enum {
+  LOG_LEVEL_ERROR,
+  LOG_LEVEL_WARN,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_DEBUG,
+  LOG_LEVEL_TRACE,
+} LogLevel;
+
+typedef enum {
+  LOG_SYS_CORE,  // wrapper itself
+  LOG_SYS_GAME,  // the game's own printf/android log output
+  LOG_SYS_GL,
+  LOG_SYS_AL,
+  LOG_SYS_IO,
+  LOG_SYS_INPUT,
+  LOG_SYS_VIDEO,
+  LOG_SYS_COUNT
+} LogSubsystem;
+
+// levels above this are compiled out entirely
+#ifndef LOG_MAX_LEVEL
+#ifdef DEBUG
+#define LOG_MAX_LEVEL LOG_LEVEL_TRACE
+#else
+#define LOG_MAX_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// runtime level per subsystem, set from the log_levels config option
+extern uint8_t log_levels[LOG_SYS_COUNT];
+
+#define LOG_PRINTF(sys, level, ...)                                            \
+  do {                                                                         \
+    if ((level) <= LOG_MAX_LEVEL && (level) <= log_levels[(sys)])              \
+      log_printf((sys), (level), __VA_ARGS__);                                 \
+  } while (0)
+
+// parses "sys=level,sys=level", e.g. "game=warn,io=debug"
+void log_set_levels(const char *spec);
+
+// queues the message for the writer thread; never blocks on file I/O
+void log_printf(LogSubsystem sys, LogLevel level, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+void log_vprintf(LogSubsystem sys, LogLevel level, const char *fmt,
+                 va_list list);
+
+// writes out everything queued so far; safe to call from a crash handler
+void log_flush(void);
+void log_shutdown(void);
+
+#endif
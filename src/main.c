@@ -19,9 +19,14 @@
 
 #include "config.h"
 #include "error.h"
+#include "frame_pacing.h"
 #include "gamedata_mapping.h"
 #include "hooks.h"
+#include "import_stats.h"
 #include "imports.h"
+#include "log.h"
+#include "mmap_stream.h"
+#include "readahead.h"
 #include "so_util.h"
 #include "util.h"
 #include "videoplayer.h"
@@ -68,12 +73,8 @@ static void check_data(void) {
     files[numfiles++] = config.mod_file;
   // check if all the required files are present
   for (unsigned int i = 0; i < numfiles; ++i) {
-    const char *file = gamedata_mapping_get(files[i]);
-    if (!file) {
-      file = files[i];
-    }
-    if (stat(file, &st) < 0) {
-      fatal_error("Could not find\n%s.\nCheck your data files.", file);
+    if (gamedata_mapping_stat(files[i], &st) < 0) {
+      fatal_error("Could not find\n%s.\nCheck your data files.", files[i]);
       break;
     }
   }
@@ -125,6 +126,9 @@ int main(void) {
   // missing
   if (read_config(CONFIG_NAME) < 0)
     write_config(CONFIG_NAME);
+  log_set_levels(config.log_levels);
+  if (config.target_fps > 0)
+    frame_pacing_init();
   // debugPrintf("Config loaded.\n");
 
   // debugPrintf("Checking system calls...\n");
@@ -138,6 +142,14 @@ int main(void) {
   debugPrintf("Checking data files...\n");
   check_data();
 
+  if (config.readahead)
+    readahead_init();
+
+  if (config.mmap_gamedata > 1) {
+    const char *archive = gamedata_mapping_get("gamedata/x_data.ras");
+    mmap_stream_benchmark(archive ? archive : "gamedata/x_data.ras");
+  }
+
   // debugPrintf("heap size = %u KB\n", MEMORY_MB * 1024);
   // debugPrintf(" lib base = %p\n", heap_so_base);
   // debugPrintf("  lib max = %u KB\n", heap_so_limit / 1024);
@@ -167,7 +179,10 @@ int main(void) {
   // debugPrintf("Relocating and resolving...\n");
   // debugPrintf("Relocating and resolving...\n");
   so_relocate();
-  so_resolve(dynlib_functions, dynlib_numfunctions, 1);
+  so_resolve(dynlib_functions, dynlib_numfunctions, 1,
+             config.import_stats ? import_stats_bind : NULL);
+  if (config.import_stats)
+    import_stats_finalize();
 
   // Make text segment writable for patching
   // debugPrintf("Making text segment writable for patching...\n");
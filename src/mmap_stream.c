@@ -0,0 +1,328 @@
+/* mmap_stream.c -- read-only FILE streams backed by a file mapping
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// glibc routes fread on cookie streams through a generic path that either
+// reads one byte per callback (unbuffered) or copies through the stdio buffer,
+// so the read/seek imports are wrapped as well: for streams opened here they
+// become a single memcpy out of the mapping and pointer arithmetic. The
+// fopencookie FILE keeps any other stdio call on the handle well defined.
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mmap_stream.h"
+#include "util.h"
+
+typedef struct {
+  FILE *file;
+  const uint8_t *base;
+  size_t size;
+  size_t pos;
+  int eof;
+} MmapStream;
+
+// the game keeps only a handful of archives open at a time, so a linear scan
+// is cheaper than hashing on every fread
+static _Atomic(MmapStream *) open_streams[MMAP_STREAM_MAX_OPEN];
+
+static MmapStream *mmap_stream_lookup(FILE *f) {
+  for (int i = 0; i < MMAP_STREAM_MAX_OPEN; ++i) {
+    MmapStream *s = atomic_load_explicit(&open_streams[i], memory_order_acquire);
+    if (s && s->file == f)
+      return s;
+  }
+  return NULL;
+}
+
+static int mmap_stream_register(MmapStream *s) {
+  for (int i = 0; i < MMAP_STREAM_MAX_OPEN; ++i) {
+    MmapStream *expected = NULL;
+    if (atomic_compare_exchange_strong(&open_streams[i], &expected, s))
+      return 0;
+  }
+  return -1;
+}
+
+static void mmap_stream_unregister(MmapStream *s) {
+  for (int i = 0; i < MMAP_STREAM_MAX_OPEN; ++i) {
+    MmapStream *expected = s;
+    if (atomic_compare_exchange_strong(&open_streams[i], &expected, NULL))
+      return;
+  }
+}
+
+// cookie callbacks, only reached by stdio calls that aren't wrapped below
+
+static ssize_t mmap_stream_read(void *cookie, char *buf, size_t size) {
+  MmapStream *s = cookie;
+  if (s->pos >= s->size)
+    return 0;
+  size_t left = s->size - s->pos;
+  if (size > left)
+    size = left;
+  memcpy(buf, s->base + s->pos, size);
+  s->pos += size;
+  return size;
+}
+
+static int mmap_stream_seek_to(MmapStream *s, int64_t offset, int whence) {
+  int64_t pos;
+  switch (whence) {
+  case SEEK_SET:
+    pos = offset;
+    break;
+  case SEEK_CUR:
+    pos = (int64_t)s->pos + offset;
+    break;
+  case SEEK_END:
+    pos = (int64_t)s->size + offset;
+    break;
+  default:
+    return -1;
+  }
+  if (pos < 0)
+    return -1;
+  // seeking past the end is allowed, reads there just return EOF
+  s->pos = pos;
+  s->eof = 0;
+  return 0;
+}
+
+static int mmap_stream_seek(void *cookie, off64_t *offset, int whence) {
+  MmapStream *s = cookie;
+  if (mmap_stream_seek_to(s, *offset, whence) < 0)
+    return -1;
+  *offset = s->pos;
+  return 0;
+}
+
+static int mmap_stream_close(void *cookie) {
+  MmapStream *s = cookie;
+  munmap((void *)s->base, s->size);
+  free(s);
+  return 0;
+}
+
+FILE *mmap_stream_open(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+      st.st_size < MMAP_STREAM_MIN_SIZE) {
+    close(fd);
+    return NULL;
+  }
+
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  MmapStream *s = calloc(1, sizeof(*s));
+  if (!s) {
+    munmap(base, st.st_size);
+    return NULL;
+  }
+  s->base = base;
+  s->size = st.st_size;
+
+  cookie_io_functions_t funcs = {
+      .read = mmap_stream_read,
+      .write = NULL,
+      .seek = mmap_stream_seek,
+      .close = mmap_stream_close,
+  };
+  s->file = fopencookie(s, "rb", funcs);
+  if (!s->file) {
+    mmap_stream_close(s);
+    return NULL;
+  }
+  if (mmap_stream_register(s) < 0) {
+    // too many open; a plain stream is still correct
+    fclose(s->file);
+    return NULL;
+  }
+  return s->file;
+}
+
+// ---- stdio import wrappers ----
+
+size_t mmap_stream_fread(void *ptr, size_t size, size_t nmemb, FILE *f) {
+  MmapStream *s = mmap_stream_lookup(f);
+  if (!s)
+    return fread(ptr, size, nmemb, f);
+  if (size == 0 || nmemb == 0)
+    return 0;
+
+  size_t want = size * nmemb;
+  size_t left = s->pos < s->size ? s->size - s->pos : 0;
+  size_t got = want < left ? want : left;
+  memcpy(ptr, s->base + s->pos, got);
+  s->pos += got;
+  if (got < want)
+    s->eof = 1;
+  return got / size;
+}
+
+int mmap_stream_fseek(FILE *f, long offset, int whence) {
+  MmapStream *s = mmap_stream_lookup(f);
+  if (!s)
+    return fseek(f, offset, whence);
+  return mmap_stream_seek_to(s, offset, whence);
+}
+
+long mmap_stream_ftell(FILE *f) {
+  MmapStream *s = mmap_stream_lookup(f);
+  if (!s)
+    return ftell(f);
+  return (long)s->pos;
+}
+
+int mmap_stream_feof(FILE *f) {
+  MmapStream *s = mmap_stream_lookup(f);
+  if (!s)
+    return feof(f);
+  return s->eof;
+}
+
+int mmap_stream_ferror(FILE *f) {
+  MmapStream *s = mmap_stream_lookup(f);
+  if (!s)
+    return ferror(f);
+  return 0;
+}
+
+int mmap_stream_fgetc(FILE *f) {
+  MmapStream *s = mmap_stream_lookup(f);
+  if (!s)
+    return fgetc(f);
+  if (s->pos >= s->size) {
+    s->eof = 1;
+    return EOF;
+  }
+  return s->base[s->pos++];
+}
+
+char *mmap_stream_fgets(char *str, int n, FILE *f) {
+  MmapStream *s = mmap_stream_lookup(f);
+  if (!s)
+    return fgets(str, n, f);
+  if (n <= 0)
+    return NULL;
+
+  int i = 0;
+  while (i < n - 1) {
+    if (s->pos >= s->size) {
+      s->eof = 1;
+      break;
+    }
+    char c = s->base[s->pos++];
+    str[i++] = c;
+    if (c == '\n')
+      break;
+  }
+  if (i == 0)
+    return NULL;
+  str[i] = '\0';
+  return str;
+}
+
+int mmap_stream_fclose(FILE *f) {
+  MmapStream *s = mmap_stream_lookup(f);
+  if (s)
+    mmap_stream_unregister(s);
+  // for mapped streams this ends up in mmap_stream_close
+  return fclose(f);
+}
+
+// ---- benchmark ----
+
+#define BENCH_OPS 20000
+#define BENCH_MAX_READ (256 * 1024)
+
+typedef struct {
+  long offset; // -1 to continue from the current position
+  size_t size;
+} BenchOp;
+
+// mimics how the engine walks an archive: seek to an entry, read a small
+// header and then the payload, sometimes followed by the adjacent entries
+static void make_ops(BenchOp *ops, long file_size) {
+  uint32_t rng = 0x12345678;
+  for (int i = 0; i < BENCH_OPS;) {
+    rng = rng * 1664525u + 1013904223u;
+    long entry = (long)((uint64_t)rng * (file_size - BENCH_MAX_READ) >> 32);
+    ops[i++] = (BenchOp){entry, 16 + (rng >> 28) * 4};
+    for (int j = 0; j < 1 + (int)((rng >> 8) & 3) && i < BENCH_OPS; ++j) {
+      rng = rng * 1664525u + 1013904223u;
+      size_t size = (rng >> 16) % 4 == 0 ? 32 * 1024 + (rng >> 18) % 224 * 1024
+                                         : 256 + (rng >> 20) % 3840;
+      ops[i++] = (BenchOp){-1, size};
+    }
+  }
+}
+
+// both variants go through the wrappers like the game's calls do
+static double replay(FILE *f, const BenchOp *ops, void *buf, size_t *total) {
+  double start = now_ms();
+  *total = 0;
+  for (int i = 0; i < BENCH_OPS; ++i) {
+    if (ops[i].offset >= 0)
+      mmap_stream_fseek(f, ops[i].offset, SEEK_SET);
+    *total += mmap_stream_fread(buf, 1, ops[i].size, f);
+  }
+  return now_ms() - start;
+}
+
+void mmap_stream_benchmark(const char *path) {
+  struct stat st;
+  if (stat(path, &st) < 0 || st.st_size < 2 * BENCH_MAX_READ) {
+    debugPrintf("mmap_stream: can't benchmark %s\n", path);
+    return;
+  }
+
+  BenchOp *ops = malloc(sizeof(*ops) * BENCH_OPS);
+  void *buf = malloc(BENCH_MAX_READ);
+  if (!ops || !buf) {
+    free(ops);
+    free(buf);
+    return;
+  }
+  make_ops(ops, st.st_size);
+
+  // first pass warms the page cache so both variants read from memory and
+  // the numbers show the per-call overhead rather than the SD card
+  for (int pass = 0; pass < 2; ++pass) {
+    size_t stdio_bytes = 0, mmap_bytes = 0;
+    FILE *f = fopen(path, "rb");
+    double stdio_ms = f ? replay(f, ops, buf, &stdio_bytes) : 0.0;
+    if (f)
+      fclose(f);
+    f = mmap_stream_open(path);
+    double mmap_ms = f ? replay(f, ops, buf, &mmap_bytes) : 0.0;
+    if (f)
+      mmap_stream_fclose(f);
+    debugPrintf("mmap_stream: %s pass %d, %d ops: stdio %.1f ms (%zu bytes), "
+                "mmap %.1f ms (%zu bytes)\n",
+                path, pass, BENCH_OPS, stdio_ms, stdio_bytes, mmap_ms,
+                mmap_bytes);
+  }
+
+  free(ops);
+  free(buf);
+}
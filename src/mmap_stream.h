@@ -0,0 +1,37 @@
+/* mmap_stream.h -- read-only FILE streams backed by a file mapping
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef MMAP_STREAM_H
+#define MMAP_STREAM_H
+
+#include <stdio.h>
+
+// files smaller than this aren't worth a mapping
+#define MMAP_STREAM_MIN_SIZE (64 * 1024)
+#define MMAP_STREAM_MAX_OPEN 32
+
+// returns NULL if the file can't or shouldn't be mapped; the caller should
+// fall back to a regular fopen in that case
+FILE *mmap_stream_open(const char *path);
+
+// replacements for the stdio imports; these fall through to libc for
+// streams that weren't opened with mmap_stream_open
+size_t mmap_stream_fread(void *ptr, size_t size, size_t nmemb, FILE *f);
+int mmap_stream_fseek(FILE *f, long offset, int whence);
+long mmap_stream_ftell(FILE *f);
+int mmap_stream_feof(FILE *f);
+int mmap_stream_ferror(FILE *f);
+int mmap_stream_fgetc(FILE *f);
+char *mmap_stream_fgets(char *str, int n, FILE *f);
+int mmap_stream_fclose(FILE *f);
+
+// replays archive style read patterns on path through stdio and through a
+// mapped stream and logs the timings
+void mmap_stream_benchmark(const char *path);
+
+#endif // MMAP_STREAM_H
@@ -0,0 +1,472 @@
+/* perf_hud.c -- performance overlay drawn at swap
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Draws frame rate, a frame time graph, per-frame GL counts and CPU load in
+// the top left corner. Everything is one glDrawArrays of textured quads: the
+// text comes from a 5x7 font in a small alpha texture, and solid quads use a
+// white texel in the same texture. The numbers are averaged over
+// PERF_HUD_UPDATE_MS so they can be read.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "gl_overlay.h"
+#include "gl_state.h"
+#include "gl_uniforms.h"
+#include "perf_hud.h"
+#include "render_scale.h"
+#include "texture_budget.h"
+#include "util.h"
+#include "vertex_stream.h"
+
+#define GLYPH_W 5
+#define GLYPH_H 7
+#define FIRST_GLYPH ' '
+#define NUM_GLYPHS 64
+#define FONT_TEX_W 512
+#define FONT_TEX_H 8
+#define SOLID_X (NUM_GLYPHS * (GLYPH_W + 1)) // a white area after the glyphs
+#define HUD_LINES 9 // lines of text above the graph
+
+// classic 5x7 font for ' ' to '_', one byte per column, bit 0 at the top
+static const unsigned char font[NUM_GLYPHS][GLYPH_W] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5f, 0x00, 0x00},
+    {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7f, 0x14, 0x7f, 0x14},
+    {0x24, 0x2a, 0x7f, 0x2a, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},
+    {0x00, 0x1c, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1c, 0x00},
+    {0x14, 0x08, 0x3e, 0x08, 0x14}, {0x08, 0x08, 0x3e, 0x08, 0x08},
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08},
+    {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},
+    {0x3e, 0x51, 0x49, 0x45, 0x3e}, {0x00, 0x42, 0x7f, 0x40, 0x00},
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4b, 0x31},
+    {0x18, 0x14, 0x12, 0x7f, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39},
+    {0x3c, 0x4a, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1e},
+    {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06},
+    {0x32, 0x49, 0x79, 0x41, 0x3e}, {0x7e, 0x11, 0x11, 0x11, 0x7e},
+    {0x7f, 0x49, 0x49, 0x49, 0x36}, {0x3e, 0x41, 0x41, 0x41, 0x22},
+    {0x7f, 0x41, 0x41, 0x22, 0x1c}, {0x7f, 0x49, 0x49, 0x49, 0x41},
+    {0x7f, 0x09, 0x09, 0x09, 0x01}, {0x3e, 0x41, 0x49, 0x49, 0x7a},
+    {0x7f, 0x08, 0x08, 0x08, 0x7f}, {0x00, 0x41, 0x7f, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3f, 0x01}, {0x7f, 0x08, 0x14, 0x22, 0x41},
+    {0x7f, 0x40, 0x40, 0x40, 0x40}, {0x7f, 0x02, 0x0c, 0x02, 0x7f},
+    {0x7f, 0x04, 0x08, 0x10, 0x7f}, {0x3e, 0x41, 0x41, 0x41, 0x3e},
+    {0x7f, 0x09, 0x09, 0x09, 0x06}, {0x3e, 0x41, 0x51, 0x21, 0x5e},
+    {0x7f, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},
+    {0x01, 0x01, 0x7f, 0x01, 0x01}, {0x3f, 0x40, 0x40, 0x40, 0x3f},
+    {0x1f, 0x20, 0x40, 0x20, 0x1f}, {0x3f, 0x40, 0x38, 0x40, 0x3f},
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x07, 0x08, 0x70, 0x08, 0x07},
+    {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7f, 0x41, 0x41, 0x00},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7f, 0x00},
+    {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},
+};
+
+static const char *const vertex_shader =
+    "attribute vec2 pos;\n"
+    "attribute vec2 uv;\n"
+    "attribute vec4 color;\n"
+    "varying vec2 v_uv;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  v_uv = uv;\n"
+    "  v_color = color;\n"
+    "  gl_Position = vec4(pos, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *const fragment_shader =
+    "precision mediump float;\n"
+    "uniform sampler2D tex;\n"
+    "varying vec2 v_uv;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(v_color.rgb, v_color.a * texture2D(tex, v_uv).a);\n"
+    "}\n";
+
+typedef struct {
+  float x, y, u, v;
+  unsigned char color[4];
+} Vertex;
+
+PerfHudNext perf_hud_next;
+
+// counts of the current frame
+static unsigned int draws = 0;
+static unsigned int uploads = 0;
+static unsigned long upload_bytes = 0;
+
+// sums over the current update window
+static struct {
+  unsigned int frames;
+  unsigned long draws, uploads, upload_bytes, stream_bytes;
+  unsigned long state_calls, state_skipped;
+  unsigned long uniform_calls, uniform_skipped;
+  double hud_ms;
+  uint64_t start_ns;
+  long cpu_ticks, all_busy, all_total;
+} window;
+
+// what is shown until the next update
+static struct {
+  float fps, frame_ms, hud_ms;
+  float draws, uploads, upload_kb, stream_kb;
+  float state_calls, state_skipped;
+  float uniform_calls, uniform_skipped;
+  int cpu_percent, all_percent;
+} shown;
+
+static float frame_times[PERF_HUD_GRAPH_FRAMES];
+static int frame_index = 0;
+static uint64_t last_frame_ns = 0;
+
+static GLuint program = 0, font_texture = 0;
+static Vertex vertices[PERF_HUD_MAX_QUADS * 6];
+static int num_vertices;
+static float pixel_w, pixel_h; // size of one screen pixel in clip space
+
+void perf_hud_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  draws++;
+  perf_hud_next.glDrawArrays(mode, first, count);
+}
+
+void perf_hud_glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                             const void *indices) {
+  draws++;
+  perf_hud_next.glDrawElements(mode, count, type, indices);
+}
+
+void perf_hud_glTexImage2D(GLenum target, GLint level, GLint internalformat,
+                           GLsizei width, GLsizei height, GLint border,
+                           GLenum format, GLenum type, const void *pixels) {
+  if (pixels) {
+    int bpp = type != GL_UNSIGNED_BYTE ? 2
+              : format == GL_RGBA      ? 4
+              : format == GL_RGB       ? 3
+              : format == GL_LUMINANCE_ALPHA ? 2
+                                             : 1;
+    uploads++;
+    upload_bytes += (unsigned long)width * height * bpp;
+  }
+  perf_hud_next.glTexImage2D(target, level, internalformat, width, height,
+                             border, format, type, pixels);
+}
+
+void perf_hud_glCompressedTexImage2D(GLenum target, GLint level,
+                                     GLenum internalformat, GLsizei width,
+                                     GLsizei height, GLint border,
+                                     GLsizei imageSize, const void *data) {
+  uploads++;
+  upload_bytes += imageSize;
+  perf_hud_next.glCompressedTexImage2D(target, level, internalformat, width,
+                                       height, border, imageSize, data);
+}
+
+void perf_hud_toggle(void) {
+  if (!config.perf_hud)
+    return;
+  config.perf_hud = config.perf_hud == 2 ? 1 : 2;
+  debugPrintf("perf_hud: %s\n", config.perf_hud == 2 ? "shown" : "hidden");
+}
+
+// process CPU time in clock ticks, and busy and total ticks of all cores
+static void read_cpu(long *process, long *busy, long *total) {
+  char buf[512];
+  *process = *busy = *total = 0;
+
+  FILE *f = fopen("/proc/self/stat", "r");
+  if (f) {
+    if (fgets(buf, sizeof(buf), f)) {
+      // utime and stime are the 14th and 15th fields; skip past the command
+      // name, which may contain spaces
+      char *p = strrchr(buf, ')');
+      long utime, stime;
+      if (p && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %ld "
+                             "%ld",
+                      &utime, &stime) == 2)
+        *process = utime + stime;
+    }
+    fclose(f);
+  }
+
+  f = fopen("/proc/stat", "r");
+  if (f) {
+    long user, nice, system, idle, iowait, irq, softirq;
+    if (fscanf(f, "cpu %ld %ld %ld %ld %ld %ld %ld", &user, &nice, &system,
+               &idle, &iowait, &irq, &softirq) == 7) {
+      *busy = user + nice + system + irq + softirq;
+      *total = *busy + idle + iowait;
+    }
+    fclose(f);
+  }
+}
+
+static void update_shown(uint64_t now) {
+  double seconds = (now - window.start_ns) / 1e9;
+  float n = window.frames;
+  long cpu_ticks, all_busy, all_total;
+  read_cpu(&cpu_ticks, &all_busy, &all_total);
+
+  shown.fps = n / seconds;
+  shown.frame_ms = seconds * 1000 / n;
+  shown.hud_ms = window.hud_ms / n;
+  shown.draws = window.draws / n;
+  shown.uploads = window.uploads / n;
+  shown.upload_kb = window.upload_bytes / n / 1024;
+  shown.stream_kb = window.stream_bytes / n / 1024;
+  shown.state_calls = window.state_calls / n;
+  shown.state_skipped = window.state_skipped / n;
+  shown.uniform_calls = window.uniform_calls / n;
+  shown.uniform_skipped = window.uniform_skipped / n;
+  if (window.start_ns) {
+    shown.cpu_percent = (cpu_ticks - window.cpu_ticks) * 100 /
+                        (seconds * sysconf(_SC_CLK_TCK));
+    shown.all_percent = all_total > window.all_total
+                            ? (all_busy - window.all_busy) * 100 /
+                                  (all_total - window.all_total)
+                            : 0;
+  }
+
+  memset(&window, 0, sizeof(window));
+  window.start_ns = now;
+  window.cpu_ticks = cpu_ticks;
+  window.all_busy = all_busy;
+  window.all_total = all_total;
+}
+
+void perf_hud_frame(void) {
+  uint64_t now = now_ns();
+  if (last_frame_ns) {
+    frame_times[frame_index] = (now - last_frame_ns) / 1e6f;
+    frame_index = (frame_index + 1) % PERF_HUD_GRAPH_FRAMES;
+  }
+  last_frame_ns = now;
+
+  window.frames++;
+  window.draws += draws;
+  window.uploads += uploads;
+  window.upload_bytes += upload_bytes;
+  draws = uploads = upload_bytes = 0;
+  if (config.gl_state_cache) {
+    for (int i = 0; i < GL_STATE_NUM_COUNTERS; ++i) {
+      window.state_calls += gl_state_last_frame.calls[i];
+      window.state_skipped += gl_state_last_frame.skipped[i];
+    }
+  }
+  if (config.vertex_stream)
+    window.stream_bytes += vertex_stream_last_frame.bytes;
+  if (config.gl_uniform_cache) {
+    window.uniform_calls += gl_uniforms_last_frame.calls;
+    window.uniform_skipped += gl_uniforms_last_frame.skipped;
+  }
+
+  if (now - window.start_ns >= PERF_HUD_UPDATE_MS * 1000000ull)
+    update_shown(now);
+}
+
+static int init_gl(void) {
+  static const char *const attribs[] = {"pos", "uv", "color"};
+  program = gl_overlay_program(vertex_shader, fragment_shader, attribs, 3);
+  if (!program) {
+    debugPrintf("perf_hud: no shader, overlay disabled\n");
+    return 0;
+  }
+
+  static unsigned char pixels[FONT_TEX_H][FONT_TEX_W];
+  for (int g = 0; g < NUM_GLYPHS; ++g) {
+    for (int x = 0; x < GLYPH_W; ++x) {
+      for (int y = 0; y < GLYPH_H; ++y) {
+        if (font[g][x] & (1 << y))
+          pixels[y][g * (GLYPH_W + 1) + x] = 255;
+      }
+    }
+  }
+  for (int y = 0; y < FONT_TEX_H; ++y)
+    memset(&pixels[y][SOLID_X], 255, 4);
+
+  glGenTextures(1, &font_texture);
+  glBindTexture(GL_TEXTURE_2D, font_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, FONT_TEX_W, FONT_TEX_H, 0, GL_ALPHA,
+               GL_UNSIGNED_BYTE, pixels);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "tex"), 0);
+  return 1;
+}
+
+// adds a quad in screen pixels with texels (u0, v0)-(u1, v1) of the font
+static void add_quad(float x, float y, float w, float h, float u0, float v0,
+                     float u1, float v1, const unsigned char color[4]) {
+  if (num_vertices + 6 > PERF_HUD_MAX_QUADS * 6)
+    return;
+  float x0 = x * pixel_w - 1.0f, x1 = (x + w) * pixel_w - 1.0f;
+  float y0 = 1.0f - y * pixel_h, y1 = 1.0f - (y + h) * pixel_h;
+  u0 /= FONT_TEX_W;
+  u1 /= FONT_TEX_W;
+  v0 /= FONT_TEX_H;
+  v1 /= FONT_TEX_H;
+  Vertex quad[6] = {
+      {x0, y0, u0, v0, {0}}, {x1, y0, u1, v0, {0}}, {x0, y1, u0, v1, {0}},
+      {x1, y0, u1, v0, {0}}, {x1, y1, u1, v1, {0}}, {x0, y1, u0, v1, {0}},
+  };
+  for (int i = 0; i < 6; ++i) {
+    memcpy(quad[i].color, color, 4);
+    vertices[num_vertices++] = quad[i];
+  }
+}
+
+static void add_rect(float x, float y, float w, float h,
+                     const unsigned char color[4]) {
+  add_quad(x, y, w, h, SOLID_X + 1, 1, SOLID_X + 2, 2, color);
+}
+
+// draws a line of text at (x, y) scaled up by scale; returns the next line
+static float add_text(float x, float y, float scale,
+                      const unsigned char color[4], const char *fmt, ...) {
+  char text[64];
+  va_list va;
+  va_start(va, fmt);
+  vsnprintf(text, sizeof(text), fmt, va);
+  va_end(va);
+
+  for (const char *c = text; *c; ++c) {
+    int ch = *c >= 'a' && *c <= 'z' ? *c - 'a' + 'A' : *c;
+    int g = ch - FIRST_GLYPH;
+    if (g > 0 && g < NUM_GLYPHS) {
+      float u = g * (GLYPH_W + 1);
+      add_quad(x, y, GLYPH_W * scale, GLYPH_H * scale, u, 0, u + GLYPH_W,
+               GLYPH_H, color);
+    }
+    x += (GLYPH_W + 1) * scale;
+  }
+  return y + (GLYPH_H + 3) * scale;
+}
+
+static void build(float scale) {
+  static const unsigned char background[4] = {0, 0, 0, 160};
+  static const unsigned char white[4] = {255, 255, 255, 255};
+  static const unsigned char grey[4] = {160, 160, 160, 255};
+  static const unsigned char green[4] = {80, 220, 80, 255};
+  static const unsigned char yellow[4] = {240, 200, 40, 255};
+  static const unsigned char red[4] = {240, 60, 40, 255};
+  const float margin = 4 * scale;
+  const float width = 30 * (GLYPH_W + 1) * scale;
+  const float graph_h = 40 * scale;
+  const float bar_w = width / PERF_HUD_GRAPH_FRAMES;
+
+  num_vertices = 0;
+  // background first; its size is known in advance
+  add_rect(0, 0, width + 2 * margin,
+           HUD_LINES * (GLYPH_H + 3) * scale + graph_h + 3 * margin,
+           background);
+
+  float x = margin, y = margin;
+  y = add_text(x, y, scale, white, "FPS %.1f  %.2f MS", shown.fps,
+               shown.frame_ms);
+  int render_w, render_h;
+  if (render_scale_size(&render_w, &render_h))
+    y = add_text(x, y, scale, white, "RES %dX%d  %d%%", render_w, render_h,
+                 render_w * 100 / screen_width);
+  else
+    y = add_text(x, y, scale, white, "RES %dX%d", screen_width,
+                 screen_height);
+  y = add_text(x, y, scale, white, "CPU %d%%  ALL CORES %d%%",
+               shown.cpu_percent, shown.all_percent);
+  if (config.vertex_stream)
+    y = add_text(x, y, scale, white, "DRAWS %.0f  STREAM %.0f KB", shown.draws,
+                 shown.stream_kb);
+  else
+    y = add_text(x, y, scale, white, "DRAWS %.0f", shown.draws);
+  y = add_text(x, y, scale, white, "TEX UPLOADS %.1f  %.0f KB",
+               shown.uploads, shown.upload_kb);
+  if (config.gl_state_cache)
+    y = add_text(x, y, scale, white, "STATE %.0f  -%.0f", shown.state_calls,
+                 shown.state_skipped);
+  else
+    y = add_text(x, y, scale, grey, "STATE CACHE OFF");
+  if (config.gl_uniform_cache)
+    y = add_text(x, y, scale, white, "UNIFORMS %.0f  -%.0f",
+                 shown.uniform_calls, shown.uniform_skipped);
+  else
+    y = add_text(x, y, scale, grey, "UNIFORM CACHE OFF");
+  if (config.texture_budget > 0) {
+    TextureBudgetStats tex;
+    texture_budget_stats(&tex);
+    int over = tex.resident > (unsigned long long)config.texture_budget << 20;
+    y = add_text(x, y, scale, over ? yellow : white, "TEX MEM %.0f MB  -%.0f",
+                 tex.resident / 1048576.0, tex.saved / 1048576.0);
+  } else {
+    y = add_text(x, y, scale, grey, "TEX BUDGET OFF");
+  }
+  y = add_text(x, y, scale, grey, "HUD %.3f MS", shown.hud_ms);
+  y += margin;
+
+  // frame times, oldest on the left, with lines at 60 and 30 fps
+  float bottom = y + graph_h;
+  for (int i = 0; i < PERF_HUD_GRAPH_FRAMES; ++i) {
+    float ms = frame_times[(frame_index + i) % PERF_HUD_GRAPH_FRAMES];
+    float h = ms / PERF_HUD_GRAPH_MAX_MS * graph_h;
+    if (h > graph_h)
+      h = graph_h;
+    add_rect(x + i * bar_w, bottom - h, bar_w, h,
+             ms < 17.5f ? green : ms < 34.0f ? yellow : red);
+  }
+  add_rect(x, bottom - 16.7f / PERF_HUD_GRAPH_MAX_MS * graph_h, width, scale,
+           grey);
+  add_rect(x, bottom - 33.3f / PERF_HUD_GRAPH_MAX_MS * graph_h, width, scale,
+           grey);
+}
+
+void perf_hud_draw(void) {
+  if (config.perf_hud != 2 || screen_width <= 0 || screen_height <= 0)
+    return;
+  uint64_t start = now_ns();
+
+  GlOverlayState saved;
+  gl_overlay_begin(&saved);
+
+  // init_gl binds a texture and a program, so it runs inside the save and
+  // restore
+  if (!program && !init_gl()) {
+    config.perf_hud = 1;
+  } else {
+    float scale = screen_height >= 480 ? screen_height / 240 : 1;
+    pixel_w = 2.0f / screen_width;
+    pixel_h = 2.0f / screen_height;
+    build(scale);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(program);
+    glBindTexture(GL_TEXTURE_2D, font_texture);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          &vertices[0].x);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          &vertices[0].u);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                          vertices[0].color);
+    for (int i = 0; i < 3; ++i)
+      glEnableVertexAttribArray(i);
+    glDrawArrays(GL_TRIANGLES, 0, num_vertices);
+  }
+
+  gl_overlay_end(&saved);
+
+  window.hud_ms += (now_ns() - start) / 1e6;
+}
@@ -0,0 +1,50 @@
+/* perf_hud.h -- performance overlay drawn at swap
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef PERF_HUD_H
+#define PERF_HUD_H
+
+#include <GLES2/gl2.h>
+
+// frames shown in the frame time graph
+#define PERF_HUD_GRAPH_FRAMES 120
+// frame time at the top of the graph
+#define PERF_HUD_GRAPH_MAX_MS 50.0f
+// how often the averaged numbers are updated
+#define PERF_HUD_UPDATE_MS 500
+#define PERF_HUD_MAX_QUADS 1024
+
+// functions the counting imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLDRAWARRAYSPROC glDrawArrays;
+  PFNGLDRAWELEMENTSPROC glDrawElements;
+  PFNGLTEXIMAGE2DPROC glTexImage2D;
+  PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
+} PerfHudNext;
+
+extern PerfHudNext perf_hud_next;
+
+// shows or hides the overlay (perf_hud 2 or 1)
+void perf_hud_toggle(void);
+// draws the overlay if it's shown, call right before swapping
+void perf_hud_draw(void);
+// called once per frame after swapping
+void perf_hud_frame(void);
+
+void perf_hud_glDrawArrays(GLenum mode, GLint first, GLsizei count);
+void perf_hud_glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                             const void *indices);
+void perf_hud_glTexImage2D(GLenum target, GLint level, GLint internalformat,
+                           GLsizei width, GLsizei height, GLint border,
+                           GLenum format, GLenum type, const void *pixels);
+void perf_hud_glCompressedTexImage2D(GLenum target, GLint level,
+                                     GLenum internalformat, GLsizei width,
+                                     GLsizei height, GLint border,
+                                     GLsizei imageSize, const void *data);
+
+#endif // PERF_HUD_H
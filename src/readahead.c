@@ -0,0 +1,383 @@
+/* readahead.c -- background prefetch of game archives
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Level loads read the .ras archives in many small, scattered pieces, which
+// is slow on SD cards. The stdio imports are wrapped to record which byte
+// ranges of each archive the game actually reads; on exit these are merged
+// into a manifest. On later runs a worker thread walks the manifest ranges
+// of an archive in file order with readahead() as soon as the game starts
+// reading it, so most of the game's reads are then served from the page
+// cache. The archive shared by every level is queued already when the game
+// opens its first archive.
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gamedata_mapping.h"
+#include "iotrace.h"
+#include "readahead.h"
+#include "util.h"
+
+#define READAHEAD_CHUNK (1024 * 1024)
+#define READAHEAD_MAX_STREAMS 32
+#define READAHEAD_NAME_MAX 256
+
+typedef struct {
+  int64_t offset;
+  int64_t length;
+} Range;
+
+typedef struct {
+  Range *items;
+  int count;
+  int capacity;
+} RangeList;
+
+typedef struct {
+  char name[READAHEAD_NAME_MAX]; // lowercase path as requested by the game
+  RangeList known;               // from the manifest
+  RangeList seen;                // read during this run
+  int queued;
+} Archive;
+
+typedef struct {
+  FILE *file;
+  Archive *archive;
+  int64_t pos;
+  int touched;
+} Stream;
+
+ReadaheadNext readahead_next;
+
+static pthread_mutex_t ra_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ra_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t ra_thread;
+static int ra_running = 0;
+static int ra_stop = 0;
+
+static Archive archives[READAHEAD_MAX_ARCHIVES];
+static int num_archives = 0;
+static Stream streams[READAHEAD_MAX_STREAMS];
+static Archive *queue[READAHEAD_MAX_ARCHIVES];
+static int queue_len = 0;
+static int opened_archive = 0;
+
+static int is_archive(const char *path) {
+  size_t len = strlen(path);
+  return len > 4 && !strcasecmp(path + len - 4, ".ras");
+}
+
+// caller holds ra_lock
+static Archive *find_archive(const char *path, int create) {
+  char name[READAHEAD_NAME_MAX];
+  size_t i;
+  for (i = 0; path[i] && i < sizeof(name) - 1; ++i)
+    name[i] = tolower((unsigned char)path[i]);
+  name[i] = '\0';
+
+  for (int a = 0; a < num_archives; ++a) {
+    if (!strcmp(archives[a].name, name))
+      return &archives[a];
+  }
+  if (!create || num_archives == READAHEAD_MAX_ARCHIVES)
+    return NULL;
+  Archive *archive = &archives[num_archives++];
+  strcpy(archive->name, name);
+  return archive;
+}
+
+static void range_push(RangeList *list, int64_t offset, int64_t length) {
+  if (list->count == list->capacity) {
+    if (list->capacity >= READAHEAD_MAX_RANGES)
+      return;
+    int capacity = list->capacity ? list->capacity * 2 : 64;
+    Range *items = realloc(list->items, capacity * sizeof(*items));
+    if (!items)
+      return;
+    list->items = items;
+    list->capacity = capacity;
+  }
+  list->items[list->count++] = (Range){offset, length};
+}
+
+// records a read, extending the previous range if the game is still walking
+// forward through the same region
+static void range_record(RangeList *list, int64_t offset, int64_t length) {
+  if (list->count) {
+    Range *last = &list->items[list->count - 1];
+    int64_t end = last->offset + last->length;
+    if (offset >= last->offset && offset <= end + READAHEAD_MERGE_GAP) {
+      if (offset + length > end)
+        last->length = offset + length - last->offset;
+      return;
+    }
+  }
+  range_push(list, offset, length);
+}
+
+static int range_compare(const void *a, const void *b) {
+  const Range *ra = a, *rb = b;
+  return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+// sorts the list by offset and merges ranges that overlap or nearly touch
+static void range_coalesce(RangeList *list) {
+  if (list->count < 2)
+    return;
+  qsort(list->items, list->count, sizeof(Range), range_compare);
+  int out = 0;
+  for (int i = 1; i < list->count; ++i) {
+    Range *cur = &list->items[out];
+    Range *next = &list->items[i];
+    int64_t end = cur->offset + cur->length;
+    if (next->offset <= end + READAHEAD_MERGE_GAP) {
+      if (next->offset + next->length > end)
+        cur->length = next->offset + next->length - cur->offset;
+    } else {
+      list->items[++out] = *next;
+    }
+  }
+  list->count = out + 1;
+}
+
+// caller holds ra_lock
+static void queue_archive(Archive *archive) {
+  if (archive->queued || queue_len == READAHEAD_MAX_ARCHIVES)
+    return;
+  archive->queued = 1;
+  queue[queue_len++] = archive;
+  pthread_cond_signal(&ra_cond);
+}
+
+static void prefetch_archive(const char *name, Range *ranges, int count) {
+  const char *path = gamedata_mapping_get(name);
+  if (!path)
+    path = name;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat st;
+  Range whole;
+  if (!count && fstat(fd, &st) == 0 && st.st_size <= READAHEAD_WHOLE_FILE_MAX) {
+    whole = (Range){0, st.st_size};
+    ranges = &whole;
+    count = 1;
+  }
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int64_t total = 0;
+  for (int i = 0; i < count && total < READAHEAD_MAX_BYTES; ++i) {
+    // issue the range in chunks so the stop flag is checked regularly and the
+    // first chunks are already cached while the rest is in flight
+    for (int64_t off = 0; off < ranges[i].length; off += READAHEAD_CHUNK) {
+      if (__atomic_load_n(&ra_stop, __ATOMIC_RELAXED))
+        goto done;
+      int64_t len = ranges[i].length - off;
+      if (len > READAHEAD_CHUNK)
+        len = READAHEAD_CHUNK;
+      if (readahead(fd, ranges[i].offset + off, len) < 0)
+        posix_fadvise(fd, ranges[i].offset + off, len, POSIX_FADV_WILLNEED);
+      total += len;
+    }
+  }
+done:
+  close(fd);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  debugPrintf("readahead: %s, %d ranges, %lld KB in %.1f ms\n", name, count,
+              (long long)(total / 1024),
+              (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+}
+
+static void *readahead_thread(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&ra_lock);
+  for (;;) {
+    while (!queue_len && !ra_stop)
+      pthread_cond_wait(&ra_cond, &ra_lock);
+    if (ra_stop)
+      break;
+
+    Archive *archive = queue[0];
+    memmove(queue, queue + 1, --queue_len * sizeof(*queue));
+    archive->queued = 0;
+    char name[READAHEAD_NAME_MAX];
+    strcpy(name, archive->name);
+    int count = archive->known.count;
+    Range *ranges = count ? malloc(count * sizeof(Range)) : NULL;
+    if (ranges)
+      memcpy(ranges, archive->known.items, count * sizeof(Range));
+    else
+      count = 0;
+
+    pthread_mutex_unlock(&ra_lock);
+    prefetch_archive(name, ranges, count);
+    free(ranges);
+    pthread_mutex_lock(&ra_lock);
+  }
+  pthread_mutex_unlock(&ra_lock);
+  return NULL;
+}
+
+static void load_manifest(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return;
+
+  char line[512], name[READAHEAD_NAME_MAX];
+  long long offset, length;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%255s %lld %lld", name, &offset, &length) != 3 ||
+        offset < 0 || length <= 0)
+      continue;
+    Archive *archive = find_archive(name, 1);
+    if (archive)
+      range_push(&archive->known, offset, length);
+  }
+  fclose(f);
+
+  for (int a = 0; a < num_archives; ++a)
+    range_coalesce(&archives[a].known);
+}
+
+static void save_manifest(const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return;
+
+  fprintf(f, "# archive offset length, recorded from previous runs\n");
+  for (int a = 0; a < num_archives; ++a) {
+    Archive *archive = &archives[a];
+    for (int i = 0; i < archive->seen.count; ++i)
+      range_push(&archive->known, archive->seen.items[i].offset,
+                 archive->seen.items[i].length);
+    range_coalesce(&archive->known);
+    for (int i = 0; i < archive->known.count; ++i)
+      fprintf(f, "%s %lld %lld\n", archive->name,
+              (long long)archive->known.items[i].offset,
+              (long long)archive->known.items[i].length);
+  }
+  fclose(f);
+}
+
+int readahead_init(void) {
+  pthread_mutex_lock(&ra_lock);
+  load_manifest(READAHEAD_MANIFEST);
+  pthread_mutex_unlock(&ra_lock);
+
+  if (pthread_create(&ra_thread, NULL, readahead_thread, NULL) != 0)
+    return -1;
+  ra_running = 1;
+  return 0;
+}
+
+void readahead_shutdown(void) {
+  if (!ra_running)
+    return;
+  pthread_mutex_lock(&ra_lock);
+  __atomic_store_n(&ra_stop, 1, __ATOMIC_RELAXED);
+  pthread_cond_signal(&ra_cond);
+  pthread_mutex_unlock(&ra_lock);
+  pthread_join(ra_thread, NULL);
+  ra_running = 0;
+
+  pthread_mutex_lock(&ra_lock);
+  save_manifest(READAHEAD_MANIFEST);
+  pthread_mutex_unlock(&ra_lock);
+}
+
+// ---- stdio import wrappers ----
+
+// caller holds ra_lock
+static Stream *find_stream(FILE *f) {
+  for (int i = 0; i < READAHEAD_MAX_STREAMS; ++i) {
+    if (streams[i].file == f)
+      return &streams[i];
+  }
+  return NULL;
+}
+
+FILE *readahead_fopen(const char *filename, const char *mode) {
+  FILE *f = readahead_next.fopen(filename, mode);
+  if (!f || !is_archive(filename) || strpbrk(mode, "wa+"))
+    return f;
+
+  pthread_mutex_lock(&ra_lock);
+  Archive *archive = find_archive(filename, 1);
+  Stream *s = find_stream(NULL);
+  if (archive && s)
+    *s = (Stream){f, archive, 0, 0};
+  if (!opened_archive) {
+    // start pulling in the shared archive while the rest are being opened
+    opened_archive = 1;
+    Archive *shared = find_archive(READAHEAD_SHARED_ARCHIVE, 1);
+    if (shared)
+      queue_archive(shared);
+  }
+  pthread_mutex_unlock(&ra_lock);
+  return f;
+}
+
+size_t readahead_fread(void *ptr, size_t size, size_t nmemb, FILE *f) {
+  size_t ret = readahead_next.fread(ptr, size, nmemb, f);
+
+  const char *first_touch = NULL;
+  pthread_mutex_lock(&ra_lock);
+  Stream *s = find_stream(f);
+  if (s) {
+    if (!s->touched) {
+      // the game opens archives up front but only starts reading one when a
+      // level that needs it begins loading
+      s->touched = 1;
+      queue_archive(s->archive);
+      first_touch = s->archive->name;
+    }
+    if (ret)
+      range_record(&s->archive->seen, s->pos, (int64_t)ret * size);
+    s->pos += (int64_t)ret * size;
+  }
+  pthread_mutex_unlock(&ra_lock);
+
+  if (first_touch)
+    iotrace_mark(first_touch);
+  return ret;
+}
+
+int readahead_fseek(FILE *f, long offset, int whence) {
+  int ret = readahead_next.fseek(f, offset, whence);
+  if (ret != 0)
+    return ret;
+
+  pthread_mutex_lock(&ra_lock);
+  Stream *s = find_stream(f);
+  if (s)
+    s->pos = whence == SEEK_SET ? offset : readahead_next.ftell(f);
+  pthread_mutex_unlock(&ra_lock);
+  return ret;
+}
+
+int readahead_fclose(FILE *f) {
+  pthread_mutex_lock(&ra_lock);
+  Stream *s = find_stream(f);
+  if (s)
+    s->file = NULL;
+  pthread_mutex_unlock(&ra_lock);
+  return readahead_next.fclose(f);
+}
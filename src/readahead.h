@@ -0,0 +1,49 @@
+/* readahead.h -- background prefetch of game archives
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <stdio.h>
+
+#define READAHEAD_MANIFEST "conf/readahead.txt"
+// needed by every level, prefetched as soon as the game opens an archive
+#define READAHEAD_SHARED_ARCHIVE "gamedata/x_data.ras"
+
+// reads closer together than this are merged into one manifest range
+#define READAHEAD_MERGE_GAP (256 * 1024)
+#define READAHEAD_MAX_RANGES 4096
+#define READAHEAD_MAX_ARCHIVES 16
+// upper limit of what is prefetched per archive so a large manifest can't
+// push the game itself out of memory
+#define READAHEAD_MAX_BYTES (192 * 1024 * 1024)
+// archives without a manifest entry are prefetched whole if this small
+#define READAHEAD_WHOLE_FILE_MAX (16 * 1024 * 1024)
+
+// functions the wrapped imports forward to, filled in by update_imports
+typedef struct {
+  FILE *(*fopen)(const char *, const char *);
+  size_t (*fread)(void *, size_t, size_t, FILE *);
+  int (*fseek)(FILE *, long, int);
+  long (*ftell)(FILE *);
+  int (*fclose)(FILE *);
+} ReadaheadNext;
+
+extern ReadaheadNext readahead_next;
+
+// loads the manifest and starts the prefetch thread
+int readahead_init(void);
+// stops the thread and writes the manifest merged with this run's reads
+void readahead_shutdown(void);
+
+FILE *readahead_fopen(const char *filename, const char *mode);
+size_t readahead_fread(void *ptr, size_t size, size_t nmemb, FILE *f);
+int readahead_fseek(FILE *f, long offset, int whence);
+int readahead_fclose(FILE *f);
+
+#endif // READAHEAD_H
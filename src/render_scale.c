@@ -0,0 +1,560 @@
+/* render_scale.c -- offscreen rendering at a lower, adaptive resolution
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The game draws to an offscreen framebuffer instead of the window, and at
+// swap the part of it that was drawn to is upscaled to the window. The
+// offscreen target is render_scale times the window's size, and the game is
+// made to draw to its lower left corner only: while the game has
+// "framebuffer 0" bound its viewport and scissor rectangles are scaled down,
+// and reading them back gives the game's own values again. That way the
+// resolution can change from frame to frame without reallocating anything,
+// and the game keeps seeing the window's size from OS_ScreenGetWidth/Height.
+// Its own framebuffer objects are left alone.
+//
+// With dynamic_resolution, every RENDER_SCALE_WINDOW frames a governor
+// compares the average cost of a frame with the budget of that frame rate
+// and changes the scale so the number of pixels drawn follows the cost. The
+// cost is the GPU time of the frame when the driver has
+// EXT_disjoint_timer_query, and the time from swap to swap otherwise.
+//
+// The upscale pass also draws the letterbox bars of square screens, so
+// nothing else has to touch the window before the swap.
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "gl_overlay.h"
+#include "log.h"
+#include "render_scale.h"
+#include "util.h"
+
+// frames longer than this are loading hitches, not a sign of too much work
+#define IGNORE_FRAME_MS 250.0f
+
+static const char *const vertex_shader =
+    "attribute vec2 pos;\n"
+    "uniform vec2 uv_scale;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "  uv = (pos * 0.5 + 0.5) * uv_scale;\n"
+    "  gl_Position = vec4(pos, 0.0, 1.0);\n"
+    "}\n";
+
+// the filters get the last texel center of the drawn area in uv_max, which
+// keeps them from blending in texels outside it, the target's size in
+// tex_size and how many window pixels a texel covers in out_scale; window
+// rows outside visible_y are the letterbox bars
+static const char *const fragment_header =
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "uniform sampler2D tex;\n"
+    "uniform vec2 uv_max;\n"
+    "uniform vec2 tex_size;\n"
+    "uniform vec2 out_scale;\n"
+    "uniform vec2 visible_y;\n"
+    "varying vec2 uv;\n"
+    "vec4 upscale(vec2 p);\n"
+    "void main() {\n"
+    "  if (gl_FragCoord.y < visible_y.x || gl_FragCoord.y > visible_y.y)\n"
+    "    gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "  else\n"
+    "    gl_FragColor = vec4(upscale(uv).rgb, 1.0);\n"
+    "}\n";
+
+static const char *const bilinear_filter =
+    "vec4 upscale(vec2 p) {\n"
+    "  return texture2D(tex, min(p, uv_max));\n"
+    "}\n";
+
+// nearest neighbour inside a texel and bilinear only across the one window
+// pixel on its edge, so pixels stay square without shimmering at
+// fractional scales
+static const char *const sharp_bilinear_filter =
+    "vec4 upscale(vec2 p) {\n"
+    "  vec2 texel = p * tex_size;\n"
+    "  vec2 center_dist = fract(texel) - 0.5;\n"
+    "  vec2 region = 0.5 - 0.5 / out_scale;\n"
+    "  vec2 f = (center_dist - clamp(center_dist, -region, region)) * "
+    "out_scale + 0.5;\n"
+    "  return texture2D(tex, min((floor(texel) + f) / tex_size, uv_max));\n"
+    "}\n";
+
+// Catmull-Rom in 9 bilinear taps, clamped like EASU to the four nearest
+// texels so the sharpening doesn't ring around edges
+static const char *const bicubic_filter =
+    "vec4 upscale(vec2 p) {\n"
+    "  vec2 pos = p * tex_size;\n"
+    "  vec2 t1 = floor(pos - 0.5) + 0.5;\n"
+    "  vec2 f = pos - t1;\n"
+    "  vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));\n"
+    "  vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);\n"
+    "  vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));\n"
+    "  vec2 w3 = f * f * (-0.5 + 0.5 * f);\n"
+    "  vec2 w12 = w1 + w2;\n"
+    "  vec2 a = min((t1 - 1.0) / tex_size, uv_max);\n"
+    "  vec2 b = min((t1 + w2 / w12) / tex_size, uv_max);\n"
+    "  vec2 c = min((t1 + 2.0) / tex_size, uv_max);\n"
+    "  vec4 sum =\n"
+    "      (texture2D(tex, vec2(a.x, a.y)) * w0.x +\n"
+    "       texture2D(tex, vec2(b.x, a.y)) * w12.x +\n"
+    "       texture2D(tex, vec2(c.x, a.y)) * w3.x) * w0.y +\n"
+    "      (texture2D(tex, vec2(a.x, b.y)) * w0.x +\n"
+    "       texture2D(tex, vec2(b.x, b.y)) * w12.x +\n"
+    "       texture2D(tex, vec2(c.x, b.y)) * w3.x) * w12.y +\n"
+    "      (texture2D(tex, vec2(a.x, c.y)) * w0.x +\n"
+    "       texture2D(tex, vec2(b.x, c.y)) * w12.x +\n"
+    "       texture2D(tex, vec2(c.x, c.y)) * w3.x) * w3.y;\n"
+    "  vec2 n0 = min(t1 / tex_size, uv_max);\n"
+    "  vec2 n1 = min((t1 + 1.0) / tex_size, uv_max);\n"
+    "  vec4 s0 = texture2D(tex, n0);\n"
+    "  vec4 s1 = texture2D(tex, vec2(n1.x, n0.y));\n"
+    "  vec4 s2 = texture2D(tex, vec2(n0.x, n1.y));\n"
+    "  vec4 s3 = texture2D(tex, n1);\n"
+    "  return clamp(sum, min(min(s0, s1), min(s2, s3)),\n"
+    "               max(max(s0, s1), max(s2, s3)));\n"
+    "}\n";
+
+static const char *const *const filters[] = {
+    &bilinear_filter, &sharp_bilinear_filter, &bicubic_filter};
+
+// one triangle covering the screen
+static const GLfloat triangle[] = {-1.0f, -1.0f, 3.0f, -1.0f, -1.0f, 3.0f};
+
+RenderScaleNext render_scale_next;
+
+static GLuint fbo = 0, color_texture = 0, depth_rb = 0, stencil_rb = 0;
+static GLuint program = 0;
+static GLint uv_scale_loc, uv_max_loc, tex_size_loc, out_scale_loc;
+static GLint visible_y_loc;
+static int full_width, full_height; // window size
+static int tex_width, tex_height;   // offscreen target size
+static int width, height;           // part of the target drawn to
+static float scale = 1.0f;          // of the window's size
+static float max_scale = 1.0f;      // the target's size
+
+// what the game thinks is set
+static int default_bound = 1;
+static GLint viewport[4], scissor[4];
+static GLint presented_framebuffer;
+
+// governor
+static uint64_t last_frame_ns = 0;
+static double window_cost_ms = 0;
+static int window_frames = 0;
+static int window_gpu_frames = 0;
+static int up_delay = 0;
+
+static struct {
+  PFNGLGENQUERIESEXTPROC glGenQueriesEXT;
+  PFNGLBEGINQUERYEXTPROC glBeginQueryEXT;
+  PFNGLENDQUERYEXTPROC glEndQueryEXT;
+  PFNGLGETQUERYOBJECTUIVEXTPROC glGetQueryObjectuivEXT;
+  PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT;
+  GLuint ids[RENDER_SCALE_QUERIES];
+  int pending[RENDER_SCALE_QUERIES];
+  int next;
+  int running; // a query has been begun on ids[next]
+  int active;
+} timer;
+
+// the game's rectangle in the scaled part of the target
+static void scale_rect(const GLint in[4], GLint out[4]) {
+  float sx = (float)width / full_width, sy = (float)height / full_height;
+  GLint x0 = lroundf(in[0] * sx), y0 = lroundf(in[1] * sy);
+  out[0] = x0;
+  out[1] = y0;
+  out[2] = lroundf((in[0] + in[2]) * sx) - x0;
+  out[3] = lroundf((in[1] + in[3]) * sy) - y0;
+}
+
+// sets the viewport and scissor the game asked for, scaled if it draws to
+// the window
+static void apply_rects(void) {
+  GLint v[4], s[4];
+  if (default_bound) {
+    scale_rect(viewport, v);
+    scale_rect(scissor, s);
+  } else {
+    memcpy(v, viewport, sizeof(v));
+    memcpy(s, scissor, sizeof(s));
+  }
+  render_scale_next.glViewport(v[0], v[1], v[2], v[3]);
+  render_scale_next.glScissor(s[0], s[1], s[2], s[3]);
+}
+
+static void set_scale(float new_scale) {
+  scale = new_scale;
+  width = lroundf(full_width * scale);
+  height = lroundf(full_height * scale);
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+  if (width > tex_width)
+    width = tex_width;
+  if (height > tex_height)
+    height = tex_height;
+  if (fbo)
+    apply_rects();
+}
+
+static void init_timer(void) {
+  if (!has_extension("GL_EXT_disjoint_timer_query"))
+    return;
+  timer.glGenQueriesEXT = (void *)eglGetProcAddress("glGenQueriesEXT");
+  timer.glBeginQueryEXT = (void *)eglGetProcAddress("glBeginQueryEXT");
+  timer.glEndQueryEXT = (void *)eglGetProcAddress("glEndQueryEXT");
+  timer.glGetQueryObjectuivEXT =
+      (void *)eglGetProcAddress("glGetQueryObjectuivEXT");
+  timer.glGetQueryObjectui64vEXT =
+      (void *)eglGetProcAddress("glGetQueryObjectui64vEXT");
+  if (!timer.glGenQueriesEXT || !timer.glBeginQueryEXT ||
+      !timer.glEndQueryEXT || !timer.glGetQueryObjectuivEXT ||
+      !timer.glGetQueryObjectui64vEXT)
+    return;
+  timer.glGenQueriesEXT(RENDER_SCALE_QUERIES, timer.ids);
+  timer.active = 1;
+}
+
+void render_scale_init(int window_width, int window_height) {
+  full_width = window_width;
+  full_height = window_height;
+  viewport[2] = scissor[2] = full_width;
+  viewport[3] = scissor[3] = full_height;
+
+  if (config.render_scale > 0.0f && config.render_scale < 1.0f)
+    max_scale = config.render_scale;
+  tex_width = lroundf(full_width * max_scale);
+  tex_height = lroundf(full_height * max_scale);
+
+  int filter = config.upscale_filter;
+  if (filter < 0 || filter >= (int)(sizeof(filters) / sizeof(*filters)))
+    filter = 0;
+  char fragment_shader[4096];
+  snprintf(fragment_shader, sizeof(fragment_shader), "%s%s", fragment_header,
+           *filters[filter]);
+  static const char *const attribs[] = {"pos"};
+  program = gl_overlay_program(vertex_shader, fragment_shader, attribs, 1);
+  if (!program) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "render_scale: no shader, rendering at full resolution\n");
+    return;
+  }
+  uv_scale_loc = glGetUniformLocation(program, "uv_scale");
+  uv_max_loc = glGetUniformLocation(program, "uv_max");
+  tex_size_loc = glGetUniformLocation(program, "tex_size");
+  out_scale_loc = glGetUniformLocation(program, "out_scale");
+  visible_y_loc = glGetUniformLocation(program, "visible_y");
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "tex"), 0);
+  glUseProgram(0);
+
+  // the window has no alpha, so neither has the target in case the game
+  // blends with the destination alpha
+  glGenTextures(1, &color_texture);
+  glBindTexture(GL_TEXTURE_2D, color_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tex_width, tex_height, 0, GL_RGB,
+               GL_UNSIGNED_BYTE, NULL);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         color_texture, 0);
+
+  // same depth and stencil bits as the window where the driver allows
+  glGenRenderbuffers(1, &depth_rb);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
+  if (has_extension("GL_OES_packed_depth_stencil")) {
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8_OES, tex_width,
+                          tex_height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, depth_rb);
+  } else {
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, tex_width,
+                          tex_height);
+    glGenRenderbuffers(1, &stencil_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, stencil_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, tex_width,
+                          tex_height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, stencil_rb);
+  }
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_rb);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "render_scale: offscreen target incomplete (0x%x), rendering "
+               "at full resolution\n",
+               status);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &color_texture);
+    glDeleteRenderbuffers(1, &depth_rb);
+    if (stencil_rb)
+      glDeleteRenderbuffers(1, &stencil_rb);
+    fbo = 0;
+    return;
+  }
+
+  set_scale(max_scale);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+  if (config.dynamic_resolution > 0) {
+    init_timer();
+    if (timer.active) {
+      timer.glBeginQueryEXT(GL_TIME_ELAPSED_EXT, timer.ids[timer.next]);
+      timer.running = 1;
+    }
+  }
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "render_scale: rendering offscreen at up to %dx%d, %s\n",
+             tex_width, tex_height,
+             config.dynamic_resolution <= 0 ? "fixed"
+             : timer.active                 ? "governed by GPU time"
+                                            : "governed by frame time");
+}
+
+int render_scale_wanted(void) {
+  return config.dynamic_resolution > 0 ||
+         (config.render_scale > 0.0f && config.render_scale < 1.0f);
+}
+
+int render_scale_present(int bar_height) {
+  if (!fbo)
+    return 0;
+  // no query is begun while all of them are still waiting for results
+  if (timer.running) {
+    timer.glEndQueryEXT(GL_TIME_ELAPSED_EXT);
+    timer.running = 0;
+    timer.pending[timer.next] = 1;
+    timer.next = (timer.next + 1) % RENDER_SCALE_QUERIES;
+  }
+
+  GlOverlayState saved;
+  gl_overlay_begin(&saved);
+  glUseProgram(program);
+  glUniform2f(uv_scale_loc, (float)width / tex_width,
+              (float)height / tex_height);
+  glUniform2f(uv_max_loc, (width - 0.5f) / tex_width,
+              (height - 0.5f) / tex_height);
+  glUniform2f(tex_size_loc, tex_width, tex_height);
+  glUniform2f(out_scale_loc, (float)full_width / width,
+              (float)full_height / height);
+  glUniform2f(visible_y_loc, bar_height, full_height - bar_height);
+  glBindTexture(GL_TEXTURE_2D, color_texture);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, triangle);
+  glEnableVertexAttribArray(0);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  gl_overlay_end(&saved);
+
+  // whatever else is drawn before the swap goes straight to the window
+  presented_framebuffer = saved.framebuffer;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return 1;
+}
+
+// GPU time of the oldest finished frame, or a negative value
+static float read_timer(void) {
+  float gpu_ms = -1.0f;
+  for (int i = 0; i < RENDER_SCALE_QUERIES; ++i) {
+    int q = (timer.next + i) % RENDER_SCALE_QUERIES;
+    if (!timer.pending[q])
+      continue;
+    GLuint available = 0;
+    timer.glGetQueryObjectuivEXT(timer.ids[q], GL_QUERY_RESULT_AVAILABLE_EXT,
+                                 &available);
+    if (!available)
+      break;
+    GLuint64 ns = 0;
+    timer.glGetQueryObjectui64vEXT(timer.ids[q], GL_QUERY_RESULT_EXT, &ns);
+    timer.pending[q] = 0;
+    gpu_ms = ns / 1e6f;
+  }
+  // the results are garbage if the GPU changed clocks or was reset meanwhile
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  return disjoint ? -1.0f : gpu_ms;
+}
+
+static void govern(void) {
+  float target_ms = 1000.0f / config.dynamic_resolution;
+  float ratio = window_cost_ms / window_frames / target_ms;
+  float min_scale = config.dynamic_resolution_min;
+  float new_scale = scale;
+
+  // the cost follows the number of pixels, i.e. the square of the scale
+  if (ratio > RENDER_SCALE_OVER_BUDGET) {
+    new_scale = scale * sqrtf(1.0f / ratio);
+    if (new_scale < scale - RENDER_SCALE_MAX_DOWN)
+      new_scale = scale - RENDER_SCALE_MAX_DOWN;
+    up_delay = RENDER_SCALE_UP_DELAY;
+  } else if (ratio < RENDER_SCALE_UNDER_BUDGET && up_delay <= 0) {
+    new_scale = scale * sqrtf(RENDER_SCALE_UNDER_BUDGET / ratio);
+    if (new_scale > scale + RENDER_SCALE_MAX_UP)
+      new_scale = scale + RENDER_SCALE_MAX_UP;
+  }
+  if (new_scale < min_scale)
+    new_scale = min_scale;
+  if (new_scale > max_scale)
+    new_scale = max_scale;
+
+  if (fabsf(new_scale - scale) >= 0.01f) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+               "render_scale: %s cost %.2f ms of %.2f, scale %.2f -> %.2f\n",
+               window_gpu_frames == window_frames ? "GPU" : "frame",
+               window_cost_ms / window_frames, target_ms, scale, new_scale);
+    set_scale(new_scale);
+  }
+}
+
+void render_scale_frame(void) {
+  if (!fbo)
+    return;
+  glBindFramebuffer(GL_FRAMEBUFFER, presented_framebuffer);
+
+  uint64_t now = now_ns();
+  float frame_ms = last_frame_ns ? (now - last_frame_ns) / 1e6f : 0.0f;
+  last_frame_ns = now;
+
+  if (timer.active) {
+    float gpu_ms = read_timer();
+    if (!timer.pending[timer.next]) {
+      timer.glBeginQueryEXT(GL_TIME_ELAPSED_EXT, timer.ids[timer.next]);
+      timer.running = 1;
+    }
+    if (gpu_ms >= 0.0f) {
+      frame_ms = gpu_ms;
+      window_gpu_frames++;
+    }
+  }
+
+  if (up_delay > 0)
+    up_delay--;
+  if (config.dynamic_resolution <= 0 || frame_ms <= 0.0f ||
+      frame_ms > IGNORE_FRAME_MS)
+    return;
+  window_cost_ms += frame_ms;
+  if (++window_frames == RENDER_SCALE_WINDOW) {
+    govern();
+    window_cost_ms = 0;
+    window_frames = window_gpu_frames = 0;
+  }
+}
+
+int render_scale_size(int *w, int *h) {
+  if (!fbo)
+    return 0;
+  *w = width;
+  *h = height;
+  return 1;
+}
+
+void render_scale_glBindFramebuffer(GLenum target, GLuint framebuffer) {
+  if (!fbo) {
+    render_scale_next.glBindFramebuffer(target, framebuffer);
+    return;
+  }
+  int to_default = framebuffer == 0;
+  render_scale_next.glBindFramebuffer(target, to_default ? fbo : framebuffer);
+  if (to_default != default_bound) {
+    default_bound = to_default;
+    if (width != full_width || height != full_height)
+      apply_rects();
+  }
+}
+
+void render_scale_glViewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+  viewport[0] = x;
+  viewport[1] = y;
+  viewport[2] = w;
+  viewport[3] = h;
+  if (fbo && default_bound) {
+    GLint v[4];
+    scale_rect(viewport, v);
+    render_scale_next.glViewport(v[0], v[1], v[2], v[3]);
+  } else {
+    render_scale_next.glViewport(x, y, w, h);
+  }
+}
+
+void render_scale_glScissor(GLint x, GLint y, GLsizei w, GLsizei h) {
+  scissor[0] = x;
+  scissor[1] = y;
+  scissor[2] = w;
+  scissor[3] = h;
+  if (fbo && default_bound) {
+    GLint s[4];
+    scale_rect(scissor, s);
+    render_scale_next.glScissor(s[0], s[1], s[2], s[3]);
+  } else {
+    render_scale_next.glScissor(x, y, w, h);
+  }
+}
+
+void render_scale_glGetIntegerv(GLenum pname, GLint *data) {
+  render_scale_next.glGetIntegerv(pname, data);
+  if (!fbo)
+    return;
+  if (pname == GL_VIEWPORT)
+    memcpy(data, viewport, sizeof(viewport));
+  else if (pname == GL_SCISSOR_BOX)
+    memcpy(data, scissor, sizeof(scissor));
+  else if (pname == GL_FRAMEBUFFER_BINDING && (GLuint)*data == fbo)
+    *data = 0;
+}
+
+// reads of the window are scaled back up, so the game gets the number of
+// pixels it asked for
+void render_scale_glReadPixels(GLint x, GLint y, GLsizei w, GLsizei h,
+                               GLenum format, GLenum type, void *pixels) {
+  if (!fbo || !default_bound || (width == full_width && height == full_height)) {
+    render_scale_next.glReadPixels(x, y, w, h, format, type, pixels);
+    return;
+  }
+
+  GLint in[4] = {x, y, w, h}, r[4];
+  scale_rect(in, r);
+  if (format != GL_RGBA || type != GL_UNSIGNED_BYTE || r[2] <= 0 ||
+      r[3] <= 0) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "render_scale: glReadPixels of 0x%x/0x%x not scaled\n", format,
+               type);
+    render_scale_next.glReadPixels(r[0], r[1], r[2], r[3], format, type,
+                                   pixels);
+    return;
+  }
+
+  uint32_t *src = malloc((size_t)r[2] * r[3] * 4);
+  if (!src)
+    return;
+  render_scale_next.glReadPixels(r[0], r[1], r[2], r[3], GL_RGBA,
+                                 GL_UNSIGNED_BYTE, src);
+  uint32_t *dst = pixels;
+  for (int j = 0; j < h; ++j) {
+    const uint32_t *row = src + (size_t)(j * r[3] / h) * r[2];
+    for (int i = 0; i < w; ++i)
+      *dst++ = row[i * r[2] / w];
+  }
+  free(src);
+}
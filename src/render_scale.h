@@ -0,0 +1,60 @@
+/* render_scale.h -- offscreen rendering at a lower, adaptive resolution
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef RENDER_SCALE_H
+#define RENDER_SCALE_H
+
+#include <GLES2/gl2.h>
+
+// frames averaged for each governor decision
+#define RENDER_SCALE_WINDOW 30
+// frames to wait after lowering the resolution before raising it again
+#define RENDER_SCALE_UP_DELAY 120
+// largest change of the scale per decision, down and up
+#define RENDER_SCALE_MAX_DOWN 0.1f
+#define RENDER_SCALE_MAX_UP 0.05f
+// the budget is missed above the first and has headroom below the second
+#define RENDER_SCALE_OVER_BUDGET 1.05f
+#define RENDER_SCALE_UNDER_BUDGET 0.8f
+// GPU timer queries in flight, results are read this many frames late
+#define RENDER_SCALE_QUERIES 4
+
+// functions the scaling imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLBINDFRAMEBUFFERPROC glBindFramebuffer;
+  PFNGLVIEWPORTPROC glViewport;
+  PFNGLSCISSORPROC glScissor;
+  PFNGLGETINTEGERVPROC glGetIntegerv;
+  PFNGLREADPIXELSPROC glReadPixels;
+} RenderScaleNext;
+
+extern RenderScaleNext render_scale_next;
+
+// nonzero if the settings ask for rendering offscreen
+int render_scale_wanted(void);
+// creates the offscreen target for a width x height window and binds it in
+// place of the window; call once the context is current
+void render_scale_init(int width, int height);
+// draws the offscreen target scaled to the window with bar_height rows of
+// black at the top and bottom, and leaves the window bound; call right
+// before swapping. Returns 0 if there is no offscreen target.
+int render_scale_present(int bar_height);
+// called once per frame after swapping, picks the next frame's resolution
+// and binds the offscreen target again
+void render_scale_frame(void);
+// the resolution the game is rendered at; returns 0 if scaling is off
+int render_scale_size(int *width, int *height);
+
+void render_scale_glBindFramebuffer(GLenum target, GLuint framebuffer);
+void render_scale_glViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void render_scale_glScissor(GLint x, GLint y, GLsizei width, GLsizei height);
+void render_scale_glGetIntegerv(GLenum pname, GLint *data);
+void render_scale_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height,
+                               GLenum format, GLenum type, void *pixels);
+
+#endif // RENDER_SCALE_H
@@ -0,0 +1,790 @@
+/* shader_cache.c -- linked shader programs kept on disk between runs
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The engine compiles and links all of its shaders from source every time it
+// starts. With GL_OES_get_program_binary the driver can hand out a linked
+// program, so each one is saved to SHADER_CACHE_DIR after linking and given
+// back to the driver on the next run in place of compiling and linking it.
+//
+// A program's file is named after a hash of its shaders' sources and types,
+// its attribute bindings and the driver's vendor, renderer and version. The
+// driver strings are also kept in the directory, and when they change the
+// program files are removed, as the driver would reject them anyway. A binary
+// the driver doesn't accept is removed and the program is linked from source.
+//
+// Compiling is what takes the time, so glCompileShader only remembers that a
+// shader should be compiled if its source has compiled before, and the engine
+// is told it compiled without asking the driver. Such shaders are compiled
+// when a program using them isn't in the cache. Programs that have linked
+// before are likewise reported linked while their link is still going on.
+// The lists of those survive driver changes: the same source is expected to
+// compile with the next driver too, and a failure is logged if it doesn't.
+//
+// With async_shaders the compiling and linking is also taken off the game
+// thread, by the driver if it has GL_KHR_parallel_shader_compile or by a
+// worker thread with a shared context. The game thread then only waits for
+// a shader or program when it needs something the answers above don't cover,
+// such as using the program or looking up its uniforms.
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "draw_batch.h"
+#include "error.h"
+#include "gl_worker.h"
+#include "log.h"
+#include "shader_cache.h"
+#include "util.h"
+
+#define DRIVER_NAME SHADER_CACHE_DIR "/driver.txt"
+#define SHADERS_NAME SHADER_CACHE_DIR "/shaders.txt"
+#define PROGRAMS_NAME SHADER_CACHE_DIR "/programs.txt"
+#define BINARY_MAGIC "SHDRBIN1"
+
+typedef void(GL_APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+enum { OBJECT_NONE, OBJECT_SHADER, OBJECT_PROGRAM };
+enum { ASYNC_NONE, ASYNC_DRIVER, ASYNC_WORKER };
+enum { BINARY_REJECTED = -1, BINARY_MISSING, BINARY_LOADED };
+
+typedef struct {
+  uint64_t name_hash;
+  GLuint index;
+} Binding;
+
+typedef struct {
+  int kind;
+  GLuint name;
+  unsigned int job; // worker job still using the object, 0 if none
+  // shaders
+  GLenum type;
+  uint64_t hash;  // of the source, 0 until there is one
+  int deferred;   // glCompileShader was called but the driver wasn't
+  int compiling;  // the driver was, but the result wasn't looked at yet
+  // programs
+  GLuint shaders[SHADER_CACHE_MAX_SHADERS];
+  int num_shaders;
+  Binding bindings[SHADER_CACHE_MAX_ATTRIBS];
+  int num_bindings;
+  int uncacheable; // more shaders or bindings than fit above
+  int linking;     // the result of the last link wasn't looked at yet
+  uint64_t key;    // of the program file, 0 if not cached
+  uint64_t link_hash; // the same without the driver
+  // set up for the link, which may run on the worker
+  GLuint compile[SHADER_CACHE_MAX_SHADERS];
+  int num_compile;
+  int save_now;
+  // results of the link
+  int binary;
+  unsigned int compiled;
+  double ms;
+} Object;
+
+typedef struct {
+  char magic[8];
+  uint64_t key;
+  uint64_t checksum;
+  uint32_t format;
+  uint32_t length;
+} BinaryHeader;
+
+// open addressing with 0 as the empty slot
+typedef struct {
+  uint64_t *slots;
+  unsigned int capacity;
+  unsigned int count;
+} HashSet;
+
+ShaderCacheNext shader_cache_next;
+
+static Object *objects[SHADER_CACHE_MAX_OBJECTS];
+static int active = 0;
+static int async_mode = ASYNC_NONE;
+static GLuint current_program = 0;
+static uint64_t driver_hash;
+static PFNGLGETPROGRAMBINARYOESPROC get_program_binary;
+static PFNGLPROGRAMBINARYOESPROC program_binary;
+
+// sources known to compile and programs known to link
+static HashSet known_shaders;
+static HashSet known_programs;
+
+static struct {
+  unsigned int loaded;
+  unsigned int linked;
+  unsigned int rejected;
+  unsigned int compiled;
+  double load_ms;
+  double link_ms;
+  double wait_ms; // on the game thread
+} stats;
+
+static int set_contains(const HashSet *s, uint64_t hash) {
+  if (!s->capacity || !hash)
+    return 0;
+  for (unsigned int i = hash & (s->capacity - 1); s->slots[i];
+       i = (i + 1) & (s->capacity - 1)) {
+    if (s->slots[i] == hash)
+      return 1;
+  }
+  return 0;
+}
+
+static void set_insert(HashSet *s, uint64_t hash) {
+  if ((s->count + 1) * 2 > s->capacity) {
+    HashSet old = *s;
+    s->capacity = s->capacity ? s->capacity * 2 : 256;
+    s->slots = calloc(s->capacity, sizeof(*s->slots));
+    if (!s->slots)
+      fatal_error("Failed to allocate shader cache");
+    s->count = 0;
+    for (unsigned int i = 0; i < old.capacity; ++i) {
+      if (old.slots[i])
+        set_insert(s, old.slots[i]);
+    }
+    free(old.slots);
+  }
+  unsigned int i = hash & (s->capacity - 1);
+  while (s->slots[i] && s->slots[i] != hash)
+    i = (i + 1) & (s->capacity - 1);
+  if (!s->slots[i]) {
+    s->slots[i] = hash;
+    s->count++;
+  }
+}
+
+static void load_set(HashSet *s, const char *name) {
+  FILE *f = fopen(name, "r");
+  if (!f)
+    return;
+  unsigned long long hash;
+  while (fscanf(f, "%llx", &hash) == 1) {
+    if (hash)
+      set_insert(s, hash);
+  }
+  fclose(f);
+}
+
+static void remember(HashSet *s, const char *name, uint64_t hash) {
+  if (!hash || set_contains(s, hash))
+    return;
+  set_insert(s, hash);
+  FILE *f = fopen(name, "a");
+  if (f) {
+    fprintf(f, "%016llx\n", (unsigned long long)hash);
+    fclose(f);
+  }
+}
+
+static void remove_binaries(void) {
+  DIR *dir = opendir(SHADER_CACHE_DIR);
+  if (!dir)
+    return;
+  struct dirent *e;
+  char path[512];
+  while ((e = readdir(dir))) {
+    if (!strstr(e->d_name, ".bin"))
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", SHADER_CACHE_DIR, e->d_name);
+    unlink(path);
+  }
+  closedir(dir);
+}
+
+// drops the program files if they were made by another driver
+static void open_cache(const char *driver) {
+  mkdir(SHADER_CACHE_DIR, 0755);
+
+  char stored[512] = "";
+  FILE *f = fopen(DRIVER_NAME, "r");
+  if (f) {
+    if (!fgets(stored, sizeof(stored), f))
+      stored[0] = '\0';
+    fclose(f);
+    stored[strcspn(stored, "\n")] = '\0';
+  }
+  if (strcmp(stored, driver)) {
+    if (stored[0])
+      LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+                 "shader_cache: driver changed from %s, clearing the cache\n",
+                 stored);
+    remove_binaries();
+    f = fopen(DRIVER_NAME, "w");
+    if (f) {
+      fprintf(f, "%s\n", driver);
+      fclose(f);
+    }
+  }
+
+  load_set(&known_shaders, SHADERS_NAME);
+  load_set(&known_programs, PROGRAMS_NAME);
+}
+
+void shader_cache_init(SDL_Window *window, SDL_GLContext context) {
+  GLint formats = 0;
+  if (has_extension("GL_OES_get_program_binary"))
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+  get_program_binary = (void *)eglGetProcAddress("glGetProgramBinaryOES");
+  program_binary = (void *)eglGetProcAddress("glProgramBinaryOES");
+  if (formats <= 0 || !get_program_binary || !program_binary) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+               "shader_cache: the driver can't save programs, cache "
+               "disabled\n");
+    return;
+  }
+
+  const char *vendor = (const char *)glGetString(GL_VENDOR);
+  const char *renderer = (const char *)glGetString(GL_RENDERER);
+  const char *version = (const char *)glGetString(GL_VERSION);
+  char driver[512];
+  snprintf(driver, sizeof(driver), "%s | %s | %s", vendor ? vendor : "",
+           renderer ? renderer : "", version ? version : "");
+  driver[strcspn(driver, "\n")] = '\0';
+  driver_hash = hash_bytes(HASH_INIT, driver, strlen(driver));
+
+  open_cache(driver);
+  active = 1;
+
+  if (config.async_shaders) {
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_threads =
+        (void *)eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    if (has_extension("GL_KHR_parallel_shader_compile") && max_threads) {
+      max_threads(0xffffffff);
+      async_mode = ASYNC_DRIVER;
+    } else if (gl_worker_init(window, context)) {
+      async_mode = ASYNC_WORKER;
+    }
+  }
+  static const char *const mode_names[] = {"on the game thread",
+                                           "in the driver", "on a worker"};
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "shader_cache: %u shaders and %u programs known with %s, "
+             "compiling %s\n",
+             known_shaders.count, known_programs.count, driver,
+             mode_names[async_mode]);
+}
+
+static Object *get_object(GLuint name) {
+  if (!active || name == 0 || name >= SHADER_CACHE_MAX_OBJECTS)
+    return NULL;
+  return objects[name];
+}
+
+static Object *new_object(GLuint name, int kind) {
+  if (name == 0 || name >= SHADER_CACHE_MAX_OBJECTS)
+    return NULL;
+  if (!objects[name]) {
+    objects[name] = malloc(sizeof(Object));
+    if (!objects[name])
+      fatal_error("Failed to allocate shader cache");
+  }
+  memset(objects[name], 0, sizeof(Object));
+  objects[name]->kind = kind;
+  objects[name]->name = name;
+  return objects[name];
+}
+
+static void wait_job(Object *o) {
+  if (o->job) {
+    gl_worker_wait(o->job);
+    o->job = 0;
+  }
+}
+
+// the jobs call GL itself, as the layers below this one keep state of the
+// game thread's and must not run on the worker
+static void compile_job(void *arg) {
+  glCompileShader((GLuint)(uintptr_t)arg);
+}
+
+static void start_compile(Object *s) {
+  s->deferred = 0;
+  s->compiling = 1;
+  stats.compiled++;
+  if (async_mode == ASYNC_WORKER)
+    s->job = gl_worker_submit(compile_job, (void *)(uintptr_t)s->name);
+  else
+    shader_cache_next.glCompileShader(s->name);
+}
+
+// waits for the shader's compile and notes the source if it worked
+static void finish_shader(Object *s) {
+  double start = now_ms();
+  wait_job(s);
+  if (!s->compiling)
+    return;
+  s->compiling = 0;
+  GLint status = GL_FALSE;
+  shader_cache_next.glGetShaderiv(s->name, GL_COMPILE_STATUS, &status);
+  stats.wait_ms += now_ms() - start;
+  if (status == GL_TRUE)
+    remember(&known_shaders, SHADERS_NAME, s->hash);
+  else if (set_contains(&known_shaders, s->hash))
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_ERROR,
+               "shader_cache: shader %016llx compiled before but not now\n",
+               (unsigned long long)s->hash);
+}
+
+static void binary_name(char *buf, size_t size, uint64_t key) {
+  snprintf(buf, size, "%s/%016llx.bin", SHADER_CACHE_DIR,
+           (unsigned long long)key);
+}
+
+static int compare_uint64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static int compare_bindings(const void *a, const void *b) {
+  return compare_uint64(&((const Binding *)a)->name_hash,
+                        &((const Binding *)b)->name_hash);
+}
+
+// sets the program's key and link_hash, or leaves them 0 if one of its
+// shaders has no source to tell it apart
+static void program_key(Object *p) {
+  uint64_t shaders[SHADER_CACHE_MAX_SHADERS];
+  p->key = p->link_hash = 0;
+  if (p->uncacheable)
+    return;
+  for (int i = 0; i < p->num_shaders; ++i) {
+    Object *s = get_object(p->shaders[i]);
+    if (!s || s->kind != OBJECT_SHADER || !s->hash)
+      return;
+    shaders[i] = hash_bytes(s->hash, &s->type, sizeof(s->type));
+  }
+  // neither the attach nor the bind order matters to the driver
+  qsort(shaders, p->num_shaders, sizeof(*shaders), compare_uint64);
+  qsort(p->bindings, p->num_bindings, sizeof(*p->bindings), compare_bindings);
+
+  uint64_t h =
+      hash_bytes(HASH_INIT, shaders, p->num_shaders * sizeof(*shaders));
+  for (int i = 0; i < p->num_bindings; ++i) {
+    h = hash_bytes(h, &p->bindings[i].name_hash,
+                   sizeof(p->bindings[i].name_hash));
+    h = hash_bytes(h, &p->bindings[i].index, sizeof(p->bindings[i].index));
+  }
+  p->link_hash = h ? h : 1;
+  h = hash_bytes(h, &driver_hash, sizeof(driver_hash));
+  p->key = h ? h : 1;
+}
+
+// may run on the worker
+static int load_binary(GLuint program, uint64_t key) {
+  char name[256];
+  binary_name(name, sizeof(name), key);
+  FILE *f = fopen(name, "rb");
+  if (!f)
+    return BINARY_MISSING;
+
+  BinaryHeader header;
+  void *data = NULL;
+  int ok = fread(&header, sizeof(header), 1, f) == 1 &&
+           !memcmp(header.magic, BINARY_MAGIC, sizeof(header.magic)) &&
+           header.key == key && header.length > 0 &&
+           header.length <= SHADER_CACHE_MAX_BINARY &&
+           (data = malloc(header.length)) &&
+           fread(data, header.length, 1, f) == 1 &&
+           hash_bytes(HASH_INIT, data, header.length) == header.checksum;
+  fclose(f);
+
+  GLint status = GL_FALSE;
+  if (ok) {
+    program_binary(program, header.format, data, header.length);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+  }
+  free(data);
+  if (status != GL_TRUE) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "shader_cache: %s was rejected, linking from source\n", name);
+    unlink(name);
+    return BINARY_REJECTED;
+  }
+  return BINARY_LOADED;
+}
+
+// may run on the worker
+static void save_binary(GLuint program, uint64_t key) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+  if (length <= 0 || length > SHADER_CACHE_MAX_BINARY)
+    return;
+  void *data = malloc(length);
+  if (!data)
+    return;
+
+  BinaryHeader header = {.key = key};
+  GLenum format = 0;
+  GLsizei written = 0;
+  get_program_binary(program, length, &written, &format, data);
+  if (written <= 0) {
+    free(data);
+    return;
+  }
+  memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+  header.format = format;
+  header.length = written;
+  header.checksum = hash_bytes(HASH_INIT, data, written);
+
+  // written under another name first so that an interrupted write never
+  // leaves a file that looks complete
+  char name[256], tmp_name[260];
+  binary_name(name, sizeof(name), key);
+  snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", name);
+  FILE *f = fopen(tmp_name, "wb");
+  if (f) {
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(data, written, 1, f) == 1;
+    if (fclose(f) == 0 && ok)
+      rename(tmp_name, name);
+    else
+      unlink(tmp_name);
+  }
+  free(data);
+}
+
+// loads the program or compiles its deferred shaders and links it; runs on
+// the worker in ASYNC_WORKER mode and on the game thread otherwise
+static void link_job(void *arg) {
+  Object *p = arg;
+  double start = now_ms();
+  p->compiled = 0;
+  p->binary = p->key ? load_binary(p->name, p->key) : BINARY_MISSING;
+  if (p->binary != BINARY_LOADED) {
+    for (int i = 0; i < p->num_compile; ++i) {
+      // on the worker an earlier link may have compiled the shader already
+      GLint status = GL_FALSE;
+      if (async_mode == ASYNC_WORKER)
+        glGetShaderiv(p->compile[i], GL_COMPILE_STATUS, &status);
+      if (status != GL_TRUE) {
+        glCompileShader(p->compile[i]);
+        p->compiled++;
+      }
+    }
+    glLinkProgram(p->name);
+    if (p->key && p->save_now) {
+      GLint status = GL_FALSE;
+      glGetProgramiv(p->name, GL_LINK_STATUS, &status);
+      if (status == GL_TRUE)
+        save_binary(p->name, p->key);
+    }
+  }
+  p->ms = now_ms() - start;
+}
+
+// waits for the program's link, saves it if that wasn't done yet and notes
+// whether it worked
+static void finish_program(Object *p) {
+  if (!p->linking)
+    return;
+  double start = now_ms();
+  wait_job(p);
+  p->linking = 0;
+  GLint status = GL_FALSE;
+  glGetProgramiv(p->name, GL_LINK_STATUS, &status);
+  if (p->binary != BINARY_LOADED && p->key && !p->save_now &&
+      status == GL_TRUE)
+    save_binary(p->name, p->key);
+  stats.wait_ms += now_ms() - start;
+
+  stats.compiled += p->compiled;
+  if (p->binary == BINARY_LOADED) {
+    stats.loaded++;
+    stats.load_ms += p->ms;
+  } else {
+    stats.rejected += p->binary == BINARY_REJECTED;
+    stats.linked++;
+    stats.link_ms += p->ms;
+  }
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "shader_cache: program %u %s %016llx in %.2f ms\n", p->name,
+             p->binary == BINARY_LOADED ? "loaded from" : "linked as",
+             (unsigned long long)p->key, p->ms);
+
+  if (status == GL_TRUE)
+    remember(&known_programs, PROGRAMS_NAME, p->link_hash);
+  else if (set_contains(&known_programs, p->link_hash))
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_ERROR,
+               "shader_cache: program %u linked before but not now\n",
+               p->name);
+}
+
+GLuint shader_cache_glCreateShader(GLenum type) {
+  GLuint shader = shader_cache_next.glCreateShader(type);
+  Object *s = active ? new_object(shader, OBJECT_SHADER) : NULL;
+  if (s)
+    s->type = type;
+  return shader;
+}
+
+GLuint shader_cache_glCreateProgram(void) {
+  GLuint program = shader_cache_next.glCreateProgram();
+  if (active)
+    new_object(program, OBJECT_PROGRAM);
+  return program;
+}
+
+void shader_cache_glShaderSource(GLuint shader, GLsizei count,
+                                 const GLchar *const *string,
+                                 const GLint *length) {
+  Object *s = get_object(shader);
+  if (s)
+    finish_shader(s);
+  shader_cache_next.glShaderSource(shader, count, string, length);
+  if (!s || s->kind != OBJECT_SHADER)
+    return;
+  uint64_t h = HASH_INIT;
+  for (GLsizei i = 0; i < count; ++i) {
+    if (!string[i])
+      continue;
+    size_t len = length && length[i] >= 0 ? (size_t)length[i]
+                                          : strlen(string[i]);
+    h = hash_bytes(h, string[i], len);
+  }
+  s->hash = h ? h : 1;
+  // a new source needs compiling again
+  s->deferred = 0;
+}
+
+void shader_cache_glCompileShader(GLuint shader) {
+  Object *s = get_object(shader);
+  if (!s || s->kind != OBJECT_SHADER || !s->hash) {
+    shader_cache_next.glCompileShader(shader);
+    return;
+  }
+  finish_shader(s);
+  if (set_contains(&known_shaders, s->hash))
+    s->deferred = 1;
+  else
+    start_compile(s);
+}
+
+void shader_cache_glGetShaderiv(GLuint shader, GLenum pname, GLint *params) {
+  Object *s = get_object(shader);
+  if (s && (s->deferred || s->compiling)) {
+    if ((pname == GL_COMPILE_STATUS || pname == GL_INFO_LOG_LENGTH) &&
+        set_contains(&known_shaders, s->hash)) {
+      *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+      return;
+    }
+    if (s->deferred)
+      start_compile(s);
+    finish_shader(s);
+  }
+  shader_cache_next.glGetShaderiv(shader, pname, params);
+}
+
+void shader_cache_glGetShaderInfoLog(GLuint shader, GLsizei bufSize,
+                                     GLsizei *length, GLchar *infoLog) {
+  Object *s = get_object(shader);
+  if (s && (s->deferred || s->compiling)) {
+    if (set_contains(&known_shaders, s->hash)) {
+      if (length)
+        *length = 0;
+      if (bufSize > 0)
+        infoLog[0] = '\0';
+      return;
+    }
+    if (s->deferred)
+      start_compile(s);
+    finish_shader(s);
+  }
+  shader_cache_next.glGetShaderInfoLog(shader, bufSize, length, infoLog);
+}
+
+void shader_cache_glAttachShader(GLuint program, GLuint shader) {
+  Object *p = get_object(program), *s = get_object(shader);
+  if (p)
+    finish_program(p);
+  if (s)
+    finish_shader(s);
+  shader_cache_next.glAttachShader(program, shader);
+  if (!p || p->kind != OBJECT_PROGRAM || p->uncacheable) {
+    // nothing would compile a deferred shader at link time
+    if (s && s->deferred)
+      start_compile(s);
+    return;
+  }
+  for (int i = 0; i < p->num_shaders; ++i) {
+    if (p->shaders[i] == shader)
+      return;
+  }
+  if (p->num_shaders < SHADER_CACHE_MAX_SHADERS) {
+    p->shaders[p->num_shaders++] = shader;
+  } else {
+    p->uncacheable = 1;
+    for (int i = 0; i < p->num_shaders; ++i) {
+      Object *other = get_object(p->shaders[i]);
+      if (other && other->deferred)
+        start_compile(other);
+    }
+    if (s && s->deferred)
+      start_compile(s);
+  }
+}
+
+void shader_cache_glBindAttribLocation(GLuint program, GLuint index,
+                                       const GLchar *name) {
+  Object *p = get_object(program);
+  if (p)
+    finish_program(p);
+  shader_cache_next.glBindAttribLocation(program, index, name);
+  if (!p || p->kind != OBJECT_PROGRAM)
+    return;
+  uint64_t h = hash_bytes(HASH_INIT, name, strlen(name));
+  for (int i = 0; i < p->num_bindings; ++i) {
+    if (p->bindings[i].name_hash == h) {
+      p->bindings[i].index = index;
+      return;
+    }
+  }
+  if (p->num_bindings < SHADER_CACHE_MAX_ATTRIBS) {
+    p->bindings[p->num_bindings].name_hash = h;
+    p->bindings[p->num_bindings++].index = index;
+  } else {
+    p->uncacheable = 1;
+  }
+}
+
+void shader_cache_glLinkProgram(GLuint program) {
+  Object *p = get_object(program);
+  if (!p || p->kind != OBJECT_PROGRAM) {
+    shader_cache_next.glLinkProgram(program);
+    return;
+  }
+  finish_program(p);
+  program_key(p);
+
+  // whatever wasn't compiled yet is compiled if the program isn't loaded
+  p->num_compile = 0;
+  for (int i = 0; i < p->num_shaders; ++i) {
+    Object *s = get_object(p->shaders[i]);
+    if (s && s->deferred)
+      p->compile[p->num_compile++] = p->shaders[i];
+  }
+  p->save_now = async_mode != ASYNC_DRIVER;
+  p->linking = 1;
+
+  // a program in use can't be relinked on another context, the game would
+  // keep drawing with the old one
+  if (async_mode == ASYNC_WORKER && program != current_program) {
+    p->job = gl_worker_submit(link_job, p);
+    for (int i = 0; i < p->num_compile; ++i)
+      get_object(p->compile[i])->job = p->job;
+    return;
+  }
+  double start = now_ms();
+  for (int i = 0; i < p->num_shaders; ++i) {
+    Object *s = get_object(p->shaders[i]);
+    if (s)
+      wait_job(s);
+  }
+  // link_job calls GL directly, past draw_batch, and the program may be the
+  // one merged draws still held back use
+  draw_batch_flush();
+  link_job(p);
+  stats.wait_ms += now_ms() - start;
+  if (p->binary != BINARY_LOADED) {
+    for (int i = 0; i < p->num_compile; ++i) {
+      Object *s = get_object(p->compile[i]);
+      s->deferred = 0;
+      s->compiling = 1;
+    }
+  }
+  if (async_mode == ASYNC_NONE)
+    finish_program(p);
+}
+
+// the rest are only installed with async_shaders, they wait for a shader or
+// program whenever the game needs more than what was answered up front
+
+void shader_cache_glGetProgramiv(GLuint program, GLenum pname,
+                                 GLint *params) {
+  Object *p = get_object(program);
+  if (p && p->linking) {
+    if ((pname == GL_LINK_STATUS || pname == GL_INFO_LOG_LENGTH) &&
+        set_contains(&known_programs, p->link_hash)) {
+      *params = pname == GL_LINK_STATUS ? GL_TRUE : 0;
+      return;
+    }
+    finish_program(p);
+  }
+  shader_cache_next.glGetProgramiv(program, pname, params);
+}
+
+void shader_cache_glGetProgramInfoLog(GLuint program, GLsizei bufSize,
+                                      GLsizei *length, GLchar *infoLog) {
+  Object *p = get_object(program);
+  if (p && p->linking) {
+    if (set_contains(&known_programs, p->link_hash)) {
+      if (length)
+        *length = 0;
+      if (bufSize > 0)
+        infoLog[0] = '\0';
+      return;
+    }
+    finish_program(p);
+  }
+  shader_cache_next.glGetProgramInfoLog(program, bufSize, length, infoLog);
+}
+
+void shader_cache_glUseProgram(GLuint program) {
+  Object *p = get_object(program);
+  if (p)
+    finish_program(p);
+  shader_cache_next.glUseProgram(program);
+  current_program = program;
+}
+
+GLint shader_cache_glGetUniformLocation(GLuint program, const GLchar *name) {
+  Object *p = get_object(program);
+  if (p)
+    finish_program(p);
+  return shader_cache_next.glGetUniformLocation(program, name);
+}
+
+GLint shader_cache_glGetAttribLocation(GLuint program, const GLchar *name) {
+  Object *p = get_object(program);
+  if (p)
+    finish_program(p);
+  return shader_cache_next.glGetAttribLocation(program, name);
+}
+
+void shader_cache_glDeleteShader(GLuint shader) {
+  Object *s = get_object(shader);
+  if (s)
+    finish_shader(s);
+  shader_cache_next.glDeleteShader(shader);
+}
+
+void shader_cache_glDeleteProgram(GLuint program) {
+  Object *p = get_object(program);
+  if (p)
+    finish_program(p);
+  shader_cache_next.glDeleteProgram(program);
+}
+
+void shader_cache_report(void) {
+  if (!active)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "shader_cache: %u programs loaded in %.1f ms, %u linked from "
+             "source in %.1f ms, %u rejected; %u shaders compiled; %.1f ms "
+             "on the game thread\n",
+             stats.loaded, stats.load_ms, stats.linked, stats.link_ms,
+             stats.rejected, stats.compiled, stats.wait_ms);
+}
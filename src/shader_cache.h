@@ -0,0 +1,78 @@
+/* shader_cache.h -- linked shader programs kept on disk between runs
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <GLES2/gl2.h>
+#include <SDL2/SDL_video.h>
+
+// program binaries, the driver they were made with and the shaders and
+// programs known to compile and link are kept here
+#define SHADER_CACHE_DIR "conf/shadercache"
+// shader and program names above this are passed through uncached
+#define SHADER_CACHE_MAX_OBJECTS 4096
+#define SHADER_CACHE_MAX_SHADERS 4
+#define SHADER_CACHE_MAX_ATTRIBS 16
+// larger program binaries than this are taken to be corrupt
+#define SHADER_CACHE_MAX_BINARY (4 * 1024 * 1024)
+
+// functions the cached imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLCREATESHADERPROC glCreateShader;
+  PFNGLCREATEPROGRAMPROC glCreateProgram;
+  PFNGLSHADERSOURCEPROC glShaderSource;
+  PFNGLCOMPILESHADERPROC glCompileShader;
+  PFNGLGETSHADERIVPROC glGetShaderiv;
+  PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
+  PFNGLATTACHSHADERPROC glAttachShader;
+  PFNGLBINDATTRIBLOCATIONPROC glBindAttribLocation;
+  PFNGLLINKPROGRAMPROC glLinkProgram;
+  // only with async_shaders
+  PFNGLGETPROGRAMIVPROC glGetProgramiv;
+  PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog;
+  PFNGLUSEPROGRAMPROC glUseProgram;
+  PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+  PFNGLGETATTRIBLOCATIONPROC glGetAttribLocation;
+  PFNGLDELETESHADERPROC glDeleteShader;
+  PFNGLDELETEPROGRAMPROC glDeleteProgram;
+} ShaderCacheNext;
+
+extern ShaderCacheNext shader_cache_next;
+
+// checks what the driver supports and opens the cache; with async_shaders
+// this also starts compiling in the background, on a context shared with the
+// game's if the driver doesn't do that itself. Call with the game's context
+// current.
+void shader_cache_init(SDL_Window *window, SDL_GLContext context);
+// logs how many programs came from the cache, call when the game exits
+void shader_cache_report(void);
+
+GLuint shader_cache_glCreateShader(GLenum type);
+GLuint shader_cache_glCreateProgram(void);
+void shader_cache_glShaderSource(GLuint shader, GLsizei count,
+                                 const GLchar *const *string,
+                                 const GLint *length);
+void shader_cache_glCompileShader(GLuint shader);
+void shader_cache_glGetShaderiv(GLuint shader, GLenum pname, GLint *params);
+void shader_cache_glGetShaderInfoLog(GLuint shader, GLsizei bufSize,
+                                     GLsizei *length, GLchar *infoLog);
+void shader_cache_glAttachShader(GLuint program, GLuint shader);
+void shader_cache_glBindAttribLocation(GLuint program, GLuint index,
+                                       const GLchar *name);
+void shader_cache_glLinkProgram(GLuint program);
+void shader_cache_glGetProgramiv(GLuint program, GLenum pname, GLint *params);
+void shader_cache_glGetProgramInfoLog(GLuint program, GLsizei bufSize,
+                                      GLsizei *length, GLchar *infoLog);
+void shader_cache_glUseProgram(GLuint program);
+GLint shader_cache_glGetUniformLocation(GLuint program, const GLchar *name);
+GLint shader_cache_glGetAttribLocation(GLuint program, const GLchar *name);
+void shader_cache_glDeleteShader(GLuint shader);
+void shader_cache_glDeleteProgram(GLuint program);
+
+#endif // SHADER_CACHE_H
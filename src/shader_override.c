@@ -0,0 +1,249 @@
+/* shader_override.c -- hand-written replacements for the game's shaders
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// A few of the game's shaders take most of the GPU time, and those are worth
+// rewriting by hand for the GPUs the port runs on. Each source the game gives
+// glShaderSource is hashed (64-bit FNV-1a over the text as given, strings
+// joined) and if there is a file of that name in SHADER_OVERRIDE_DIR, that is
+// compiled instead. The replacements are taken as written, past the automatic
+// precision pass, so their author decides the precision.
+//
+// The hashes of the shaders without a replacement are logged at debug level
+// (log_levels gl=debug) to find which file name to give a new one. The
+// game's own compile and link status queries tell how each replacement did,
+// failures are logged with the driver's info log as they happen and the
+// counts when the game exits.
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "log.h"
+#include "shader_override.h"
+#include "util.h"
+
+typedef struct {
+  uint64_t hash;
+  char *source;
+  GLint length;
+  unsigned int shaders; // given it instead of the game's source
+  unsigned int compiled;
+  unsigned int compile_failed;
+  unsigned int linked;
+  unsigned int link_failed;
+} Override;
+
+// per GL name; shaders and programs share the names
+typedef struct {
+  uint16_t shader;     // override + 1 the shader was given, 0 for none
+  uint16_t program[2]; // overrides + 1 of the shaders attached to a program
+  uint8_t counted;     // compile status already counted
+} Object;
+
+ShaderOverrideNext shader_override_next;
+
+static Override overrides[SHADER_OVERRIDE_MAX];
+static int num_overrides = 0;
+static int loaded = 0;
+static Object objects[SHADER_OVERRIDE_MAX_OBJECTS];
+
+static int compare_override(const void *a, const void *b) {
+  uint64_t x = ((const Override *)a)->hash, y = ((const Override *)b)->hash;
+  return x < y ? -1 : x > y;
+}
+
+static char *read_file(const char *path, long *size) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  char *data = NULL;
+  if (fseek(f, 0, SEEK_END) == 0 && (*size = ftell(f)) >= 0 &&
+      fseek(f, 0, SEEK_SET) == 0) {
+    data = malloc(*size + 1);
+    if (!data)
+      fatal_error("Failed to allocate shader override");
+    if (fread(data, 1, *size, f) != (size_t)*size) {
+      free(data);
+      data = NULL;
+    } else {
+      data[*size] = '\0';
+    }
+  }
+  fclose(f);
+  return data;
+}
+
+// the directory is read on the first shader, which is after the game has
+// started and before anything is compiled
+static void load_overrides(void) {
+  loaded = 1;
+  DIR *dir = opendir(SHADER_OVERRIDE_DIR);
+  if (!dir)
+    return;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const char *name = entry->d_name;
+    char *end;
+    uint64_t hash = strtoull(name, &end, 16);
+    if (end != name + 16 || strcmp(end, ".txt") != 0)
+      continue;
+    if (num_overrides == SHADER_OVERRIDE_MAX) {
+      LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+                 "shader_override: more than %d overrides, ignoring %s\n",
+                 SHADER_OVERRIDE_MAX, name);
+      continue;
+    }
+
+    char path[512];
+    long size = 0;
+    snprintf(path, sizeof(path), "%s/%s", SHADER_OVERRIDE_DIR, name);
+    char *source = read_file(path, &size);
+    if (!source) {
+      LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+                 "shader_override: could not read %s\n", path);
+      continue;
+    }
+    overrides[num_overrides++] = (Override){hash, source, (GLint)size};
+  }
+  closedir(dir);
+
+  qsort(overrides, num_overrides, sizeof(Override), compare_override);
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "shader_override: %d overrides in %s\n", num_overrides,
+             SHADER_OVERRIDE_DIR);
+}
+
+static Override *find_override(uint64_t hash) {
+  Override key = {.hash = hash};
+  return bsearch(&key, overrides, num_overrides, sizeof(Override),
+                 compare_override);
+}
+
+void shader_override_glShaderSource(GLuint shader, GLsizei count,
+                                    const GLchar *const *string,
+                                    const GLint *length) {
+  if (!loaded)
+    load_overrides();
+
+  uint64_t hash = HASH_INIT;
+  for (GLsizei i = 0; i < count; ++i) {
+    if (string[i])
+      hash = hash_bytes(hash, string[i],
+                        length && length[i] >= 0 ? (size_t)length[i]
+                                                 : strlen(string[i]));
+  }
+  Override *o = find_override(hash);
+
+  if (shader < SHADER_OVERRIDE_MAX_OBJECTS) {
+    objects[shader].shader = o ? o - overrides + 1 : 0;
+    objects[shader].counted = 0;
+  }
+  if (!o) {
+    GLint type = 0;
+    glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+               "shader_override: no override for %s shader %016llx\n",
+               type == GL_VERTEX_SHADER ? "vertex" : "fragment",
+               (unsigned long long)hash);
+    shader_override_next.glShaderSource(shader, count, string, length);
+    return;
+  }
+
+  o->shaders++;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "shader_override: shader %u replaced by %016llx.txt\n", shader,
+             (unsigned long long)o->hash);
+  const GLchar *source = o->source;
+  shader_override_next.glShaderSourceVerbatim(shader, 1, &source, &o->length);
+}
+
+void shader_override_glGetShaderiv(GLuint shader, GLenum pname,
+                                   GLint *params) {
+  shader_override_next.glGetShaderiv(shader, pname, params);
+  if (pname != GL_COMPILE_STATUS || shader >= SHADER_OVERRIDE_MAX_OBJECTS ||
+      !objects[shader].shader || objects[shader].counted)
+    return;
+
+  Override *o = &overrides[objects[shader].shader - 1];
+  objects[shader].counted = 1;
+  if (*params == GL_TRUE) {
+    o->compiled++;
+    return;
+  }
+  o->compile_failed++;
+  char log[1024] = "";
+  shader_override_next.glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_ERROR,
+             "shader_override: %016llx.txt failed to compile:\n%s\n",
+             (unsigned long long)o->hash, log);
+}
+
+void shader_override_glAttachShader(GLuint program, GLuint shader) {
+  shader_override_next.glAttachShader(program, shader);
+  if (program >= SHADER_OVERRIDE_MAX_OBJECTS ||
+      shader >= SHADER_OVERRIDE_MAX_OBJECTS || !objects[shader].shader)
+    return;
+  uint16_t *slots = objects[program].program;
+  if (!slots[0])
+    slots[0] = objects[shader].shader;
+  else if (!slots[1])
+    slots[1] = objects[shader].shader;
+}
+
+void shader_override_glGetProgramiv(GLuint program, GLenum pname,
+                                    GLint *params) {
+  shader_override_next.glGetProgramiv(program, pname, params);
+  if (pname != GL_LINK_STATUS || program >= SHADER_OVERRIDE_MAX_OBJECTS ||
+      !objects[program].program[0])
+    return;
+
+  // counted once per link, which also forgets the shaders of a program
+  // whose name is reused later
+  uint16_t *slots = objects[program].program;
+  for (int i = 0; i < 2 && slots[i]; ++i) {
+    Override *o = &overrides[slots[i] - 1];
+    if (*params == GL_TRUE) {
+      o->linked++;
+    } else {
+      o->link_failed++;
+      LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_ERROR,
+                 "shader_override: program %u with %016llx.txt failed to "
+                 "link\n",
+                 program, (unsigned long long)o->hash);
+    }
+    slots[i] = 0;
+  }
+}
+
+void shader_override_report(void) {
+  if (!num_overrides)
+    return;
+  unsigned int used = 0, failed = 0;
+  for (int i = 0; i < num_overrides; ++i) {
+    const Override *o = &overrides[i];
+    if (!o->shaders) {
+      LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+                 "shader_override: %016llx.txt matched no shader\n",
+                 (unsigned long long)o->hash);
+      continue;
+    }
+    used++;
+    failed += o->compile_failed || o->link_failed;
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+               "shader_override: %016llx.txt in %u shaders, %u compiled, "
+               "%u failed; %u programs linked, %u failed\n",
+               (unsigned long long)o->hash, o->shaders, o->compiled,
+               o->compile_failed, o->linked, o->link_failed);
+  }
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "shader_override: %u of %d overrides used, %u failed\n", used,
+             num_overrides, failed);
+}
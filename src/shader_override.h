@@ -0,0 +1,46 @@
+/* shader_override.h -- hand-written replacements for the game's shaders
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef SHADER_OVERRIDE_H
+#define SHADER_OVERRIDE_H
+
+#include <GLES2/gl2.h>
+
+// a shader whose source hashes to 0123456789abcdef is replaced by
+// SHADER_OVERRIDE_DIR/0123456789abcdef.txt
+#define SHADER_OVERRIDE_DIR "gamedata/es2/overrides"
+#define SHADER_OVERRIDE_MAX 256
+// shader and program names above this are passed through uncounted
+#define SHADER_OVERRIDE_MAX_OBJECTS 4096
+
+// functions the override imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLSHADERSOURCEPROC glShaderSource;
+  // takes the replacement sources past the source transforms under this
+  PFNGLSHADERSOURCEPROC glShaderSourceVerbatim;
+  PFNGLGETSHADERIVPROC glGetShaderiv;
+  PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
+  PFNGLATTACHSHADERPROC glAttachShader;
+  PFNGLGETPROGRAMIVPROC glGetProgramiv;
+} ShaderOverrideNext;
+
+extern ShaderOverrideNext shader_override_next;
+
+// logs how each override compiled and linked, call when the game exits
+void shader_override_report(void);
+
+void shader_override_glShaderSource(GLuint shader, GLsizei count,
+                                    const GLchar *const *string,
+                                    const GLint *length);
+void shader_override_glGetShaderiv(GLuint shader, GLenum pname,
+                                   GLint *params);
+void shader_override_glAttachShader(GLuint program, GLuint shader);
+void shader_override_glGetProgramiv(GLuint program, GLenum pname,
+                                    GLint *params);
+
+#endif // SHADER_OVERRIDE_H
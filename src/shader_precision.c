@@ -0,0 +1,447 @@
+/* shader_precision.c -- lowers fragment shader precision where it is safe
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The engine's fragment shaders default to highp floats, which Mali and
+// PowerVR GPUs run at half the rate of mediump. The sources are split into
+// tokens, comments and preprocessor lines are passed through as they are,
+// and the default precision and explicit highp declarations are lowered to
+// mediump except for what needs the range or resolution:
+//
+//  - uniforms, which must have the same precision in the vertex shader and
+//    are given an explicit highp when the default is lowered under them
+//  - anything used in the coordinates of a texture lookup, which would lose
+//    texels on larger textures, including what is assigned to them or passed
+//    to a function for a parameter that is
+//  - anything computed from gl_FragCoord, which holds depth and pixel
+//    positions
+//
+// glreplay -P replays a trace with and without the rewrite and compares the
+// frames, to check what the rules let through.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "log.h"
+#include "shader_precision.h"
+
+enum { TOK_SPACE, TOK_IDENT, TOK_NUMBER, TOK_PUNCT, TOK_DIRECTIVE };
+
+typedef struct {
+  int kind;
+  int len;
+  const char *s;
+} Token;
+
+typedef struct {
+  Token *tokens;
+  int count;
+  int capacity;
+} TokenList;
+
+ShaderPrecisionNext shader_precision_next;
+
+static const char *const float_types[] = {"float", "vec2", "vec3", "vec4",
+                                          "mat2",  "mat3", "mat4"};
+static const char *const qualifiers[] = {"uniform", "varying", "const",
+                                         "attribute", "invariant", "in",
+                                         "out", "inout"};
+static const char *const lookups[] = {
+    "texture2D",        "texture2DProj",       "texture2DLod",
+    "texture2DProjLod", "texture2DLodEXT",     "texture2DProjLodEXT",
+    "textureCube",      "textureCubeLod",      "textureCubeLodEXT",
+    "shadow2DEXT",      "shadow2DProjEXT",     "texture2DGradEXT"};
+
+#define COUNT(a) (int)(sizeof(a) / sizeof(*(a)))
+
+static int is(const Token *t, const char *word) {
+  return t->kind != TOK_SPACE && (int)strlen(word) == t->len &&
+         !memcmp(t->s, word, t->len);
+}
+
+static int is_any(const Token *t, const char *const *words, int n) {
+  for (int i = 0; i < n; ++i) {
+    if (is(t, words[i]))
+      return 1;
+  }
+  return 0;
+}
+
+static int is_ident_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+static void push(TokenList *list, int kind, const char *s, int len) {
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity ? list->capacity * 2 : 256;
+    list->tokens = realloc(list->tokens, list->capacity * sizeof(Token));
+    if (!list->tokens)
+      fatal_error("Failed to allocate shader tokens");
+  }
+  list->tokens[list->count++] = (Token){kind, len, s};
+}
+
+// comments and whitespace become space tokens and preprocessor lines are kept
+// whole, the rewriting only looks at the rest
+static void tokenize(TokenList *list, const char *s, const char *end) {
+  int line_start = 1;
+  while (s < end) {
+    const char *start = s;
+    int kind;
+    if (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') {
+      while (s < end && (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')) {
+        if (*s == '\n')
+          line_start = 1;
+        s++;
+      }
+      push(list, TOK_SPACE, start, s - start);
+      continue;
+    }
+    if (s + 1 < end && s[0] == '/' && s[1] == '/') {
+      while (s < end && *s != '\n')
+        s++;
+      kind = TOK_SPACE;
+    } else if (s + 1 < end && s[0] == '/' && s[1] == '*') {
+      s += 2;
+      while (s + 1 < end && !(s[0] == '*' && s[1] == '/'))
+        s++;
+      s = s + 2 < end ? s + 2 : end;
+      kind = TOK_SPACE;
+    } else if (*s == '#' && line_start) {
+      while (s < end && *s != '\n') {
+        if (*s == '\\' && s + 1 < end && s[1] == '\n')
+          s++;
+        s++;
+      }
+      kind = TOK_DIRECTIVE;
+    } else if (is_ident_char(*s) && !(*s >= '0' && *s <= '9')) {
+      while (s < end && is_ident_char(*s))
+        s++;
+      kind = TOK_IDENT;
+    } else if ((*s >= '0' && *s <= '9') || (*s == '.' && s + 1 < end &&
+                                             s[1] >= '0' && s[1] <= '9')) {
+      while (s < end && (is_ident_char(*s) || *s == '.' ||
+                         ((*s == '+' || *s == '-') &&
+                          (s[-1] == 'e' || s[-1] == 'E'))))
+        s++;
+      kind = TOK_NUMBER;
+    } else {
+      s++;
+      kind = TOK_PUNCT;
+    }
+    line_start = 0;
+    push(list, kind, start, s - start);
+  }
+}
+
+typedef struct {
+  const Token *t;
+  int n;          // significant tokens
+  int *index;     // significant token -> token
+  const char **replace; // per token
+  int *insert_highp;    // per token
+  const Token **coords; // names used in texture coordinates
+  int num_coords;
+} Pass;
+
+#define SIG(i) (&p->t[p->index[i]])
+
+static int in_coords(const Pass *p, const Token *name) {
+  for (int i = 0; i < p->num_coords; ++i) {
+    if (p->coords[i]->len == name->len &&
+        !memcmp(p->coords[i]->s, name->s, name->len))
+      return 1;
+  }
+  return 0;
+}
+
+static void add_coord(Pass *p, const Token *name) {
+  if (!in_coords(p, name))
+    p->coords[p->num_coords++] = name;
+}
+
+// names in every argument but the sampler of every texture lookup
+static void find_coords(Pass *p) {
+  for (int i = 0; i + 1 < p->n; ++i) {
+    if (!is_any(SIG(i), lookups, COUNT(lookups)) || !is(SIG(i + 1), "("))
+      continue;
+    int depth = 0, past_sampler = 0;
+    for (int j = i + 1; j < p->n; ++j) {
+      const Token *t = SIG(j);
+      if (is(t, "("))
+        depth++;
+      else if (is(t, ")") && --depth == 0)
+        break;
+      else if (is(t, ",") && depth == 1)
+        past_sampler = 1;
+      else if (past_sampler && t->kind == TOK_IDENT && !is(SIG(j - 1), ".") &&
+               !(j + 1 < p->n && is(SIG(j + 1), "(")))
+        add_coord(p, t);
+    }
+  }
+}
+
+// whether the name at significant token i, followed by "(", is that of a
+// function being defined or declared rather than called
+static int is_function_declarator(const Pass *p, int i) {
+  const Token *prev = SIG(i - 1);
+  return prev->kind == TOK_IDENT && !is(prev, "return") && !is(prev, "else");
+}
+
+// adds the names in the arguments of a call to the function named at
+// significant token i for the parameters set in params
+static void add_call_arguments(Pass *p, int i, unsigned int params) {
+  int depth = 0, arg = 0;
+  for (int j = i + 1; j < p->n; ++j) {
+    const Token *t = SIG(j);
+    if (is(t, "("))
+      depth++;
+    else if (is(t, ")") && --depth == 0)
+      break;
+    else if (is(t, ",") && depth == 1)
+      arg++;
+    else if (arg < 32 && (params >> arg & 1) && t->kind == TOK_IDENT &&
+             !is(SIG(j - 1), ".") && !(j + 1 < p->n && is(SIG(j + 1), "(")))
+      add_coord(p, t);
+  }
+}
+
+// an argument passed for a parameter that is a coordinate is a coordinate
+// too, e.g. the varying in f(uv * 0.5)
+static void propagate_calls(Pass *p) {
+  for (int i = 1; i + 1 < p->n; ++i) {
+    if (SIG(i)->kind != TOK_IDENT || !is(SIG(i + 1), "(") ||
+        !is_function_declarator(p, i))
+      continue;
+    // the parameters' names come right before a "," or the closing ")"
+    unsigned int params = 0;
+    int depth = 0, arg = 0;
+    for (int j = i + 1; j < p->n; ++j) {
+      const Token *t = SIG(j);
+      if (is(t, "("))
+        depth++;
+      else if (is(t, ")") && --depth == 0)
+        break;
+      else if (is(t, ",") && depth == 1)
+        arg++;
+      else if (depth == 1 && arg < 32 && t->kind == TOK_IDENT &&
+               j + 1 < p->n &&
+               (is(SIG(j + 1), ",") || is(SIG(j + 1), ")")) &&
+               in_coords(p, t))
+        params |= 1u << arg;
+    }
+    if (!params)
+      continue;
+    const Token *name = SIG(i);
+    for (int k = 1; k + 1 < p->n; ++k) {
+      if (SIG(k)->len == name->len && !memcmp(SIG(k)->s, name->s, name->len) &&
+          is(SIG(k + 1), "(") && !is_function_declarator(p, k))
+        add_call_arguments(p, k, params);
+    }
+  }
+}
+
+// what is assigned to a coordinate is a coordinate too; repeated until no
+// new names turn up, so temporaries a lookup is computed through stay highp
+static void propagate_coords(Pass *p) {
+  int before;
+  do {
+    before = p->num_coords;
+    propagate_calls(p);
+    for (int i = 0; i + 1 < p->n; ++i) {
+      if (SIG(i)->kind != TOK_IDENT || !in_coords(p, SIG(i)))
+        continue;
+      int j = i + 1;
+      if (j + 1 < p->n && SIG(j + 1)->len == 1 && *SIG(j + 1)->s == '=' &&
+          SIG(j)->len == 1 && strchr("+-*/", *SIG(j)->s))
+        j++;
+      if (!is(SIG(j), "=") || (j + 1 < p->n && is(SIG(j + 1), "=")))
+        continue;
+      int depth = 0;
+      for (j++; j < p->n; ++j) {
+        const Token *t = SIG(j);
+        if (is(t, "("))
+          depth++;
+        else if (is(t, ")") && --depth < 0)
+          break;
+        else if (depth == 0 && (is(t, ";") || is(t, ",")))
+          break;
+        else if (t->kind == TOK_IDENT && !is(SIG(j - 1), ".") &&
+                 !(j + 1 < p->n && is(SIG(j + 1), "(")))
+          add_coord(p, t);
+      }
+    }
+  } while (p->num_coords != before);
+}
+
+// looks at the declaration whose type is significant token i; returns the
+// number of precisions changed
+static int lower_declaration(Pass *p, int i, int default_lowered) {
+  int prec = i > 0 && (is(SIG(i - 1), "highp") || is(SIG(i - 1), "mediump") ||
+                       is(SIG(i - 1), "lowp"))
+                 ? i - 1
+                 : -1;
+  int uniform = 0;
+  for (int j = (prec >= 0 ? prec : i) - 1;
+       j >= 0 && is_any(SIG(j), qualifiers, COUNT(qualifiers)); --j)
+    uniform |= is(SIG(j), "uniform");
+
+  // the declared names and their initializers, up to the end of the
+  // statement or parameter
+  int keep_high = uniform;
+  int j = i + 1;
+  while (j < p->n && SIG(j)->kind == TOK_IDENT) {
+    if (j + 1 < p->n && is(SIG(j + 1), "("))
+      return 0; // a function's return type
+    keep_high |= in_coords(p, SIG(j));
+    int depth = 0;
+    for (j++; j < p->n; ++j) {
+      const Token *t = SIG(j);
+      if (is(t, "(") || is(t, "["))
+        depth++;
+      else if ((is(t, ")") || is(t, "]")) && --depth < 0)
+        break;
+      else if (depth == 0 && (is(t, ";") || is(t, ",")))
+        break;
+      else if (is(t, "gl_FragCoord"))
+        keep_high = 1;
+    }
+    // another declarator follows the comma, a parameter follows with its type
+    if (j + 1 >= p->n || !is(SIG(j), ",") ||
+        is_any(SIG(j + 1), float_types, COUNT(float_types)) ||
+        is_any(SIG(j + 1), qualifiers, COUNT(qualifiers)) ||
+        is(SIG(j + 1), "highp") || is(SIG(j + 1), "mediump") ||
+        is(SIG(j + 1), "lowp"))
+      break;
+    j++;
+  }
+
+  if (prec >= 0 && is(SIG(prec), "highp") && !keep_high) {
+    p->replace[p->index[prec]] = "mediump";
+    return 1;
+  }
+  if (prec < 0 && default_lowered && keep_high)
+    p->insert_highp[p->index[i]] = 1;
+  return 0;
+}
+
+char *shader_precision_rewrite(const char *source, size_t length) {
+  TokenList list = {0};
+  tokenize(&list, source, source + length);
+
+  Pass pass = {.t = list.tokens};
+  Pass *p = &pass;
+  p->index = malloc(list.count * sizeof(*p->index));
+  p->replace = calloc(list.count, sizeof(*p->replace));
+  p->insert_highp = calloc(list.count, sizeof(*p->insert_highp));
+  p->coords = malloc(list.count * sizeof(*p->coords));
+  if (!p->index || !p->replace || !p->insert_highp || !p->coords)
+    fatal_error("Failed to allocate shader tokens");
+  for (int i = 0; i < list.count; ++i) {
+    if (list.tokens[i].kind != TOK_SPACE &&
+        list.tokens[i].kind != TOK_DIRECTIVE)
+      p->index[p->n++] = i;
+  }
+
+  int default_lowered = 0, lowered = 0, kept = 0;
+  for (int i = 0; i + 3 < p->n; ++i) {
+    if (is(SIG(i), "precision") && is(SIG(i + 1), "highp") &&
+        is(SIG(i + 2), "float") && is(SIG(i + 3), ";")) {
+      p->replace[p->index[i + 1]] = "mediump";
+      default_lowered = 1;
+    }
+  }
+  find_coords(p);
+  propagate_coords(p);
+  for (int i = 0; i < p->n; ++i) {
+    if (!is_any(SIG(i), float_types, COUNT(float_types)) ||
+        (i + 1 < p->n && is(SIG(i + 1), "(")) ||
+        (i > 0 && is(SIG(i - 1), "precision")))
+      continue;
+    lowered += lower_declaration(p, i, default_lowered);
+    kept += p->insert_highp[p->index[i]];
+  }
+  char *out = NULL;
+  if (!default_lowered && !lowered)
+    goto done;
+
+  // "mediump" is two characters longer than the "highp" it replaces
+  out = malloc(length + kept * 6 + (default_lowered + lowered) * 2 + 1);
+  if (!out)
+    fatal_error("Failed to allocate shader source");
+  char *o = out;
+  for (int i = 0; i < list.count; ++i) {
+    const Token *t = &list.tokens[i];
+    if (p->insert_highp[i]) {
+      memcpy(o, "highp ", 6);
+      o += 6;
+    }
+    if (p->replace[i]) {
+      size_t len = strlen(p->replace[i]);
+      memcpy(o, p->replace[i], len);
+      o += len;
+    } else {
+      memcpy(o, t->s, t->len);
+      o += t->len;
+    }
+  }
+  *o = '\0';
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "shader_precision: %s%d declarations lowered, %d kept at highp\n",
+             default_lowered ? "default lowered, " : "", lowered, kept);
+
+done:
+  free(p->index);
+  free(p->replace);
+  free(p->insert_highp);
+  free(p->coords);
+  free(list.tokens);
+  return out;
+}
+
+void shader_precision_glShaderSource(GLuint shader, GLsizei count,
+                                     const GLchar *const *string,
+                                     const GLint *length) {
+  GLint type = 0;
+  glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+  if (type != GL_FRAGMENT_SHADER || count <= 0) {
+    shader_precision_next.glShaderSource(shader, count, string, length);
+    return;
+  }
+
+  size_t total = 0;
+  for (GLsizei i = 0; i < count; ++i) {
+    if (string[i])
+      total += length && length[i] >= 0 ? (size_t)length[i] : strlen(string[i]);
+  }
+  char *joined = malloc(total + 1);
+  if (!joined)
+    fatal_error("Failed to allocate shader source");
+  char *o = joined;
+  for (GLsizei i = 0; i < count; ++i) {
+    if (!string[i])
+      continue;
+    size_t len =
+        length && length[i] >= 0 ? (size_t)length[i] : strlen(string[i]);
+    memcpy(o, string[i], len);
+    o += len;
+  }
+  *o = '\0';
+
+  char *rewritten = shader_precision_rewrite(joined, total);
+  if (rewritten) {
+    const GLchar *s = rewritten;
+    shader_precision_next.glShaderSource(shader, 1, &s, NULL);
+  } else {
+    shader_precision_next.glShaderSource(shader, count, string, length);
+  }
+  free(rewritten);
+  free(joined);
+}
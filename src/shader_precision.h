@@ -0,0 +1,30 @@
+/* shader_precision.h -- lowers fragment shader precision where it is safe
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef SHADER_PRECISION_H
+#define SHADER_PRECISION_H
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+
+// functions the rewriting import forwards to, filled in by update_imports
+typedef struct {
+  PFNGLSHADERSOURCEPROC glShaderSource;
+} ShaderPrecisionNext;
+
+extern ShaderPrecisionNext shader_precision_next;
+
+// returns the fragment shader source with highp lowered to mediump where
+// that is safe, or NULL if nothing was changed; free the result
+char *shader_precision_rewrite(const char *source, size_t length);
+
+void shader_precision_glShaderSource(GLuint shader, GLsizei count,
+                                     const GLchar *const *string,
+                                     const GLint *length);
+
+#endif // SHADER_PRECISION_H
@@ -418,8 +418,8 @@ int so_relocate(void) {
   return 0;
 }
 
-int so_resolve(DynLibFunction *funcs, int num_funcs,
-               int taint_missing_imports) {
+int so_resolve(DynLibFunction *funcs, int num_funcs, int taint_missing_imports,
+               uintptr_t (*bind)(const char *symbol, uintptr_t func)) {
   for (int i = 0; i < elf_hdr->e_shnum; i++) {
     char *sh_name = shstrtab + sec_hdr[i].sh_name;
     if (strcmp(sh_name, ".rela.dyn") == 0 ||
@@ -443,6 +443,10 @@ int so_resolve(DynLibFunction *funcs, int num_funcs,
             for (int k = 0; k < num_funcs; k++) {
               if (strcmp(name, funcs[k].symbol) == 0) {
                 *ptr = funcs[k].func;
+                // only calls go through the PLT; GLOB_DAT slots can hold
+                // data or function addresses the game compares
+                if (bind && type == R_AARCH64_JUMP_SLOT)
+                  *ptr = bind(funcs[k].symbol, funcs[k].func);
                 break;
               }
             }
@@ -33,7 +33,9 @@ void so_flush_caches(void);
 void so_free_temp(void);
 int so_load(const char *filename, void *base, size_t max_size);
 int so_relocate(void);
-int so_resolve(DynLibFunction *funcs, int num_funcs, int taint_missing_imports);
+// bind, if set, may substitute what each PLT slot is bound to
+int so_resolve(DynLibFunction *funcs, int num_funcs, int taint_missing_imports,
+               uintptr_t (*bind)(const char *symbol, uintptr_t func));
 void so_execute_init_array(void);
 uintptr_t so_find_addr(const char *symbol);
 uintptr_t so_find_addr_rx(const char *symbol);
@@ -0,0 +1,542 @@
+/* texture_budget.c -- keeps the game's textures within a memory budget
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Every level the game uploads is counted against the texture bound at the
+// time, and deleting a texture takes it off again. When the total goes over
+// texture_budget megabytes, the textures that haven't been bound for a while
+// lose their top level, least recently bound first: each level moves up one
+// step, so the texture is half the size and a quarter of the memory. Once the
+// total is comfortably under the budget again, the most recently bound ones
+// get their levels back. Both are done after the swap and only a few
+// megabytes of uploads per frame, one level per texture at a time.
+//
+// GLES2 can neither read a texture back nor start its chain at a later level,
+// so dropping and restoring both upload the whole chain again from a copy.
+// The copies of the textures that could be dropped (mipmapped, from the
+// game's data and large enough to be worth it) are written to a deleted file
+// in TEXTURE_BUDGET_SPILL_DIR as they're uploaded, which keeps them out of
+// memory but for the page cache, and their space is given back to the file
+// system with the textures. The levels past the end of a shortened chain are
+// left as they were; GL doesn't use them and they're a few bytes.
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "draw_batch.h"
+#include "error.h"
+#include "log.h"
+#include "texture_budget.h"
+#include "util.h"
+
+typedef struct {
+  int present;
+  int compressed;
+  GLenum internalformat;
+  GLenum format; // for uncompressed levels
+  GLenum type;
+  GLsizei width;
+  GLsizei height;
+  GLsizei size;  // bytes of data as uploaded
+  size_t memory; // estimate of what the driver allocates
+  off_t offset;  // of the copy in the spill file, -1 if there is none
+} Level;
+
+typedef struct {
+  GLuint name;
+  int cube;       // cube maps are counted but left alone
+  int kept;       // levels are copied to the spill file
+  int chain;      // levels in the complete chain, 0 until it is
+  int dropped;    // top levels left out
+  unsigned int last_bound;
+  unsigned int upload_frame;
+  unsigned int drops;
+  Level levels[TEXTURE_BUDGET_MAX_LEVELS];
+} Texture;
+
+TextureBudgetNext texture_budget_next;
+
+static Texture **textures = NULL; // by texture name
+static GLuint num_textures = 0;
+static Texture **candidates = NULL;
+static unsigned int frame = 0;
+static int spill_fd = -1;
+static int spill_failed = 0;
+static off_t spill_end = 0;
+static uint8_t *scratch = NULL;
+static size_t scratch_size = 0;
+
+static TextureBudgetStats totals;
+
+static struct {
+  unsigned long long peak;
+  unsigned long long spilled;
+  unsigned long long uploaded;
+  unsigned int drops;
+  unsigned int restores;
+  unsigned int over_frames; // over the budget with nothing left to drop
+} stats;
+
+static unsigned long long budget_bytes(void) {
+  return (unsigned long long)config.texture_budget * 1024 * 1024;
+}
+
+static Texture *find_texture(GLuint name) {
+  return name < num_textures ? textures[name] : NULL;
+}
+
+static Texture *get_texture(GLuint name) {
+  if (name >= num_textures) {
+    GLuint num = name * 2 + 64;
+    Texture **grown = realloc(textures, num * sizeof(*grown));
+    Texture **grown_candidates =
+        realloc(candidates, num * sizeof(*grown_candidates));
+    if (!grown || !grown_candidates)
+      fatal_error("Failed to allocate texture budget");
+    memset(grown + num_textures, 0, (num - num_textures) * sizeof(*grown));
+    textures = grown;
+    candidates = grown_candidates;
+    num_textures = num;
+  }
+  if (!textures[name]) {
+    Texture *t = calloc(1, sizeof(*t));
+    if (!t)
+      fatal_error("Failed to allocate texture budget");
+    t->name = name;
+    t->last_bound = frame;
+    for (int i = 0; i < TEXTURE_BUDGET_MAX_LEVELS; ++i)
+      t->levels[i].offset = -1;
+    textures[name] = t;
+    totals.textures++;
+  }
+  return textures[name];
+}
+
+// adds (sign 1) or takes off (sign -1) the texture's share of the totals;
+// done around every change to it
+static void account(const Texture *t, int sign) {
+  unsigned long long resident = 0, saved = 0;
+  for (int i = 0; i < TEXTURE_BUDGET_MAX_LEVELS; ++i) {
+    const Level *l = &t->levels[i];
+    if (!l->present)
+      continue;
+    if (i < t->dropped)
+      saved += l->memory;
+    else
+      resident += l->memory * (t->cube ? 6 : 1);
+  }
+  if (sign > 0) {
+    totals.resident += resident;
+    totals.saved += saved;
+    totals.dropped += t->dropped > 0;
+    if (totals.resident > stats.peak)
+      stats.peak = totals.resident;
+  } else {
+    totals.resident -= resident;
+    totals.saved -= saved;
+    totals.dropped -= t->dropped > 0;
+  }
+}
+
+static void release_copy(Level *l) {
+  if (l->offset >= 0)
+    fallocate(spill_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, l->offset,
+              l->size);
+  l->offset = -1;
+}
+
+static void release_copies(Texture *t) {
+  for (int i = 0; i < TEXTURE_BUDGET_MAX_LEVELS; ++i)
+    release_copy(&t->levels[i]);
+  t->kept = 0;
+  t->chain = 0;
+}
+
+static int open_spill(void) {
+  if (spill_fd >= 0 || spill_failed)
+    return spill_fd >= 0;
+  char path[] = TEXTURE_BUDGET_SPILL_DIR "/texbudget.XXXXXX";
+  spill_fd = mkstemp(path);
+  if (spill_fd < 0) {
+    spill_failed = 1;
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "texture_budget: could not create %s, no levels will be "
+               "dropped\n",
+               path);
+    return 0;
+  }
+  unlink(path);
+  return 1;
+}
+
+static void keep_copy(Texture *t, Level *l, const void *data) {
+  if (!open_spill() ||
+      pwrite(spill_fd, data, l->size, spill_end) != (ssize_t)l->size) {
+    // most likely out of disk space; the texture stays as it is
+    release_copies(t);
+    return;
+  }
+  l->offset = spill_end;
+  spill_end += l->size;
+  stats.spilled += l->size;
+}
+
+// the number of levels if they make a complete chain down to 1x1, else 0
+static int chain_length(const Texture *t) {
+  const Level *base = &t->levels[0];
+  if (!base->present)
+    return 0;
+  for (int i = 0; i < TEXTURE_BUDGET_MAX_LEVELS; ++i) {
+    const Level *l = &t->levels[i];
+    GLsizei w = base->width >> i ? base->width >> i : 1;
+    GLsizei h = base->height >> i ? base->height >> i : 1;
+    if (!l->present || l->offset < 0 || l->width != w || l->height != h ||
+        l->internalformat != base->internalformat)
+      return 0;
+    if (w == 1 && h == 1)
+      return i + 1;
+  }
+  return 0;
+}
+
+// uploads the texture's chain without its top dropped levels; returns the
+// bytes uploaded, or 0 if the copies couldn't be read
+static size_t upload_chain(Texture *t, int dropped) {
+  size_t size = 0;
+  for (int i = dropped; i < t->chain; ++i)
+    size += t->levels[i].size;
+  if (size > scratch_size) {
+    uint8_t *grown = realloc(scratch, size);
+    if (!grown)
+      fatal_error("Failed to allocate texture budget");
+    scratch = grown;
+    scratch_size = size;
+  }
+  // everything is read first so that a failure leaves the texture alone
+  size_t pos = 0;
+  for (int i = dropped; i < t->chain; ++i) {
+    const Level *l = &t->levels[i];
+    if (pread(spill_fd, scratch + pos, l->size, l->offset) !=
+        (ssize_t)l->size) {
+      LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+                 "texture_budget: could not read texture %u back\n", t->name);
+      return 0;
+    }
+    pos += l->size;
+  }
+
+  // merged draws still held back must be drawn with the game's binding
+  draw_batch_flush();
+  GLint bound = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+  if ((GLuint)bound != t->name)
+    glBindTexture(GL_TEXTURE_2D, t->name);
+  pos = 0;
+  for (int i = dropped; i < t->chain; ++i) {
+    const Level *l = &t->levels[i];
+    if (l->compressed)
+      texture_budget_next.glCompressedTexImage2D(
+          GL_TEXTURE_2D, i - dropped, l->internalformat, l->width, l->height,
+          0, l->size, scratch + pos);
+    else
+      texture_budget_next.glTexImage2D(GL_TEXTURE_2D, i - dropped,
+                                       l->internalformat, l->width, l->height,
+                                       0, l->format, l->type, scratch + pos);
+    pos += l->size;
+  }
+  if ((GLuint)bound != t->name)
+    glBindTexture(GL_TEXTURE_2D, bound);
+  stats.uploaded += size;
+  return size;
+}
+
+static size_t set_dropped(Texture *t, int dropped) {
+  size_t size = upload_chain(t, dropped);
+  if (!size) {
+    // the copy is no good, so the texture is kept as it is from now on
+    if (!t->dropped)
+      release_copies(t);
+    return 0;
+  }
+  account(t, -1);
+  if (dropped > t->dropped) {
+    stats.drops++;
+    t->drops++;
+  } else {
+    stats.restores++;
+  }
+  t->dropped = dropped;
+  account(t, 1);
+  return size;
+}
+
+// the texture bound to target before the game changes one of its levels
+static Texture *upload_texture(GLenum target, GLint level) {
+  if (level < 0 || level >= TEXTURE_BUDGET_MAX_LEVELS)
+    return NULL;
+  GLenum binding;
+  if (target == GL_TEXTURE_2D)
+    binding = GL_TEXTURE_BINDING_2D;
+  else if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X &&
+           target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z)
+    binding = GL_TEXTURE_BINDING_CUBE_MAP;
+  else
+    return NULL;
+  GLint name = 0;
+  glGetIntegerv(binding, &name);
+  if (name <= 0)
+    return NULL;
+
+  Texture *t = get_texture(name);
+  // the game's levels are where it thinks they are before it changes any
+  if (t->dropped)
+    set_dropped(t, 0);
+  if (level == 0 && target == GL_TEXTURE_2D) {
+    account(t, -1);
+    release_copies(t);
+    memset(t->levels, 0, sizeof(t->levels));
+    for (int i = 0; i < TEXTURE_BUDGET_MAX_LEVELS; ++i)
+      t->levels[i].offset = -1;
+    t->dropped = 0;
+    account(t, 1);
+  }
+  t->cube = target != GL_TEXTURE_2D;
+  return t;
+}
+
+static void record_level(Texture *t, GLint level, const Level *info,
+                         const void *data) {
+  Level *l = &t->levels[level];
+  account(t, -1);
+  release_copy(l);
+  *l = *info;
+  l->present = 1;
+  l->offset = -1;
+  account(t, 1);
+
+  t->upload_frame = frame;
+  t->chain = 0;
+  if (level == 0)
+    t->kept = !t->cube && data &&
+              info->width * info->height >= TEXTURE_BUDGET_MIN_PIXELS;
+  if (t->kept) {
+    if (data)
+      keep_copy(t, l, data);
+    else
+      release_copies(t);
+  }
+}
+
+void texture_budget_glTexImage2D(GLenum target, GLint level,
+                                 GLint internalformat, GLsizei width,
+                                 GLsizei height, GLint border, GLenum format,
+                                 GLenum type, const void *pixels) {
+  Texture *t = upload_texture(target, level);
+  texture_budget_next.glTexImage2D(target, level, internalformat, width,
+                                   height, border, format, type, pixels);
+  if (!t || width <= 0 || height <= 0)
+    return;
+
+  int bpp = pixel_size(format, type);
+  Level info = {
+      .internalformat = internalformat,
+      .format = format,
+      .type = type,
+      .width = width,
+      .height = height,
+      .size = image_size(width, height, format, type),
+      // drivers keep RGB with a fourth byte
+      .memory = (size_t)width * height * (bpp == 3 ? 4 : bpp),
+  };
+  record_level(t, level, &info, pixels);
+}
+
+void texture_budget_glCompressedTexImage2D(GLenum target, GLint level,
+                                           GLenum internalformat,
+                                           GLsizei width, GLsizei height,
+                                           GLint border, GLsizei imageSize,
+                                           const void *data) {
+  // with disable_mipmaps only the first level gets to GL
+  if (config.disable_mipmaps && level > 0) {
+    texture_budget_next.glCompressedTexImage2D(target, level, internalformat,
+                                               width, height, border,
+                                               imageSize, data);
+    return;
+  }
+  Texture *t = upload_texture(target, level);
+  texture_budget_next.glCompressedTexImage2D(target, level, internalformat,
+                                             width, height, border, imageSize,
+                                             data);
+  if (!t || width <= 0 || height <= 0 || imageSize <= 0)
+    return;
+
+  Level info = {
+      .compressed = 1,
+      .internalformat = internalformat,
+      .width = width,
+      .height = height,
+      .size = imageSize,
+      .memory = imageSize,
+  };
+  record_level(t, level, &info, data);
+}
+
+void texture_budget_glBindTexture(GLenum target, GLuint texture) {
+  Texture *t = find_texture(texture);
+  if (t)
+    t->last_bound = frame;
+  texture_budget_next.glBindTexture(target, texture);
+}
+
+void texture_budget_glDeleteTextures(GLsizei n, const GLuint *names) {
+  for (GLsizei i = 0; i < n; ++i) {
+    Texture *t = find_texture(names[i]);
+    if (!t)
+      continue;
+    account(t, -1);
+    release_copies(t);
+    textures[names[i]] = NULL;
+    totals.textures--;
+    free(t);
+  }
+  texture_budget_next.glDeleteTextures(n, names);
+}
+
+static int least_recent_first(const void *a, const void *b) {
+  const Texture *ta = *(Texture *const *)a, *tb = *(Texture *const *)b;
+  return ta->last_bound < tb->last_bound   ? -1
+         : ta->last_bound > tb->last_bound ? 1
+                                           : 0;
+}
+
+static int most_recent_first(const void *a, const void *b) {
+  return least_recent_first(b, a);
+}
+
+// textures that can lose another level, least recently bound first
+static int drop_candidates(void) {
+  int n = 0;
+  for (GLuint i = 0; i < num_textures; ++i) {
+    Texture *t = textures[i];
+    if (!t || !t->kept || t->dropped >= TEXTURE_BUDGET_MAX_DROP ||
+        frame - t->last_bound < TEXTURE_BUDGET_IDLE_FRAMES)
+      continue;
+    // the whole chain has been seen once the game is past the frame it was
+    // uploaded in; if it isn't complete by then the copies are of no use
+    if (!t->chain && t->upload_frame != frame) {
+      t->chain = chain_length(t);
+      if (!t->chain) {
+        release_copies(t);
+        continue;
+      }
+    }
+    if (t->chain - t->dropped > 1)
+      candidates[n++] = t;
+  }
+  qsort(candidates, n, sizeof(*candidates), least_recent_first);
+  return n;
+}
+
+// textures with levels left out, most recently bound first
+static int restore_candidates(void) {
+  int n = 0;
+  for (GLuint i = 0; i < num_textures; ++i) {
+    if (textures[i] && textures[i]->dropped)
+      candidates[n++] = textures[i];
+  }
+  qsort(candidates, n, sizeof(*candidates), most_recent_first);
+  return n;
+}
+
+void texture_budget_frame(void) {
+  frame++;
+  unsigned long long budget = budget_bytes();
+  unsigned long long restore_below =
+      budget / 100 * TEXTURE_BUDGET_RESTORE_PERCENT;
+  size_t work = 0;
+
+  if (totals.resident > budget) {
+    int n = drop_candidates();
+    for (int i = 0; i < n && totals.resident > budget &&
+                    work < TEXTURE_BUDGET_FRAME_BYTES;
+         ++i)
+      work += set_dropped(candidates[i], candidates[i]->dropped + 1);
+    if (!n)
+      stats.over_frames++;
+  } else if (totals.resident < restore_below && totals.dropped) {
+    int n = restore_candidates();
+    for (int i = 0; i < n && work < TEXTURE_BUDGET_FRAME_BYTES; ++i) {
+      Texture *t = candidates[i];
+      size_t gain = t->levels[t->dropped - 1].memory;
+      if (totals.resident + gain > restore_below)
+        break;
+      work += set_dropped(t, t->dropped - 1);
+    }
+  }
+
+  if (frame % TEXTURE_BUDGET_LOG_FRAMES == 0)
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+               "texture_budget: %.1f of %d MB in %u textures, %.1f MB left "
+               "out of %u\n",
+               totals.resident / 1048576.0, config.texture_budget,
+               totals.textures, totals.saved / 1048576.0, totals.dropped);
+}
+
+void texture_budget_stats(TextureBudgetStats *out) { *out = totals; }
+
+static void write_csv(void) {
+  FILE *f = fopen(TEXTURE_BUDGET_CSV_NAME, "w");
+  if (!f) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "texture_budget: could not open %s\n", TEXTURE_BUDGET_CSV_NAME);
+    return;
+  }
+  fprintf(f, "texture,width,height,format,levels,bytes,resident,dropped,"
+             "drops,idle_frames\n");
+  for (GLuint i = 0; i < num_textures; ++i) {
+    const Texture *t = textures[i];
+    if (!t || !t->levels[0].present)
+      continue;
+    unsigned long long bytes = 0, resident = 0;
+    int levels = 0;
+    for (int j = 0; j < TEXTURE_BUDGET_MAX_LEVELS; ++j) {
+      const Level *l = &t->levels[j];
+      if (!l->present)
+        continue;
+      levels++;
+      bytes += l->memory * (t->cube ? 6 : 1);
+      if (j >= t->dropped)
+        resident += l->memory * (t->cube ? 6 : 1);
+    }
+    fprintf(f, "%u,%d,%d,0x%04x,%d,%llu,%llu,%d,%u,%u\n", t->name,
+            t->levels[0].width, t->levels[0].height,
+            t->levels[0].internalformat, levels, bytes, resident, t->dropped,
+            t->drops, frame - t->last_bound);
+  }
+  fclose(f);
+}
+
+void texture_budget_report(void) {
+  if (!totals.textures && !stats.peak)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "texture_budget: %.1f MB in %u textures at exit, peak %.1f of "
+             "%d MB; %u levels dropped and %u restored (%.1f MB uploaded), "
+             "%u frames over with nothing to drop, %.1f MB spilled\n",
+             totals.resident / 1048576.0, totals.textures,
+             stats.peak / 1048576.0, config.texture_budget, stats.drops,
+             stats.restores, stats.uploaded / 1048576.0, stats.over_frames,
+             stats.spilled / 1048576.0);
+  write_csv();
+}
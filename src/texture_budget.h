@@ -0,0 +1,68 @@
+/* texture_budget.h -- keeps the game's textures within a memory budget
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef TEXTURE_BUDGET_H
+#define TEXTURE_BUDGET_H
+
+#include <GLES2/gl2.h>
+
+// per-texture sizes are written here when the game exits
+#define TEXTURE_BUDGET_CSV_NAME "texmem.csv"
+// copies of the levels that can be dropped are kept in a deleted file here
+#define TEXTURE_BUDGET_SPILL_DIR "conf"
+// textures whose first level is smaller than this are never dropped
+#define TEXTURE_BUDGET_MIN_PIXELS (128 * 128)
+// at most this many top levels are left out of a texture
+#define TEXTURE_BUDGET_MAX_DROP 2
+// textures bound within this many frames are left alone
+#define TEXTURE_BUDGET_IDLE_FRAMES 60
+// levels are restored once the total is below this percentage of the budget
+#define TEXTURE_BUDGET_RESTORE_PERCENT 90
+// bytes re-uploaded per frame at most when dropping or restoring levels
+#define TEXTURE_BUDGET_FRAME_BYTES (4 * 1024 * 1024)
+#define TEXTURE_BUDGET_MAX_LEVELS 16
+// how often the totals are logged at debug level
+#define TEXTURE_BUDGET_LOG_FRAMES 600
+
+// functions the tracking imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLTEXIMAGE2DPROC glTexImage2D;
+  PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
+  PFNGLBINDTEXTUREPROC glBindTexture;
+  PFNGLDELETETEXTURESPROC glDeleteTextures;
+} TextureBudgetNext;
+
+typedef struct {
+  unsigned long long resident; // bytes in the textures as they are now
+  unsigned long long saved;    // bytes of the levels left out
+  unsigned int textures;
+  unsigned int dropped; // textures with levels left out
+} TextureBudgetStats;
+
+extern TextureBudgetNext texture_budget_next;
+
+// drops or restores levels as needed, called once per frame after swapping
+void texture_budget_frame(void);
+void texture_budget_stats(TextureBudgetStats *stats);
+// logs the totals and writes TEXTURE_BUDGET_CSV_NAME, call when the game
+// exits
+void texture_budget_report(void);
+
+void texture_budget_glTexImage2D(GLenum target, GLint level,
+                                 GLint internalformat, GLsizei width,
+                                 GLsizei height, GLint border, GLenum format,
+                                 GLenum type, const void *pixels);
+void texture_budget_glCompressedTexImage2D(GLenum target, GLint level,
+                                           GLenum internalformat,
+                                           GLsizei width, GLsizei height,
+                                           GLint border, GLsizei imageSize,
+                                           const void *data);
+void texture_budget_glBindTexture(GLenum target, GLuint texture);
+void texture_budget_glDeleteTextures(GLsizei n, const GLuint *textures);
+
+#endif // TEXTURE_BUDGET_H
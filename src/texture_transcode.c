@@ -0,0 +1,384 @@
+/* texture_transcode.c -- smaller formats for the game's RGB(A) textures
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Most of the game's textures come compressed, but the ones it uploads as
+// 8-bit RGB or RGBA take four to eight times the memory and bandwidth of a
+// compressed texture. With texture_transcode 1 those are converted to 16 bits
+// per pixel: RGB565 if the first level is opaque, RGBA5551 if its alpha is
+// only ever 0 or 255 and RGBA4444 otherwise. With texture_transcode 2 they
+// are encoded as ETC2 (RGB8, or RGBA8 with EAC alpha) if the driver takes it,
+// opaque ones as ETC1 if only that is there, and the rest as with 1.
+//
+// The format is picked from the first level and kept for the texture's other
+// levels, which must all be in the same format. Encoding is split by rows of
+// blocks over the thread pool; the results are saved to TEXTURE_TRANSCODE_DIR
+// under a hash of the pixels, so only the first run pays for it. The game
+// never updates part of a texture or lets GL make its mipmaps, and the upload
+// alignment is left at 4 bytes, which keeps this to whole levels.
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "error.h"
+#include "etc_encode.h"
+#include "log.h"
+#include "texture_transcode.h"
+#include "thread_pool.h"
+#include "util.h"
+
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
+#define CACHE_MAGIC "TEXETC01"
+// part of every key, to be changed when the encoder's output changes
+#define ENCODER_VERSION 1
+
+enum {
+  FORMAT_NONE,
+  FORMAT_RGB565,
+  FORMAT_RGBA5551,
+  FORMAT_RGBA4444,
+  FORMAT_ETC1,
+  FORMAT_ETC2_RGB,
+  FORMAT_ETC2_RGBA,
+};
+
+typedef struct {
+  char magic[8];
+  uint64_t key;
+  uint64_t checksum;
+  uint32_t format;
+  uint32_t length;
+} CacheHeader;
+
+// one level being converted
+typedef struct {
+  const uint8_t *pixels;
+  int width;
+  int height;
+  int bpp;
+  size_t stride;
+  int format;
+  uint8_t *out;
+  size_t out_stride; // bytes per row, or per row of blocks
+} Level;
+
+TextureTranscodeNext texture_transcode_next;
+
+static int initialized = 0;
+static int have_etc1 = 0;
+static int have_etc2 = 0;
+static uint8_t *texture_formats = NULL; // by texture name
+static GLuint num_texture_formats = 0;
+
+static struct {
+  unsigned int textures;
+  unsigned int encoded;
+  unsigned int loaded;
+  unsigned long long bytes_in;
+  unsigned long long bytes_out;
+  double encode_ms;
+  double load_ms;
+  double convert_ms;
+} stats;
+
+// the pixels can be megabytes, so eight bytes are mixed in at a time
+static uint64_t hash_pixels(uint64_t h, const uint8_t *p, size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, p + i, 8);
+    h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+    h ^= h >> 32;
+  }
+  return hash_bytes(h, p + i, size - i);
+}
+
+static int is_etc(int format) {
+  return format == FORMAT_ETC1 || format == FORMAT_ETC2_RGB ||
+         format == FORMAT_ETC2_RGBA;
+}
+
+static GLenum etc_gl_format(int format) {
+  return format == FORMAT_ETC1       ? GL_ETC1_RGB8_OES
+         : format == FORMAT_ETC2_RGB ? GL_COMPRESSED_RGB8_ETC2
+                                     : GL_COMPRESSED_RGBA8_ETC2_EAC;
+}
+
+static size_t level_size(int format, int width, int height) {
+  if (is_etc(format)) {
+    size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (format == FORMAT_ETC2_RGBA ? 16 : 8);
+  }
+  return (size_t)((width * 2 + 3) & ~3) * height;
+}
+
+static int choose_format(const uint8_t *pixels, int width, int height,
+                         int bpp, size_t stride) {
+  int opaque = 1, binary = 1;
+  for (int y = 0; y < height && bpp == 4 && binary; ++y) {
+    const uint8_t *row = pixels + y * stride;
+    for (int x = 0; x < width; ++x) {
+      uint8_t a = row[x * 4 + 3];
+      opaque &= a == 255;
+      binary &= a == 0 || a == 255;
+    }
+  }
+
+  if (config.texture_transcode >= 2) {
+    if (have_etc2)
+      return opaque ? FORMAT_ETC2_RGB : FORMAT_ETC2_RGBA;
+    if (have_etc1 && opaque)
+      return FORMAT_ETC1;
+  }
+  return opaque ? FORMAT_RGB565 : binary ? FORMAT_RGBA5551 : FORMAT_RGBA4444;
+}
+
+static int texture_format(GLuint texture) {
+  return texture < num_texture_formats ? texture_formats[texture]
+                                       : FORMAT_NONE;
+}
+
+static void set_texture_format(GLuint texture, int format) {
+  if (texture >= num_texture_formats) {
+    if (format == FORMAT_NONE)
+      return;
+    GLuint num = texture * 2 + 64;
+    uint8_t *formats = realloc(texture_formats, num);
+    if (!formats)
+      fatal_error("Failed to allocate texture formats");
+    memset(formats + num_texture_formats, 0, num - num_texture_formats);
+    texture_formats = formats;
+    num_texture_formats = num;
+  }
+  texture_formats[texture] = format;
+}
+
+// thread pool task for one row of pixels
+static void convert_row(void *arg, int y) {
+  const Level *l = arg;
+  const uint8_t *src = l->pixels + y * l->stride;
+  uint16_t *dst = (uint16_t *)(l->out + y * l->out_stride);
+  for (int x = 0; x < l->width; ++x, src += l->bpp) {
+    int a = l->bpp == 4 ? src[3] : 255;
+    if (l->format == FORMAT_RGB565)
+      dst[x] = (src[0] * 31 + 127) / 255 << 11 |
+               (src[1] * 63 + 127) / 255 << 5 | (src[2] * 31 + 127) / 255;
+    else if (l->format == FORMAT_RGBA5551)
+      dst[x] = (src[0] * 31 + 127) / 255 << 11 |
+               (src[1] * 31 + 127) / 255 << 6 |
+               (src[2] * 31 + 127) / 255 << 1 | (a >= 128);
+    else
+      dst[x] = (src[0] * 15 + 127) / 255 << 12 |
+               (src[1] * 15 + 127) / 255 << 8 |
+               (src[2] * 15 + 127) / 255 << 4 | (a * 15 + 127) / 255;
+  }
+}
+
+// thread pool task for one row of blocks; blocks past the edges repeat the
+// last column and row
+static void encode_row(void *arg, int by) {
+  const Level *l = arg;
+  int blocks_x = (l->width + 3) / 4;
+  uint8_t *out = l->out + by * l->out_stride;
+  for (int bx = 0; bx < blocks_x; ++bx) {
+    uint8_t block[16 * 4];
+    for (int y = 0; y < 4; ++y) {
+      int sy = by * 4 + y < l->height ? by * 4 + y : l->height - 1;
+      for (int x = 0; x < 4; ++x) {
+        int sx = bx * 4 + x < l->width ? bx * 4 + x : l->width - 1;
+        const uint8_t *p = l->pixels + sy * l->stride + sx * l->bpp;
+        uint8_t *q = block + (y * 4 + x) * 4;
+        q[0] = p[0];
+        q[1] = p[1];
+        q[2] = p[2];
+        q[3] = l->bpp == 4 ? p[3] : 255;
+      }
+    }
+    if (l->format == FORMAT_ETC2_RGBA) {
+      etc_encode_alpha(block, out);
+      out += 8;
+    }
+    etc_encode_rgb(block, out);
+    out += 8;
+  }
+}
+
+static void cache_name(char *buf, size_t size, uint64_t key) {
+  snprintf(buf, size, "%s/%016llx.bin", TEXTURE_TRANSCODE_DIR,
+           (unsigned long long)key);
+}
+
+static int load_cached(uint64_t key, int format, uint8_t *data,
+                       size_t length) {
+  char name[256];
+  cache_name(name, sizeof(name), key);
+  FILE *f = fopen(name, "rb");
+  if (!f)
+    return 0;
+  CacheHeader header;
+  int ok = fread(&header, sizeof(header), 1, f) == 1 &&
+           !memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) &&
+           header.key == key && header.format == (uint32_t)format &&
+           header.length == length && fread(data, length, 1, f) == 1 &&
+           hash_pixels(HASH_INIT, data, length) == header.checksum;
+  fclose(f);
+  if (!ok) {
+    LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_WARN,
+               "texture_transcode: %s is corrupt, encoding again\n", name);
+    unlink(name);
+  }
+  return ok;
+}
+
+static void save_cached(uint64_t key, int format, const uint8_t *data,
+                        size_t length) {
+  CacheHeader header = {.key = key, .format = format, .length = length};
+  memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  header.checksum = hash_pixels(HASH_INIT, data, length);
+
+  // written under another name first so that an interrupted write never
+  // leaves a file that looks complete
+  char name[256], tmp_name[260];
+  cache_name(name, sizeof(name), key);
+  snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", name);
+  FILE *f = fopen(tmp_name, "wb");
+  if (!f)
+    return;
+  int ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+           fwrite(data, length, 1, f) == 1;
+  if (fclose(f) == 0 && ok)
+    rename(tmp_name, name);
+  else
+    unlink(tmp_name);
+}
+
+static void encode_level(Level *l, uint8_t *data, size_t length) {
+  // the rows as given, without the padding at their ends
+  uint64_t key = HASH_INIT;
+  for (int y = 0; y < l->height; ++y)
+    key = hash_pixels(key, l->pixels + y * l->stride,
+                      (size_t)l->width * l->bpp);
+  uint32_t params[5] = {l->width, l->height, l->bpp, l->format,
+                        ENCODER_VERSION};
+  key = hash_pixels(key, (const uint8_t *)params, sizeof(params));
+
+  double start = now_ms();
+  if (load_cached(key, l->format, data, length)) {
+    stats.loaded++;
+    stats.load_ms += now_ms() - start;
+    return;
+  }
+  l->out = data;
+  l->out_stride = (size_t)((l->width + 3) / 4) *
+                  (l->format == FORMAT_ETC2_RGBA ? 16 : 8);
+  thread_pool_run(encode_row, l, (l->height + 3) / 4);
+  save_cached(key, l->format, data, length);
+  stats.encoded++;
+  stats.encode_ms += now_ms() - start;
+}
+
+void texture_transcode_init(void) {
+  const char *version = (const char *)glGetString(GL_VERSION);
+  have_etc1 = has_extension("GL_OES_compressed_ETC1_RGB8_texture");
+  // ETC2 is core in ES 3, which drivers often give for a 2.0 context
+  have_etc2 = (version && !strncmp(version, "OpenGL ES 3", 11)) ||
+              (has_extension("GL_OES_compressed_ETC2_RGB8_texture") &&
+               has_extension("GL_OES_compressed_ETC2_RGBA8_texture"));
+  if (config.texture_transcode >= 2)
+    mkdir(TEXTURE_TRANSCODE_DIR, 0755);
+  thread_pool_init();
+  initialized = 1;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "texture_transcode: to %s\n",
+             config.texture_transcode < 2 ? "16 bits"
+             : have_etc2                  ? "ETC2"
+             : have_etc1 ? "ETC1 if opaque, otherwise 16 bits"
+                         : "16 bits, the driver has no ETC");
+}
+
+void texture_transcode_report(void) {
+  if (!stats.textures)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "texture_transcode: %u textures, %.1f MB as %.1f MB; %u levels "
+             "encoded in %.1f ms, %u loaded in %.1f ms, %.1f ms converting\n",
+             stats.textures, stats.bytes_in / 1048576.0,
+             stats.bytes_out / 1048576.0, stats.encoded, stats.encode_ms,
+             stats.loaded, stats.load_ms, stats.convert_ms);
+}
+
+void texture_transcode_glTexImage2D(GLenum target, GLint level,
+                                    GLint internalformat, GLsizei width,
+                                    GLsizei height, GLint border,
+                                    GLenum format, GLenum type,
+                                    const void *pixels) {
+  if (!initialized || target != GL_TEXTURE_2D || !pixels || border ||
+      type != GL_UNSIGNED_BYTE || (format != GL_RGB && format != GL_RGBA) ||
+      internalformat != (GLint)format || width <= 0 || height <= 0) {
+    texture_transcode_next.glTexImage2D(target, level, internalformat, width,
+                                        height, border, format, type, pixels);
+    return;
+  }
+
+  Level l = {.pixels = pixels, .width = width, .height = height};
+  l.bpp = format == GL_RGBA ? 4 : 3;
+  l.stride = ((size_t)width * l.bpp + 3) & ~(size_t)3;
+  GLint texture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+  if (level == 0) {
+    l.format = width * height >= TEXTURE_TRANSCODE_MIN_PIXELS
+                   ? choose_format(l.pixels, width, height, l.bpp, l.stride)
+                   : FORMAT_NONE;
+    set_texture_format(texture, l.format);
+    if (l.format != FORMAT_NONE)
+      stats.textures++;
+  } else {
+    l.format = texture_format(texture);
+  }
+  if (l.format == FORMAT_NONE) {
+    texture_transcode_next.glTexImage2D(target, level, internalformat, width,
+                                        height, border, format, type, pixels);
+    return;
+  }
+
+  size_t length = level_size(l.format, width, height);
+  uint8_t *data = malloc(length);
+  if (!data)
+    fatal_error("Failed to allocate texture");
+  stats.bytes_in += (size_t)width * height * l.bpp;
+  stats.bytes_out += length;
+
+  if (is_etc(l.format)) {
+    encode_level(&l, data, length);
+    texture_transcode_next.glCompressedTexImage2D(
+        target, level, etc_gl_format(l.format), width, height, 0, length, data);
+  } else {
+    double start = now_ms();
+    l.out = data;
+    l.out_stride = (size_t)(width * 2 + 3) & ~(size_t)3;
+    thread_pool_run(convert_row, &l, height);
+    stats.convert_ms += now_ms() - start;
+    GLenum packed = l.format == FORMAT_RGB565     ? GL_UNSIGNED_SHORT_5_6_5
+                    : l.format == FORMAT_RGBA5551 ? GL_UNSIGNED_SHORT_5_5_5_1
+                                                  : GL_UNSIGNED_SHORT_4_4_4_4;
+    GLenum base = l.format == FORMAT_RGB565 ? GL_RGB : GL_RGBA;
+    texture_transcode_next.glTexImage2D(target, level, base, width, height, 0,
+                                        base, packed, data);
+  }
+  free(data);
+}
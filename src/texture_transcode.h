@@ -0,0 +1,39 @@
+/* texture_transcode.h -- smaller formats for the game's RGB(A) textures
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef TEXTURE_TRANSCODE_H
+#define TEXTURE_TRANSCODE_H
+
+#include <GLES2/gl2.h>
+
+// ETC encoded textures are kept here by a hash of their pixels
+#define TEXTURE_TRANSCODE_DIR "conf/texcache"
+// textures whose first level is smaller than this are left as they are
+#define TEXTURE_TRANSCODE_MIN_PIXELS (64 * 64)
+
+// functions the transcoding import forwards to, filled in by update_imports
+typedef struct {
+  PFNGLTEXIMAGE2DPROC glTexImage2D;
+  PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
+} TextureTranscodeNext;
+
+extern TextureTranscodeNext texture_transcode_next;
+
+// checks which formats the driver takes and starts the encoding threads;
+// call with the game's context current
+void texture_transcode_init(void);
+// logs how much was transcoded and saved, call when the game exits
+void texture_transcode_report(void);
+
+void texture_transcode_glTexImage2D(GLenum target, GLint level,
+                                    GLint internalformat, GLsizei width,
+                                    GLsizei height, GLint border,
+                                    GLenum format, GLenum type,
+                                    const void *pixels);
+
+#endif // TEXTURE_TRANSCODE_H
@@ -0,0 +1,330 @@
+/* texture_upload.c -- the game's texture uploads on a background thread
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// The engine uploads a level's textures while it loads and streams in more
+// as the player moves on, each glTexImage2D and glCompressedTexImage2D
+// blocking the game thread while the driver copies and converts the data.
+// With async_textures the data is copied and the upload is queued on the GL
+// worker, which binds the texture in its shared context and uploads it there.
+//
+// The worker's ticket for the last upload to a texture works as its fence.
+// A texture is only waited for when the game draws with it bound, when it is
+// attached to a framebuffer or deleted, or when the game uploads a level of it
+// that has to stay on the game thread (render targets without data). After a
+// wait the texture is bound again, as changes made in another context are
+// only guaranteed to be seen by a context that binds the object after they
+// are complete. If too much data is waiting for the worker, the game thread
+// waits for it to catch up before queuing more.
+//
+// Texture parameters are still set on the game thread while the data may be
+// on its way; they are separate from the levels the worker changes.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "draw_batch.h"
+#include "error.h"
+#include "gl_worker.h"
+#include "log.h"
+#include "texture_upload.h"
+#include "util.h"
+
+typedef struct {
+  GLenum target;  // of the upload
+  GLenum binding; // GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+  GLuint texture;
+  GLint level;
+  GLenum internalformat;
+  GLsizei width;
+  GLsizei height;
+  GLenum format; // for uncompressed levels
+  GLenum type;
+  int compressed;
+  GLsizei size;
+  uint8_t data[];
+} Upload;
+
+TextureUploadNext texture_upload_next;
+
+static int active = 0;
+static unsigned int *tickets = NULL; // by texture name, 0 once settled
+static GLuint num_tickets = 0;
+static unsigned int unsettled = 0; // textures with a ticket
+static unsigned int last_ticket = 0;
+static size_t queued_bytes = 0; // updated by the worker too
+static GLuint active_unit = 0;
+static GLuint bound_2d[TEXTURE_UPLOAD_MAX_UNITS];
+static GLuint bound_cube[TEXTURE_UPLOAD_MAX_UNITS];
+
+static struct {
+  unsigned int queued;
+  unsigned int direct;
+  unsigned long long bytes;
+  unsigned int waits;     // for a texture still being uploaded
+  unsigned int throttled; // for the queue to shrink
+  double wait_ms;
+} stats;
+
+void texture_upload_init(SDL_Window *window, SDL_GLContext context) {
+  active = gl_worker_init(window, context);
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "texture_upload: uploading on %s\n",
+             active ? "a worker" : "the game thread");
+}
+
+void texture_upload_report(void) {
+  if (!stats.queued && !stats.direct)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "texture_upload: %u levels (%.1f MB) uploaded on the worker, %u "
+             "on the game thread; waited %u times for a texture and %u for "
+             "the queue, %.1f ms in all\n",
+             stats.queued, stats.bytes / 1048576.0, stats.direct, stats.waits,
+             stats.throttled, stats.wait_ms);
+}
+
+static unsigned int texture_ticket(GLuint texture) {
+  return texture < num_tickets ? tickets[texture] : 0;
+}
+
+static void set_ticket(GLuint texture, unsigned int ticket) {
+  if (texture >= num_tickets) {
+    GLuint num = texture * 2 + 64;
+    unsigned int *grown = realloc(tickets, num * sizeof(*grown));
+    if (!grown)
+      fatal_error("Failed to allocate texture upload tickets");
+    memset(grown + num_tickets, 0, (num - num_tickets) * sizeof(*grown));
+    tickets = grown;
+    num_tickets = num;
+  }
+  if (!tickets[texture])
+    unsettled++;
+  tickets[texture] = ticket;
+}
+
+// waits for the texture's uploads if they're still going; returns nonzero if
+// it had any, in which case it must be bound again before it is used
+static int settle(GLuint texture) {
+  unsigned int ticket = texture_ticket(texture);
+  if (!ticket)
+    return 0;
+  if (!gl_worker_done(ticket)) {
+    double start = now_ms();
+    gl_worker_wait(ticket);
+    stats.waits++;
+    stats.wait_ms += now_ms() - start;
+  }
+  tickets[texture] = 0;
+  unsettled--;
+  return 1;
+}
+
+static void upload_job(void *arg) {
+  Upload *u = arg;
+  // straight to GL, not through texture_upload_next: the layers below this
+  // one keep state of the game thread's and must not run on the worker
+  glBindTexture(u->binding, u->texture);
+  if (u->compressed)
+    glCompressedTexImage2D(u->target, u->level, u->internalformat, u->width,
+                           u->height, 0, u->size, u->data);
+  else
+    glTexImage2D(u->target, u->level, u->internalformat, u->width, u->height,
+                 0, u->format, u->type, u->data);
+  __atomic_sub_fetch(&queued_bytes, u->size, __ATOMIC_RELAXED);
+  free(u);
+}
+
+// the upload's copy, or NULL if it has to be done on the game thread
+static Upload *start_upload(GLenum target, GLint border, const void *data,
+                            size_t size) {
+  if (!active || !data || border)
+    return NULL;
+  GLenum binding;
+  GLenum pname;
+  if (target == GL_TEXTURE_2D) {
+    binding = GL_TEXTURE_2D;
+    pname = GL_TEXTURE_BINDING_2D;
+  } else if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X &&
+             target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z) {
+    binding = GL_TEXTURE_CUBE_MAP;
+    pname = GL_TEXTURE_BINDING_CUBE_MAP;
+  } else {
+    return NULL;
+  }
+  GLint texture = 0;
+  glGetIntegerv(pname, &texture);
+  if (texture <= 0)
+    return NULL;
+
+  if (__atomic_load_n(&queued_bytes, __ATOMIC_RELAXED) + size >
+          TEXTURE_UPLOAD_MAX_QUEUED &&
+      !gl_worker_done(last_ticket)) {
+    double start = now_ms();
+    gl_worker_wait(last_ticket);
+    stats.throttled++;
+    stats.wait_ms += now_ms() - start;
+  }
+
+  Upload *u = malloc(sizeof(*u) + size);
+  if (!u)
+    fatal_error("Failed to allocate texture upload");
+  u->target = target;
+  u->binding = binding;
+  u->texture = texture;
+  u->size = size;
+  memcpy(u->data, data, size);
+  return u;
+}
+
+static void queue_upload(Upload *u) {
+  // the upload skips the layers below, so merged draws still held back are
+  // drawn before it changes the texture
+  draw_batch_flush();
+  __atomic_add_fetch(&queued_bytes, u->size, __ATOMIC_RELAXED);
+  stats.queued++;
+  stats.bytes += u->size;
+  GLuint texture = u->texture;
+  last_ticket = gl_worker_submit(upload_job, u);
+  set_ticket(texture, last_ticket);
+}
+
+// before an upload that stays on the game thread, so that the levels land
+// in the order the game gave them
+static void upload_directly(GLenum target) {
+  GLint texture = 0;
+  if (!active)
+    return;
+  stats.direct++;
+  if (!unsettled)
+    return;
+  glGetIntegerv(target == GL_TEXTURE_2D ? GL_TEXTURE_BINDING_2D
+                                        : GL_TEXTURE_BINDING_CUBE_MAP,
+                &texture);
+  if (texture > 0 && settle(texture))
+    glBindTexture(target == GL_TEXTURE_2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP,
+                  texture);
+}
+
+void texture_upload_glTexImage2D(GLenum target, GLint level,
+                                 GLint internalformat, GLsizei width,
+                                 GLsizei height, GLint border, GLenum format,
+                                 GLenum type, const void *pixels) {
+  size_t size = image_size(width, height, format, type);
+  Upload *u = start_upload(target, border, pixels, size);
+  if (!u) {
+    upload_directly(target);
+    texture_upload_next.glTexImage2D(target, level, internalformat, width,
+                                     height, border, format, type, pixels);
+    return;
+  }
+  u->compressed = 0;
+  u->level = level;
+  u->internalformat = internalformat;
+  u->width = width;
+  u->height = height;
+  u->format = format;
+  u->type = type;
+  queue_upload(u);
+}
+
+void texture_upload_glCompressedTexImage2D(GLenum target, GLint level,
+                                           GLenum internalformat,
+                                           GLsizei width, GLsizei height,
+                                           GLint border, GLsizei imageSize,
+                                           const void *data) {
+  Upload *u = start_upload(target, border, data, imageSize > 0 ? imageSize : 0);
+  if (!u) {
+    upload_directly(target);
+    texture_upload_next.glCompressedTexImage2D(target, level, internalformat,
+                                               width, height, border,
+                                               imageSize, data);
+    return;
+  }
+  u->compressed = 1;
+  u->level = level;
+  u->internalformat = internalformat;
+  u->width = width;
+  u->height = height;
+  queue_upload(u);
+}
+
+void texture_upload_glActiveTexture(GLenum texture) {
+  active_unit = texture - GL_TEXTURE0;
+  texture_upload_next.glActiveTexture(texture);
+}
+
+void texture_upload_glBindTexture(GLenum target, GLuint texture) {
+  if (active_unit < TEXTURE_UPLOAD_MAX_UNITS) {
+    if (target == GL_TEXTURE_2D)
+      bound_2d[active_unit] = texture;
+    else if (target == GL_TEXTURE_CUBE_MAP)
+      bound_cube[active_unit] = texture;
+  }
+  // the ticket isn't cleared even if the uploads are done: gl_state may drop
+  // this bind as redundant, so settle_bound binds the texture itself
+  texture_upload_next.glBindTexture(target, texture);
+}
+
+void texture_upload_glDeleteTextures(GLsizei n, const GLuint *textures) {
+  // the worker binds by name, which the game may soon get again
+  for (GLsizei i = 0; i < n && unsettled; ++i)
+    settle(textures[i]);
+  for (int i = 0; i < TEXTURE_UPLOAD_MAX_UNITS; ++i) {
+    for (GLsizei j = 0; j < n; ++j) {
+      if (bound_2d[i] == textures[j])
+        bound_2d[i] = 0;
+      if (bound_cube[i] == textures[j])
+        bound_cube[i] = 0;
+    }
+  }
+  texture_upload_next.glDeleteTextures(n, textures);
+}
+
+void texture_upload_glFramebufferTexture2D(GLenum target, GLenum attachment,
+                                           GLenum textarget, GLuint texture,
+                                           GLint level) {
+  if (unsettled)
+    settle(texture);
+  texture_upload_next.glFramebufferTexture2D(target, attachment, textarget,
+                                             texture, level);
+}
+
+// waits for the textures bound for the draw and binds them again
+static void settle_bound(void) {
+  int switched = 0;
+  for (GLuint i = 0; i < TEXTURE_UPLOAD_MAX_UNITS && unsettled; ++i) {
+    int settle_2d = settle(bound_2d[i]);
+    int settle_cube = settle(bound_cube[i]);
+    if (!settle_2d && !settle_cube)
+      continue;
+    if (i != active_unit) {
+      glActiveTexture(GL_TEXTURE0 + i);
+      switched = 1;
+    }
+    if (settle_2d)
+      glBindTexture(GL_TEXTURE_2D, bound_2d[i]);
+    if (settle_cube)
+      glBindTexture(GL_TEXTURE_CUBE_MAP, bound_cube[i]);
+  }
+  if (switched)
+    glActiveTexture(GL_TEXTURE0 + active_unit);
+}
+
+void texture_upload_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  if (unsettled)
+    settle_bound();
+  texture_upload_next.glDrawArrays(mode, first, count);
+}
+
+void texture_upload_glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                                   const void *indices) {
+  if (unsettled)
+    settle_bound();
+  texture_upload_next.glDrawElements(mode, count, type, indices);
+}
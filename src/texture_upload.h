@@ -0,0 +1,60 @@
+/* texture_upload.h -- the game's texture uploads on a background thread
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <GLES2/gl2.h>
+#include <SDL2/SDL_video.h>
+
+// texture units whose bindings are followed
+#define TEXTURE_UPLOAD_MAX_UNITS 16
+// bytes of copied levels waiting for the worker before the game thread waits
+#define TEXTURE_UPLOAD_MAX_QUEUED (64 * 1024 * 1024)
+
+// functions the uploading imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLTEXIMAGE2DPROC glTexImage2D;
+  PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
+  PFNGLACTIVETEXTUREPROC glActiveTexture;
+  PFNGLBINDTEXTUREPROC glBindTexture;
+  PFNGLDELETETEXTURESPROC glDeleteTextures;
+  PFNGLFRAMEBUFFERTEXTURE2DPROC glFramebufferTexture2D;
+  PFNGLDRAWARRAYSPROC glDrawArrays;
+  PFNGLDRAWELEMENTSPROC glDrawElements;
+} TextureUploadNext;
+
+extern TextureUploadNext texture_upload_next;
+
+// starts the GL worker, or shares the one already running; call with the
+// game's context current. Uploads stay on the game thread if it can't start.
+void texture_upload_init(SDL_Window *window, SDL_GLContext context);
+// logs how much was uploaded in the background and how long the game waited,
+// call when the game exits
+void texture_upload_report(void);
+
+void texture_upload_glTexImage2D(GLenum target, GLint level,
+                                 GLint internalformat, GLsizei width,
+                                 GLsizei height, GLint border, GLenum format,
+                                 GLenum type, const void *pixels);
+void texture_upload_glCompressedTexImage2D(GLenum target, GLint level,
+                                           GLenum internalformat,
+                                           GLsizei width, GLsizei height,
+                                           GLint border, GLsizei imageSize,
+                                           const void *data);
+void texture_upload_glActiveTexture(GLenum texture);
+void texture_upload_glBindTexture(GLenum target, GLuint texture);
+void texture_upload_glDeleteTextures(GLsizei n, const GLuint *textures);
+void texture_upload_glFramebufferTexture2D(GLenum target, GLenum attachment,
+                                           GLenum textarget, GLuint texture,
+                                           GLint level);
+void texture_upload_glDrawArrays(GLenum mode, GLint first, GLsizei count);
+void texture_upload_glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                                   const void *indices);
+
+#endif // TEXTURE_UPLOAD_H
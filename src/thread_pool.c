@@ -0,0 +1,118 @@
+/* thread_pool.c -- worker threads for splitting CPU-heavy work
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// A batch is a task and a count of indices. The threads and the caller take
+// the next index with an atomic increment until there are none left, so
+// uneven pieces of work even out, and the caller returns once every thread
+// has stopped taking. Only one batch runs at a time.
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "thread_pool.h"
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t threads[THREAD_POOL_MAX_THREADS];
+static int num_threads = 0;
+static int stop = 0;
+
+static ThreadPoolTask batch_task;
+static void *batch_arg;
+static int batch_count;
+static int next_index;
+static unsigned int batch = 0; // incremented for each batch
+static int busy = 0;           // threads still working on the batch
+
+static void take_indices(ThreadPoolTask task, void *arg, int count) {
+  int i;
+  while ((i = __atomic_fetch_add(&next_index, 1, __ATOMIC_RELAXED)) < count)
+    task(arg, i);
+}
+
+static void *thread_main(void *arg) {
+  (void)arg;
+  unsigned int seen = 0;
+  pthread_mutex_lock(&lock);
+  for (;;) {
+    while (batch == seen && !stop)
+      pthread_cond_wait(&batch_cond, &lock);
+    if (stop)
+      break;
+    seen = batch;
+    ThreadPoolTask task = batch_task;
+    void *task_arg = batch_arg;
+    int count = batch_count;
+    pthread_mutex_unlock(&lock);
+
+    take_indices(task, task_arg, count);
+
+    pthread_mutex_lock(&lock);
+    if (--busy == 0)
+      pthread_cond_signal(&done_cond);
+  }
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+void thread_pool_init(void) {
+  if (num_threads)
+    return;
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int wanted = cores > 1 ? (int)cores - 1 : 0;
+  if (wanted > THREAD_POOL_MAX_THREADS)
+    wanted = THREAD_POOL_MAX_THREADS;
+  while (num_threads < wanted &&
+         pthread_create(&threads[num_threads], NULL, thread_main, NULL) == 0)
+    num_threads++;
+  LOG_PRINTF(LOG_SYS_CORE, LOG_LEVEL_DEBUG, "thread_pool: %d threads\n",
+             num_threads);
+}
+
+void thread_pool_shutdown(void) {
+  if (!num_threads)
+    return;
+  pthread_mutex_lock(&lock);
+  stop = 1;
+  pthread_cond_broadcast(&batch_cond);
+  pthread_mutex_unlock(&lock);
+  for (int i = 0; i < num_threads; ++i)
+    pthread_join(threads[i], NULL);
+  num_threads = 0;
+  stop = 0;
+}
+
+void thread_pool_run(ThreadPoolTask task, void *arg, int count) {
+  if (!num_threads || count <= 1) {
+    for (int i = 0; i < count; ++i)
+      task(arg, i);
+    return;
+  }
+
+  pthread_mutex_lock(&run_lock);
+  pthread_mutex_lock(&lock);
+  batch_task = task;
+  batch_arg = arg;
+  batch_count = count;
+  next_index = 0;
+  busy = num_threads;
+  batch++;
+  pthread_cond_broadcast(&batch_cond);
+  pthread_mutex_unlock(&lock);
+
+  take_indices(task, arg, count);
+
+  pthread_mutex_lock(&lock);
+  while (busy)
+    pthread_cond_wait(&done_cond, &lock);
+  pthread_mutex_unlock(&lock);
+  pthread_mutex_unlock(&run_lock);
+}
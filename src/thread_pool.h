@@ -0,0 +1,24 @@
+/* thread_pool.h -- worker threads for splitting CPU-heavy work
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#define THREAD_POOL_MAX_THREADS 8
+
+typedef void (*ThreadPoolTask)(void *arg, int index);
+
+// starts a thread for each core but the one the caller runs on
+void thread_pool_init(void);
+void thread_pool_shutdown(void);
+// runs task(arg, i) for every i below count on the pool and the calling
+// thread, and returns once they all have; runs everything on the caller if
+// the pool isn't started
+void thread_pool_run(ThreadPoolTask task, void *arg, int count);
+
+#endif // THREAD_POOL_H
@@ -7,13 +7,16 @@
  * of the MIT license.  See the LICENSE file for details.
  */
 
+#include <GLES2/gl2.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "config.h"
+#include "log.h"
 #include "util.h"
 
 #ifdef DEBUG_LOG
@@ -33,18 +36,12 @@ void userAppExit(void) {
 
 int debugPrintf(char *text, ...) {
 #ifdef DEBUG_LOG
-  va_list list;
-
-  FILE *f = fopen(LOG_NAME, "a");
-  if (f) {
-    va_start(list, text);
-    vfprintf(f, text, list);
-    va_end(list);
-    fclose(f);
-  }
+  if (LOG_LEVEL_INFO > log_levels[LOG_SYS_CORE])
+    return 0;
 
+  va_list list;
   va_start(list, text);
-  vprintf(text, list);
+  log_vprintf(LOG_SYS_CORE, LOG_LEVEL_INFO, text, list);
   va_end(list);
 #endif
   return 0;
@@ -59,3 +56,58 @@ int ret0(void) {
 int ret1(void) { return 1; }
 
 int retm1(void) { return -1; }
+
+uint64_t hash_bytes(uint64_t h, const void *data, size_t size) {
+  const uint8_t *p = data;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+int pixel_size(unsigned int format, unsigned int type) {
+  if (type != GL_UNSIGNED_BYTE)
+    return 2; // the packed 16-bit types
+  switch (format) {
+  case GL_RGBA:
+    return 4;
+  case GL_RGB:
+    return 3;
+  case GL_LUMINANCE_ALPHA:
+    return 2;
+  default:
+    return 1;
+  }
+}
+
+size_t image_size(int width, int height, unsigned int format,
+                  unsigned int type) {
+  if (width <= 0 || height <= 0)
+    return 0;
+  size_t bpp = pixel_size(format, type);
+  size_t stride = ((size_t)width * bpp + 3) & ~(size_t)3;
+  return stride * (height - 1) + (size_t)width * bpp;
+}
+
+uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int has_extension(const char *name) {
+  const char *ext = (const char *)glGetString(GL_EXTENSIONS);
+  size_t len = strlen(name);
+  for (const char *p = ext; p && (p = strstr(p, name)); p += len) {
+    if ((p == ext || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+      return 1;
+  }
+  return 0;
+}
@@ -10,6 +10,7 @@
 #ifndef __UTIL_H__
 #define __UTIL_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 int debugPrintf(char *text, ...);
@@ -18,6 +19,24 @@ int ret0(void);
 int ret1(void);
 int retm1(void);
 
+// 64-bit FNV-1a, started from HASH_INIT or continued from an earlier hash
+#define HASH_INIT 0xcbf29ce484222325ull
+uint64_t hash_bytes(uint64_t h, const void *data, size_t size);
+
+// bytes per pixel of the game's uncompressed texture data
+int pixel_size(unsigned int format, unsigned int type);
+// bytes of a width by height image with rows aligned to 4, the unpack
+// alignment the game keeps; 0 if it is empty
+size_t image_size(int width, int height, unsigned int format,
+                  unsigned int type);
+
+// CLOCK_MONOTONIC time
+uint64_t now_ns(void);
+double now_ms(void);
+
+// whether the current GL context lists the extension
+int has_extension(const char *name);
+
 static inline void *armGetTlsRw(void) {
   void *ret;
   __asm__("mrs %x[data], s3_3_c13_c0_2" : [data] "=r"(ret));
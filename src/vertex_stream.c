@@ -0,0 +1,364 @@
+/* vertex_stream.c -- client-side vertex arrays streamed into buffers
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Some of the engine's draws take their vertices, and often their indices,
+// straight from its own memory. The driver then has to find the range of
+// vertices used and copy it somewhere the GPU can read on every draw, and
+// many drivers do that slowly. With vertex_stream those draws copy the
+// vertices they use into one large buffer and the indices into another,
+// one after the other, and the attribute pointers are pointed into the
+// buffer for the draw. A full buffer is orphaned with glBufferData, so the
+// driver gives it new memory instead of waiting for the GPU to be done with
+// the old, and filling starts over from the beginning.
+//
+// Attributes interleaved in the same array are copied together. The copied
+// range starts at the lowest vertex used, so indices are rebased while they
+// are copied when it isn't 0. Draws with client arrays but indices in a
+// buffer are left to the driver, as the indices can't be read back to find
+// the range. The game's own buffer bindings and client pointers are put back
+// after each draw, so the draws left to the driver read the game's arrays.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "log.h"
+#include "vertex_stream.h"
+
+#define ALIGN(x) (((x) + 15) & ~(size_t)15)
+
+typedef struct {
+  int enabled;
+  GLint size;
+  GLenum type;
+  GLboolean normalized;
+  GLsizei stride;
+  const uint8_t *pointer;
+  GLuint buffer; // bound to GL_ARRAY_BUFFER when the pointer was set
+} Attrib;
+
+// streamed attributes sharing one copied range
+typedef struct {
+  const uint8_t *base;
+  size_t stride;
+  size_t extent; // bytes of one vertex from base
+} Group;
+
+typedef struct {
+  GLuint name;
+  GLenum target;
+  size_t size;
+  size_t offset;
+} Ring;
+
+VertexStreamCounters vertex_stream_last_frame;
+VertexStreamNext vertex_stream_next;
+
+static Attrib attribs[VERTEX_STREAM_MAX_ATTRIBS];
+static GLuint array_buffer = 0;
+static GLuint element_buffer = 0;
+static Ring vertex_ring = {0, GL_ARRAY_BUFFER, VERTEX_STREAM_VERTEX_BYTES, 0};
+static Ring index_ring = {0, GL_ELEMENT_ARRAY_BUFFER,
+                          VERTEX_STREAM_INDEX_BYTES, 0};
+static uint8_t *scratch = NULL; // rebased indices
+static size_t scratch_size = 0;
+
+static VertexStreamCounters frame;
+static unsigned long long total_bytes = 0;
+static unsigned long long total_draws = 0;
+static unsigned int total_orphans = 0;
+static unsigned int frames = 0;
+
+static size_t type_size(GLenum type) {
+  switch (type) {
+  case GL_BYTE:
+  case GL_UNSIGNED_BYTE:
+    return 1;
+  case GL_SHORT:
+  case GL_UNSIGNED_SHORT:
+  case 0x8D61: // GL_HALF_FLOAT_OES
+    return 2;
+  default:
+    return 4;
+  }
+}
+
+static size_t attrib_stride(const Attrib *a) {
+  return a->stride ? (size_t)a->stride : a->size * type_size(a->type);
+}
+
+// room for size bytes in the ring, orphaning it if they don't fit; the ring
+// is left bound to its target
+static size_t reserve(Ring *r, size_t size) {
+  if (!r->name) {
+    glGenBuffers(1, &r->name);
+    glBindBuffer(r->target, r->name);
+    glBufferData(r->target, r->size, NULL, GL_STREAM_DRAW);
+  } else {
+    glBindBuffer(r->target, r->name);
+  }
+  if (r->offset + size > r->size) {
+    glBufferData(r->target, r->size, NULL, GL_STREAM_DRAW);
+    r->offset = 0;
+    frame.orphans++;
+  }
+  size_t offset = r->offset;
+  r->offset = ALIGN(offset + size);
+  frame.bytes += size;
+  return offset;
+}
+
+// the enabled attributes without a buffer, grouped by the array they're in;
+// returns the number of groups, and 0 if there are none
+static int find_groups(Group *groups, int *group_of) {
+  int order[VERTEX_STREAM_MAX_ATTRIBS], n = 0;
+  for (int i = 0; i < VERTEX_STREAM_MAX_ATTRIBS; ++i) {
+    const Attrib *a = &attribs[i];
+    if (!a->enabled || a->buffer)
+      continue;
+    // sorted by pointer so that an array's attributes come one after another
+    int j = n++;
+    for (; j > 0 && attribs[order[j - 1]].pointer > a->pointer; --j)
+      order[j] = order[j - 1];
+    order[j] = i;
+  }
+
+  int num_groups = 0;
+  for (int k = 0; k < n; ++k) {
+    const Attrib *a = &attribs[order[k]];
+    size_t stride = attrib_stride(a);
+    size_t extent = a->size * type_size(a->type);
+    Group *g = num_groups ? &groups[num_groups - 1] : NULL;
+    if (g && g->stride == stride && (size_t)(a->pointer - g->base) < stride) {
+      if ((size_t)(a->pointer - g->base) + extent > g->extent)
+        g->extent = a->pointer - g->base + extent;
+    } else {
+      g = &groups[num_groups++];
+      g->base = a->pointer;
+      g->stride = stride;
+      g->extent = extent;
+    }
+    group_of[order[k]] = num_groups - 1;
+  }
+  return num_groups;
+}
+
+// copies vertices first to last of the client arrays and points the
+// attributes at the copies, leaving the vertex ring bound; returns 0 if they
+// don't fit in the ring
+static int stream_vertices(const Group *groups, int num_groups,
+                           const int *group_of, GLuint first, GLuint last) {
+  size_t total = 0;
+  for (int g = 0; g < num_groups; ++g)
+    total += ALIGN((last - first) * groups[g].stride + groups[g].extent);
+  if (total > vertex_ring.size)
+    return 0;
+
+  // one block for all of the groups, so the ring is orphaned before any of
+  // them is copied rather than in between
+  size_t offsets[VERTEX_STREAM_MAX_ATTRIBS];
+  size_t offset = reserve(&vertex_ring, total);
+  for (int g = 0; g < num_groups; ++g) {
+    const Group *group = &groups[g];
+    size_t size = (last - first) * group->stride + group->extent;
+    offsets[g] = offset;
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size,
+                    group->base + first * group->stride);
+    offset += ALIGN(size);
+  }
+  for (int i = 0; i < VERTEX_STREAM_MAX_ATTRIBS; ++i) {
+    const Attrib *a = &attribs[i];
+    if (!a->enabled || a->buffer)
+      continue;
+    const Group *group = &groups[group_of[i]];
+    uintptr_t pointer = offsets[group_of[i]] + (a->pointer - group->base);
+    glVertexAttribPointer(i, a->size, a->type, a->normalized, a->stride,
+                          (const void *)pointer);
+  }
+  return 1;
+}
+
+// points the streamed attributes back at the game's client arrays and
+// rebinds the game's array buffer
+static void restore_pointers(void) {
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  for (int i = 0; i < VERTEX_STREAM_MAX_ATTRIBS; ++i) {
+    const Attrib *a = &attribs[i];
+    if (a->enabled && !a->buffer)
+      glVertexAttribPointer(i, a->size, a->type, a->normalized, a->stride,
+                            a->pointer);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, array_buffer);
+}
+
+static void index_range(GLenum type, const void *indices, GLsizei count,
+                        GLuint *min, GLuint *max) {
+  GLuint lo = 0xffffffffu, hi = 0;
+#define RANGE(T)                                                               \
+  for (GLsizei i = 0; i < count; ++i) {                                        \
+    GLuint v = ((const T *)indices)[i];                                        \
+    lo = v < lo ? v : lo;                                                      \
+    hi = v > hi ? v : hi;                                                      \
+  }
+  if (type == GL_UNSIGNED_BYTE)
+    RANGE(uint8_t)
+  else if (type == GL_UNSIGNED_SHORT)
+    RANGE(uint16_t)
+  else
+    RANGE(uint32_t)
+#undef RANGE
+  *min = lo;
+  *max = hi;
+}
+
+// the indices with base taken off each
+static const void *rebase(GLenum type, const void *indices, GLsizei count,
+                          GLuint base) {
+  size_t size = count * type_size(type);
+  if (size > scratch_size) {
+    uint8_t *grown = realloc(scratch, size);
+    if (!grown)
+      fatal_error("Failed to allocate vertex stream indices");
+    scratch = grown;
+    scratch_size = size;
+  }
+#define REBASE(T)                                                              \
+  for (GLsizei i = 0; i < count; ++i)                                          \
+    ((T *)scratch)[i] = ((const T *)indices)[i] - base;
+  if (type == GL_UNSIGNED_BYTE)
+    REBASE(uint8_t)
+  else if (type == GL_UNSIGNED_SHORT)
+    REBASE(uint16_t)
+  else
+    REBASE(uint32_t)
+#undef REBASE
+  return scratch;
+}
+
+void vertex_stream_glBindBuffer(GLenum target, GLuint buffer) {
+  if (target == GL_ARRAY_BUFFER)
+    array_buffer = buffer;
+  else if (target == GL_ELEMENT_ARRAY_BUFFER)
+    element_buffer = buffer;
+  vertex_stream_next.glBindBuffer(target, buffer);
+}
+
+// deleting a bound buffer resets the binding to 0
+void vertex_stream_glDeleteBuffers(GLsizei n, const GLuint *buffers) {
+  for (GLsizei i = 0; i < n; ++i) {
+    if (buffers[i] == array_buffer)
+      array_buffer = 0;
+    if (buffers[i] == element_buffer)
+      element_buffer = 0;
+  }
+  vertex_stream_next.glDeleteBuffers(n, buffers);
+}
+
+void vertex_stream_glVertexAttribPointer(GLuint index, GLint size,
+                                         GLenum type, GLboolean normalized,
+                                         GLsizei stride, const void *pointer) {
+  if (index < VERTEX_STREAM_MAX_ATTRIBS) {
+    Attrib *a = &attribs[index];
+    a->size = size;
+    a->type = type;
+    a->normalized = normalized;
+    a->stride = stride;
+    a->pointer = pointer;
+    a->buffer = array_buffer;
+  }
+  vertex_stream_next.glVertexAttribPointer(index, size, type, normalized,
+                                           stride, pointer);
+}
+
+void vertex_stream_glEnableVertexAttribArray(GLuint index) {
+  if (index < VERTEX_STREAM_MAX_ATTRIBS)
+    attribs[index].enabled = 1;
+  vertex_stream_next.glEnableVertexAttribArray(index);
+}
+
+void vertex_stream_glDisableVertexAttribArray(GLuint index) {
+  if (index < VERTEX_STREAM_MAX_ATTRIBS)
+    attribs[index].enabled = 0;
+  vertex_stream_next.glDisableVertexAttribArray(index);
+}
+
+void vertex_stream_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  Group groups[VERTEX_STREAM_MAX_ATTRIBS];
+  int group_of[VERTEX_STREAM_MAX_ATTRIBS];
+  int num_groups = count > 0 ? find_groups(groups, group_of) : 0;
+  if (!num_groups ||
+      !stream_vertices(groups, num_groups, group_of, first, first + count - 1)) {
+    vertex_stream_next.glDrawArrays(mode, first, count);
+    return;
+  }
+  frame.draws++;
+  vertex_stream_next.glDrawArrays(mode, 0, count);
+  restore_pointers();
+}
+
+void vertex_stream_glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                                  const void *indices) {
+  Group groups[VERTEX_STREAM_MAX_ATTRIBS];
+  int group_of[VERTEX_STREAM_MAX_ATTRIBS];
+  int num_groups = count > 0 ? find_groups(groups, group_of) : 0;
+  size_t index_bytes = count * type_size(type);
+  if (count <= 0 || element_buffer || index_bytes > index_ring.size) {
+    if (element_buffer && num_groups)
+      frame.skipped++;
+    vertex_stream_next.glDrawElements(mode, count, type, indices);
+    return;
+  }
+
+  if (num_groups) {
+    GLuint min, max;
+    index_range(type, indices, count, &min, &max);
+    if (!stream_vertices(groups, num_groups, group_of, min, max)) {
+      vertex_stream_next.glDrawElements(mode, count, type, indices);
+      return;
+    }
+    if (min)
+      indices = rebase(type, indices, count, min);
+  }
+
+  size_t offset = reserve(&index_ring, index_bytes);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, index_bytes, indices);
+  frame.draws++;
+  vertex_stream_next.glDrawElements(mode, count, type,
+                                    (const void *)(uintptr_t)offset);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer);
+  if (num_groups)
+    restore_pointers();
+}
+
+void vertex_stream_frame(void) {
+  vertex_stream_last_frame = frame;
+  total_bytes += frame.bytes;
+  total_draws += frame.draws;
+  total_orphans += frame.orphans;
+  memset(&frame, 0, sizeof(frame));
+
+  if (++frames % VERTEX_STREAM_REPORT_FRAMES)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_DEBUG,
+             "vertex_stream: %.1f draws and %.1f KB per frame so far, last "
+             "frame %u draws and %.1f KB\n",
+             (double)total_draws / frames, total_bytes / 1024.0 / frames,
+             vertex_stream_last_frame.draws,
+             vertex_stream_last_frame.bytes / 1024.0);
+}
+
+void vertex_stream_report(void) {
+  if (!frames)
+    return;
+  LOG_PRINTF(LOG_SYS_GL, LOG_LEVEL_INFO,
+             "vertex_stream: %llu draws and %.1f MB streamed in %u frames, "
+             "%.1f KB per frame, buffers orphaned %u times\n",
+             total_draws, total_bytes / 1048576.0, frames,
+             total_bytes / 1024.0 / frames, total_orphans);
+}
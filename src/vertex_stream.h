@@ -0,0 +1,61 @@
+/* vertex_stream.h -- client-side vertex arrays streamed into buffers
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+
+#include <GLES2/gl2.h>
+
+#define VERTEX_STREAM_MAX_ATTRIBS 16
+// sizes of the buffers the vertices and the indices are streamed into; draws
+// with more data than fits are left as they are
+#define VERTEX_STREAM_VERTEX_BYTES (4 * 1024 * 1024)
+#define VERTEX_STREAM_INDEX_BYTES (1024 * 1024)
+// frames between reports in the log
+#define VERTEX_STREAM_REPORT_FRAMES 600
+
+typedef struct {
+  unsigned int draws;   // draws that had client arrays streamed
+  unsigned int skipped; // client arrays with indices in a buffer
+  unsigned int orphans; // times a buffer was full and started over
+  unsigned long bytes;
+} VertexStreamCounters;
+
+// counts of the last finished frame
+extern VertexStreamCounters vertex_stream_last_frame;
+
+// functions the streaming imports forward to, filled in by update_imports
+typedef struct {
+  PFNGLBINDBUFFERPROC glBindBuffer;
+  PFNGLDELETEBUFFERSPROC glDeleteBuffers;
+  PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
+  PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
+  PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
+  PFNGLDRAWARRAYSPROC glDrawArrays;
+  PFNGLDRAWELEMENTSPROC glDrawElements;
+} VertexStreamNext;
+
+extern VertexStreamNext vertex_stream_next;
+
+// called once per frame at swap
+void vertex_stream_frame(void);
+// logs the bytes streamed per frame, call when the game exits
+void vertex_stream_report(void);
+
+void vertex_stream_glBindBuffer(GLenum target, GLuint buffer);
+void vertex_stream_glDeleteBuffers(GLsizei n, const GLuint *buffers);
+void vertex_stream_glVertexAttribPointer(GLuint index, GLint size,
+                                         GLenum type, GLboolean normalized,
+                                         GLsizei stride, const void *pointer);
+void vertex_stream_glEnableVertexAttribArray(GLuint index);
+void vertex_stream_glDisableVertexAttribArray(GLuint index);
+void vertex_stream_glDrawArrays(GLenum mode, GLint first, GLsizei count);
+void vertex_stream_glDrawElements(GLenum mode, GLsizei count, GLenum type,
+                                  const void *indices);
+
+#endif // VERTEX_STREAM_H
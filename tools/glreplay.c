@@ -0,0 +1,937 @@
+/* glreplay.c -- plays back GL traces written by gl_recorder
+ *
+ * Copyright (C) 2025 Jaakko Lukkari
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+// Replays a gltrace.bin on an offscreen EGL context (a pbuffer, or with -x a
+// surfaceless context rendering into an FBO, e.g. Mesa's llvmpipe) and
+// reports how long each recorded frame takes to submit. The GL layers of the
+// wrapper can be put between the trace and GL to measure what they save:
+//
+//   glreplay [-s | -S] [-u] [-b | -B] [-p | -P] [-t 1|2] [-f] [-x] [-v]
+//            [-o frames.csv] gltrace.bin
+//
+//   -s  drop redundant state changes (gl_state_cache 1), -S to also verify
+//   -u  drop repeated uniform uploads (gl_uniform_cache 1)
+//   -b  merge consecutive draws (draw_batch 1), -B to also replay without it
+//       in a second process and compare the frames
+//   -p  lower fragment shader precision (shader_precision 1), -P to also
+//       replay without it in a second process and compare the frames
+//   -t  convert RGB(A) textures to 16 bits or ETC (texture_transcode 1 or
+//       2), keeping the ETC ones in conf/texcache under the current directory
+//   -f  glFinish after each frame and report the total frame time too
+//   -o  write per-frame times as CSV
+//   -x  use a surfaceless context instead of a pbuffer
+//   -v  print the GL layers' log output
+
+#define _GNU_SOURCE
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "draw_batch.h"
+#include "error.h"
+#include "gl_state.h"
+#include "gl_trace.h"
+#include "gl_uniforms.h"
+#include "log.h"
+#include "shader_precision.h"
+#include "texture_transcode.h"
+#include "thread_pool.h"
+
+// what the GL layers expect from the rest of the wrapper
+Config config;
+uint8_t log_levels[LOG_SYS_COUNT];
+
+void log_printf(LogSubsystem sys, LogLevel level, const char *fmt, ...) {
+  va_list va;
+  (void)sys;
+  (void)level;
+  va_start(va, fmt);
+  vfprintf(stderr, fmt, va);
+  va_end(va);
+}
+
+void log_vprintf(LogSubsystem sys, LogLevel level, const char *fmt,
+                 va_list va) {
+  (void)sys;
+  (void)level;
+  vfprintf(stderr, fmt, va);
+}
+
+void fatal_error(const char *fmt, ...) {
+  va_list va;
+  va_start(va, fmt);
+  vfprintf(stderr, fmt, va);
+  va_end(va);
+  fputc('\n', stderr);
+  exit(1);
+}
+
+#define FUNC(name, ...) __typeof__(&name) name;
+#define REPLAY_SPECIAL_CALLS(X)                                                \
+  X(glGenTextures)                                                             \
+  X(glGenBuffers)                                                              \
+  X(glGenFramebuffers)                                                         \
+  X(glGenRenderbuffers)                                                        \
+  X(glDeleteTextures)                                                          \
+  X(glDeleteBuffers)                                                           \
+  X(glDeleteFramebuffers)                                                      \
+  X(glDeleteRenderbuffers)                                                     \
+  X(glCreateProgram)                                                           \
+  X(glCreateShader)                                                            \
+  X(glShaderSource)                                                            \
+  X(glGetUniformLocation)                                                      \
+  X(glGetAttribLocation)                                                       \
+  X(glBindAttribLocation)                                                      \
+  X(glBufferData)                                                              \
+  X(glTexImage2D)                                                              \
+  X(glCompressedTexImage2D)                                                    \
+  X(glUniform1fv)                                                              \
+  X(glUniform2fv)                                                              \
+  X(glUniform3fv)                                                              \
+  X(glUniform4fv)                                                              \
+  X(glUniformMatrix3fv)                                                        \
+  X(glUniformMatrix4fv)                                                        \
+  X(glVertexAttrib4fv)                                                         \
+  X(glVertexAttribPointer)                                                     \
+  X(glDrawArrays)                                                              \
+  X(glDrawElements)                                                            \
+  X(glReadPixels)
+
+// the functions replayed calls go to, GL itself or the wrapper's layers
+static struct {
+  GL_TRACE_CALLS(FUNC, FUNC, FUNC, FUNC, FUNC, FUNC)
+  GL_TRACE_TRACKED_CALLS(FUNC, FUNC, FUNC, FUNC, FUNC, FUNC)
+  REPLAY_SPECIAL_CALLS(FUNC)
+} gl;
+
+// recorded object names to ours
+typedef struct {
+  GLuint *names;
+  uint32_t size;
+} NameMap;
+
+// recorded uniform locations of a program to ours, stored + 2 so that 0 is
+// unmapped
+typedef struct {
+  GLint *locations;
+  int size;
+} LocationMap;
+
+static NameMap textures, buffers, framebuffers, renderbuffers;
+static NameMap objects; // programs and shaders share their names
+static LocationMap *location_maps;
+static uint32_t num_location_maps;
+static GLuint current_program = 0;  // as recorded
+static GLuint bound_array_buffer = 0; // ours
+static GLuint default_framebuffer = 0;
+
+static EGLDisplay display;
+static EGLSurface surface = EGL_NO_SURFACE;
+static void *scratch = NULL;
+static size_t scratch_size = 0;
+
+static void *grow(void *p, size_t old_count, size_t new_count, size_t size) {
+  p = realloc(p, new_count * size);
+  if (!p)
+    fatal_error("out of memory");
+  memset((char *)p + old_count * size, 0, (new_count - old_count) * size);
+  return p;
+}
+
+static GLuint map_name(const NameMap *m, GLuint name) {
+  if (name && name < m->size && m->names[name])
+    return m->names[name];
+  return name;
+}
+
+static void set_name(NameMap *m, GLuint recorded, GLuint name) {
+  if (recorded >= m->size) {
+    uint32_t size = recorded * 2 + 16;
+    m->names = grow(m->names, m->size, size, sizeof(GLuint));
+    m->size = size;
+  }
+  m->names[recorded] = name;
+}
+
+static GLuint map_framebuffer(GLuint name) {
+  return name ? map_name(&framebuffers, name) : default_framebuffer;
+}
+
+static GLint map_location(GLint location) {
+  if (location < 0 || current_program >= num_location_maps)
+    return location;
+  LocationMap *m = &location_maps[current_program];
+  if (location < m->size && m->locations[location])
+    return m->locations[location] - 2;
+  return location;
+}
+
+static void set_location(GLuint program, GLint recorded, GLint location) {
+  if (recorded < 0)
+    return;
+  if (program >= num_location_maps) {
+    uint32_t num = program * 2 + 16;
+    location_maps =
+        grow(location_maps, num_location_maps, num, sizeof(LocationMap));
+    num_location_maps = num;
+  }
+  LocationMap *m = &location_maps[program];
+  if (recorded >= m->size) {
+    int size = recorded * 2 + 16;
+    m->locations = grow(m->locations, m->size, size, sizeof(GLint));
+    m->size = size;
+  }
+  m->locations[recorded] = location + 2;
+}
+
+static void *scratch_buffer(size_t size) {
+  if (scratch_size < size) {
+    scratch = grow(scratch, 0, size, 1);
+    scratch_size = size;
+  }
+  return scratch;
+}
+
+static GLuint *map_names(const NameMap *m, GLsizei n, const GLuint *names) {
+  GLuint *out = scratch_buffer(n * sizeof(GLuint));
+  for (GLsizei i = 0; i < n; ++i)
+    out[i] = map_name(m, names[i]);
+  return out;
+}
+
+#define GET_ENUM(a) (a).u
+#define GET_BITS(a) (a).u
+#define GET_BOOL(a) (GLboolean)(a).u
+#define GET_INT(a) (a).i
+#define GET_UINT(a) (a).u
+#define GET_SIZEI(a) (a).i
+#define GET_FLOAT(a) (a).f
+#define GET_LOC(a) map_location((a).i)
+#define GET_TEX(a) map_name(&textures, (a).u)
+#define GET_BUF(a) map_name(&buffers, (a).u)
+#define GET_FB(a) map_framebuffer((a).u)
+#define GET_RB(a) map_name(&renderbuffers, (a).u)
+#define GET_PROG(a) map_name(&objects, (a).u)
+#define GET_SHADER(a) map_name(&objects, (a).u)
+
+#define CASE0(name)                                                            \
+  case GL_TRACE_OP_##name:                                                     \
+    gl.name();                                                                 \
+    break;
+#define CASE1(name, A)                                                         \
+  case GL_TRACE_OP_##name:                                                     \
+    gl.name(GET_##A(a[0]));                                                    \
+    break;
+#define CASE2(name, A, B)                                                      \
+  case GL_TRACE_OP_##name:                                                     \
+    gl.name(GET_##A(a[0]), GET_##B(a[1]));                                     \
+    break;
+#define CASE3(name, A, B, C)                                                   \
+  case GL_TRACE_OP_##name:                                                     \
+    gl.name(GET_##A(a[0]), GET_##B(a[1]), GET_##C(a[2]));                      \
+    break;
+#define CASE4(name, A, B, C, D)                                                \
+  case GL_TRACE_OP_##name:                                                     \
+    gl.name(GET_##A(a[0]), GET_##B(a[1]), GET_##C(a[2]), GET_##D(a[3]));       \
+    break;
+#define CASE5(name, A, B, C, D, E)                                             \
+  case GL_TRACE_OP_##name:                                                     \
+    gl.name(GET_##A(a[0]), GET_##B(a[1]), GET_##C(a[2]), GET_##D(a[3]),        \
+            GET_##E(a[4]));                                                    \
+    break;
+
+#define CASE_GEN(name, map)                                                    \
+  case GL_TRACE_OP_##name: {                                                   \
+    const GLuint *recorded = data;                                             \
+    GLuint *names = scratch_buffer(a[0].i * sizeof(GLuint));                   \
+    gl.name(a[0].i, names);                                                    \
+    for (GLsizei i = 0; i < a[0].i; ++i)                                       \
+      set_name(&map, recorded[i], names[i]);                                   \
+    break;                                                                     \
+  }
+#define CASE_DELETE(name, map)                                                 \
+  case GL_TRACE_OP_##name:                                                     \
+    gl.name(a[0].i, map_names(&map, a[0].i, data));                            \
+    break;
+
+static void replay_call(const GlTraceCall *c, const GlTraceArg *a,
+                        const void *data) {
+  switch (c->op) {
+    GL_TRACE_CALLS(CASE0, CASE1, CASE2, CASE3, CASE4, CASE5)
+    GL_TRACE_TRACKED_CALLS(CASE0, CASE1, CASE2, CASE3, CASE4, CASE5)
+    CASE_GEN(glGenTextures, textures)
+    CASE_GEN(glGenBuffers, buffers)
+    CASE_GEN(glGenFramebuffers, framebuffers)
+    CASE_GEN(glGenRenderbuffers, renderbuffers)
+    CASE_DELETE(glDeleteTextures, textures)
+    CASE_DELETE(glDeleteBuffers, buffers)
+    CASE_DELETE(glDeleteFramebuffers, framebuffers)
+    CASE_DELETE(glDeleteRenderbuffers, renderbuffers)
+  case GL_TRACE_OP_glCreateProgram:
+    set_name(&objects, a[0].u, gl.glCreateProgram());
+    break;
+  case GL_TRACE_OP_glCreateShader:
+    set_name(&objects, a[1].u, gl.glCreateShader(a[0].u));
+    break;
+  case GL_TRACE_OP_glShaderSource: {
+    const GLchar *source = data;
+    GLint length = c->data_size ? c->data_size - 1 : 0;
+    gl.glShaderSource(GET_SHADER(a[0]), 1, &source, &length);
+    break;
+  }
+  case GL_TRACE_OP_glGetUniformLocation:
+    set_location(a[0].u, a[1].i,
+                 gl.glGetUniformLocation(GET_PROG(a[0]), data));
+    break;
+  case GL_TRACE_OP_glGetAttribLocation:
+    // attribute indices are used as recorded, which holds on the same driver
+    gl.glGetAttribLocation(GET_PROG(a[0]), data);
+    break;
+  case GL_TRACE_OP_glBindAttribLocation:
+    gl.glBindAttribLocation(GET_PROG(a[0]), a[1].u, data);
+    break;
+  case GL_TRACE_OP_glBufferData:
+    gl.glBufferData(a[0].u, a[1].i, c->data_size ? data : NULL, a[2].u);
+    break;
+  case GL_TRACE_OP_glTexImage2D:
+    gl.glTexImage2D(a[0].u, a[1].i, a[2].i, a[3].i, a[4].i, a[5].i, a[6].u,
+                    a[7].u, c->data_size ? data : NULL);
+    break;
+  case GL_TRACE_OP_glCompressedTexImage2D:
+    gl.glCompressedTexImage2D(a[0].u, a[1].i, a[2].u, a[3].i, a[4].i, a[5].i,
+                              a[6].i, data);
+    break;
+  case GL_TRACE_OP_glUniform1fv:
+    gl.glUniform1fv(GET_LOC(a[0]), a[1].i, data);
+    break;
+  case GL_TRACE_OP_glUniform2fv:
+    gl.glUniform2fv(GET_LOC(a[0]), a[1].i, data);
+    break;
+  case GL_TRACE_OP_glUniform3fv:
+    gl.glUniform3fv(GET_LOC(a[0]), a[1].i, data);
+    break;
+  case GL_TRACE_OP_glUniform4fv:
+    gl.glUniform4fv(GET_LOC(a[0]), a[1].i, data);
+    break;
+  case GL_TRACE_OP_glUniformMatrix3fv:
+    gl.glUniformMatrix3fv(GET_LOC(a[0]), a[1].i, a[2].u, data);
+    break;
+  case GL_TRACE_OP_glUniformMatrix4fv:
+    gl.glUniformMatrix4fv(GET_LOC(a[0]), a[1].i, a[2].u, data);
+    break;
+  case GL_TRACE_OP_glVertexAttrib4fv:
+    gl.glVertexAttrib4fv(a[0].u, data);
+    break;
+  case GL_TRACE_OP_glVertexAttribPointer:
+    gl.glVertexAttribPointer(a[0].u, a[1].i, a[2].u, a[3].u, a[4].i,
+                             (const void *)(uintptr_t)a[5].u);
+    break;
+  case GL_TRACE_OP_CLIENT_ARRAY: {
+    // GL only reads from the first vertex on, which is where the data starts
+    const char *base = (const char *)data - (size_t)a[5].i * a[4].i;
+    if (bound_array_buffer)
+      gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl.glVertexAttribPointer(a[0].u, a[1].i, a[2].u, a[3].u, a[4].i, base);
+    if (bound_array_buffer)
+      gl.glBindBuffer(GL_ARRAY_BUFFER, bound_array_buffer);
+    break;
+  }
+  case GL_TRACE_OP_glDrawArrays:
+    gl.glDrawArrays(a[0].u, a[1].i, a[2].i);
+    break;
+  case GL_TRACE_OP_glDrawElements:
+    gl.glDrawElements(a[0].u, a[1].i, a[2].u,
+                      c->data_size ? data : (const void *)(uintptr_t)a[3].u);
+    break;
+  case GL_TRACE_OP_glReadPixels:
+    gl.glReadPixels(a[0].i, a[1].i, a[2].i, a[3].i, a[4].u, a[5].u,
+                    scratch_buffer((size_t)a[2].i * a[3].i * 4));
+    break;
+  default:
+    fatal_error("unknown op %u in trace", c->op);
+  }
+
+  // replay state the mapping depends on
+  if (c->op == GL_TRACE_OP_glUseProgram)
+    current_program = a[0].u;
+  else if (c->op == GL_TRACE_OP_glBindBuffer && a[0].u == GL_ARRAY_BUFFER)
+    bound_array_buffer = GET_BUF(a[1]);
+}
+
+static void init_egl(int width, int height, int surfaceless) {
+  static const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2,
+                                           EGL_NONE};
+  EGLint config_attribs[] = {EGL_SURFACE_TYPE,
+                             surfaceless ? 0 : EGL_PBUFFER_BIT,
+                             EGL_RENDERABLE_TYPE,
+                             EGL_OPENGL_ES2_BIT,
+                             EGL_RED_SIZE,
+                             8,
+                             EGL_GREEN_SIZE,
+                             8,
+                             EGL_BLUE_SIZE,
+                             8,
+                             EGL_DEPTH_SIZE,
+                             surfaceless ? 0 : 24,
+                             EGL_STENCIL_SIZE,
+                             surfaceless ? 0 : 8,
+                             EGL_NONE};
+  EGLConfig egl_config;
+  EGLint num_configs;
+
+  // without a display server Mesa's surfaceless platform still has pbuffers
+  display = EGL_NO_DISPLAY;
+  if (!surfaceless) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && !eglInitialize(display, NULL, NULL))
+      display = EGL_NO_DISPLAY;
+  }
+  if (display == EGL_NO_DISPLAY) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (void *)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display)
+      display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                     EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+      fatal_error("could not initialize EGL");
+  }
+  eglBindAPI(EGL_OPENGL_ES_API);
+  if (!eglChooseConfig(display, config_attribs, &egl_config, 1,
+                       &num_configs) ||
+      num_configs < 1)
+    fatal_error("no suitable EGL config");
+  EGLContext context = eglCreateContext(display, egl_config, EGL_NO_CONTEXT,
+                                        context_attribs);
+  if (context == EGL_NO_CONTEXT)
+    fatal_error("could not create a GLES2 context");
+
+  if (!surfaceless) {
+    const EGLint surface_attribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height,
+                                      EGL_NONE};
+    surface = eglCreatePbufferSurface(display, egl_config, surface_attribs);
+    if (surface == EGL_NO_SURFACE)
+      fatal_error("could not create a %dx%d pbuffer", width, height);
+  }
+  if (!eglMakeCurrent(display, surface, surface, context))
+    fatal_error("could not make the context current");
+
+  if (surfaceless) {
+    // stands in for the window's framebuffer
+    GLuint color, depth;
+    glGenTextures(1, &color);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8_OES, width,
+                          height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &default_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, default_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, depth);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      fatal_error("could not create a %dx%d framebuffer", width, height);
+  }
+  glViewport(0, 0, width, height);
+
+  printf("GL_RENDERER: %s\n", glGetString(GL_RENDERER));
+}
+
+// replace_import for the layers that wrap all of GL at once
+static uintptr_t replace_call(const char *symbol, uintptr_t func) {
+  uintptr_t previous = 0;
+#define REPLACE(name, ...)                                                     \
+  if (!strcmp(symbol, #name)) {                                                \
+    previous = (uintptr_t)gl.name;                                             \
+    gl.name = (void *)func;                                                    \
+  }
+  GL_TRACE_CALLS(REPLACE, REPLACE, REPLACE, REPLACE, REPLACE, REPLACE)
+  GL_TRACE_TRACKED_CALLS(REPLACE, REPLACE, REPLACE, REPLACE, REPLACE, REPLACE)
+  REPLAY_SPECIAL_CALLS(REPLACE)
+#undef REPLACE
+  if (!previous)
+    fatal_error("%s is not replayed", symbol);
+  return previous;
+}
+
+static void install_layers(int batch, int state_cache, int uniform_cache,
+                           int precision, int transcode) {
+#define REAL(name, ...) gl.name = &name;
+  GL_TRACE_CALLS(REAL, REAL, REAL, REAL, REAL, REAL)
+  GL_TRACE_TRACKED_CALLS(REAL, REAL, REAL, REAL, REAL, REAL)
+  REPLAY_SPECIAL_CALLS(REAL)
+#undef REAL
+
+  // in the same order as update_imports
+  config.draw_batch = batch;
+  if (batch)
+    draw_batch_install(replace_call);
+#define LAYER(layer, name)                                                     \
+  do {                                                                         \
+    layer##_next.name = gl.name;                                               \
+    gl.name = &layer##_##name;                                                 \
+  } while (0)
+  config.gl_state_cache = state_cache;
+  if (state_cache) {
+    LAYER(gl_state, glBindTexture);
+    LAYER(gl_state, glActiveTexture);
+    LAYER(gl_state, glUseProgram);
+    LAYER(gl_state, glEnable);
+    LAYER(gl_state, glDisable);
+    LAYER(gl_state, glBlendFunc);
+    LAYER(gl_state, glBlendFuncSeparate);
+    LAYER(gl_state, glDepthMask);
+    LAYER(gl_state, glDepthFunc);
+    LAYER(gl_state, glCullFace);
+    LAYER(gl_state, glFrontFace);
+    LAYER(gl_state, glBindBuffer);
+    LAYER(gl_state, glDeleteTextures);
+    LAYER(gl_state, glDeleteBuffers);
+    gl_state_invalidate();
+  }
+  config.shader_precision = precision;
+  if (precision)
+    LAYER(shader_precision, glShaderSource);
+  config.gl_uniform_cache = uniform_cache;
+  if (uniform_cache) {
+    LAYER(gl_uniforms, glUseProgram);
+    LAYER(gl_uniforms, glLinkProgram);
+    LAYER(gl_uniforms, glDeleteProgram);
+    LAYER(gl_uniforms, glGetUniformLocation);
+    LAYER(gl_uniforms, glUniform1f);
+    LAYER(gl_uniforms, glUniform1fv);
+    LAYER(gl_uniforms, glUniform1i);
+    LAYER(gl_uniforms, glUniform2fv);
+    LAYER(gl_uniforms, glUniform3f);
+    LAYER(gl_uniforms, glUniform3fv);
+    LAYER(gl_uniforms, glUniform4fv);
+    LAYER(gl_uniforms, glUniformMatrix3fv);
+    LAYER(gl_uniforms, glUniformMatrix4fv);
+  }
+  config.texture_transcode = transcode;
+  if (transcode) {
+    LAYER(texture_transcode, glTexImage2D);
+    texture_transcode_next.glCompressedTexImage2D = gl.glCompressedTexImage2D;
+    mkdir("conf", 0755);
+    texture_transcode_init();
+  }
+#undef LAYER
+}
+
+static double now_ms(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void print_stats(const char *what, double *ms, int n) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i)
+    sum += ms[i];
+  qsort(ms, n, sizeof(*ms), compare_double);
+  printf("%-8s mean %7.3f  median %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n",
+         what, sum / n, ms[n / 2], ms[n * 95 / 100], ms[n * 99 / 100],
+         ms[n - 1]);
+}
+
+// the frame as it is in the window's framebuffer, whatever the game has bound
+static void read_frame(uint8_t *pixels, int width, int height) {
+  GLint bound;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound);
+  glBindFramebuffer(GL_FRAMEBUFFER, default_framebuffer);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glBindFramebuffer(GL_FRAMEBUFFER, bound);
+}
+
+static void write_all(int fd, const void *buf, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t n = write(fd, (const char *)buf + done, size - done);
+    if (n <= 0)
+      fatal_error("could not send a reference frame");
+    done += n;
+  }
+}
+
+static void read_all(int fd, void *buf, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t n = read(fd, (char *)buf + done, size - done);
+    if (n <= 0)
+      fatal_error("the reference replay ended early");
+    done += n;
+  }
+}
+
+typedef struct {
+  unsigned int frame;
+  int max_diff;   // largest difference of a color channel
+  double differs; // % of pixels with a channel more than 8 off
+  double psnr;    // dB, 99 for identical frames
+} FrameDiff;
+
+static FrameDiff compare_frames(const uint8_t *a, const uint8_t *b,
+                                int width, int height) {
+  FrameDiff d = {0};
+  double sum = 0;
+  size_t differing = 0, num = (size_t)width * height;
+  for (size_t i = 0; i < num; ++i) {
+    int pixel_diff = 0;
+    for (int c = 0; c < 3; ++c) {
+      int diff = abs(a[i * 4 + c] - b[i * 4 + c]);
+      sum += diff * diff;
+      if (diff > pixel_diff)
+        pixel_diff = diff;
+    }
+    if (pixel_diff > d.max_diff)
+      d.max_diff = pixel_diff;
+    differing += pixel_diff > 8;
+  }
+  double mse = sum / (num * 3);
+  d.differs = 100.0 * differing / num;
+  d.psnr = mse > 0 ? fmin(10 * log10(255.0 * 255.0 / mse), 99) : 99;
+  return d;
+}
+
+static void write_ppm(const char *name, const uint8_t *pixels, int width,
+                      int height) {
+  FILE *f = fopen(name, "wb");
+  if (!f)
+    fatal_error("could not write %s", name);
+  fprintf(f, "P6\n%d %d\n255\n", width, height);
+  // GL's rows go from the bottom up
+  for (int y = height - 1; y >= 0; --y) {
+    for (int x = 0; x < width; ++x)
+      fwrite(&pixels[((size_t)y * width + x) * 4], 3, 1, f);
+  }
+  fclose(f);
+}
+
+static int compare_psnr(const void *a, const void *b) {
+  double x = ((const FrameDiff *)a)->psnr, y = ((const FrameDiff *)b)->psnr;
+  return x < y ? -1 : x > y;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: glreplay [-s | -S] [-u] [-b | -B] [-p | -P] "
+                  "[-t 1|2] [-f] [-x] [-v] [-o frames.csv] gltrace.bin\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  int state_cache = 0, uniform_cache = 0, finish = 0, surfaceless = 0;
+  int batch = 0, precision = 0, validate = 0, transcode = 0;
+  const char *csv_name = NULL;
+  int opt;
+  memset(log_levels, LOG_LEVEL_WARN, sizeof(log_levels));
+  while ((opt = getopt(argc, argv, "sSubBpPt:fxvo:")) != -1) {
+    switch (opt) {
+    case 's':
+      state_cache = 1;
+      break;
+    case 'S':
+      state_cache = 2;
+      break;
+    case 'u':
+      uniform_cache = 1;
+      break;
+    case 'b':
+      batch = 1;
+      break;
+    case 'B':
+      batch = 1;
+      validate = 1;
+      break;
+    case 'p':
+      precision = 1;
+      break;
+    case 'P':
+      precision = 1;
+      validate = 1;
+      break;
+    case 't':
+      transcode = atoi(optarg);
+      if (transcode < 1 || transcode > 2)
+        usage();
+      break;
+    case 'f':
+      finish = 1;
+      break;
+    case 'x':
+      surfaceless = 1;
+      break;
+    case 'v':
+      memset(log_levels, LOG_LEVEL_DEBUG, sizeof(log_levels));
+      break;
+    case 'o':
+      csv_name = optarg;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (optind != argc - 1)
+    usage();
+
+  int fd = open(argv[optind], O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0)
+    fatal_error("could not open %s", argv[optind]);
+  const uint8_t *trace =
+      mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  if (trace == MAP_FAILED)
+    fatal_error("could not map %s", argv[optind]);
+  const uint8_t *end = trace + st.st_size;
+
+  const GlTraceHeader *header = (const GlTraceHeader *)trace;
+  if ((size_t)st.st_size < sizeof(*header) ||
+      memcmp(header->magic, GL_TRACE_MAGIC, sizeof(header->magic)) ||
+      header->version != GL_TRACE_VERSION)
+    fatal_error("%s is not a version %d GL trace", argv[optind],
+                GL_TRACE_VERSION);
+  int width = header->width ? header->width : 1280;
+  int height = header->height ? header->height : 720;
+
+  // the reference frames are rendered by a child process of its own, forked
+  // before either has a GL context, and sent over a pipe frame by frame
+  int reference = 0, frame_pipe[2];
+  pid_t child = 0;
+  if (validate) {
+    if (pipe(frame_pipe) < 0 || (child = fork()) < 0)
+      fatal_error("could not start the reference replay");
+    reference = child == 0;
+    if (reference) {
+      close(frame_pipe[0]);
+      batch = 0;
+      precision = 0;
+      csv_name = NULL;
+      if (!freopen("/dev/null", "w", stdout))
+        fatal_error("could not silence the reference replay");
+    } else {
+      close(frame_pipe[1]);
+    }
+  }
+
+  init_egl(width, height, surfaceless);
+  install_layers(batch, state_cache, uniform_cache, precision, transcode);
+
+  size_t frame_size = (size_t)width * height * 4;
+  uint8_t *pixels = NULL, *ref_pixels = NULL, *worst = NULL;
+  FrameDiff *diffs = NULL;
+  double worst_psnr = 0;
+  if (validate) {
+    pixels = malloc(frame_size);
+    ref_pixels = malloc(frame_size);
+    worst = malloc(frame_size * 2);
+    if (!pixels || !ref_pixels || !worst)
+      fatal_error("out of memory");
+  }
+
+  // frames are counted as recorded, only those from start_frame on are timed
+  int max_frames = 1024, num_frames = 0;
+  double *submit = malloc(max_frames * sizeof(double));
+  double *cpu = malloc(max_frames * sizeof(double));
+  double *total = malloc(max_frames * sizeof(double));
+  if (validate && !reference)
+    diffs = malloc(max_frames * sizeof(FrameDiff));
+  unsigned long state_skipped = 0, uniforms_skipped = 0;
+  unsigned long batch_draws = 0, batch_batches = 0;
+  unsigned int frame = 0;
+  unsigned long calls = 0;
+  double frame_start = now_ms(CLOCK_MONOTONIC);
+  double cpu_start = now_ms(CLOCK_THREAD_CPUTIME_ID);
+  double setup_start = frame_start;
+
+  const uint8_t *p = trace + sizeof(*header);
+  while (p + sizeof(GlTraceCall) <= end) {
+    const GlTraceCall *c = (const GlTraceCall *)p;
+    const GlTraceArg *a = (const GlTraceArg *)(c + 1);
+    const uint8_t *data = (const uint8_t *)(a + c->num_args);
+    p = data + ((c->data_size + 3) & ~3u);
+    if (p > end) {
+      fprintf(stderr, "trace is truncated\n");
+      break;
+    }
+
+    if (c->op != GL_TRACE_OP_FRAME) {
+      replay_call(c, a, data);
+      calls++;
+      continue;
+    }
+
+    if (batch)
+      draw_batch_flush();
+    double submitted = now_ms(CLOCK_MONOTONIC);
+    double cpu_end = now_ms(CLOCK_THREAD_CPUTIME_ID);
+    if (finish)
+      glFinish();
+    double done = now_ms(CLOCK_MONOTONIC);
+    if (surface != EGL_NO_SURFACE)
+      eglSwapBuffers(display, surface);
+
+    if (frame == header->start_frame && frame > 0)
+      printf("setup: %u frames without draws in %.1f ms\n", frame,
+             submitted - setup_start);
+    if (frame >= header->start_frame) {
+      if (num_frames == max_frames) {
+        max_frames *= 2;
+        submit = realloc(submit, max_frames * sizeof(double));
+        cpu = realloc(cpu, max_frames * sizeof(double));
+        total = realloc(total, max_frames * sizeof(double));
+        if (diffs)
+          diffs = realloc(diffs, max_frames * sizeof(FrameDiff));
+        if (!submit || !cpu || !total || (validate && !reference && !diffs))
+          fatal_error("out of memory");
+      }
+      submit[num_frames] = submitted - frame_start;
+      cpu[num_frames] = cpu_end - cpu_start;
+      total[num_frames] = done - frame_start;
+      num_frames++;
+    }
+    if (validate && frame >= header->start_frame) {
+      read_frame(pixels, width, height);
+      if (reference) {
+        write_all(frame_pipe[1], pixels, frame_size);
+      } else {
+        read_all(frame_pipe[0], ref_pixels, frame_size);
+        FrameDiff d = compare_frames(ref_pixels, pixels, width, height);
+        d.frame = frame;
+        if (num_frames == 1 || d.psnr < worst_psnr) {
+          worst_psnr = d.psnr;
+          memcpy(worst, ref_pixels, frame_size);
+          memcpy(worst + frame_size, pixels, frame_size);
+        }
+        diffs[num_frames - 1] = d;
+      }
+    }
+    if (state_cache)
+      gl_state_frame();
+    if (uniform_cache)
+      gl_uniforms_frame();
+    if (batch)
+      draw_batch_frame();
+    if (frame >= header->start_frame) {
+      for (int i = 0; i < GL_STATE_NUM_COUNTERS; ++i)
+        state_skipped += gl_state_last_frame.skipped[i];
+      uniforms_skipped += gl_uniforms_last_frame.skipped;
+      batch_draws += draw_batch_last_frame.draws;
+      batch_batches += draw_batch_last_frame.batches;
+    }
+    frame++;
+    frame_start = now_ms(CLOCK_MONOTONIC);
+    cpu_start = now_ms(CLOCK_THREAD_CPUTIME_ID);
+  }
+
+  if (reference)
+    return 0;
+  if (!num_frames)
+    fatal_error("no frames from frame %u on in the trace",
+                header->start_frame);
+  if (validate) {
+    int status;
+    close(frame_pipe[0]);
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      fatal_error("the reference replay failed");
+  }
+
+  if (csv_name) {
+    FILE *csv = fopen(csv_name, "w");
+    if (!csv)
+      fatal_error("could not write %s", csv_name);
+    fprintf(csv, "frame,submit_ms,cpu_ms,total_ms%s\n",
+            validate ? ",max_diff,differs_pct,psnr_db" : "");
+    for (int i = 0; i < num_frames; ++i) {
+      fprintf(csv, "%u,%.4f,%.4f,%.4f", header->start_frame + i, submit[i],
+              cpu[i], total[i]);
+      if (validate)
+        fprintf(csv, ",%d,%.3f,%.2f", diffs[i].max_diff, diffs[i].differs,
+                diffs[i].psnr);
+      fputc('\n', csv);
+    }
+    fclose(csv);
+  }
+
+  printf("%d frames, %lu calls replayed, %dx%d\n", num_frames, calls, width,
+         height);
+  print_stats("submit", submit, num_frames);
+  print_stats("cpu", cpu, num_frames);
+  if (finish)
+    print_stats("total", total, num_frames);
+  if (state_cache)
+    printf("state changes dropped: %.1f per frame\n",
+           (double)state_skipped / num_frames);
+  if (uniform_cache)
+    printf("uniform uploads dropped: %.1f per frame\n",
+           (double)uniforms_skipped / num_frames);
+  if (batch)
+    printf("draws merged: %.1f into %.1f per frame\n",
+           (double)batch_draws / num_frames,
+           (double)batch_batches / num_frames);
+
+  if (validate) {
+    double psnr_sum = 0;
+    for (int i = 0; i < num_frames; ++i)
+      psnr_sum += diffs[i].psnr;
+    qsort(diffs, num_frames, sizeof(*diffs), compare_psnr);
+    // the worst frame is written as <name>_ref.ppm and <name>_<changed>.ppm
+    const char *name = precision ? "precision" : "batch";
+    const char *changed = precision ? "lowered" : "merged";
+    char ref_name[32], changed_name[32];
+    snprintf(ref_name, sizeof(ref_name), "%s_ref.ppm", name);
+    snprintf(changed_name, sizeof(changed_name), "%s_%s.ppm", name, changed);
+    printf("%s: mean PSNR %.2f dB, worst frames:\n",
+           precision && batch ? "lowered precision and merged draws"
+           : precision        ? "lowered precision"
+                              : "merged draws",
+           psnr_sum / num_frames);
+    for (int i = 0; i < num_frames && i < 5; ++i)
+      printf("  frame %u: PSNR %.2f dB, max diff %d, %.3f%% of pixels off by "
+             "more than 8\n",
+             diffs[i].frame, diffs[i].psnr, diffs[i].max_diff,
+             diffs[i].differs);
+    if (diffs[0].max_diff) {
+      write_ppm(ref_name, worst, width, height);
+      write_ppm(changed_name, worst + frame_size, width, height);
+      printf("frame %u written to %s and %s\n", diffs[0].frame, ref_name,
+             changed_name);
+    }
+  }
+  if (transcode) {
+    // the layer's summary is shown without -v too
+    if (log_levels[LOG_SYS_GL] < LOG_LEVEL_INFO)
+      log_levels[LOG_SYS_GL] = LOG_LEVEL_INFO;
+    texture_transcode_report();
+    thread_pool_shutdown();
+  }
+  return 0;
+}